@@ -0,0 +1,202 @@
+/*
+ * Segmented append buffer, chain of BLOCK-sized blocks aligned to BLOCK.
+ *
+ * The append pointer is end position in the sense of Logical.hxx: blocks are aligned to their size, so offset of the
+ * pointer within the block is the pointer masked by BLOCK-1 and offset 0 means the block is full.  Each block starts
+ * with header (link to the next block and end of the data), so the pointer never starts at offset 0.  Fast path of
+ * single record append is therefore the logical_cmpAddFirst check with immediate mask, without loading any block
+ * limit.  Batch append checks the whole batch by single comparison, the slow path finishes the current block and
+ * chains new one.  Records are never split across blocks.  clear() rewinds to the first block and keeps the chain, so
+ * buffer flushed and reused in steady state does not allocate.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+
+#ifndef AppendBuffer_hxx__
+# define AppendBuffer_hxx__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <new>
+#include <stdexcept>
+
+#include "Logical.hxx"
+
+// Smallest power of two not less than value
+constexpr long appendBufferRoundUp(long value, long power = 1)
+{
+	return power >= value ? power : appendBufferRoundUp(value, power*2);
+}
+
+template <long BLOCK>
+class AppendBuffer
+{
+public:
+	static_assert((BLOCK&(BLOCK-1)) == 0 && BLOCK >= 64, "BLOCK must be power of two, at least 64");
+
+	struct Header
+	{
+		Header *next;
+		uint8_t *end;
+	};
+
+	static constexpr long HEADER = sizeof(Header);
+	// Largest record or batch stored within single block
+	static constexpr long CAPACITY = BLOCK-HEADER;
+
+	AppendBuffer():
+		first(NULL),
+		last(NULL),
+		pos(NULL),
+		blockCount(0)
+	{
+		chain();
+	}
+
+	~AppendBuffer()
+	{
+		for (Header *block = first; block != NULL; ) {
+			Header *next = block->next;
+			free(block);
+			block = next;
+		}
+	}
+
+	AppendBuffer(const AppendBuffer &) = delete;
+
+	AppendBuffer &operator=(const AppendBuffer &) = delete;
+
+	// Appends trivially copyable record, up to half of the block.  The check is for the size rounded up to power of two,
+	// the slow path takes the rest exactly.
+	template <typename T>
+	void append(const T &record)
+	{
+		static_assert(sizeof(T) <= BLOCK/2, "record larger than half of the block");
+		if (__builtin_expect(LogicalCmpAddFirst<BLOCK, appendBufferRoundUp(sizeof(T))>::fits((long)pos), 1)) {
+			memcpy(pos, &record, sizeof(T));
+			pos += sizeof(T);
+		}
+		else {
+			appendSlow(&record, sizeof(T));
+		}
+	}
+
+	// Appends count records, checking whether the whole batch fits into the current block at once
+	template <typename T>
+	void appendBatch(const T *records, size_t count)
+	{
+		size_t size = count*sizeof(T);
+		// subCmp with runtime size, (pos-1)&(BLOCK-1) wraps to BLOCK-1 for full block
+		if (__builtin_expect((((uintptr_t)pos-1)&(BLOCK-1)) < BLOCK-size && size <= (size_t)CAPACITY, 1)) {
+			memcpy(pos, records, size);
+			pos += size;
+		}
+		else {
+			appendBatchSlow(records, count, sizeof(T));
+		}
+	}
+
+	// Discards the content, keeps the blocks allocated for further appends
+	void clear()
+	{
+		last = first;
+		pos = (uint8_t *)first+HEADER;
+		blockCount = 1;
+	}
+
+	// Total bytes appended
+	size_t size() const
+	{
+		size_t total = 0;
+		forEachBlock([&total](const uint8_t *, size_t length) { total += length; });
+		return total;
+	}
+
+	// Blocks in use
+	size_t blocks() const
+	{
+		return blockCount;
+	}
+
+	// Calls consumer(data, length) for each block, in order of appending
+	template <typename Consumer>
+	void forEachBlock(Consumer consumer) const
+	{
+		for (Header *block = first; ; block = block->next) {
+			const uint8_t *data = (const uint8_t *)block+HEADER;
+			if (block == last) {
+				consumer(data, pos-data);
+				break;
+			}
+			consumer(data, block->end-data);
+		}
+	}
+
+private:
+	// Bytes left in the current block
+	size_t remaining() const
+	{
+		return BLOCK-1-(((uintptr_t)pos-1)&(BLOCK-1));
+	}
+
+	__attribute__((noinline))
+	void appendSlow(const void *record, size_t size)
+	{
+		if (remaining() < size)
+			chain();
+		memcpy(pos, record, size);
+		pos += size;
+	}
+
+	__attribute__((noinline))
+	void appendBatchSlow(const void *records, size_t count, size_t recordSize)
+	{
+		if (recordSize > (size_t)CAPACITY)
+			throw std::length_error("record larger than block capacity");
+		const uint8_t *source = (const uint8_t *)records;
+		while (count > 0) {
+			size_t fitting = remaining()/recordSize;
+			if (fitting == 0) {
+				chain();
+				continue;
+			}
+			fitting = count < fitting ? count : fitting;
+			memcpy(pos, source, fitting*recordSize);
+			pos += fitting*recordSize;
+			source += fitting*recordSize;
+			count -= fitting;
+		}
+	}
+
+	// Moves to the next block, reusing the block kept by clear() if any
+	void chain()
+	{
+		Header *block = last != NULL ? last->next : NULL;
+		if (block == NULL) {
+			void *memory;
+			if (posix_memalign(&memory, BLOCK, BLOCK) != 0)
+				throw std::bad_alloc();
+			block = (Header *)memory;
+			block->next = NULL;
+			if (last != NULL)
+				last->next = block;
+			else
+				first = block;
+		}
+		block->end = NULL;
+		if (last != NULL)
+			last->end = pos;
+		last = block;
+		pos = (uint8_t *)block+HEADER;
+		++blockCount;
+	}
+
+	Header *first;
+	Header *last;
+	uint8_t *pos;
+	size_t blockCount;
+};
+
+#endif
@@ -0,0 +1,379 @@
+/*
+ * Benchmark of AppendBuffer on logging records.
+ *
+ * Appends stream of 24-byte logging records (timestamp, event, thread, argument) and 8-byte records with:
+ * - append: AppendBuffer single record append, cmpAddFirst check with immediate mask on fast path.
+ * - batch: AppendBuffer batch append of BATCH records, single check per batch.
+ * - naive: the same segmented buffer checking pos+size > end against block end kept in memory.
+ * - vector: std::vector push_back, growing by reallocation.
+ *
+ * Each variant is verified to store the same stream first.  Results are nanoseconds per record, best of REPEAT runs:
+ * - fresh: each run starts with new buffer, so the block allocation, page faults and vector growth are included.
+ * - reused: each run starts with cleared buffer keeping its memory, the steady state of periodically flushed log.
+ * - hot: the buffer is cleared every HOT_RECORDS records, so the data stays in cache and the append path dominates.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <vector>
+
+#include "AppendBuffer.hxx"
+
+
+static const size_t RECORDS = 1<<22;
+static const size_t BATCH = 16;
+// Records between clears in hot test, buffer and records stay in cache
+static const size_t HOT_RECORDS = 1024;
+static const int REPEAT = 5;
+
+struct LogRecord {
+	uint64_t timestamp;
+	uint32_t event;
+	uint32_t thread;
+	uint64_t argument;
+};
+
+struct SmallRecord {
+	uint64_t timestamp;
+};
+
+// Segmented buffer with conventional bounds check against the block end
+template <long BLOCK>
+class NaiveBuffer
+{
+public:
+	NaiveBuffer():
+		current(0)
+	{
+		blocks.push_back(allocate());
+		pos = blocks[0];
+		end = pos+BLOCK;
+	}
+
+	~NaiveBuffer()
+	{
+		for (uint8_t *block: blocks)
+			free(block);
+	}
+
+	NaiveBuffer(const NaiveBuffer &) = delete;
+
+	NaiveBuffer &operator=(const NaiveBuffer &) = delete;
+
+	template <typename T>
+	void append(const T &record)
+	{
+		if (__builtin_expect(pos+sizeof(T) > end, 0))
+			chain();
+		memcpy(pos, &record, sizeof(T));
+		pos += sizeof(T);
+	}
+
+	void clear()
+	{
+		current = 0;
+		pos = blocks[0];
+		end = pos+BLOCK;
+	}
+
+	template <typename Consumer>
+	void forEachBlock(Consumer consumer) const
+	{
+		for (size_t i = 0; i <= current; ++i)
+			consumer(blocks[i], (i == current ? pos : ends[i])-blocks[i]);
+	}
+
+private:
+	static uint8_t *allocate()
+	{
+		uint8_t *block = (uint8_t *)malloc(BLOCK);
+		if (block == NULL)
+			throw std::bad_alloc();
+		return block;
+	}
+
+	__attribute__((noinline))
+	void chain()
+	{
+		ends.resize(current+1);
+		ends[current] = pos;
+		if (++current == blocks.size())
+			blocks.push_back(allocate());
+		pos = blocks[current];
+		end = pos+BLOCK;
+	}
+
+	uint8_t *pos;
+	uint8_t *end;
+	size_t current;
+	std::vector<uint8_t *> blocks;
+	std::vector<uint8_t *> ends;
+};
+
+template <typename T>
+static T makeRecord(size_t i);
+
+template <>
+LogRecord makeRecord<LogRecord>(size_t i)
+{
+	return LogRecord{ i*1000, (uint32_t)(i%97), (uint32_t)(i%7), i*31 };
+}
+
+template <>
+SmallRecord makeRecord<SmallRecord>(size_t i)
+{
+	return SmallRecord{ i*1000 };
+}
+
+template <typename T>
+static std::vector<T> makeRecords()
+{
+	std::vector<T> records(RECORDS);
+	for (size_t i = 0; i < RECORDS; ++i)
+		records[i] = makeRecord<T>(i);
+	return records;
+}
+
+// Variants adapt the buffers to common interface: append all records, clear, collect content
+template <typename T, long BLOCK>
+struct AppendVariant
+{
+	typedef AppendBuffer<BLOCK> Buffer;
+
+	static const char *name()
+	{
+		return "append";
+	}
+
+	__attribute__((noinline))
+	static void run(Buffer *buffer, const T *records, size_t count)
+	{
+		for (const T *record = records; record != records+count; ++record)
+			buffer->append(*record);
+	}
+
+	static void clear(Buffer *buffer)
+	{
+		buffer->clear();
+	}
+
+	static void content(const Buffer &buffer, std::vector<uint8_t> *content)
+	{
+		buffer.forEachBlock([content](const uint8_t *data, size_t length) { content->insert(content->end(), data, data+length); });
+	}
+};
+
+template <typename T, long BLOCK>
+struct BatchVariant: AppendVariant<T, BLOCK>
+{
+	typedef AppendBuffer<BLOCK> Buffer;
+
+	static const char *name()
+	{
+		return "batch";
+	}
+
+	__attribute__((noinline))
+	static void run(Buffer *buffer, const T *records, size_t count)
+	{
+		for (size_t i = 0; i < count; i += BATCH)
+			buffer->appendBatch(records+i, std::min(BATCH, count-i));
+	}
+};
+
+template <typename T, long BLOCK>
+struct NaiveVariant
+{
+	typedef NaiveBuffer<BLOCK> Buffer;
+
+	static const char *name()
+	{
+		return "naive";
+	}
+
+	__attribute__((noinline))
+	static void run(Buffer *buffer, const T *records, size_t count)
+	{
+		for (const T *record = records; record != records+count; ++record)
+			buffer->append(*record);
+	}
+
+	static void clear(Buffer *buffer)
+	{
+		buffer->clear();
+	}
+
+	static void content(const Buffer &buffer, std::vector<uint8_t> *content)
+	{
+		buffer.forEachBlock([content](const uint8_t *data, size_t length) { content->insert(content->end(), data, data+length); });
+	}
+};
+
+template <typename T, long BLOCK>
+struct VectorVariant
+{
+	typedef std::vector<T> Buffer;
+
+	static const char *name()
+	{
+		return "vector";
+	}
+
+	__attribute__((noinline))
+	static void run(Buffer *buffer, const T *records, size_t count)
+	{
+		for (const T *record = records; record != records+count; ++record)
+			buffer->push_back(*record);
+	}
+
+	// keeps the capacity, so no more growth
+	static void clear(Buffer *buffer)
+	{
+		buffer->clear();
+	}
+
+	static void content(const Buffer &buffer, std::vector<uint8_t> *content)
+	{
+		content->insert(content->end(), (const uint8_t *)buffer.data(), (const uint8_t *)(buffer.data()+buffer.size()));
+	}
+};
+
+struct Timing {
+	double fresh;
+	double reused;
+	double hot;
+};
+
+template <typename Function>
+static double measure(Function function)
+{
+	double best = 1e30;
+	for (int r = 0; r < REPEAT; ++r) {
+		auto start = std::chrono::steady_clock::now();
+		function();
+		std::chrono::duration<double, std::nano> duration(std::chrono::steady_clock::now()-start);
+		best = std::min(best, duration.count()/RECORDS);
+	}
+	return best;
+}
+
+// Verifies the content and returns the best nanoseconds per record, for new buffer and cleared one
+template <typename Variant, typename T>
+static Timing benchmarkVariant(const std::vector<T> &records)
+{
+	typedef typename Variant::Buffer Buffer;
+	Timing timing;
+	Buffer reused;
+	Variant::run(&reused, records.data(), records.size());
+	// records never split across blocks, so the concatenated content of any variant is the original stream
+	std::vector<uint8_t> content;
+	Variant::content(reused, &content);
+	if (content.size() != records.size()*sizeof(T) || memcmp(content.data(), records.data(), content.size()) != 0) {
+		fprintf(stderr, "%s: content differs from the appended records\n", Variant::name());
+		exit(1);
+	}
+	timing.fresh = measure([&records]() {
+		Buffer buffer;
+		Variant::run(&buffer, records.data(), records.size());
+	});
+	timing.reused = measure([&records, &reused]() {
+		Variant::clear(&reused);
+		Variant::run(&reused, records.data(), records.size());
+	});
+	timing.hot = measure([&records, &reused]() {
+		for (size_t i = 0; i < records.size(); i += HOT_RECORDS) {
+			Variant::clear(&reused);
+			Variant::run(&reused, records.data(), HOT_RECORDS);
+		}
+	});
+	return timing;
+}
+
+template <typename T, long BLOCK>
+static void benchmarkRecord(const char *recordName)
+{
+	std::vector<T> records = makeRecords<T>();
+	const std::pair<const char *, Timing> timings[] = {
+		{ AppendVariant<T, BLOCK>::name(), benchmarkVariant<AppendVariant<T, BLOCK> >(records) },
+		{ BatchVariant<T, BLOCK>::name(), benchmarkVariant<BatchVariant<T, BLOCK> >(records) },
+		{ NaiveVariant<T, BLOCK>::name(), benchmarkVariant<NaiveVariant<T, BLOCK> >(records) },
+		{ VectorVariant<T, BLOCK>::name(), benchmarkVariant<VectorVariant<T, BLOCK> >(records) },
+	};
+	const Timing &baseline = timings[0].second;
+	for (const auto &timing: timings) {
+		printf("%-8s %6zu %-10ld %-8s %10.3f %8.2f %10.3f %8.2f %10.3f %8.2f\n", recordName, sizeof(T), BLOCK, timing.first, timing.second.fresh, timing.second.fresh/baseline.fresh, timing.second.reused, timing.second.reused/baseline.reused, timing.second.hot, timing.second.hot/baseline.hot);
+	}
+	fflush(stdout);
+}
+
+// Appends with sizes crossing block boundaries in every way, checks the stream is kept and records are not split
+static void verifyBoundaries(AppendBuffer<64> &buffer)
+{
+	std::vector<uint8_t> expected;
+	for (size_t i = 0; i < 1000; ++i) {
+		uint8_t record[40];
+		for (size_t j = 0; j < sizeof(record); ++j)
+			record[j] = (uint8_t)(i*7+j);
+		switch (i%5) {
+		case 0: {
+			uint64_t value;
+			memcpy(&value, record, sizeof(value));
+			buffer.append(value);
+			expected.insert(expected.end(), record, record+8);
+			break;
+		}
+		case 1:
+			buffer.append(*(uint8_t (*)[24])record);
+			expected.insert(expected.end(), record, record+24);
+			break;
+		case 2:
+			buffer.append(*(uint8_t (*)[13])record);
+			expected.insert(expected.end(), record, record+13);
+			break;
+		case 3:
+			buffer.appendBatch(record, i%41);
+			expected.insert(expected.end(), record, record+i%41);
+			break;
+		case 4:
+			buffer.appendBatch((const uint8_t (*)[5])record, i%9);
+			expected.insert(expected.end(), record, record+i%9*5);
+			break;
+		}
+	}
+	std::vector<uint8_t> content;
+	buffer.forEachBlock([&content](const uint8_t *data, size_t length) {
+		if (length > (size_t)AppendBuffer<64>::CAPACITY) {
+			fprintf(stderr, "block overflow: %zu bytes\n", length);
+			exit(1);
+		}
+		content.insert(content.end(), data, data+length);
+	});
+	if (content != expected || buffer.size() != expected.size()) {
+		fprintf(stderr, "boundary verification failed: %zu bytes stored, %zu expected\n", content.size(), expected.size());
+		exit(1);
+	}
+}
+
+int main()
+{
+	AppendBuffer<64> buffer;
+	verifyBoundaries(buffer);
+	buffer.clear();
+	verifyBoundaries(buffer);
+	printf("# ns per record, %zu records per run, batch %zu; fresh starts with new buffer, reused with cleared one, hot clears every %zu records; relative to append\n", RECORDS, BATCH, HOT_RECORDS);
+	printf("%-8s %6s %-10s %-8s %10s %8s %10s %8s %10s %8s\n", "record", "bytes", "block", "variant", "fresh", "relative", "reused", "relative", "hot", "relative");
+	benchmarkRecord<LogRecord, 4096L>("log");
+	benchmarkRecord<LogRecord, 65536L>("log");
+	benchmarkRecord<LogRecord, (1L<<20)>("log");
+	benchmarkRecord<SmallRecord, 4096L>("small");
+	benchmarkRecord<SmallRecord, 65536L>("small");
+	benchmarkRecord<SmallRecord, (1L<<20)>("small");
+	return 0;
+}
@@ -0,0 +1,127 @@
+/*
+ * Block boundary check idioms, as templates so the block mask is compile time immediate.
+ *
+ * Each idiom checks whether 8-byte write at position pos fits into the current block of BLOCK bytes (power of two,
+ * larger than 8).  There are two semantics of the position:
+ * - end position (append pointer): pos is the end of the data written so far, offset 0 within block means the
+ *   previous block is full, so the write fits if pos%BLOCK is in [1, BLOCK-8].  This is logical_cmpAddFirst.
+ * - start position: offset 0 is the start of fresh block, the write fits if pos%BLOCK is in [0, BLOCK-8].  This is
+ *   logical_cmpAddLast.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+
+#ifndef Logical_hxx__
+# define Logical_hxx__
+
+constexpr int logicalLog2(long value)
+{
+	return value <= 1 ? 0 : 1+logicalLog2(value/2);
+}
+
+// (pos+7)&((BLOCK-1)&~7), end position.  Works for any power of two SIZE in place of 8: offset+SIZE-1 has some of the
+// bits between SIZE and BLOCK set only if offset is in [1, BLOCK-SIZE].
+template <long BLOCK, long SIZE = 8>
+struct LogicalCmpAddFirst
+{
+	static_assert((SIZE&(SIZE-1)) == 0 && SIZE < BLOCK, "SIZE must be power of two smaller than BLOCK");
+
+	static constexpr bool endPosition = true;
+
+	static const char *name()
+	{
+		return "cmpAddFirst";
+	}
+
+	static bool fits(long pos)
+	{
+		return ((pos+SIZE-1)&((BLOCK-1)&~(SIZE-1))) != 0;
+	}
+};
+
+// ((pos-1)&(BLOCK-1)) < BLOCK-8 unsigned, end position
+template <long BLOCK>
+struct LogicalSubCmp
+{
+	static constexpr bool endPosition = true;
+
+	static const char *name()
+	{
+		return "subCmp";
+	}
+
+	static bool fits(long pos)
+	{
+		return (unsigned long)((pos-1)&(BLOCK-1)) < (unsigned long)(BLOCK-8);
+	}
+};
+
+// pos-1 and pos+7 in the same block, end position
+template <long BLOCK>
+struct LogicalShiftEnd
+{
+	static constexpr bool endPosition = true;
+
+	static const char *name()
+	{
+		return "shiftEnd";
+	}
+
+	static bool fits(long pos)
+	{
+		return ((pos-1)>>logicalLog2(BLOCK)) == ((pos+7)>>logicalLog2(BLOCK));
+	}
+};
+
+// (pos&(BLOCK-1)) <= BLOCK-8, start position
+template <long BLOCK>
+struct LogicalCmpAddLast
+{
+	static constexpr bool endPosition = false;
+
+	static const char *name()
+	{
+		return "cmpAddLast";
+	}
+
+	static bool fits(long pos)
+	{
+		return (pos&(BLOCK-1)) <= BLOCK-8;
+	}
+};
+
+// pos and pos+7 in the same block, start position
+template <long BLOCK>
+struct LogicalShiftStart
+{
+	static constexpr bool endPosition = false;
+
+	static const char *name()
+	{
+		return "shiftStart";
+	}
+
+	static bool fits(long pos)
+	{
+		return (pos>>logicalLog2(BLOCK)) == ((pos+7)>>logicalLog2(BLOCK));
+	}
+};
+
+// pos and pos+7 differ only within block bits, start position
+template <long BLOCK>
+struct LogicalXorStart
+{
+	static constexpr bool endPosition = false;
+
+	static const char *name()
+	{
+		return "xorStart";
+	}
+
+	static bool fits(long pos)
+	{
+		return ((pos^(pos+7))&~(BLOCK-1)) == 0;
+	}
+};
+
+#endif
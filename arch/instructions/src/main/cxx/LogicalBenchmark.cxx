@@ -0,0 +1,229 @@
+/*
+ * Benchmark of block boundary check idioms from Logical.hxx.
+ *
+ * For each block size and record stride (8 keeps positions aligned, 13 does not) it measures:
+ * - latency: the check result feeds the next position, so the loop is single dependency chain through the check.
+ * - throughput: independent checks of precomputed positions.
+ * - ring: ring buffer write loop, 8-byte store on the fast path, moving to the next block on the slow path.
+ *
+ * Every idiom is verified against its reference semantics first.  The fastest idiom is reported per configuration
+ * and overall, by geometric mean over all configurations.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Logical.hxx"
+
+
+static const long ITERATIONS = 1L<<22;
+static const int REPEAT = 5;
+static const size_t POSITIONS = 4096;
+static const long RING_SIZE = 1L<<16;
+
+enum Test {
+	TEST_LATENCY,
+	TEST_THROUGHPUT,
+	TEST_RING,
+	TEST_COUNT
+};
+
+static const char *const testNames[TEST_COUNT] = { "latency", "throughput", "ring" };
+
+struct Result {
+	std::string idiom;
+	bool endPosition;
+	double ns[TEST_COUNT];
+};
+
+volatile long logical_sink;
+
+template <typename Check>
+__attribute__((noinline))
+static long runLatency(long pos, long iterations, long stride)
+{
+	for (long i = 0; i < iterations; ++i)
+		pos += stride+!Check::fits(pos);
+	return pos;
+}
+
+template <typename Check>
+__attribute__((noinline))
+static long runThroughput(const long *positions, long iterations)
+{
+	long fitting = 0;
+	for (long i = 0; i < iterations; i += POSITIONS) {
+		for (size_t j = 0; j < POSITIONS; ++j) {
+			long pos = positions[j];
+			// keeps the check scalar, as in the real write paths
+			__asm__ __volatile__("" : "+r"(pos));
+			fitting += Check::fits(pos);
+		}
+	}
+	return fitting;
+}
+
+// Moves to the start of the next block, unless already at block start
+__attribute__((noinline))
+static long nextBlock(long pos, long block)
+{
+	return (pos+block-1)&~(block-1);
+}
+
+template <typename Check, long BLOCK>
+__attribute__((noinline))
+static long runRing(uint8_t *ring, long iterations, long stride)
+{
+	long pos = 8;
+	uint64_t value = 0;
+	for (long i = 0; i < iterations; ++i) {
+		if (__builtin_expect(!Check::fits(pos), 0))
+			pos = nextBlock(pos, BLOCK);
+		memcpy(ring+(pos&(RING_SIZE-1)), &value, sizeof(value));
+		pos += stride;
+		++value;
+	}
+	return pos;
+}
+
+// Returns the best nanoseconds per iteration
+template <typename Function>
+static double measure(Function function)
+{
+	double best = 1e30;
+	for (int r = 0; r < REPEAT; ++r) {
+		auto start = std::chrono::steady_clock::now();
+		logical_sink = function();
+		std::chrono::duration<double, std::nano> duration(std::chrono::steady_clock::now()-start);
+		best = std::min(best, duration.count()/ITERATIONS);
+	}
+	return best;
+}
+
+template <typename Check, long BLOCK>
+static bool reference(long pos)
+{
+	long offset = pos&(BLOCK-1);
+	return Check::endPosition ? offset != 0 && offset <= BLOCK-8 : offset <= BLOCK-8;
+}
+
+template <typename Check, long BLOCK>
+static void verify()
+{
+	std::vector<long> positions;
+	for (long block = 0; block < 4; ++block) {
+		for (long delta = -16; delta <= 16; ++delta) {
+			if (block*BLOCK+delta >= 0)
+				positions.push_back(block*BLOCK+delta);
+		}
+	}
+	for (long pos = 0; pos < 4096; ++pos)
+		positions.push_back(pos);
+	for (long pos: positions) {
+		if (Check::fits(pos) != reference<Check, BLOCK>(pos)) {
+			fprintf(stderr, "%s: block %ld pos %ld: got %d, expected %d\n", Check::name(), BLOCK, pos, Check::fits(pos), reference<Check, BLOCK>(pos));
+			exit(1);
+		}
+	}
+}
+
+template <typename Check, long BLOCK>
+static Result benchmarkIdiom(long stride, const long *positions, uint8_t *ring)
+{
+	verify<Check, BLOCK>();
+	Result result;
+	result.idiom = Check::name();
+	result.endPosition = Check::endPosition;
+	result.ns[TEST_LATENCY] = measure([stride]() { return runLatency<Check>(8, ITERATIONS, stride); });
+	result.ns[TEST_THROUGHPUT] = measure([positions]() { return runThroughput<Check>(positions, ITERATIONS); });
+	result.ns[TEST_RING] = measure([ring, stride]() { return runRing<Check, BLOCK>(ring, ITERATIONS, stride); });
+	return result;
+}
+
+template <long BLOCK>
+static std::vector<Result> benchmarkBlock(long stride)
+{
+	std::vector<long> positions(POSITIONS);
+	for (size_t i = 0; i < POSITIONS; ++i)
+		positions[i] = 8+(long)i*stride;
+	std::vector<uint8_t> ring(RING_SIZE+8);
+	return std::vector<Result>{
+		benchmarkIdiom<LogicalCmpAddFirst<BLOCK>, BLOCK>(stride, positions.data(), ring.data()),
+		benchmarkIdiom<LogicalSubCmp<BLOCK>, BLOCK>(stride, positions.data(), ring.data()),
+		benchmarkIdiom<LogicalShiftEnd<BLOCK>, BLOCK>(stride, positions.data(), ring.data()),
+		benchmarkIdiom<LogicalCmpAddLast<BLOCK>, BLOCK>(stride, positions.data(), ring.data()),
+		benchmarkIdiom<LogicalShiftStart<BLOCK>, BLOCK>(stride, positions.data(), ring.data()),
+		benchmarkIdiom<LogicalXorStart<BLOCK>, BLOCK>(stride, positions.data(), ring.data()),
+	};
+}
+
+static const std::string &fastest(const std::vector<Result> &results, int test)
+{
+	return std::min_element(results.begin(), results.end(), [test](const Result &l, const Result &r) { return l.ns[test] < r.ns[test]; })->idiom;
+}
+
+int main()
+{
+	static const long strides[] = { 8, 13 };
+	// geometric mean accumulators per idiom and test
+	std::map<std::string, std::vector<double> > logSums;
+	std::map<std::string, bool> semantics;
+	int configurations = 0;
+
+	printf("%-10s %-6s %-12s %-5s %12s %12s %12s\n", "block", "stride", "idiom", "pos", "latency-ns", "through-ns", "ring-ns");
+	for (long stride: strides) {
+		std::vector<std::pair<long, std::vector<Result> > > blocks = {
+			{ 64L, benchmarkBlock<64L>(stride) },
+			{ 4096L, benchmarkBlock<4096L>(stride) },
+			{ 65536L, benchmarkBlock<65536L>(stride) },
+			{ 1L<<20, benchmarkBlock<(1L<<20)>(stride) },
+			{ 1L<<30, benchmarkBlock<(1L<<30)>(stride) },
+		};
+		for (const auto &block: blocks) {
+			for (const Result &result: block.second) {
+				printf("%-10ld %-6ld %-12s %-5s %12.3f %12.3f %12.3f\n", block.first, stride, result.idiom.c_str(), result.endPosition ? "end" : "start", result.ns[TEST_LATENCY], result.ns[TEST_THROUGHPUT], result.ns[TEST_RING]);
+				std::vector<double> &sums = logSums[result.idiom];
+				sums.resize(TEST_COUNT);
+				for (int test = 0; test < TEST_COUNT; ++test)
+					sums[test] += log(result.ns[test]);
+				semantics[result.idiom] = result.endPosition;
+			}
+			printf("# fastest for block %ld stride %ld: latency %s, throughput %s, ring %s\n", block.first, stride, fastest(block.second, TEST_LATENCY).c_str(), fastest(block.second, TEST_THROUGHPUT).c_str(), fastest(block.second, TEST_RING).c_str());
+			++configurations;
+		}
+	}
+
+	printf("# geometric mean over %d configurations, ns\n", configurations);
+	std::vector<Result> means;
+	for (const auto &sums: logSums) {
+		Result mean;
+		mean.idiom = sums.first;
+		mean.endPosition = semantics[sums.first];
+		for (int test = 0; test < TEST_COUNT; ++test)
+			mean.ns[test] = exp(sums.second[test]/configurations);
+		printf("%-17s %-12s %-5s %12.3f %12.3f %12.3f\n", "#", mean.idiom.c_str(), mean.endPosition ? "end" : "start", mean.ns[TEST_LATENCY], mean.ns[TEST_THROUGHPUT], mean.ns[TEST_RING]);
+		means.push_back(mean);
+	}
+	for (int position = 1; position >= 0; --position) {
+		std::vector<Result> group;
+		for (const Result &mean: means) {
+			if (mean.endPosition == (position != 0))
+				group.push_back(mean);
+		}
+		for (int test = 0; test < TEST_COUNT; ++test)
+			printf("# fastest %s position %s: %s\n", position ? "end" : "start", testNames[test], fastest(group, test).c_str());
+	}
+	for (int test = 0; test < TEST_COUNT; ++test)
+		printf("# fastest overall %s: %s\n", testNames[test], fastest(means, test).c_str());
+	return 0;
+}
@@ -1,9 +1,13 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdint.h>
-#include <sys/resource.h>
+#include <stdlib.h>
+#include <math.h>
+#include <sys/mman.h>
 
+#include <chrono>
 #include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <memory>
 #include <stdexcept>
@@ -11,6 +15,8 @@
 #include <regex>
 #include <array>
 
+#include "CpuSpeed.hxx"
+
 using namespace std;
 
 void runDepend64(long loops)
@@ -287,6 +293,61 @@ void runIncMov64(long loops)
 	}
 }
 
+void runAddSelf64(long loops)
+{
+#define ADDSELF64_DECL \
+	int64_t r0;
+#define ADDSELF64_MODIFIED \
+	"=r"(r0)
+
+#if (defined __x86_64__)
+#	define ADDSELF64_STEP \
+				"add %0, %0\n" \
+				"add %0, %0\n" \
+				"add %0, %0\n" \
+				"add %0, %0\n" \
+				"add %0, %0\n" \
+				"add %0, %0\n" \
+				"add %0, %0\n" \
+				"add %0, %0\n" \
+				"add %0, %0\n" \
+				"add %0, %0\n"
+#elif (defined __aarch64__)
+#	define ADDSELF64_STEP \
+				"add %0, %0, %0\n" \
+				"add %0, %0, %0\n" \
+				"add %0, %0, %0\n" \
+				"add %0, %0, %0\n" \
+				"add %0, %0, %0\n" \
+				"add %0, %0, %0\n" \
+				"add %0, %0, %0\n" \
+				"add %0, %0, %0\n" \
+				"add %0, %0, %0\n" \
+				"add %0, %0, %0\n"
+#else
+# error Unsupported platform
+#endif
+
+	for (long i = 0; i < loops; ++i) {
+		ADDSELF64_DECL;
+		__asm__ __volatile(
+				ADDSELF64_STEP
+				ADDSELF64_STEP
+				ADDSELF64_STEP
+				ADDSELF64_STEP
+				ADDSELF64_STEP
+				ADDSELF64_STEP
+				ADDSELF64_STEP
+				ADDSELF64_STEP
+				ADDSELF64_STEP
+				ADDSELF64_STEP
+				: ADDSELF64_MODIFIED
+				:
+				: "memory"
+				);
+	}
+}
+
 string pipeExec(const char *command)
 {
 	std::array<char, 128> buffer;
@@ -377,25 +438,177 @@ double getCpuClock()
 	return cpuFrequency;
 }
 
-void runTickBenchmark(const char *name, long batchSize, void (*benchmark)())
+bool parseMeasureOption(const char *arg, MeasureOptions *options)
+{
+	if (strncmp(arg, "--budget=", 9) == 0) {
+		options->budget = atof(arg+9);
+		return true;
+	}
+	else if (strncmp(arg, "--precision=", 12) == 0) {
+		options->precision = atof(arg+12)/100;
+		return true;
+	}
+	else if (strncmp(arg, "--frequency-trace=", 18) == 0) {
+		options->frequencyTrace = arg+18;
+		return true;
+	}
+	return false;
+}
+
+// Two-sided 95% Student's t quantile for given degrees of freedom
+static double studentT95(int freedom)
+{
+	static const double table[] = { 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131 };
+	if (freedom <= (int)(sizeof(table)/sizeof(table[0])))
+		return table[freedom-1];
+	return freedom <= 30 ? 2.1 : 1.96;
+}
+
+// Returns seconds
+static double timeLoops(const std::function<void(long loops)> &probe, long loops)
+{
+	auto start = std::chrono::steady_clock::now();
+	probe(loops);
+	return std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+}
+
+Measurement measureRate(const std::string &name, const std::function<void(long loops)> &probe, const MeasureOptions &options)
+{
+	static const int minSamples = 5;
+	double sampleTime = options.budget/10;
+	auto start = std::chrono::steady_clock::now();
+
+	// doubling until the sample is long enough to extrapolate, this also serves as warmup
+	Measurement result = { 0, 0, 0, 1, false, { 0, 0, 0, false } };
+	for (;;) {
+		double duration = timeLoops(probe, result.loops);
+		if (duration >= sampleTime/8) {
+			result.loops = std::max(1L, (long)(result.loops*sampleTime/duration));
+			break;
+		}
+		result.loops *= 2;
+	}
+
+	bool traced = startFrequencyTracer(options.frequencyTrace);
+	if (traced)
+		beginFrequencyRun(name);
+	double sum = 0, sumSquares = 0;
+	for (;;) {
+		double rate = result.loops/timeLoops(probe, result.loops);
+		sum += rate;
+		sumSquares += rate*rate;
+		++result.samples;
+		result.rate = sum/result.samples;
+		if (result.samples >= 2) {
+			double variance = std::max(0.0, (sumSquares-sum*sum/result.samples)/(result.samples-1));
+			result.interval = studentT95(result.samples-1)*sqrt(variance/result.samples)/result.rate;
+		}
+		if (result.samples >= minSamples && result.interval <= options.precision) {
+			result.converged = true;
+			break;
+		}
+		// hard limit for noisy hosts, reported as not converged
+		if (std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count() >= 4*options.budget && result.samples >= minSamples)
+			break;
+	}
+	if (traced)
+		result.frequency = endFrequencyRun();
+	return result;
+}
+
+double calibrateClock(const MeasureOptions &options, bool *converged)
+{
+	MeasureOptions calibration = options;
+	calibration.budget = std::max(options.budget, 0.2);
+	Measurement measurement = measureRate("addSelf64.calibration", &runAddSelf64, calibration);
+	*converged = measurement.converged;
+	return measurement.rate*100;
+}
+
+void runTickBenchmark(const char *name, long opsPerLoop, const std::function<void(long loops)> &probe, const MeasureOptions &options)
 {
-	struct rusage start, end;
-	getrusage(RUSAGE_SELF, &start);
-	benchmark();
-	getrusage(RUSAGE_SELF, &end);
-	double clock = getCpuClock();
-	printf("%s: per-second=%.6f per-tick=%.3f\n", name, batchSize/((end.ru_utime.tv_sec+end.ru_utime.tv_usec/1000000.0)-(start.ru_utime.tv_sec+start.ru_utime.tv_usec/1000000.0)), batchSize/((end.ru_utime.tv_sec+end.ru_utime.tv_usec/1000000.0)-(start.ru_utime.tv_sec+start.ru_utime.tv_usec/1000000.0))/clock);
+	Measurement measurement = measureRate(name, probe, options);
+	double perSecond = measurement.rate*opsPerLoop;
+	double clock = effectiveClock(measurement);
+	char frequency[64] = " clock=nominal";
+	if (measurement.frequency.frequency != 0)
+		snprintf(frequency, sizeof(frequency), " clock=%.0fMHz%s", clock/1e6, measurement.frequency.changed ? " frequency-changed" : "");
+	printf("%s: per-second=%.6f per-tick=%.3f ci=%.2f%% samples=%d loops=%ld%s%s\n", name, perSecond, perSecond/clock, measurement.interval*100, measurement.samples, measurement.loops, frequency, measurement.converged ? "" : " not-converged");
+}
+
+void *mapExecutable(const void *code, size_t size)
+{
+	void *mapped = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if (mapped == MAP_FAILED)
+		throw std::bad_alloc();
+	memcpy(mapped, code, size);
+	__builtin___clear_cache((char *)mapped, (char *)mapped+size);
+	if (mprotect(mapped, size, PROT_READ|PROT_EXEC) != 0) {
+		munmap(mapped, size);
+		throw std::runtime_error(string("Failed to make generated code executable: ")+strerror(errno));
+	}
+	return mapped;
 }
 
-int main(void)
+void unmapExecutable(void *code, size_t size)
 {
-	// warmup
-	runIncAln64(200000000L);
-
-	runTickBenchmark("runDepend64", 1000000000L*102, [](){ runDepend64(1000000000L); });
-	runTickBenchmark("runIncAln32", 1000000000L*102, [](){ runIncAln32(1000000000L); });
-	runTickBenchmark("runIncAln64", 1000000000L*102, [](){ runIncAln64(1000000000L); });
-	runTickBenchmark("runIncMov32", 1000000000L*102, [](){ runIncMov32(1000000000L); });
-	runTickBenchmark("runIncMov64", 1000000000L*102, [](){ runIncMov64(1000000000L); });
+	munmap(code, size);
+}
+
+static int runBasic(int argc, char **argv)
+{
+	MeasureOptions options;
+	for (int i = 0; i < argc; ++i) {
+		if (!parseMeasureOption(argv[i], &options)) {
+			fprintf(stderr, "Usage: basic [--budget=seconds] [--precision=percent] [--frequency-trace=file]\n");
+			return 2;
+		}
+	}
+
+	runTickBenchmark("runDepend64", 102, &runDepend64, options);
+	runTickBenchmark("runIncAln32", 102, &runIncAln32, options);
+	runTickBenchmark("runIncAln64", 102, &runIncAln64, options);
+	runTickBenchmark("runIncMov32", 102, &runIncMov32, options);
+	runTickBenchmark("runIncMov64", 102, &runIncMov64, options);
 	return 0;
 }
+
+static int usage(const char *argv0)
+{
+	fprintf(stderr, "Usage: %s [basic [options]|instructions [options] [filter]|memory [options]|topology [options]|c2c [options]|smt [options]|branch [options]|alignment [options]]\n", argv0);
+	return 2;
+}
+
+int main(int argc, char **argv)
+{
+	const char *mode = argc > 1 ? argv[1] : "basic";
+	// options without mode go to basic
+	if (argc > 1 && argv[1][0] == '-') {
+		return runBasic(argc-1, argv+1);
+	}
+	else if (strcmp(mode, "basic") == 0) {
+		return runBasic(argc-2, argv+2);
+	}
+	else if (strcmp(mode, "instructions") == 0) {
+		return runInstructions(argc-2, argv+2);
+	}
+	else if (strcmp(mode, "memory") == 0) {
+		return runMemory(argc-2, argv+2);
+	}
+	else if (strcmp(mode, "topology") == 0) {
+		return runTopology(argc-2, argv+2);
+	}
+	else if (strcmp(mode, "c2c") == 0) {
+		return runCoreToCore(argc-2, argv+2);
+	}
+	else if (strcmp(mode, "smt") == 0) {
+		return runSmt(argc-2, argv+2);
+	}
+	else if (strcmp(mode, "branch") == 0) {
+		return runBranch(argc-2, argv+2);
+	}
+	else if (strcmp(mode, "alignment") == 0) {
+		return runAlignment(argc-2, argv+2);
+	}
+	return usage(argv[0]);
+}
@@ -0,0 +1,145 @@
+/*
+ * CpuSpeed harness shared by the probe suites.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+
+#ifndef CpuSpeed_hxx__
+# define CpuSpeed_hxx__
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Nominal CPU clock in Hz, used for per-tick normalization when the effective frequency cannot be measured
+double getCpuClock();
+
+// Adaptive measurement settings, shared by the suites
+struct MeasureOptions {
+	// Seconds per probe, probe not converging stops at four times the budget
+	double budget;
+	// Target relative half-width of 95% confidence interval of the mean
+	double precision;
+	// CSV file for effective frequency time series, NULL if not written
+	const char *frequencyTrace;
+
+	MeasureOptions(): budget(0.2), precision(0.01), frequencyTrace(NULL) {}
+};
+
+// Consumes --budget=seconds, --precision=percent and --frequency-trace=file, returns false for other arguments
+bool parseMeasureOption(const char *arg, MeasureOptions *options);
+
+// Effective frequency during probe run
+struct FrequencyRun {
+	// Hz, cycles counted divided by elapsed time, 0 if no cycle counter is available
+	double frequency;
+	// Slowest and fastest of the sampling intervals within the run
+	double minimum;
+	double maximum;
+	// Frequency changed part-way through the run
+	bool changed;
+};
+
+// Starts background sampler of calling thread's cycles (perf_event or APERF), time series goes to tracePath if not
+// NULL.  Returns false if there is no cycle counter, subsequent calls only return the state.
+bool startFrequencyTracer(const char *tracePath);
+
+// Marks probe run of the traced thread, label goes to the time series
+void beginFrequencyRun(const std::string &label);
+FrequencyRun endFrequencyRun();
+
+struct Measurement {
+	// Loops per second, mean of the samples
+	double rate;
+	// Relative half-width of 95% confidence interval of the rate
+	double interval;
+	int samples;
+	// Loops per sample
+	long loops;
+	bool converged;
+	FrequencyRun frequency;
+};
+
+// Measured frequency of the run, nominal clock (or the given one) if not available
+double effectiveClock(const Measurement &measurement);
+double effectiveClock(const Measurement &measurement, double clock);
+
+// Calibrates loop count so single sample takes tenth of the budget, then repeats samples (steady clock) until the
+// confidence interval is within precision.  Frequency is traced over the samples, the name labels the run.
+Measurement measureRate(const std::string &name, const std::function<void(long loops)> &probe, const MeasureOptions &options);
+
+// Clock from dependent chain of register adds (runAddSelf64), for hosts without cycle counter where the nominal clock
+// may be just a default guess.  Measured with at least 0.2 seconds budget.
+double calibrateClock(const MeasureOptions &options, bool *converged);
+
+// Measures probe and prints operations per second and per tick of effective frequency
+void runTickBenchmark(const char *name, long opsPerLoop, const std::function<void(long loops)> &probe, const MeasureOptions &options);
+
+// Copies generated machine code to new executable mapping (page aligned), throws on failure
+void *mapExecutable(const void *code, size_t size);
+void unmapExecutable(void *code, size_t size);
+
+// Basic probes, loops of 100 instructions
+void runDepend64(long loops);
+void runIncAln32(long loops);
+void runIncAln64(long loops);
+void runIncMov32(long loops);
+void runIncMov64(long loops);
+// Dependent register adds (add r, r), single cycle each on all supported cores, unlike immediate adds which newer cores
+// fold
+void runAddSelf64(long loops);
+
+// Named kernel running given number of loops.  Every instance owns its memory, so two instances can run concurrently.
+struct Workload {
+	std::string name;
+	std::function<void(long loops)> run;
+};
+
+// Instruction probes as <name>.latency and <name>.throughput, supported on this CPU only
+std::vector<Workload> instructionWorkloads();
+
+// memory.chase, memory.read and memory.write over buffer beyond last level cache, allocated on first run
+std::vector<Workload> memoryWorkloads();
+
+// Logical CPU as described by sysfs topology
+struct CpuInfo {
+	int cpu;
+	int package;
+	int core;
+	// -1 if not available
+	int cluster;
+	// Logical CPUs sharing the same physical core, including this one
+	std::vector<int> siblings;
+	// Core type on hybrid CPUs (cpu_core, cpu_atom), empty otherwise
+	std::string type;
+	// Relative capacity on heterogeneous aarch64, 0 if not available
+	int capacity;
+	// Hz, 0 if not available
+	double maxFrequency;
+};
+
+std::vector<CpuInfo> readCpuTopology();
+
+// CPUs of the topology the process is allowed to run on (sched_getaffinity, such as taskset or cgroup cpuset)
+std::vector<CpuInfo> filterAllowedCpus(const std::vector<CpuInfo> &topology);
+
+// Parses and formats sysfs CPU list, such as 0-3,8
+std::vector<int> parseCpuList(const std::string &list);
+std::string formatCpuList(std::vector<int> cpus);
+
+// Pins calling thread to single CPU, returns false on failure
+bool pinCurrentThread(int cpu);
+
+// Current frequency of CPU in Hz as reported by cpufreq, 0 if not available
+double readCpuFrequency(int cpu);
+
+// Suites, return process exit code
+int runInstructions(int argc, char **argv);
+int runMemory(int argc, char **argv);
+int runTopology(int argc, char **argv);
+int runCoreToCore(int argc, char **argv);
+int runSmt(int argc, char **argv);
+int runBranch(int argc, char **argv);
+int runAlignment(int argc, char **argv);
+
+#endif
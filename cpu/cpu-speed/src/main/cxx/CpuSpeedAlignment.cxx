@@ -0,0 +1,285 @@
+/*
+ * Code alignment and front-end sensitivity.
+ *
+ * Generates the same loop at runtime with its head at every offset within 64-byte window, with the body repeated to
+ * several sizes, so the loop crosses fetch blocks, uop cache lines and loop buffer capacity in different ways.  Bodies
+ * are the basic probes increment and increment-move patterns and the logical_cmpAddFirst boundary check from
+ * arch/instructions.  For each body and size it reports the best and worst offset and the smallest loop alignment
+ * which keeps within 2% of the best, the value worth passing to -falign-loops.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "CpuSpeed.hxx"
+
+
+static const size_t WINDOW = 64;
+// Relative tolerance for the offsets considered as good as the best
+static const double TOLERANCE = 0.02;
+
+struct LoopBody {
+	const char *name;
+	// Machine code of single repetition
+	std::vector<uint8_t> code;
+	// Instructions in single repetition
+	int instructions;
+};
+
+#if (defined __x86_64__)
+
+// Offsets must be multiple of instruction alignment
+static const size_t INSTRUCTION_ALIGN = 1;
+// Loop counter is the first argument, rdi, other registers are caller saved
+static const int LOOP_END_INSTRUCTIONS = 2;
+
+static std::vector<LoopBody> loopBodies()
+{
+	return std::vector<LoopBody>{
+		// inc rax; inc rcx; inc rdx; inc rsi
+		{ "inc", { 0x48, 0xff, 0xc0, 0x48, 0xff, 0xc1, 0x48, 0xff, 0xc2, 0x48, 0xff, 0xc6 }, 4 },
+		// inc rax; mov rcx, rdx; inc rsi; mov r8, r9
+		{ "incMov", { 0x48, 0xff, 0xc0, 0x48, 0x89, 0xd1, 0x48, 0xff, 0xc6, 0x4d, 0x89, 0xc8 }, 4 },
+		// inc rsi; lea rax, [rsi+7]; test rax, 0x3ffffff8; setne cl; add rdx, rcx
+		{ "cmpAddFirst", { 0x48, 0xff, 0xc6, 0x48, 0x8d, 0x46, 0x07, 0x48, 0xa9, 0xf8, 0xff, 0xff, 0x3f, 0x0f, 0x95, 0xc1, 0x48, 0x01, 0xca }, 5 },
+	};
+}
+
+// Pads with int3, never executed
+static void emitPadding(std::vector<uint8_t> *code, size_t size)
+{
+	code->resize(code->size()+size, 0xcc);
+}
+
+// dec rdi; jnz head; ret
+static void emitLoopEnd(std::vector<uint8_t> *code, size_t head)
+{
+	static const uint8_t dec[] = { 0x48, 0xff, 0xcf };
+	code->insert(code->end(), dec, dec+sizeof(dec));
+	long shortDisplacement = (long)head-(long)(code->size()+2);
+	if (shortDisplacement >= -128) {
+		code->push_back(0x75);
+		code->push_back((uint8_t)(int8_t)shortDisplacement);
+	}
+	else {
+		int32_t displacement = (int32_t)((long)head-(long)(code->size()+6));
+		code->push_back(0x0f);
+		code->push_back(0x85);
+		code->insert(code->end(), (uint8_t *)&displacement, (uint8_t *)&displacement+4);
+	}
+	code->push_back(0xc3);
+}
+
+#elif (defined __aarch64__)
+
+static const size_t INSTRUCTION_ALIGN = 4;
+// Loop counter is the first argument, x0, x1-x7 are caller saved
+static const int LOOP_END_INSTRUCTIONS = 2;
+
+static std::vector<uint8_t> words(std::initializer_list<uint32_t> instructions)
+{
+	std::vector<uint8_t> code;
+	for (uint32_t instruction: instructions)
+		code.insert(code.end(), (uint8_t *)&instruction, (uint8_t *)&instruction+4);
+	return code;
+}
+
+static std::vector<LoopBody> loopBodies()
+{
+	return std::vector<LoopBody>{
+		// add x1, x1, 1; add x2, x2, 1; add x3, x3, 1; add x4, x4, 1
+		{ "inc", words({ 0x91000421, 0x91000442, 0x91000463, 0x91000484 }), 4 },
+		// add x1, x1, 1; mov x2, x3; add x4, x4, 1; mov x5, x6
+		{ "incMov", words({ 0x91000421, 0xaa0303e2, 0x91000484, 0xaa0603e5 }), 4 },
+		// add x4, x4, 1; add x5, x4, 7; tst x5, 0x3ffffff8; cset w6, ne; add x7, x7, x6
+		{ "cmpAddFirst", words({ 0x91000484, 0x91001c85, 0xf27d68bf, 0x1a9f07e6, 0x8b0600e7 }), 5 },
+	};
+}
+
+// Pads with brk, never executed
+static void emitPadding(std::vector<uint8_t> *code, size_t size)
+{
+	for (size_t i = 0; i < size; i += 4) {
+		std::vector<uint8_t> brk = words({ 0xd4200000 });
+		code->insert(code->end(), brk.begin(), brk.end());
+	}
+}
+
+// subs x0, x0, 1; b.ne head; ret
+static void emitLoopEnd(std::vector<uint8_t> *code, size_t head)
+{
+	int32_t displacement = (int32_t)(((long)head-(long)(code->size()+4))/4);
+	std::vector<uint8_t> end = words({ 0xf1000400, 0x54000001|(((uint32_t)displacement&0x7ffff)<<5), 0xd65f03c0 });
+	code->insert(code->end(), end.begin(), end.end());
+}
+
+#else
+# error Unsupported platform
+#endif
+
+// Loop generated with its head at offset from 64-byte aligned start
+class GeneratedLoop
+{
+public:
+	GeneratedLoop(const LoopBody &body, int repeat, size_t offset)
+	{
+		std::vector<uint8_t> generated;
+		emitPadding(&generated, offset);
+		for (int i = 0; i < repeat; ++i)
+			generated.insert(generated.end(), body.code.begin(), body.code.end());
+		emitLoopEnd(&generated, offset);
+		size = generated.size();
+		code = (uint8_t *)mapExecutable(generated.data(), size);
+		function = (void (*)(long))(code+offset);
+	}
+
+	~GeneratedLoop()
+	{
+		unmapExecutable(code, size);
+	}
+
+	void operator()(long loops) const
+	{
+		function(loops);
+	}
+
+private:
+	uint8_t *code;
+	size_t size;
+	void (*function)(long loops);
+};
+
+// Result of single offset, the fastest of the rounds which converged without frequency change, the fastest of all
+// rounds only if there is no such
+struct OffsetResult {
+	double cycles;
+	bool converged;
+	bool changed;
+
+	OffsetResult(): cycles(1e30), converged(false), changed(true) {}
+
+	bool clean() const { return converged && !changed; }
+
+	// Clock is used when the run has no measured frequency
+	void update(const Measurement &measurement, double clock)
+	{
+		OffsetResult candidate;
+		candidate.cycles = effectiveClock(measurement, clock)/measurement.rate;
+		candidate.converged = measurement.converged;
+		candidate.changed = measurement.frequency.changed;
+		if (candidate.clean() != clean() ? candidate.clean() : candidate.cycles < cycles)
+			*this = candidate;
+	}
+
+	// Cycles prefixed by ! if frequency changed and ~ if not converged
+	std::string format() const
+	{
+		char buf[32];
+		snprintf(buf, sizeof(buf), "%s%s%.2f", changed ? "!" : "", converged ? "" : "~", cycles);
+		return buf;
+	}
+};
+
+// Smallest alignment of loop head where all offsets aligned to it are within tolerance of the best, 0 if none is
+static size_t requiredAlignment(const std::vector<OffsetResult> &results, double best)
+{
+	for (size_t alignment = INSTRUCTION_ALIGN; alignment <= WINDOW; alignment *= 2) {
+		bool good = true;
+		for (size_t offset = 0; offset < WINDOW; offset += alignment)
+			good = good && results[offset/INSTRUCTION_ALIGN].cycles <= best*(1+TOLERANCE);
+		if (good)
+			return alignment;
+	}
+	return 0;
+}
+
+int runAlignment(int argc, char **argv)
+{
+	MeasureOptions options;
+	// hundreds of loops, short budget keeps the whole run within minutes, yet long enough for most of them to converge
+	options.budget = 0.02;
+	int rounds = 3;
+	bool offsets = false;
+	for (int i = 0; i < argc; ++i) {
+		if (parseMeasureOption(argv[i], &options))
+			continue;
+		else if (strcmp(argv[i], "--offsets") == 0)
+			offsets = true;
+		else if (strncmp(argv[i], "--rounds=", 9) == 0)
+			rounds = std::max(1, atoi(argv[i]+9));
+		else {
+			fprintf(stderr, "Usage: alignment [--offsets] [--rounds=n] [--budget=seconds] [--precision=percent] [--frequency-trace=file]\n");
+			return 2;
+		}
+	}
+	static const int repeats[] = { 1, 4, 16, 64, 256 };
+
+	double clock = getCpuClock();
+	if (startFrequencyTracer(options.frequencyTrace)) {
+		printf("# clock: measured per probe\n");
+	}
+	else {
+		bool converged;
+		clock = calibrateClock(options, &converged);
+		printf("# clock: %s%.0f MHz calibrated by register add chain (no cycle counter)\n", converged ? "" : "~", clock/1e6);
+	}
+	printf("# cycles per iteration at loop head offset within %zu-byte window, align is the smallest -falign-loops within %.0f%% of the best\n", WINDOW, TOLERANCE*100);
+	printf("# ~ not converged, ! frequency changed, align ? if any offset is either\n");
+	printf("%-12s %6s %6s %6s %12s %12s %9s %8s %7s %6s\n", "body", "repeat", "bytes", "insns", "best(off)", "worst(off)", "aligned64", "spread", "ipc", "align");
+	double maxSpread = 0;
+	std::string maxSpreadName;
+	for (const LoopBody &body: loopBodies()) {
+		for (int repeat: repeats) {
+			// rounds interleave the offsets, so slow periods of the host do not hit single offset, the fastest round counts
+			std::vector<OffsetResult> results(WINDOW/INSTRUCTION_ALIGN);
+			for (int round = 0; round < rounds; ++round) {
+				for (size_t offset = 0; offset < WINDOW; offset += INSTRUCTION_ALIGN) {
+					GeneratedLoop loop(body, repeat, offset);
+					std::string name = std::string(body.name)+"."+std::to_string(repeat)+"@"+std::to_string(offset);
+					results[offset/INSTRUCTION_ALIGN].update(measureRate(name, std::ref(loop), options), clock);
+				}
+			}
+			auto byCycles = [](const OffsetResult &l, const OffsetResult &r) { return l.cycles < r.cycles; };
+			size_t best = std::min_element(results.begin(), results.end(), byCycles)-results.begin();
+			size_t worst = std::max_element(results.begin(), results.end(), byCycles)-results.begin();
+			double spread = results[worst].cycles/results[best].cycles-1;
+			int instructions = body.instructions*repeat+LOOP_END_INSTRUCTIONS;
+			// unreliable offsets may fake or hide the difference, no recommendation then
+			bool clean = std::all_of(results.begin(), results.end(), [](const OffsetResult &r) { return r.clean(); });
+			size_t alignment = requiredAlignment(results, results[best].cycles);
+			char bestText[32], worstText[32], alignText[16];
+			snprintf(bestText, sizeof(bestText), "%s(%zu)", results[best].format().c_str(), best*INSTRUCTION_ALIGN);
+			snprintf(worstText, sizeof(worstText), "%s(%zu)", results[worst].format().c_str(), worst*INSTRUCTION_ALIGN);
+			if (!clean)
+				snprintf(alignText, sizeof(alignText), "?");
+			else if (alignment == 0)
+				snprintf(alignText, sizeof(alignText), "-");
+			else if (alignment == INSTRUCTION_ALIGN)
+				snprintf(alignText, sizeof(alignText), "any");
+			else
+				snprintf(alignText, sizeof(alignText), "%zu", alignment);
+			printf("%-12s %6d %6zu %6d %12s %12s %9s %7.1f%% %7.2f %6s\n", body.name, repeat, body.code.size()*repeat, instructions, bestText, worstText, results[0].format().c_str(), spread*100, instructions/results[best].cycles, alignText);
+			if (offsets) {
+				for (size_t i = 0; i < results.size(); ++i)
+					printf("#   offset %2zu: %s\n", i*INSTRUCTION_ALIGN, results[i].format().c_str());
+			}
+			fflush(stdout);
+			if (clean && spread > maxSpread) {
+				maxSpread = spread;
+				maxSpreadName = std::string(body.name)+" x"+std::to_string(repeat);
+			}
+		}
+	}
+	if (maxSpreadName.empty())
+		printf("# largest spread: no row converged without frequency change\n");
+	else
+		printf("# largest spread: %.1f%% (%s)\n", maxSpread*100, maxSpreadName.c_str());
+	return 0;
+}
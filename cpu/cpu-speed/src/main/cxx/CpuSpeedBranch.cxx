@@ -0,0 +1,501 @@
+/*
+ * Branch prediction probes: branch throughput, misprediction penalty, history capacity, BTB capacity, indirect branches
+ * and return stack.
+ *
+ * Conditional branch probes run single data dependent branch per iteration over byte pattern repeating with given
+ * period, random pattern mispredicts half of the time which gives the penalty, growing period shows how long history
+ * the predictor can learn.  BTB probe generates chain of unconditional jumps at runtime, so the number of distinct
+ * branch targets can grow beyond the BTB.  Indirect probes dispatch by switch jump table and virtual call over
+ * constant, cycling and random targets.  Return stack probe recurses to growing depth, returns beyond the return stack
+ * buffer size mispredict.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "CpuSpeed.hxx"
+
+
+#define BRANCH_REP10(s) s s s s s s s s s s
+#define BRANCH_REP100(s) BRANCH_REP10(BRANCH_REP10(s))
+
+// Taken branches are 16 bytes apart, densely packed branches hit front-end limits rather than the branch unit
+#define BRANCH_SPACE ".p2align 4\n"
+
+// Pattern buffer size, the period of patterns is a power of two up to this size
+static const size_t PATTERN_SIZE = 65536;
+
+#if (defined __x86_64__)
+
+// Unconditional jumps to the next slot, 100 per loop
+static void takenJmp(long loops)
+{
+	__asm__ __volatile__(
+			".p2align 4\n"
+			"1:\n"
+			BRANCH_REP100("jmp 3f\n" BRANCH_SPACE "3:\n")
+			"dec %[loops]\n"
+			"jnz 1b\n"
+			: [loops] "+r"(loops)
+			:
+			: "cc"
+			);
+}
+
+// Unconditional jumps packed back to back, 100 per loop
+static void takenDenseJmp(long loops)
+{
+	__asm__ __volatile__(
+			".p2align 4\n"
+			"1:\n"
+			BRANCH_REP100("jmp 3f\n" "3:\n")
+			"dec %[loops]\n"
+			"jnz 1b\n"
+			: [loops] "+r"(loops)
+			:
+			: "cc"
+			);
+}
+
+// Conditional jumps, taken, 100 per loop
+static void takenJcc(long loops)
+{
+	__asm__ __volatile__(
+			".p2align 4\n"
+			"1:\n"
+			"cmp %%eax, %%eax\n"
+			BRANCH_REP100("jz 3f\n" BRANCH_SPACE "3:\n")
+			"dec %[loops]\n"
+			"jnz 1b\n"
+			: [loops] "+r"(loops)
+			:
+			: "rax", "cc"
+			);
+}
+
+// Conditional jumps, not taken, 100 per loop
+static void notTakenJcc(long loops)
+{
+	__asm__ __volatile__(
+			".p2align 4\n"
+			"1:\n"
+			"cmp %%eax, %%eax\n"
+			BRANCH_REP100("jnz 3f\n" "3:\n")
+			"dec %[loops]\n"
+			"jnz 1b\n"
+			: [loops] "+r"(loops)
+			:
+			: "rax", "cc"
+			);
+}
+
+// Single branch per loop, taken when the pattern byte is zero
+static void patternBranch(long loops, const uint8_t *pattern)
+{
+	long index = 0, taken = 0;
+	__asm__ __volatile__(
+			".p2align 4\n"
+			"1:\n"
+			"movzbl (%[pattern],%[index]), %%eax\n"
+			"test %%eax, %%eax\n"
+			"jz 2f\n"
+			"inc %[taken]\n"
+			"2:\n"
+			"inc %[index]\n"
+			"and %[mask], %[index]\n"
+			"dec %[loops]\n"
+			"jnz 1b\n"
+			: [loops] "+&r"(loops), [index] "+&r"(index), [taken] "+&r"(taken)
+			: [pattern] "r"(pattern), [mask] "i"(PATTERN_SIZE-1)
+			: "rax", "cc", "memory"
+			);
+}
+
+// Writes jump to next slot into each of count slots of stride bytes, followed by return
+static void emitJumpChain(uint8_t *code, size_t count, size_t stride)
+{
+	memset(code, 0xcc, count*stride+1);
+	for (size_t i = 0; i < count; ++i) {
+		int32_t offset = (int32_t)(stride-5);
+		code[i*stride] = 0xe9;
+		memcpy(code+i*stride+1, &offset, sizeof(offset));
+	}
+	code[count*stride] = 0xc3;
+}
+
+#elif (defined __aarch64__)
+
+static void takenJmp(long loops)
+{
+	__asm__ __volatile__(
+			".p2align 4\n"
+			"1:\n"
+			BRANCH_REP100("b 3f\n" BRANCH_SPACE "3:\n")
+			"subs %[loops], %[loops], 1\n"
+			"b.ne 1b\n"
+			: [loops] "+r"(loops)
+			:
+			: "cc"
+			);
+}
+
+static void takenDenseJmp(long loops)
+{
+	__asm__ __volatile__(
+			".p2align 4\n"
+			"1:\n"
+			BRANCH_REP100("b 3f\n" "3:\n")
+			"subs %[loops], %[loops], 1\n"
+			"b.ne 1b\n"
+			: [loops] "+r"(loops)
+			:
+			: "cc"
+			);
+}
+
+static void takenJcc(long loops)
+{
+	__asm__ __volatile__(
+			".p2align 4\n"
+			"1:\n"
+			"cmp xzr, xzr\n"
+			BRANCH_REP100("b.eq 3f\n" BRANCH_SPACE "3:\n")
+			"subs %[loops], %[loops], 1\n"
+			"b.ne 1b\n"
+			: [loops] "+r"(loops)
+			:
+			: "cc"
+			);
+}
+
+static void notTakenJcc(long loops)
+{
+	__asm__ __volatile__(
+			".p2align 4\n"
+			"1:\n"
+			"cmp xzr, xzr\n"
+			BRANCH_REP100("b.ne 3f\n" "3:\n")
+			"subs %[loops], %[loops], 1\n"
+			"b.ne 1b\n"
+			: [loops] "+r"(loops)
+			:
+			: "cc"
+			);
+}
+
+static void patternBranch(long loops, const uint8_t *pattern)
+{
+	long index = 0, taken = 0;
+	__asm__ __volatile__(
+			".p2align 4\n"
+			"1:\n"
+			"ldrb w9, [%[pattern], %[index]]\n"
+			"cbz w9, 2f\n"
+			"add %[taken], %[taken], 1\n"
+			"2:\n"
+			"add %[index], %[index], 1\n"
+			"and %[index], %[index], %[mask]\n"
+			"subs %[loops], %[loops], 1\n"
+			"b.ne 1b\n"
+			: [loops] "+&r"(loops), [index] "+&r"(index), [taken] "+&r"(taken)
+			: [pattern] "r"(pattern), [mask] "r"(PATTERN_SIZE-1)
+			: "x9", "cc", "memory"
+			);
+}
+
+static void emitJumpChain(uint8_t *code, size_t count, size_t stride)
+{
+	uint32_t *words = (uint32_t *)code;
+	// nop padding
+	for (size_t i = 0; i < count*stride/4; ++i)
+		words[i] = 0xd503201f;
+	for (size_t i = 0; i < count; ++i)
+		words[i*stride/4] = 0x14000000|(uint32_t)(stride/4);
+	words[count*stride/4] = 0xd65f03c0;
+}
+
+#else
+# error Unsupported platform
+#endif
+
+// Distance between jumps of BTB probe, keeps the code of the largest chain within L2
+static const size_t JUMP_STRIDE = 16;
+
+// Executable memory with chain of count jumps
+class JumpChain
+{
+public:
+	explicit JumpChain(size_t count):
+		size(count*JUMP_STRIDE+4)
+	{
+		std::vector<uint8_t> generated(size);
+		emitJumpChain(generated.data(), count, JUMP_STRIDE);
+		code = (uint8_t *)mapExecutable(generated.data(), size);
+	}
+
+	~JumpChain()
+	{
+		unmapExecutable(code, size);
+	}
+
+	void operator()(long loops) const
+	{
+		void (*function)() = (void (*)())code;
+		for (long i = 0; i < loops; ++i)
+			function();
+	}
+
+private:
+	uint8_t *code;
+	size_t size;
+};
+
+// Fills pattern buffer with random bytes 0 or 1 repeating with period
+static std::vector<uint8_t> randomPattern(size_t period, unsigned targets)
+{
+	std::vector<uint8_t> pattern(PATTERN_SIZE);
+	std::mt19937 random(period*31+targets);
+	for (size_t i = 0; i < period; ++i)
+		pattern[i] = (uint8_t)(random()%targets);
+	for (size_t i = period; i < PATTERN_SIZE; ++i)
+		pattern[i] = pattern[i-period];
+	return pattern;
+}
+
+// Targets cycling in order 0, 1, ... targets-1
+static std::vector<uint8_t> cyclePattern(unsigned targets)
+{
+	std::vector<uint8_t> pattern(PATTERN_SIZE);
+	for (size_t i = 0; i < PATTERN_SIZE; ++i)
+		pattern[i] = (uint8_t)(i%targets);
+	return pattern;
+}
+
+volatile long branch_sink;
+
+// Switch over 16 cases with side effects, so the compiler keeps the jump table rather than converting to lookup
+static void switchDispatch(long loops, const uint8_t *pattern)
+{
+	long accumulator = 0;
+	size_t index = 0;
+	for (long i = 0; i < loops; ++i) {
+		switch (pattern[index]) {
+#define BRANCH_CASE(n) case n: __asm__ __volatile__("" : "+r"(accumulator)); accumulator = accumulator*(n+3)+n; break;
+		BRANCH_CASE(0) BRANCH_CASE(1) BRANCH_CASE(2) BRANCH_CASE(3)
+		BRANCH_CASE(4) BRANCH_CASE(5) BRANCH_CASE(6) BRANCH_CASE(7)
+		BRANCH_CASE(8) BRANCH_CASE(9) BRANCH_CASE(10) BRANCH_CASE(11)
+		BRANCH_CASE(12) BRANCH_CASE(13) BRANCH_CASE(14) BRANCH_CASE(15)
+#undef BRANCH_CASE
+		}
+		index = (index+1)&(PATTERN_SIZE-1);
+	}
+	branch_sink = accumulator;
+}
+
+class VirtualTarget
+{
+public:
+	virtual ~VirtualTarget() {}
+
+	virtual long apply(long value) const = 0;
+};
+
+template <int N>
+class VirtualTargetImpl: public VirtualTarget
+{
+public:
+	virtual long apply(long value) const
+	{
+		return value*(N+3)+N;
+	}
+};
+
+// Objects of up to 16 distinct classes, chosen by pattern
+class VirtualDispatch
+{
+public:
+	explicit VirtualDispatch(const std::vector<uint8_t> &pattern):
+		objects(PATTERN_SIZE)
+	{
+		static const VirtualTargetImpl<0> t0; static const VirtualTargetImpl<1> t1; static const VirtualTargetImpl<2> t2;
+		static const VirtualTargetImpl<3> t3; static const VirtualTargetImpl<4> t4; static const VirtualTargetImpl<5> t5;
+		static const VirtualTargetImpl<6> t6; static const VirtualTargetImpl<7> t7; static const VirtualTargetImpl<8> t8;
+		static const VirtualTargetImpl<9> t9; static const VirtualTargetImpl<10> t10; static const VirtualTargetImpl<11> t11;
+		static const VirtualTargetImpl<12> t12; static const VirtualTargetImpl<13> t13; static const VirtualTargetImpl<14> t14;
+		static const VirtualTargetImpl<15> t15;
+		static const VirtualTarget *const targets[16] = { &t0, &t1, &t2, &t3, &t4, &t5, &t6, &t7, &t8, &t9, &t10, &t11, &t12, &t13, &t14, &t15 };
+		for (size_t i = 0; i < PATTERN_SIZE; ++i)
+			objects[i] = targets[pattern[i]];
+	}
+
+	void operator()(long loops) const
+	{
+		long accumulator = 0;
+		size_t index = 0;
+		for (long i = 0; i < loops; ++i) {
+			accumulator = objects[index]->apply(accumulator);
+			index = (index+1)&(PATTERN_SIZE-1);
+		}
+		branch_sink = accumulator;
+	}
+
+private:
+	std::vector<const VirtualTarget *> objects;
+};
+
+// Recursion the compiler cannot turn into loop
+__attribute__((noinline))
+static long recurse(long depth)
+{
+	if (depth == 0)
+		return 0;
+	long result = recurse(depth-1);
+	__asm__ __volatile__("" : "+r"(result));
+	return result+1;
+}
+
+// Formats cycles per unit, marked with ~ if the measurement did not converge and with ! if the frequency changed
+static std::string formatCycles(const Measurement &measurement, double cycles)
+{
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%s%s%.2f", measurement.frequency.changed ? "!" : "", measurement.converged ? "" : "~", cycles);
+	return buffer;
+}
+
+// Measures probe and prints cycles per unit (branch, iteration or call), returns the cycles.  Clock is used when the
+// run has no measured frequency.
+static double printCycles(const std::string &name, const std::function<void(long loops)> &probe, double units, const MeasureOptions &options, double clock)
+{
+	Measurement measurement = measureRate(name, probe, options);
+	double cycles = effectiveClock(measurement, clock)/measurement.rate/units;
+	printf("%-28s %10s\n", name.c_str(), formatCycles(measurement, cycles).c_str());
+	fflush(stdout);
+	return cycles;
+}
+
+// Returns the last x before y grows over threshold times the minimum seen so far, 0 if y never does
+static size_t findCapacity(const std::vector<size_t> &x, const std::vector<double> &y, double threshold)
+{
+	double minimum = y.empty() ? 0 : y[0];
+	for (size_t i = 1; i < x.size(); ++i) {
+		if (y[i] > minimum*threshold)
+			return x[i-1];
+		minimum = std::min(minimum, y[i]);
+	}
+	return 0;
+}
+
+int runBranch(int argc, char **argv)
+{
+	MeasureOptions options;
+	// many probes, short budget keeps the whole run within seconds
+	options.budget = 0.05;
+	for (int i = 0; i < argc; ++i) {
+		if (!parseMeasureOption(argv[i], &options)) {
+			fprintf(stderr, "Usage: branch [--budget=seconds] [--precision=percent] [--frequency-trace=file]\n");
+			return 2;
+		}
+	}
+	double clock = getCpuClock();
+	if (startFrequencyTracer(options.frequencyTrace)) {
+		printf("# clock: measured per probe\n");
+	}
+	else {
+		bool converged;
+		clock = calibrateClock(options, &converged);
+		printf("# clock: %s%.0f MHz calibrated by register add chain (no cycle counter)\n", converged ? "" : "~", clock/1e6);
+	}
+
+	printf("# branch throughput, cycles per branch\n");
+	printCycles("taken.unconditional", &takenJmp, 100, options, clock);
+	printCycles("taken.conditional", &takenJcc, 100, options, clock);
+	printCycles("taken.dense", &takenDenseJmp, 100, options, clock);
+	printCycles("notTaken.conditional", &notTakenJcc, 100, options, clock);
+
+	printf("# conditional branch, cycles per iteration\n");
+	std::vector<uint8_t> constant(PATTERN_SIZE, 0);
+	std::vector<uint8_t> alternating = cyclePattern(2);
+	std::vector<uint8_t> random = randomPattern(PATTERN_SIZE, 2);
+	double base = printCycles("pattern.constant", [&constant](long loops) { patternBranch(loops, constant.data()); }, 1, options, clock);
+	printCycles("pattern.alternating", [&alternating](long loops) { patternBranch(loops, alternating.data()); }, 1, options, clock);
+	double randomCycles = printCycles("pattern.random", [&random](long loops) { patternBranch(loops, random.data()); }, 1, options, clock);
+	// random pattern mispredicts half of the branches
+	double penalty = (randomCycles-base)*2;
+	printf("# misprediction penalty: %.1f cycles\n", penalty);
+
+	printf("# history, random pattern repeating with period, cycles per iteration and misprediction rate\n");
+	printf("%-28s %10s %10s\n", "period", "cycles", "mispredict");
+	size_t historyCapacity = 0;
+	bool learnt = true;
+	for (size_t period = 2; period <= PATTERN_SIZE; period *= 2) {
+		std::vector<uint8_t> pattern = randomPattern(period, 2);
+		Measurement measurement = measureRate("history."+std::to_string(period), [&pattern](long loops) { patternBranch(loops, pattern.data()); }, options);
+		double cycles = effectiveClock(measurement, clock)/measurement.rate;
+		double rate = penalty > 0 ? std::max(0.0, (cycles-base)/penalty) : 0;
+		printf("%-28zu %10s %9.1f%%\n", period, formatCycles(measurement, cycles).c_str(), rate*100);
+		fflush(stdout);
+		learnt = learnt && rate < 0.05;
+		if (learnt)
+			historyCapacity = period;
+	}
+	printf("# history capacity: period %zu learnt with less than 5%% mispredictions\n", historyCapacity);
+
+	printf("# BTB, chain of unconditional jumps %zu bytes apart, cycles per jump\n", JUMP_STRIDE);
+	printf("%-28s %10s\n", "jumps", "cycles");
+	std::vector<size_t> counts;
+	std::vector<double> jumpCycles;
+	for (size_t count = 16; count <= 16384; count *= 2) {
+		JumpChain chain(count);
+		Measurement measurement = measureRate("btb."+std::to_string(count), std::ref(chain), options);
+		double cycles = effectiveClock(measurement, clock)/measurement.rate/count;
+		printf("%-28zu %10s\n", count, formatCycles(measurement, cycles).c_str());
+		fflush(stdout);
+		counts.push_back(count);
+		jumpCycles.push_back(cycles);
+	}
+	printf("# BTB capacity: %zu jumps before the cost grows over 1.5x\n", findCapacity(counts, jumpCycles, 1.5));
+
+	printf("# indirect branches, cycles per dispatch\n");
+	static const unsigned targetCounts[] = { 1, 2, 4, 16 };
+	for (unsigned targets: targetCounts) {
+		std::vector<uint8_t> cycle = cyclePattern(targets);
+		std::vector<uint8_t> shuffled = randomPattern(PATTERN_SIZE, targets);
+		printCycles("switch.cycle."+std::to_string(targets), [&cycle](long loops) { switchDispatch(loops, cycle.data()); }, 1, options, clock);
+		if (targets > 1)
+			printCycles("switch.random."+std::to_string(targets), [&shuffled](long loops) { switchDispatch(loops, shuffled.data()); }, 1, options, clock);
+		VirtualDispatch cycleCalls(cycle), shuffledCalls(shuffled);
+		printCycles("virtual.cycle."+std::to_string(targets), std::ref(cycleCalls), 1, options, clock);
+		if (targets > 1)
+			printCycles("virtual.random."+std::to_string(targets), std::ref(shuffledCalls), 1, options, clock);
+	}
+
+	printf("# return stack, recursion depth, cycles per call and return\n");
+	printf("%-28s %10s\n", "depth", "cycles");
+	std::vector<size_t> depths;
+	std::vector<double> callCycles;
+	for (size_t depth = 4; depth <= 256; depth *= 2) {
+		Measurement measurement = measureRate("return."+std::to_string(depth), [depth](long loops) {
+			long result = 0;
+			for (long i = 0; i < loops; ++i)
+				result += recurse(depth);
+			branch_sink = result;
+		}, options);
+		double cycles = effectiveClock(measurement, clock)/measurement.rate/depth;
+		printf("%-28zu %10s\n", depth, formatCycles(measurement, cycles).c_str());
+		fflush(stdout);
+		depths.push_back(depth);
+		callCycles.push_back(cycles);
+	}
+	printf("# return stack depth: %zu calls before the cost grows over 1.5x\n", findCapacity(depths, callCycles, 1.5));
+	return 0;
+}
@@ -0,0 +1,369 @@
+/*
+ * Cross-core cache line transfer probes: core-to-core latency matrix, contended atomics and false sharing.
+ *
+ * Latency bounces single cache line between two pinned threads, each waiting for the other's value before writing its
+ * own, so every step is one cache line handoff.  Contention runs atomic operations on single shared variable with
+ * growing number of threads.  False sharing compares threads updating their own counters packed in single cache line
+ * with the same counters padded to separate lines.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sched.h>
+#include <pthread.h>
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CpuSpeed.hxx"
+
+
+struct alignas(64) SharedLine {
+	std::atomic<int64_t> value;
+	char padding[64-sizeof(std::atomic<int64_t>)];
+};
+
+// Pins each of count threads and waits for the others, returns false in all of them if any pinning failed
+struct PinBarrier {
+	std::atomic<int> ready;
+	std::atomic<bool> failed;
+	int count;
+
+	explicit PinBarrier(int count_): ready(0), failed(false), count(count_) {}
+
+	bool pin(int cpu)
+	{
+		if (!pinCurrentThread(cpu))
+			failed.store(true);
+		ready.fetch_add(1);
+		while (ready.load() != count)
+			std::this_thread::yield();
+		return !failed.load();
+	}
+};
+
+// Returns one-way latency in nanoseconds, the best of few samples, negative if the threads could not be pinned.  The
+// calling thread pings from cpuA, so the frequency of the best sample can be traced (zero if there is no cycle
+// counter), the caller restores its affinity.
+static double measurePingPong(int cpuA, int cpuB, long rounds, FrequencyRun *frequency)
+{
+	double best = 1e30;
+	bool traced = startFrequencyTracer(NULL);
+	*frequency = FrequencyRun{ 0, 0, 0, false };
+	for (int sample = 0; sample < 3; ++sample) {
+		SharedLine line;
+		line.value.store(-1);
+		PinBarrier pinned(2);
+		double duration = 0;
+		// each side waits for the other's value and writes the next one
+		auto bounce = [&line, rounds](int64_t first) {
+			for (int64_t expected = first; expected < 2*rounds; expected += 2) {
+				while (line.value.load(std::memory_order_acquire) != expected)
+					;
+				line.value.store(expected+1, std::memory_order_release);
+			}
+		};
+		std::thread pong([&]() {
+			if (!pinned.pin(cpuB))
+				return;
+			line.value.store(0);
+			bounce(1);
+		});
+		FrequencyRun run = { 0, 0, 0, false };
+		if (pinned.pin(cpuA)) {
+			while (line.value.load(std::memory_order_acquire) != 0)
+				;
+			if (traced)
+				beginFrequencyRun("c2c."+std::to_string(cpuA)+"-"+std::to_string(cpuB));
+			auto start = std::chrono::steady_clock::now();
+			bounce(0);
+			while (line.value.load(std::memory_order_acquire) != 2*rounds)
+				;
+			duration = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now()-start).count();
+			if (traced)
+				run = endFrequencyRun();
+		}
+		pong.join();
+		if (pinned.failed.load())
+			return -1;
+		if (duration/(2*rounds) < best) {
+			best = duration/(2*rounds);
+			*frequency = run;
+		}
+	}
+	return best;
+}
+
+enum AtomicOperation {
+	ATOMIC_FETCH_ADD,
+	ATOMIC_CAS,
+	ATOMIC_EXCHANGE,
+	ATOMIC_COUNT
+};
+
+static const char *const atomicNames[ATOMIC_COUNT] = { "fetch_add", "cas", "exchange" };
+
+// Runs body on threads pinned to given CPUs for duration, returns total number of operations per second, negative if
+// the threads could not be pinned
+template <typename Body>
+static double runPinned(const std::vector<int> &cpus, double duration, Body body)
+{
+	PinBarrier pinned((int)cpus.size()+1);
+	std::atomic<bool> go(false), stop(false);
+	std::vector<uint64_t> counts(cpus.size());
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < cpus.size(); ++t) {
+		threads.emplace_back([&, t]() {
+			if (!pinned.pin(cpus[t]))
+				return;
+			while (!go.load())
+				;
+			uint64_t count = 0;
+			while (!stop.load(std::memory_order_relaxed)) {
+				// batch, so the stop check does not dominate
+				for (int i = 0; i < 64; ++i)
+					body(t);
+				count += 64;
+			}
+			counts[t] = count;
+		});
+	}
+	pinned.ready.fetch_add(1);
+	while (pinned.ready.load() != pinned.count)
+		std::this_thread::yield();
+	if (pinned.failed.load()) {
+		for (std::thread &thread: threads)
+			thread.join();
+		return -1;
+	}
+	auto start = std::chrono::steady_clock::now();
+	go.store(true);
+	std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+	stop.store(true);
+	for (std::thread &thread: threads)
+		thread.join();
+	std::chrono::duration<double> elapsed(std::chrono::steady_clock::now()-start);
+	uint64_t total = 0;
+	for (uint64_t count: counts)
+		total += count;
+	return total/elapsed.count();
+}
+
+static double measureAtomic(AtomicOperation operation, const std::vector<int> &cpus, double duration)
+{
+	SharedLine line;
+	line.value.store(0);
+	switch (operation) {
+	case ATOMIC_FETCH_ADD:
+		return runPinned(cpus, duration, [&line](size_t) { line.value.fetch_add(1); });
+	case ATOMIC_CAS:
+		return runPinned(cpus, duration, [&line](size_t) {
+			int64_t old = line.value.load(std::memory_order_relaxed);
+			while (!line.value.compare_exchange_weak(old, old+1))
+				;
+		});
+	case ATOMIC_EXCHANGE:
+		return runPinned(cpus, duration, [&line](size_t t) { line.value.exchange((int64_t)t); });
+	default:
+		abort();
+	}
+}
+
+struct PackedCounters {
+	alignas(64) std::atomic<uint64_t> counters[8];
+};
+
+struct PaddedCounter {
+	alignas(64) std::atomic<uint64_t> value;
+};
+
+struct PaddedCounters {
+	PaddedCounter counters[8];
+};
+
+// Plain (not locked) increments of per-thread counter, so only the cache line ownership is contended
+template <typename Counters>
+static double measureCounters(Counters *counters, const std::vector<int> &cpus, double duration, std::atomic<uint64_t> &(*counter)(Counters *, size_t))
+{
+	for (size_t t = 0; t < cpus.size(); ++t)
+		counter(counters, t).store(0);
+	return runPinned(cpus, duration, [counters, counter](size_t t) {
+		std::atomic<uint64_t> &c = counter(counters, t);
+		c.store(c.load(std::memory_order_relaxed)+1, std::memory_order_relaxed);
+	});
+}
+
+static std::atomic<uint64_t> &packedCounter(PackedCounters *counters, size_t t)
+{
+	return counters->counters[t];
+}
+
+static std::atomic<uint64_t> &paddedCounter(PaddedCounters *counters, size_t t)
+{
+	return counters->counters[t].value;
+}
+
+// Sums of latencies of CPU pairs in the same relation
+struct RelationSummary {
+	double ns;
+	double ticks;
+	int pairs;
+	// pairs with frequency changed during the best sample
+	int changed;
+
+	RelationSummary(): ns(0), ticks(0), pairs(0), changed(0) {}
+};
+
+// Relation of two CPUs, from the closest
+static const char *pairRelation(const CpuInfo &a, const CpuInfo &b)
+{
+	if (std::find(a.siblings.begin(), a.siblings.end(), b.cpu) != a.siblings.end())
+		return "smt";
+	if (a.package != b.package)
+		return "remote-package";
+	if (a.cluster >= 0 && a.cluster == b.cluster)
+		return "cluster";
+	return "package";
+}
+
+int runCoreToCore(int argc, char **argv)
+{
+	long rounds = 20000;
+	double duration = 0.2;
+	for (int i = 0; i < argc; ++i) {
+		if (strncmp(argv[i], "--rounds=", 9) == 0) {
+			rounds = std::max(1L, atol(argv[i]+9));
+		}
+		else if (strncmp(argv[i], "--duration=", 11) == 0) {
+			duration = atof(argv[i]+11);
+		}
+		else {
+			fprintf(stderr, "Usage: c2c [--rounds=n] [--duration=seconds]\n");
+			return 2;
+		}
+	}
+	// only the CPUs allowed by affinity, pinning to the others fails
+	std::vector<CpuInfo> topology = filterAllowedCpus(readCpuTopology());
+	size_t n = topology.size();
+	if (n == 0) {
+		fprintf(stderr, "No allowed CPUs found\n");
+		return 1;
+	}
+	if (startFrequencyTracer(NULL))
+		printf("# ticks of effective frequency of the pinging CPU measured during each pair\n");
+	else
+		printf("# ticks of maximum CPU frequency, nominal clock if not known (no cycle counter)\n");
+
+#ifdef __linux__
+	cpu_set_t original;
+	pthread_getaffinity_np(pthread_self(), sizeof(original), &original);
+#endif
+	printf("# core-to-core one-way latency, ns\n");
+	printf("%4s", "");
+	for (size_t j = 0; j < n; ++j)
+		printf(" %6d", topology[j].cpu);
+	printf("\n");
+	std::vector<std::vector<double> > matrix(n, std::vector<double>(n, 0));
+	std::map<std::string, RelationSummary> relations;
+	for (size_t i = 0; i < n; ++i) {
+		printf("%4d", topology[i].cpu);
+		for (size_t j = 0; j < n; ++j) {
+			if (j < i) {
+				matrix[i][j] = matrix[j][i];
+			}
+			else if (j > i) {
+				FrequencyRun frequency;
+				matrix[i][j] = measurePingPong(topology[i].cpu, topology[j].cpu, rounds, &frequency);
+				if (matrix[i][j] < 0) {
+					fprintf(stderr, "Failed to pin to cpus %d and %d, skipping\n", topology[i].cpu, topology[j].cpu);
+				}
+				else {
+					double clock = frequency.frequency != 0 ? frequency.frequency : topology[i].maxFrequency != 0 ? topology[i].maxFrequency : getCpuClock();
+					RelationSummary &relation = relations[pairRelation(topology[i], topology[j])];
+					relation.ns += matrix[i][j];
+					relation.ticks += matrix[i][j]*clock/1e9;
+					relation.pairs += 1;
+					relation.changed += frequency.changed;
+				}
+			}
+			if (i == j || matrix[i][j] < 0)
+				printf(" %6s", "-");
+			else
+				printf(" %6.1f", matrix[i][j]);
+		}
+		printf("\n");
+		fflush(stdout);
+	}
+#ifdef __linux__
+	pthread_setaffinity_np(pthread_self(), sizeof(original), &original);
+#endif
+	for (const auto &relation: relations) {
+		const RelationSummary &summary = relation.second;
+		printf("# %s: average %.1f ns, %.1f ticks, %d pairs", relation.first.c_str(), summary.ns/summary.pairs, summary.ticks/summary.pairs, summary.pairs);
+		if (summary.changed != 0)
+			printf(", frequency changed in %d", summary.changed);
+		printf("\n");
+	}
+
+	// thread counts doubling up to all CPUs
+	std::vector<size_t> threadCounts;
+	for (size_t count = 1; count < n; count *= 2)
+		threadCounts.push_back(count);
+	threadCounts.push_back(n);
+	std::vector<int> cpus;
+	for (const CpuInfo &info: topology)
+		cpus.push_back(info.cpu);
+
+	printf("# contended atomics, total Mops/s and ns per operation per thread\n");
+	printf("%-8s", "threads");
+	for (int operation = 0; operation < ATOMIC_COUNT; ++operation)
+		printf(" %10s %8s", atomicNames[operation], "ns/op");
+	printf("\n");
+	for (size_t count: threadCounts) {
+		std::vector<int> used(cpus.begin(), cpus.begin()+count);
+		printf("%-8zu", count);
+		for (int operation = 0; operation < ATOMIC_COUNT; ++operation) {
+			double ops = measureAtomic((AtomicOperation)operation, used, duration);
+			if (ops < 0) {
+				fprintf(stderr, "Failed to pin to cpus %s, skipping\n", formatCpuList(used).c_str());
+				printf(" %10s %8s", "-", "-");
+				continue;
+			}
+			printf(" %10.2f %8.2f", ops/1e6, 1e9*count/ops);
+		}
+		printf("\n");
+		fflush(stdout);
+	}
+
+	printf("# false sharing, total Mops/s of per-thread counters\n");
+	printf("%-8s %10s %10s %8s\n", "threads", "packed", "padded", "ratio");
+	for (size_t count: threadCounts) {
+		if (count > 8)
+			break;
+		std::vector<int> used(cpus.begin(), cpus.begin()+count);
+		PackedCounters packed;
+		PaddedCounters padded;
+		double packedOps = measureCounters(&packed, used, duration, &packedCounter);
+		double paddedOps = measureCounters(&padded, used, duration, &paddedCounter);
+		if (packedOps < 0 || paddedOps < 0) {
+			fprintf(stderr, "Failed to pin to cpus %s, skipping\n", formatCpuList(used).c_str());
+			continue;
+		}
+		printf("%-8zu %10.2f %10.2f %8.2f\n", count, packedOps/1e6, paddedOps/1e6, paddedOps/packedOps);
+		fflush(stdout);
+	}
+	return 0;
+}
@@ -0,0 +1,254 @@
+/*
+ * Effective frequency tracer.
+ *
+ * Counts core cycles of the measuring thread with perf_event (user space cycles, allowed with the default
+ * perf_event_paranoid), or with APERF MSR of the CPU the thread runs on where /dev/cpu/N/msr is readable.  Background
+ * thread samples the counter every 10 ms and records the frequency time series, probe runs get the average frequency
+ * over the run and the range of the sampled intervals, so turbo, thermal throttling and AVX license changes part-way
+ * through the run are visible.  As the cycles are counted only when the thread runs, the frequency also drops when the
+ * thread is preempted, which is what per-cycle normalization needs anyway.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CpuSpeed.hxx"
+
+
+static const double SAMPLE_INTERVAL = 0.010;
+// Relative difference between the slowest and fastest interval considered as frequency change
+static const double CHANGE_THRESHOLD = 0.05;
+
+#ifdef __linux__
+static const uint32_t MSR_APERF = 0xe8;
+#endif
+
+class FrequencyTracer
+{
+public:
+	FrequencyTracer():
+		perfFd(-1),
+		tid(0),
+		trace(NULL),
+		running(false),
+		active(false)
+	{
+	}
+
+	~FrequencyTracer()
+	{
+		if (running.exchange(false))
+			sampler.join();
+		if (trace != NULL)
+			fclose(trace);
+#ifdef __linux__
+		if (perfFd >= 0)
+			close(perfFd);
+#endif
+	}
+
+	bool start(const char *tracePath)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if (running.load())
+			return true;
+		if (!openCounter()) {
+			if (tracePath != NULL)
+				fprintf(stderr, "No cycle counter available (perf_event, APERF MSR), frequency trace not written\n");
+			return false;
+		}
+		if (tracePath != NULL) {
+			trace = fopen(tracePath, "w");
+			if (trace == NULL)
+				fprintf(stderr, "Failed to open frequency trace %s: %s\n", tracePath, strerror(errno));
+			else
+				fprintf(trace, "time,frequency,probe\n");
+		}
+		origin = std::chrono::steady_clock::now();
+		running.store(true);
+		sampler = std::thread([this]() { sample(); });
+		return true;
+	}
+
+	void begin(const std::string &label)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		runLabel = label;
+		runIntervals.clear();
+		runStart = std::chrono::steady_clock::now();
+		runCycles = readCycles();
+		active = true;
+	}
+
+	FrequencyRun end()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		FrequencyRun run = { 0, 0, 0, false };
+		std::chrono::duration<double> elapsed(std::chrono::steady_clock::now()-runStart);
+		uint64_t cycles = readCycles();
+		// zero if APERF moved to another CPU, the caller falls back to nominal clock
+		run.frequency = cycles >= runCycles ? (cycles-runCycles)/elapsed.count() : 0;
+		run.minimum = run.maximum = run.frequency;
+		if (!runIntervals.empty()) {
+			run.minimum = *std::min_element(runIntervals.begin(), runIntervals.end());
+			run.maximum = *std::max_element(runIntervals.begin(), runIntervals.end());
+		}
+		run.changed = run.minimum > 0 && run.maximum/run.minimum-1 > CHANGE_THRESHOLD;
+		active = false;
+		return run;
+	}
+
+private:
+	bool openCounter()
+	{
+#ifdef __linux__
+		tid = (pid_t)syscall(SYS_gettid);
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_CPU_CYCLES;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		perfFd = (int)syscall(SYS_perf_event_open, &attr, tid, -1, -1, 0);
+		if (perfFd >= 0)
+			return true;
+		int cpu = currentCpu();
+		return cpu >= 0 && readMsr(cpu, MSR_APERF) != 0;
+#else
+		return false;
+#endif
+	}
+
+	// CPU the traced thread last ran on
+	int currentCpu()
+	{
+#ifdef __linux__
+		std::ifstream stat("/proc/self/task/"+std::to_string(tid)+"/stat");
+		std::string content((std::istreambuf_iterator<char>(stat)), std::istreambuf_iterator<char>());
+		// fields after the command name, which may contain spaces; processor is field 39, 37th after it
+		size_t pos = content.rfind(')');
+		if (pos == std::string::npos)
+			return -1;
+		const char *p = content.c_str()+pos+1;
+		for (int field = 0; field < 37 && *p != '\0'; ++field) {
+			p += strspn(p, " ");
+			p += strcspn(p, " ");
+		}
+		return *p != '\0' ? atoi(p) : -1;
+#else
+		return -1;
+#endif
+	}
+
+#ifdef __linux__
+	static uint64_t readMsr(int cpu, uint32_t msr)
+	{
+		uint64_t value = 0;
+		int fd = open(("/dev/cpu/"+std::to_string(cpu)+"/msr").c_str(), O_RDONLY);
+		if (fd < 0)
+			return 0;
+		if (pread(fd, &value, sizeof(value), msr) != sizeof(value))
+			value = 0;
+		close(fd);
+		return value;
+	}
+#endif
+
+	// APERF is per CPU, so the value is only continuous while the thread stays on the same CPU
+	uint64_t readCycles()
+	{
+#ifdef __linux__
+		uint64_t value = 0;
+		if (perfFd >= 0)
+			return read(perfFd, &value, sizeof(value)) == sizeof(value) ? value : 0;
+		int cpu = currentCpu();
+		return cpu >= 0 ? readMsr(cpu, MSR_APERF) : 0;
+#else
+		return 0;
+#endif
+	}
+
+	void sample()
+	{
+		uint64_t lastCycles = readCycles();
+		auto last = std::chrono::steady_clock::now();
+		while (running.load()) {
+			std::this_thread::sleep_for(std::chrono::duration<double>(SAMPLE_INTERVAL));
+			std::lock_guard<std::mutex> guard(lock);
+			uint64_t cycles = readCycles();
+			auto now = std::chrono::steady_clock::now();
+			// APERF of another CPU after migration, no valid interval
+			if (cycles >= lastCycles) {
+				double frequency = (cycles-lastCycles)/std::chrono::duration<double>(now-last).count();
+				if (active)
+					runIntervals.push_back(frequency);
+				if (trace != NULL)
+					fprintf(trace, "%.3f,%.0f,%s\n", std::chrono::duration<double>(now-origin).count(), frequency, active ? runLabel.c_str() : "-");
+			}
+			lastCycles = cycles;
+			last = now;
+		}
+	}
+
+	int perfFd;
+	int tid;
+	FILE *trace;
+	std::atomic<bool> running;
+	std::thread sampler;
+	std::mutex lock;
+	std::chrono::steady_clock::time_point origin;
+
+	bool active;
+	std::string runLabel;
+	std::chrono::steady_clock::time_point runStart;
+	uint64_t runCycles;
+	std::vector<double> runIntervals;
+};
+
+static FrequencyTracer tracer;
+
+bool startFrequencyTracer(const char *tracePath)
+{
+	static bool available = tracer.start(tracePath);
+	return available;
+}
+
+void beginFrequencyRun(const std::string &label)
+{
+	tracer.begin(label);
+}
+
+FrequencyRun endFrequencyRun()
+{
+	return tracer.end();
+}
+
+double effectiveClock(const Measurement &measurement)
+{
+	return effectiveClock(measurement, getCpuClock());
+}
+
+double effectiveClock(const Measurement &measurement, double clock)
+{
+	return measurement.frequency.frequency != 0 ? measurement.frequency.frequency : clock;
+}
@@ -0,0 +1,483 @@
+/*
+ * Instruction latency and reciprocal throughput probes.
+ *
+ * Every probe is generated from single instruction template, taking register name.  Latency variant repeats the
+ * instruction on single register, so each instruction depends on previous one.  Throughput variant rotates the
+ * instruction over ten registers, so there are ten independent dependency chains, enough to saturate execution ports
+ * for instructions with latency up to ten times the reciprocal throughput.  Both run 100 instructions per loop
+ * iteration, the loop itself is written in assembler too, so the registers can be initialized once.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "CpuSpeed.hxx"
+
+
+#define CPUSPEED_REP10(s) s s s s s s s s s s
+#define CPUSPEED_REP100(s) CPUSPEED_REP10(CPUSPEED_REP10(s))
+
+// Applies INSN to each of the ten registers of class REG
+#define CPUSPEED_STREAMS(INSN, REG) \
+	INSN(REG(0)) INSN(REG(1)) INSN(REG(2)) INSN(REG(3)) INSN(REG(4)) \
+	INSN(REG(5)) INSN(REG(6)) INSN(REG(7)) INSN(REG(8)) INSN(REG(9))
+
+#if (defined __x86_64__)
+
+#define CPUSPEED_LOOP_END \
+	"dec %[loops]\n" \
+	"jnz 1b\n"
+// shifts by register take the count from cl
+#define CPUSPEED_SHIFT_OPERAND [shift] "c"(3L)
+#define CPUSPEED_FEATURE(f) (__builtin_cpu_supports(f) != 0)
+
+#define CPUSPEED_GPR(n) CPUSPEED_GPR_##n
+#define CPUSPEED_GPR_0 "%%r8"
+#define CPUSPEED_GPR_1 "%%r9"
+#define CPUSPEED_GPR_2 "%%r10"
+#define CPUSPEED_GPR_3 "%%r11"
+#define CPUSPEED_GPR_4 "%%r12"
+#define CPUSPEED_GPR_5 "%%r13"
+#define CPUSPEED_GPR_6 "%%r14"
+#define CPUSPEED_GPR_7 "%%r15"
+#define CPUSPEED_GPR_8 "%%rsi"
+#define CPUSPEED_GPR_9 "%%rdi"
+#define CPUSPEED_GPR_CLOBBERS "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15", "rsi", "rdi"
+#define CPUSPEED_GPR_FINISH ""
+
+#define CPUSPEED_XMM(n) "%%xmm" #n
+#define CPUSPEED_XMM_CLOBBERS "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7", "xmm8", "xmm9"
+#define CPUSPEED_XMM_FINISH ""
+
+#define CPUSPEED_YMM(n) "%%ymm" #n
+#define CPUSPEED_YMM_CLOBBERS CPUSPEED_XMM_CLOBBERS
+#define CPUSPEED_YMM_FINISH "vzeroupper\n"
+
+#define CPUSPEED_ZMM(n) "%%zmm" #n
+#define CPUSPEED_ZMM_CLOBBERS CPUSPEED_XMM_CLOBBERS
+#define CPUSPEED_ZMM_FINISH "vzeroupper\n"
+
+// Register initialization, vectors are loaded with 1.0f so multiplications and divisions do not hit denormals
+#define INIT_ONE(r) "mov $1, " r "\n"
+#define INIT_POINTER(r) "mov %[memory], " r "\n"
+#define INIT_XMM(r) "movups 64(%[memory]), " r "\n"
+#define INIT_VEX(r) "vmovups 64(%[memory]), " r "\n"
+
+#elif (defined __aarch64__)
+
+#define CPUSPEED_LOOP_END \
+	"subs %[loops], %[loops], 1\n" \
+	"b.ne 1b\n"
+#define CPUSPEED_SHIFT_OPERAND [shift] "r"(3L)
+#define CPUSPEED_FEATURE(f) true
+
+#define CPUSPEED_GPR(n) CPUSPEED_GPR_##n
+#define CPUSPEED_GPR_0 "x8"
+#define CPUSPEED_GPR_1 "x9"
+#define CPUSPEED_GPR_2 "x10"
+#define CPUSPEED_GPR_3 "x11"
+#define CPUSPEED_GPR_4 "x12"
+#define CPUSPEED_GPR_5 "x13"
+#define CPUSPEED_GPR_6 "x14"
+#define CPUSPEED_GPR_7 "x15"
+#define CPUSPEED_GPR_8 "x16"
+#define CPUSPEED_GPR_9 "x17"
+// x7 holds divisor
+#define CPUSPEED_GPR_CLOBBERS "x7", "x8", "x9", "x10", "x11", "x12", "x13", "x14", "x15", "x16", "x17"
+#define CPUSPEED_GPR_FINISH ""
+
+// v16-v25, avoiding callee-saved v8-v15
+#define CPUSPEED_NEON4S(n) CPUSPEED_NEON4S_##n
+#define CPUSPEED_NEON4S_0 "v16.4s"
+#define CPUSPEED_NEON4S_1 "v17.4s"
+#define CPUSPEED_NEON4S_2 "v18.4s"
+#define CPUSPEED_NEON4S_3 "v19.4s"
+#define CPUSPEED_NEON4S_4 "v20.4s"
+#define CPUSPEED_NEON4S_5 "v21.4s"
+#define CPUSPEED_NEON4S_6 "v22.4s"
+#define CPUSPEED_NEON4S_7 "v23.4s"
+#define CPUSPEED_NEON4S_8 "v24.4s"
+#define CPUSPEED_NEON4S_9 "v25.4s"
+#define CPUSPEED_NEON4S_CLOBBERS "v16", "v17", "v18", "v19", "v20", "v21", "v22", "v23", "v24", "v25"
+#define CPUSPEED_NEON4S_FINISH ""
+
+#define CPUSPEED_NEON16B(n) CPUSPEED_NEON16B_##n
+#define CPUSPEED_NEON16B_0 "v16.16b"
+#define CPUSPEED_NEON16B_1 "v17.16b"
+#define CPUSPEED_NEON16B_2 "v18.16b"
+#define CPUSPEED_NEON16B_3 "v19.16b"
+#define CPUSPEED_NEON16B_4 "v20.16b"
+#define CPUSPEED_NEON16B_5 "v21.16b"
+#define CPUSPEED_NEON16B_6 "v22.16b"
+#define CPUSPEED_NEON16B_7 "v23.16b"
+#define CPUSPEED_NEON16B_8 "v24.16b"
+#define CPUSPEED_NEON16B_9 "v25.16b"
+#define CPUSPEED_NEON16B_CLOBBERS CPUSPEED_NEON4S_CLOBBERS
+#define CPUSPEED_NEON16B_FINISH ""
+
+#define INIT_ONE(r) "mov " r ", 1\n"
+#define INIT_DIVIDEND(r) "mov " r ", 12345\n" "mov x7, 1\n"
+#define INIT_POINTER(r) "mov " r ", %[memory]\n"
+#define INIT_NEON4S(r) "fmov " r ", 1.0\n"
+#define INIT_NEON16B(r) "movi " r ", 1\n"
+
+#else
+# error Unsupported platform
+#endif
+
+typedef void (*ProbeFunction)(long loops, void *memory);
+
+// Generates name_latency and name_throughput functions
+#define CPUSPEED_PROBE_FUNCTION(name, suffix, CLASS, INIT, BODY) \
+	static void name##_##suffix(long loops, void *memory) \
+	{ \
+		__asm__ __volatile__( \
+				CPUSPEED_STREAMS(INIT, CLASS) \
+				".p2align 4\n" \
+				"1:\n" \
+				BODY \
+				CPUSPEED_LOOP_END \
+				CLASS##_FINISH \
+				: [loops] "+r"(loops) \
+				: [memory] "r"(memory), CPUSPEED_SHIFT_OPERAND \
+				: CLASS##_CLOBBERS, "cc", "memory" \
+				); \
+	}
+
+#define CPUSPEED_LATENCY_PROBE(name, CLASS, INIT, INSN) \
+	CPUSPEED_PROBE_FUNCTION(name, latency, CLASS, INIT, CPUSPEED_REP100(INSN(CLASS(0))))
+
+#define CPUSPEED_THROUGHPUT_PROBE(name, CLASS, INIT, INSN) \
+	CPUSPEED_PROBE_FUNCTION(name, throughput, CLASS, INIT, CPUSPEED_REP10(CPUSPEED_STREAMS(INSN, CLASS)))
+
+#define CPUSPEED_PROBE(name, CLASS, INIT, INSN) \
+	CPUSPEED_LATENCY_PROBE(name, CLASS, INIT, INSN) \
+	CPUSPEED_THROUGHPUT_PROBE(name, CLASS, INIT, INSN)
+
+
+#if (defined __x86_64__)
+
+#define INSN_ADD(r) "add $1, " r "\n"
+#define INSN_LEA_SIMPLE(r) "lea 1(" r "), " r "\n"
+#define INSN_LEA_COMPLEX(r) "lea 1(" r "," r ",2), " r "\n"
+#define INSN_IMUL(r) "imul " r ", " r "\n"
+#define INSN_SHL_IMM(r) "shl $3, " r "\n"
+#define INSN_SHL_CL(r) "shl %%cl, " r "\n"
+#define INSN_SHLX(r) "shlx %%rcx, " r ", " r "\n"
+#define INSN_POPCNT(r) "popcnt " r ", " r "\n"
+#define INSN_TZCNT(r) "tzcnt " r ", " r "\n"
+#define INSN_CRC32(r) "crc32q " r ", " r "\n"
+#define INSN_LOAD_CHASE(r) "mov (" r "), " r "\n"
+#define INSN_STORE(r) "mov " r ", 128(%[memory])\n"
+#define INSN_STORE_FORWARD(r) "mov " r ", 128(%[memory])\n" "mov 128(%[memory]), " r "\n"
+#define INSN_ADDPS(r) "addps " r ", " r "\n"
+#define INSN_MULPS(r) "mulps " r ", " r "\n"
+#define INSN_DIVPS(r) "divps " r ", " r "\n"
+#define INSN_SQRTPS(r) "sqrtps " r ", " r "\n"
+#define INSN_VADDPS(r) "vaddps " r ", " r ", " r "\n"
+#define INSN_VMULPS(r) "vmulps " r ", " r ", " r "\n"
+#define INSN_VFMADD(r) "vfmadd231ps " r ", " r ", " r "\n"
+#define INSN_VSHUFPS(r) "vshufps $0x1b, " r ", " r ", " r "\n"
+#define INSN_VPERMILPS(r) "vpermilps $0x1b, " r ", " r "\n"
+#define INSN_VPERM2F128(r) "vperm2f128 $1, " r ", " r ", " r "\n"
+#define INSN_VPERMPS(r) "vpermps " r ", " r ", " r "\n"
+#define INSN_VPSHUFB(r) "vpshufb " r ", " r ", " r "\n"
+#define INSN_VLOAD(r) "vmovups (%[memory]), " r "\n"
+#define INSN_VSTORE(r) "vmovups " r ", 128(%[memory])\n"
+
+CPUSPEED_PROBE(add64, CPUSPEED_GPR, INIT_ONE, INSN_ADD)
+CPUSPEED_PROBE(leaSimple, CPUSPEED_GPR, INIT_ONE, INSN_LEA_SIMPLE)
+CPUSPEED_PROBE(leaComplex, CPUSPEED_GPR, INIT_ONE, INSN_LEA_COMPLEX)
+CPUSPEED_PROBE(imul64, CPUSPEED_GPR, INIT_ONE, INSN_IMUL)
+CPUSPEED_PROBE(shlImm, CPUSPEED_GPR, INIT_ONE, INSN_SHL_IMM)
+CPUSPEED_PROBE(shlCl, CPUSPEED_GPR, INIT_ONE, INSN_SHL_CL)
+CPUSPEED_PROBE(shlx, CPUSPEED_GPR, INIT_ONE, INSN_SHLX)
+CPUSPEED_PROBE(popcnt, CPUSPEED_GPR, INIT_ONE, INSN_POPCNT)
+CPUSPEED_PROBE(tzcnt, CPUSPEED_GPR, INIT_ONE, INSN_TZCNT)
+CPUSPEED_PROBE(crc32, CPUSPEED_GPR, INIT_ONE, INSN_CRC32)
+CPUSPEED_PROBE(load, CPUSPEED_GPR, INIT_POINTER, INSN_LOAD_CHASE)
+CPUSPEED_THROUGHPUT_PROBE(store, CPUSPEED_GPR, INIT_ONE, INSN_STORE)
+CPUSPEED_LATENCY_PROBE(storeForward, CPUSPEED_GPR, INIT_ONE, INSN_STORE_FORWARD)
+CPUSPEED_PROBE(addpsXmm, CPUSPEED_XMM, INIT_XMM, INSN_ADDPS)
+CPUSPEED_PROBE(mulpsXmm, CPUSPEED_XMM, INIT_XMM, INSN_MULPS)
+CPUSPEED_PROBE(divpsXmm, CPUSPEED_XMM, INIT_XMM, INSN_DIVPS)
+CPUSPEED_PROBE(sqrtpsXmm, CPUSPEED_XMM, INIT_XMM, INSN_SQRTPS)
+CPUSPEED_PROBE(vaddpsYmm, CPUSPEED_YMM, INIT_VEX, INSN_VADDPS)
+CPUSPEED_PROBE(vmulpsYmm, CPUSPEED_YMM, INIT_VEX, INSN_VMULPS)
+CPUSPEED_PROBE(vfmaddYmm, CPUSPEED_YMM, INIT_VEX, INSN_VFMADD)
+CPUSPEED_PROBE(vshufpsYmm, CPUSPEED_YMM, INIT_VEX, INSN_VSHUFPS)
+CPUSPEED_PROBE(vpermilpsYmm, CPUSPEED_YMM, INIT_VEX, INSN_VPERMILPS)
+CPUSPEED_PROBE(vperm2f128Ymm, CPUSPEED_YMM, INIT_VEX, INSN_VPERM2F128)
+CPUSPEED_PROBE(vpermpsYmm, CPUSPEED_YMM, INIT_VEX, INSN_VPERMPS)
+CPUSPEED_PROBE(vpshufbYmm, CPUSPEED_YMM, INIT_VEX, INSN_VPSHUFB)
+CPUSPEED_THROUGHPUT_PROBE(vloadYmm, CPUSPEED_YMM, INIT_VEX, INSN_VLOAD)
+CPUSPEED_THROUGHPUT_PROBE(vstoreYmm, CPUSPEED_YMM, INIT_VEX, INSN_VSTORE)
+CPUSPEED_PROBE(vaddpsZmm, CPUSPEED_ZMM, INIT_VEX, INSN_VADDPS)
+CPUSPEED_PROBE(vfmaddZmm, CPUSPEED_ZMM, INIT_VEX, INSN_VFMADD)
+CPUSPEED_PROBE(vpermpsZmm, CPUSPEED_ZMM, INIT_VEX, INSN_VPERMPS)
+CPUSPEED_THROUGHPUT_PROBE(vloadZmm, CPUSPEED_ZMM, INIT_VEX, INSN_VLOAD)
+CPUSPEED_THROUGHPUT_PROBE(vstoreZmm, CPUSPEED_ZMM, INIT_VEX, INSN_VSTORE)
+
+// Division uses fixed rdx:rax, so only latency can be measured.  Dividing by one keeps the quotient large and the
+// remainder (next high half) zero.
+#define CPUSPEED_DIV_PROBE(name, INSN) \
+	static void name##_latency(long loops, void *memory) \
+	{ \
+		__asm__ __volatile__( \
+				"mov $1, %%r8\n" \
+				"xor %%edx, %%edx\n" \
+				"movabs $0x123456789abcdef, %%rax\n" \
+				".p2align 4\n" \
+				"1:\n" \
+				CPUSPEED_REP100(INSN) \
+				CPUSPEED_LOOP_END \
+				: [loops] "+r"(loops) \
+				: [memory] "r"(memory) \
+				: "rax", "rdx", "r8", "cc", "memory" \
+				); \
+	}
+
+CPUSPEED_DIV_PROBE(div32, "div %%r8d\n")
+CPUSPEED_DIV_PROBE(div64, "div %%r8\n")
+
+#elif (defined __aarch64__)
+
+#define INSN_ADD(r) "add " r ", " r ", 1\n"
+#define INSN_MUL(r) "mul " r ", " r ", " r "\n"
+#define INSN_UDIV(r) "udiv " r ", " r ", x7\n"
+#define INSN_LSL_IMM(r) "lsl " r ", " r ", 3\n"
+#define INSN_LSL_REG(r) "lsl " r ", " r ", %[shift]\n"
+#define INSN_LOAD_CHASE(r) "ldr " r ", [" r "]\n"
+#define INSN_STORE(r) "str " r ", [%[memory], 128]\n"
+#define INSN_STORE_FORWARD(r) "str " r ", [%[memory], 128]\n" "ldr " r ", [%[memory], 128]\n"
+#define INSN_FADD(r) "fadd " r ", " r ", " r "\n"
+#define INSN_FMUL(r) "fmul " r ", " r ", " r "\n"
+#define INSN_FDIV(r) "fdiv " r ", " r ", " r "\n"
+#define INSN_FMLA(r) "fmla " r ", " r ", " r "\n"
+#define INSN_CNT(r) "cnt " r ", " r "\n"
+#define INSN_EXT(r) "ext " r ", " r ", " r ", 4\n"
+#define INSN_TBL(r) "tbl " r ", {" r "}, " r "\n"
+#define INSN_VLOAD(r) "ld1 {" r "}, [%[memory]]\n"
+#define INSN_VSTORE(r) "st1 {" r "}, [%[memory]]\n"
+
+CPUSPEED_PROBE(add64, CPUSPEED_GPR, INIT_ONE, INSN_ADD)
+CPUSPEED_PROBE(mul64, CPUSPEED_GPR, INIT_ONE, INSN_MUL)
+CPUSPEED_PROBE(udiv64, CPUSPEED_GPR, INIT_DIVIDEND, INSN_UDIV)
+CPUSPEED_PROBE(lslImm, CPUSPEED_GPR, INIT_ONE, INSN_LSL_IMM)
+CPUSPEED_PROBE(lslReg, CPUSPEED_GPR, INIT_ONE, INSN_LSL_REG)
+CPUSPEED_PROBE(load, CPUSPEED_GPR, INIT_POINTER, INSN_LOAD_CHASE)
+CPUSPEED_THROUGHPUT_PROBE(store, CPUSPEED_GPR, INIT_ONE, INSN_STORE)
+CPUSPEED_LATENCY_PROBE(storeForward, CPUSPEED_GPR, INIT_ONE, INSN_STORE_FORWARD)
+CPUSPEED_PROBE(fadd4s, CPUSPEED_NEON4S, INIT_NEON4S, INSN_FADD)
+CPUSPEED_PROBE(fmul4s, CPUSPEED_NEON4S, INIT_NEON4S, INSN_FMUL)
+CPUSPEED_PROBE(fdiv4s, CPUSPEED_NEON4S, INIT_NEON4S, INSN_FDIV)
+CPUSPEED_PROBE(fmla4s, CPUSPEED_NEON4S, INIT_NEON4S, INSN_FMLA)
+CPUSPEED_PROBE(cnt16b, CPUSPEED_NEON16B, INIT_NEON16B, INSN_CNT)
+CPUSPEED_PROBE(ext16b, CPUSPEED_NEON16B, INIT_NEON16B, INSN_EXT)
+CPUSPEED_PROBE(tbl16b, CPUSPEED_NEON16B, INIT_NEON16B, INSN_TBL)
+CPUSPEED_THROUGHPUT_PROBE(vload4s, CPUSPEED_NEON4S, INIT_NEON4S, INSN_VLOAD)
+CPUSPEED_THROUGHPUT_PROBE(vstore4s, CPUSPEED_NEON4S, INIT_NEON4S, INSN_VSTORE)
+
+#endif
+
+
+struct InstructionProbe {
+	const char *name;
+	// Feature required, NULL for baseline
+	const char *feature;
+	bool supported;
+	// NULL if not applicable
+	ProbeFunction latency;
+	ProbeFunction throughput;
+};
+
+#define PROBE_BOTH(name, feature) { #name, feature, CPUSPEED_FEATURE(feature), name##_latency, name##_throughput }
+#define PROBE_LATENCY(name, feature) { #name, feature, CPUSPEED_FEATURE(feature), name##_latency, NULL }
+#define PROBE_THROUGHPUT(name, feature) { #name, feature, CPUSPEED_FEATURE(feature), NULL, name##_throughput }
+
+static std::vector<InstructionProbe> instructionProbes()
+{
+#if (defined __x86_64__)
+	__builtin_cpu_init();
+	InstructionProbe probes[] = {
+		PROBE_BOTH(add64, "sse2"),
+		PROBE_BOTH(leaSimple, "sse2"),
+		PROBE_BOTH(leaComplex, "sse2"),
+		PROBE_BOTH(imul64, "sse2"),
+		PROBE_LATENCY(div32, "sse2"),
+		PROBE_LATENCY(div64, "sse2"),
+		PROBE_BOTH(shlImm, "sse2"),
+		PROBE_BOTH(shlCl, "sse2"),
+		PROBE_BOTH(shlx, "bmi2"),
+		PROBE_BOTH(popcnt, "popcnt"),
+		PROBE_BOTH(tzcnt, "bmi"),
+		PROBE_BOTH(crc32, "sse4.2"),
+		PROBE_BOTH(load, "sse2"),
+		PROBE_THROUGHPUT(store, "sse2"),
+		PROBE_LATENCY(storeForward, "sse2"),
+		PROBE_BOTH(addpsXmm, "sse2"),
+		PROBE_BOTH(mulpsXmm, "sse2"),
+		PROBE_BOTH(divpsXmm, "sse2"),
+		PROBE_BOTH(sqrtpsXmm, "sse2"),
+		PROBE_BOTH(vaddpsYmm, "avx"),
+		PROBE_BOTH(vmulpsYmm, "avx"),
+		PROBE_BOTH(vfmaddYmm, "fma"),
+		PROBE_BOTH(vshufpsYmm, "avx"),
+		PROBE_BOTH(vpermilpsYmm, "avx"),
+		PROBE_BOTH(vperm2f128Ymm, "avx"),
+		PROBE_BOTH(vpermpsYmm, "avx2"),
+		PROBE_BOTH(vpshufbYmm, "avx2"),
+		PROBE_THROUGHPUT(vloadYmm, "avx"),
+		PROBE_THROUGHPUT(vstoreYmm, "avx"),
+		PROBE_BOTH(vaddpsZmm, "avx512f"),
+		PROBE_BOTH(vfmaddZmm, "avx512f"),
+		PROBE_BOTH(vpermpsZmm, "avx512f"),
+		PROBE_THROUGHPUT(vloadZmm, "avx512f"),
+		PROBE_THROUGHPUT(vstoreZmm, "avx512f"),
+	};
+#elif (defined __aarch64__)
+	InstructionProbe probes[] = {
+		PROBE_BOTH(add64, "base"),
+		PROBE_BOTH(mul64, "base"),
+		PROBE_BOTH(udiv64, "base"),
+		PROBE_BOTH(lslImm, "base"),
+		PROBE_BOTH(lslReg, "base"),
+		PROBE_BOTH(load, "base"),
+		PROBE_THROUGHPUT(store, "base"),
+		PROBE_LATENCY(storeForward, "base"),
+		PROBE_BOTH(fadd4s, "neon"),
+		PROBE_BOTH(fmul4s, "neon"),
+		PROBE_BOTH(fdiv4s, "neon"),
+		PROBE_BOTH(fmla4s, "neon"),
+		PROBE_BOTH(cnt16b, "neon"),
+		PROBE_BOTH(ext16b, "neon"),
+		PROBE_BOTH(tbl16b, "neon"),
+		PROBE_THROUGHPUT(vload4s, "neon"),
+		PROBE_THROUGHPUT(vstore4s, "neon"),
+	};
+#endif
+	return std::vector<InstructionProbe>(probes, probes+sizeof(probes)/sizeof(probes[0]));
+}
+
+// Memory for load and store probes: pointer to itself at the beginning (for pointer chasing), 1.0f at offset 64 for
+// vector initialization, stores go to offset 128 where possible, the rest is restored before each probe
+struct alignas(64) ProbeMemory {
+	void *self;
+	char padding[64-sizeof(void *)];
+	float ones[16];
+	char scratch[128];
+};
+
+static void initProbeMemory(ProbeMemory *memory)
+{
+	memory->self = memory;
+	for (int i = 0; i < 16; ++i)
+		memory->ones[i] = 1.0f;
+}
+
+// Formats cycles per instruction, marked with ~ if the measurement did not converge and with ! if the frequency changed
+// during the run.  Clock is used when the run has no measured frequency.
+static void measureCycles(char *buffer, size_t size, const std::string &name, ProbeFunction probe, ProbeMemory *memory, const MeasureOptions &options, double clock)
+{
+	Measurement measurement = measureRate(name, [probe, memory](long loops) { probe(loops, memory); }, options);
+	snprintf(buffer, size, "%s%s%.2f", measurement.frequency.changed ? "!" : "", measurement.converged ? "" : "~", effectiveClock(measurement, clock)/measurement.rate/100);
+}
+
+static std::string hostName()
+{
+	std::ifstream cpuInfo("/proc/cpuinfo");
+	const std::regex modelRegex("^(?:model name|CPU part)\\s*:\\s*(.*?)\\s*$");
+	for (std::string line; getline(cpuInfo, line); ) {
+		std::smatch match;
+		if (std::regex_match(line, match, modelRegex))
+			return match[1];
+	}
+	return "unknown";
+}
+
+int runInstructions(int argc, char **argv)
+{
+	MeasureOptions options;
+	// many probes, short budget keeps the whole table within seconds
+	options.budget = 0.05;
+	std::regex filter("");
+	for (int i = 0; i < argc; ++i) {
+		if (parseMeasureOption(argv[i], &options))
+			continue;
+		if (argv[i][0] == '-') {
+			fprintf(stderr, "Usage: instructions [--budget=seconds] [--precision=percent] [--frequency-trace=file] [filter]\n");
+			return 2;
+		}
+		filter = std::regex(argv[i]);
+	}
+	ProbeMemory memory;
+
+	double clock = getCpuClock();
+	if (startFrequencyTracer(options.frequencyTrace)) {
+		printf("# host: %s, clock: measured per probe\n", hostName().c_str());
+	}
+	else {
+		bool converged;
+		clock = calibrateClock(options, &converged);
+		printf("# host: %s, clock: %s%.0f MHz calibrated by register add chain (no cycle counter)\n", hostName().c_str(), converged ? "" : "~", clock/1000000);
+	}
+	printf("%-20s %-8s %10s %18s\n", "instruction", "feature", "latency", "recip-throughput");
+	for (const InstructionProbe &probe: instructionProbes()) {
+		if (!std::regex_search(probe.name, filter))
+			continue;
+		if (!probe.supported) {
+			printf("%-20s %-8s %10s %18s\n", probe.name, probe.feature, "-", "unsupported");
+			continue;
+		}
+		initProbeMemory(&memory);
+		char latency[32] = "-", throughput[32] = "-";
+		if (probe.latency != NULL)
+			measureCycles(latency, sizeof(latency), std::string(probe.name)+".latency", probe.latency, &memory, options, clock);
+		if (probe.throughput != NULL)
+			measureCycles(throughput, sizeof(throughput), std::string(probe.name)+".throughput", probe.throughput, &memory, options, clock);
+		printf("%-20s %-8s %10s %18s\n", probe.name, probe.feature, latency, throughput);
+		fflush(stdout);
+	}
+	return 0;
+}
+
+// Allocates probe memory with its alignment, plain new does not guarantee it before C++17
+static std::shared_ptr<ProbeMemory> allocateProbeMemory()
+{
+	void *raw;
+	if (posix_memalign(&raw, alignof(ProbeMemory), sizeof(ProbeMemory)) != 0)
+		throw std::bad_alloc();
+	ProbeMemory *memory = new(raw) ProbeMemory();
+	initProbeMemory(memory);
+	return std::shared_ptr<ProbeMemory>(memory, [](ProbeMemory *m) { free(m); });
+}
+
+std::vector<Workload> instructionWorkloads()
+{
+	std::vector<Workload> workloads;
+	for (const InstructionProbe &probe: instructionProbes()) {
+		if (!probe.supported)
+			continue;
+		// separate memory for each, store probes may overwrite the pointer used by load probes
+		const ProbeFunction functions[2] = { probe.latency, probe.throughput };
+		const char *const suffixes[2] = { ".latency", ".throughput" };
+		for (int i = 0; i < 2; ++i) {
+			if (functions[i] == NULL)
+				continue;
+			std::shared_ptr<ProbeMemory> memory = allocateProbeMemory();
+			ProbeFunction function = functions[i];
+			workloads.push_back(Workload{ std::string(probe.name)+suffixes[i], [memory, function](long loops) { function(loops, memory.get()); } });
+		}
+	}
+	return workloads;
+}
@@ -0,0 +1,545 @@
+/*
+ * Memory hierarchy probes: pointer chasing latency and streaming bandwidth over growing working set.
+ *
+ * Latency chases pointers through randomly ordered cache lines forming single cycle, so neither prefetcher nor
+ * out-of-order execution can hide the access latency.  It runs with 4 KiB pages and with huge pages, the difference
+ * shows TLB misses cost.  Bandwidth streams through the buffer by 64-byte lines using plain loads, stores, load and
+ * store pairs (copy) and non-temporal stores, on single thread and on all cores.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CpuSpeed.hxx"
+
+
+static const size_t LINE_SIZE = 64;
+static const size_t HUGE_PAGE_SIZE = 2*1024*1024;
+
+struct MemoryBuffer {
+	char *data;
+	size_t size;
+	size_t mapped;
+	// Page type actually obtained
+	const char *pages;
+};
+
+// Allocates buffer with 4 KiB pages or huge pages, falls back to transparent huge pages if no huge pages are reserved
+static MemoryBuffer allocateBuffer(size_t size, bool huge)
+{
+	MemoryBuffer buffer = { NULL, size, 0, "4k" };
+	if (!huge) {
+		buffer.mapped = size;
+		buffer.data = (char *)mmap(NULL, buffer.mapped, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		if (buffer.data == MAP_FAILED)
+			throw std::bad_alloc();
+#ifdef MADV_NOHUGEPAGE
+		madvise(buffer.data, buffer.mapped, MADV_NOHUGEPAGE);
+#endif
+		return buffer;
+	}
+	buffer.mapped = (size+HUGE_PAGE_SIZE-1)&~(HUGE_PAGE_SIZE-1);
+#ifdef MAP_HUGETLB
+	buffer.data = (char *)mmap(NULL, buffer.mapped, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+	if (buffer.data != MAP_FAILED) {
+		buffer.pages = "2m";
+		return buffer;
+	}
+#endif
+	// over-allocate to align to huge page boundary, the rest stays unused
+	char *raw = (char *)mmap(NULL, buffer.mapped+HUGE_PAGE_SIZE, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if (raw == MAP_FAILED)
+		throw std::bad_alloc();
+	size_t skip = (HUGE_PAGE_SIZE-((uintptr_t)raw&(HUGE_PAGE_SIZE-1)))&(HUGE_PAGE_SIZE-1);
+	if (skip != 0)
+		munmap(raw, skip);
+	munmap(raw+skip+buffer.mapped, HUGE_PAGE_SIZE-skip);
+	buffer.data = raw+skip;
+#ifdef MADV_HUGEPAGE
+	madvise(buffer.data, buffer.mapped, MADV_HUGEPAGE);
+	buffer.pages = "thp";
+#endif
+	return buffer;
+}
+
+static void freeBuffer(const MemoryBuffer &buffer)
+{
+	munmap(buffer.data, buffer.mapped);
+}
+
+// Links all cache lines of buffer into single random cycle (Sattolo's algorithm)
+static void buildChase(const MemoryBuffer &buffer)
+{
+	size_t lines = buffer.size/LINE_SIZE;
+	std::vector<uint32_t> order(lines);
+	for (size_t i = 0; i < lines; ++i)
+		order[i] = (uint32_t)i;
+	std::mt19937_64 random(lines);
+	for (size_t i = lines-1; i > 0; --i) {
+		std::swap(order[i], order[random()%i]);
+	}
+	for (size_t i = 0; i < lines; ++i) {
+		*(char **)(buffer.data+order[i]*LINE_SIZE) = buffer.data+order[(i+1)%lines]*LINE_SIZE;
+	}
+}
+
+#define CHASE_STEP p = *(char **)p;
+#define CHASE_STEP16 CHASE_STEP CHASE_STEP CHASE_STEP CHASE_STEP CHASE_STEP CHASE_STEP CHASE_STEP CHASE_STEP \
+	CHASE_STEP CHASE_STEP CHASE_STEP CHASE_STEP CHASE_STEP CHASE_STEP CHASE_STEP CHASE_STEP
+
+static char *chase(char *p, long steps)
+{
+	for (long i = 0; i < steps; i += 16) {
+		CHASE_STEP16
+	}
+	return p;
+}
+
+char *volatile memory_sink;
+
+// Returns nanoseconds per load, frequency of the timed chase goes to frequency (zero if there is no cycle counter)
+static double measureLatency(const MemoryBuffer &buffer, const std::string &label, FrequencyRun *frequency)
+{
+	long steps = std::max(2L*1024*1024, (long)(4*buffer.size/LINE_SIZE));
+	char *p = chase(buffer.data, buffer.size/LINE_SIZE);
+	bool traced = startFrequencyTracer(NULL);
+	if (traced)
+		beginFrequencyRun(label);
+	auto start = std::chrono::steady_clock::now();
+	p = chase(p, steps);
+	std::chrono::duration<double, std::nano> duration(std::chrono::steady_clock::now()-start);
+	*frequency = traced ? endFrequencyRun() : FrequencyRun{ 0, 0, 0, false };
+	memory_sink = p;
+	return duration.count()/steps;
+}
+
+enum StreamKind {
+	STREAM_READ,
+	STREAM_WRITE,
+	STREAM_COPY,
+	STREAM_NT_WRITE,
+	STREAM_COUNT
+};
+
+static const char *const streamNames[STREAM_COUNT] = { "read", "write", "copy", "ntwrite" };
+
+// Streams over size bytes (multiple of 64) from/to given buffers, copy reads first half and writes second half
+static void stream(StreamKind kind, char *data, size_t size)
+{
+	char *end = data+size;
+#if (defined __x86_64__)
+	switch (kind) {
+	case STREAM_READ:
+		__asm__ __volatile__(
+				"1:\n"
+				"movdqa (%0), %%xmm0\n"
+				"movdqa 16(%0), %%xmm1\n"
+				"movdqa 32(%0), %%xmm2\n"
+				"movdqa 48(%0), %%xmm3\n"
+				"add $64, %0\n"
+				"cmp %1, %0\n"
+				"jb 1b\n"
+				: "+&r"(data)
+				: "r"(end)
+				: "xmm0", "xmm1", "xmm2", "xmm3", "cc", "memory"
+				);
+		break;
+	case STREAM_WRITE:
+		__asm__ __volatile__(
+				"pxor %%xmm0, %%xmm0\n"
+				"1:\n"
+				"movdqa %%xmm0, (%0)\n"
+				"movdqa %%xmm0, 16(%0)\n"
+				"movdqa %%xmm0, 32(%0)\n"
+				"movdqa %%xmm0, 48(%0)\n"
+				"add $64, %0\n"
+				"cmp %1, %0\n"
+				"jb 1b\n"
+				: "+&r"(data)
+				: "r"(end)
+				: "xmm0", "cc", "memory"
+				);
+		break;
+	case STREAM_COPY:
+		{
+			size_t half = size/2&~(LINE_SIZE-1);
+			char *dst = data+half;
+			end = data+half;
+			__asm__ __volatile__(
+					"1:\n"
+					"movdqa (%0), %%xmm0\n"
+					"movdqa 16(%0), %%xmm1\n"
+					"movdqa 32(%0), %%xmm2\n"
+					"movdqa 48(%0), %%xmm3\n"
+					"movdqa %%xmm0, (%1)\n"
+					"movdqa %%xmm1, 16(%1)\n"
+					"movdqa %%xmm2, 32(%1)\n"
+					"movdqa %%xmm3, 48(%1)\n"
+					"add $64, %0\n"
+					"add $64, %1\n"
+					"cmp %2, %0\n"
+					"jb 1b\n"
+					: "+&r"(data), "+&r"(dst)
+					: "r"(end)
+					: "xmm0", "xmm1", "xmm2", "xmm3", "cc", "memory"
+					);
+		}
+		break;
+	case STREAM_NT_WRITE:
+		__asm__ __volatile__(
+				"pxor %%xmm0, %%xmm0\n"
+				"1:\n"
+				"movntdq %%xmm0, (%0)\n"
+				"movntdq %%xmm0, 16(%0)\n"
+				"movntdq %%xmm0, 32(%0)\n"
+				"movntdq %%xmm0, 48(%0)\n"
+				"add $64, %0\n"
+				"cmp %1, %0\n"
+				"jb 1b\n"
+				"sfence\n"
+				: "+&r"(data)
+				: "r"(end)
+				: "xmm0", "cc", "memory"
+				);
+		break;
+	default:
+		abort();
+	}
+#elif (defined __aarch64__)
+	switch (kind) {
+	case STREAM_READ:
+		__asm__ __volatile__(
+				"1:\n"
+				"ldp q0, q1, [%0]\n"
+				"ldp q2, q3, [%0, 32]\n"
+				"add %0, %0, 64\n"
+				"cmp %0, %1\n"
+				"b.lo 1b\n"
+				: "+&r"(data)
+				: "r"(end)
+				: "v0", "v1", "v2", "v3", "cc", "memory"
+				);
+		break;
+	case STREAM_WRITE:
+		__asm__ __volatile__(
+				"movi v0.16b, 0\n"
+				"1:\n"
+				"stp q0, q0, [%0]\n"
+				"stp q0, q0, [%0, 32]\n"
+				"add %0, %0, 64\n"
+				"cmp %0, %1\n"
+				"b.lo 1b\n"
+				: "+&r"(data)
+				: "r"(end)
+				: "v0", "cc", "memory"
+				);
+		break;
+	case STREAM_COPY:
+		{
+			size_t half = size/2&~(LINE_SIZE-1);
+			char *dst = data+half;
+			end = data+half;
+			__asm__ __volatile__(
+					"1:\n"
+					"ldp q0, q1, [%0]\n"
+					"ldp q2, q3, [%0, 32]\n"
+					"stp q0, q1, [%1]\n"
+					"stp q2, q3, [%1, 32]\n"
+					"add %0, %0, 64\n"
+					"add %1, %1, 64\n"
+					"cmp %0, %2\n"
+					"b.lo 1b\n"
+					: "+&r"(data), "+&r"(dst)
+					: "r"(end)
+					: "v0", "v1", "v2", "v3", "cc", "memory"
+					);
+		}
+		break;
+	case STREAM_NT_WRITE:
+		__asm__ __volatile__(
+				"movi v0.16b, 0\n"
+				"1:\n"
+				"stnp q0, q0, [%0]\n"
+				"stnp q0, q0, [%0, 32]\n"
+				"add %0, %0, 64\n"
+				"cmp %0, %1\n"
+				"b.lo 1b\n"
+				"dmb ishst\n"
+				: "+&r"(data)
+				: "r"(end)
+				: "v0", "cc", "memory"
+				);
+		break;
+	default:
+		abort();
+	}
+#else
+# error Unsupported platform
+#endif
+}
+
+// Returns bytes per second for all threads together, each thread working on its own part of the working set.  Copy
+// counts both read and written bytes.  The calling thread streams the first part, so its frequency can be traced.
+static double measureBandwidth(StreamKind kind, size_t size, int threads, const std::string &label, FrequencyRun *frequency)
+{
+	size_t part = std::max(LINE_SIZE*2, size/threads&~(LINE_SIZE-1));
+	size_t repeat = std::max((size_t)4, (size_t)256*1024*1024/(part*threads));
+	std::vector<MemoryBuffer> buffers;
+	for (int t = 0; t < threads; ++t) {
+		buffers.push_back(allocateBuffer(part, true));
+		memset(buffers.back().data, 1, part);
+	}
+
+	std::atomic<int> ready(0);
+	std::atomic<bool> go(false);
+	std::vector<std::thread> workers;
+	for (int t = 1; t < threads; ++t) {
+		workers.emplace_back([&, t]() {
+			stream(kind, buffers[t].data, part);
+			ready.fetch_add(1);
+			while (!go.load())
+				std::this_thread::yield();
+			for (size_t r = 0; r < repeat; ++r)
+				stream(kind, buffers[t].data, part);
+		});
+	}
+	stream(kind, buffers[0].data, part);
+	while (ready.load() != threads-1)
+		std::this_thread::yield();
+	bool traced = startFrequencyTracer(NULL);
+	if (traced)
+		beginFrequencyRun(label);
+	auto start = std::chrono::steady_clock::now();
+	go.store(true);
+	for (size_t r = 0; r < repeat; ++r)
+		stream(kind, buffers[0].data, part);
+	*frequency = traced ? endFrequencyRun() : FrequencyRun{ 0, 0, 0, false };
+	for (std::thread &worker: workers)
+		worker.join();
+	std::chrono::duration<double> duration(std::chrono::steady_clock::now()-start);
+
+	for (const MemoryBuffer &buffer: buffers)
+		freeBuffer(buffer);
+	size_t bytes = kind == STREAM_COPY ? (part/2&~(LINE_SIZE-1))*2 : part;
+	return (double)bytes*repeat*threads/duration.count();
+}
+
+// Well beyond last level cache of current CPUs
+static const size_t WORKLOAD_SIZE = 256*1024*1024;
+// Bytes streamed by single loop of memory.read and memory.write
+static const size_t WORKLOAD_BLOCK = 64*1024;
+// Loads of single loop of memory.chase
+static const long WORKLOAD_CHASE = 1024;
+
+struct WorkloadBuffer {
+	MemoryBuffer buffer;
+	char *position;
+
+	WorkloadBuffer(): buffer(), position(NULL) {}
+	~WorkloadBuffer() { if (buffer.data != NULL) freeBuffer(buffer); }
+
+	// Allocated on first use, so the memory is local to the thread running the workload
+	void init(bool chained)
+	{
+		if (buffer.data != NULL)
+			return;
+		buffer = allocateBuffer(WORKLOAD_SIZE, true);
+		if (chained)
+			buildChase(buffer);
+		else
+			memset(buffer.data, 1, buffer.size);
+		position = buffer.data;
+	}
+};
+
+static Workload streamWorkload(const char *name, StreamKind kind)
+{
+	std::shared_ptr<WorkloadBuffer> state(new WorkloadBuffer());
+	return Workload{ name, [state, kind](long loops) {
+		state->init(false);
+		for (long i = 0; i < loops; ++i) {
+			stream(kind, state->position, WORKLOAD_BLOCK);
+			state->position += WORKLOAD_BLOCK;
+			if (state->position == state->buffer.data+state->buffer.size)
+				state->position = state->buffer.data;
+		}
+	} };
+}
+
+std::vector<Workload> memoryWorkloads()
+{
+	std::vector<Workload> workloads;
+	std::shared_ptr<WorkloadBuffer> chain(new WorkloadBuffer());
+	workloads.push_back(Workload{ "memory.chase", [chain](long loops) {
+		chain->init(true);
+		chain->position = chase(chain->position, loops*WORKLOAD_CHASE);
+		memory_sink = chain->position;
+	} });
+	workloads.push_back(streamWorkload("memory.read", STREAM_READ));
+	workloads.push_back(streamWorkload("memory.write", STREAM_WRITE));
+	return workloads;
+}
+
+static std::string formatSize(size_t size)
+{
+	char buf[32];
+	if (size >= (size_t)1 << 30 && size%((size_t)1 << 30) == 0)
+		snprintf(buf, sizeof(buf), "%zuG", size >> 30);
+	else if (size >= (size_t)1 << 20 && size%((size_t)1 << 20) == 0)
+		snprintf(buf, sizeof(buf), "%zuM", size >> 20);
+	else
+		snprintf(buf, sizeof(buf), "%zuK", size >> 10);
+	return buf;
+}
+
+static size_t parseSize(const char *value)
+{
+	char *end;
+	double size = strtod(value, &end);
+	switch (*end) {
+	case 'G': case 'g':
+		size *= 1024;
+		// fall through
+	case 'M': case 'm':
+		size *= 1024;
+		// fall through
+	case 'K': case 'k':
+		size *= 1024;
+	}
+	return (size_t)size;
+}
+
+// Boundary is transition of consecutive steps growing latency by 30% or more each, which together grow it at least by
+// 60%.  Caches shared with other cores or partitioned into slices make the transitions gradual rather than sharp.
+static void reportBoundaries(const char *pages, const std::vector<size_t> &sizes, const std::vector<double> &latencies)
+{
+	printf("# boundaries (%s pages):", pages);
+	int level = 1;
+	size_t plateau = 0;
+	for (size_t i = 1; i < sizes.size(); ) {
+		size_t end = i;
+		while (end < sizes.size() && latencies[end] >= latencies[end-1]*1.3)
+			++end;
+		if (end > i && latencies[end-1] >= latencies[i-1]*1.6) {
+			printf(" L%d <= %s (%.1f ns),", level, formatSize(sizes[i-1]).c_str(), latencies[i-1]);
+			++level;
+			plateau = end-1;
+		}
+		i = end+1;
+	}
+	// no cache level is as slow as 50 ns
+	std::string last = level > 3 || latencies.back() > 50 ? std::string("DRAM") : "L"+std::to_string(level);
+	printf(" %s from %s (%.1f ns)\n", last.c_str(), formatSize(sizes[plateau]).c_str(), latencies.back());
+}
+
+// Cache sizes reported by kernel, for comparison with detected boundaries
+static void reportSysfsCaches()
+{
+	printf("# sysfs caches:");
+	for (int index = 0; ; ++index) {
+		std::string base = "/sys/devices/system/cpu/cpu0/cache/index"+std::to_string(index)+"/";
+		std::ifstream levelFd(base+"level"), typeFd(base+"type"), sizeFd(base+"size");
+		std::string level, type, size;
+		if (!getline(levelFd, level) || !getline(typeFd, type) || !getline(sizeFd, size))
+			break;
+		if (type != "Instruction")
+			printf(" L%s%s %s", level.c_str(), type == "Data" ? "d" : "", size.c_str());
+	}
+	printf("\n");
+}
+
+// Frequency measured during the run, nominal clock if not available
+static double runClock(const FrequencyRun &frequency)
+{
+	return frequency.frequency != 0 ? frequency.frequency : getCpuClock();
+}
+
+// Per tick value, prefixed by ! if the frequency changed part-way through the run
+static std::string formatTicks(double value, const FrequencyRun &frequency)
+{
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%s%.2f", frequency.changed ? "!" : "", value);
+	return buf;
+}
+
+int runMemory(int argc, char **argv)
+{
+	size_t minSize = 4*1024;
+	size_t maxSize = 256*1024*1024;
+	int threads = std::max(1, (int)std::thread::hardware_concurrency());
+	for (int i = 0; i < argc; ++i) {
+		if (strncmp(argv[i], "--min-size=", 11) == 0) {
+			minSize = std::max(LINE_SIZE*2, parseSize(argv[i]+11));
+		}
+		else if (strncmp(argv[i], "--max-size=", 11) == 0) {
+			maxSize = parseSize(argv[i]+11);
+		}
+		else if (strncmp(argv[i], "--threads=", 10) == 0) {
+			threads = std::max(1, atoi(argv[i]+10));
+		}
+		else {
+			fprintf(stderr, "Usage: memory [--min-size=size] [--max-size=size] [--threads=n]\n");
+			return 2;
+		}
+	}
+	std::vector<size_t> sizes;
+	for (size_t size = minSize; size <= maxSize; size *= 2)
+		sizes.push_back(size);
+
+	reportSysfsCaches();
+	if (startFrequencyTracer(NULL))
+		printf("# ticks of effective frequency measured during each run, ! marks frequency changed during the run\n");
+	else
+		printf("# ticks of nominal clock %.0f MHz (no cycle counter)\n", getCpuClock()/1e6);
+	for (int huge = 0; huge < 2; ++huge) {
+		std::vector<double> latencies;
+		const char *pages = NULL;
+		printf("%-8s %6s %10s %10s\n", "size", "pages", "ns", "ticks");
+		for (size_t size: sizes) {
+			MemoryBuffer buffer = allocateBuffer(size, huge != 0);
+			buildChase(buffer);
+			FrequencyRun frequency;
+			double latency = measureLatency(buffer, "memory.latency."+formatSize(size)+"."+buffer.pages, &frequency);
+			pages = buffer.pages;
+			freeBuffer(buffer);
+			latencies.push_back(latency);
+			printf("%-8s %6s %10.2f %10s\n", formatSize(size).c_str(), pages, latency, formatTicks(latency*runClock(frequency)/1e9, frequency).c_str());
+			fflush(stdout);
+		}
+		reportBoundaries(pages, sizes, latencies);
+	}
+
+	int threadCounts[2] = { 1, threads };
+	for (int t = 0; t < (threads > 1 ? 2 : 1); ++t) {
+		printf("# bandwidth, threads=%d, GB/s and bytes per tick per thread\n", threadCounts[t]);
+		printf("%-8s", "size");
+		for (int kind = 0; kind < STREAM_COUNT; ++kind)
+			printf(" %10s %8s", streamNames[kind], "B/tick");
+		printf("\n");
+		for (size_t size: sizes) {
+			printf("%-8s", formatSize(size).c_str());
+			for (int kind = 0; kind < STREAM_COUNT; ++kind) {
+				FrequencyRun frequency;
+				double bandwidth = measureBandwidth((StreamKind)kind, size, threadCounts[t], std::string("memory.")+streamNames[kind]+"."+formatSize(size)+"x"+std::to_string(threadCounts[t]), &frequency);
+				printf(" %10.2f %8s", bandwidth/1e9, formatTicks(bandwidth/runClock(frequency)/threadCounts[t], frequency).c_str());
+			}
+			printf("\n");
+			fflush(stdout);
+		}
+	}
+	return 0;
+}
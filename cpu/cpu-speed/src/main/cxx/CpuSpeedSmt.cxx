@@ -0,0 +1,200 @@
+/*
+ * SMT sibling interference: pairs of workloads running simultaneously on two hyperthreads of single physical core.
+ *
+ * Each workload runs solo on its CPU first, then both run together, each pinned to its sibling.  Slowdown is the solo
+ * rate divided by the paired rate, combined throughput sums both paired rates relative to their solo rates, so 2.0
+ * means the siblings do not share anything the workloads need and 1.0 means the core gives nothing extra by running
+ * the second thread.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CpuSpeed.hxx"
+
+
+static const char *const defaultPairs[] = {
+	"depend64:depend64",
+	"incAln64:incAln64",
+	"depend64:incAln64",
+	"incAln64:memory.chase",
+	"incAln64:memory.read",
+	"memory.chase:memory.chase",
+	"memory.read:memory.read",
+};
+
+// Fresh instances of all workloads, so every thread gets its own memory
+static std::vector<Workload> allWorkloads()
+{
+	std::vector<Workload> workloads = {
+		{ "depend64", &runDepend64 },
+		{ "incAln32", &runIncAln32 },
+		{ "incAln64", &runIncAln64 },
+		{ "incMov32", &runIncMov32 },
+		{ "incMov64", &runIncMov64 },
+	};
+	for (const Workload &workload: instructionWorkloads())
+		workloads.push_back(workload);
+	for (const Workload &workload: memoryWorkloads())
+		workloads.push_back(workload);
+	return workloads;
+}
+
+static bool findWorkload(const std::string &name, Workload *result)
+{
+	for (const Workload &workload: allWorkloads()) {
+		if (workload.name == name) {
+			*result = workload;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Number of loops taking at least a millisecond, so the stop check and clock reads do not count
+static long calibrateChunk(Workload &workload, int cpu)
+{
+	long chunk = 1;
+	std::thread calibration([&]() {
+		pinCurrentThread(cpu);
+		// first run allocates memory and gets the core out of idle state
+		workload.run(1);
+		for (;;) {
+			auto start = std::chrono::steady_clock::now();
+			workload.run(chunk);
+			std::chrono::duration<double> duration(std::chrono::steady_clock::now()-start);
+			if (duration.count() >= 0.001)
+				break;
+			chunk *= 2;
+		}
+	});
+	calibration.join();
+	return chunk;
+}
+
+// Runs workloads simultaneously, each on its CPU in chunks until duration elapses, returns loops per second of each
+static std::vector<double> runTogether(std::vector<Workload *> workloads, const std::vector<int> &cpus, const std::vector<long> &chunks, double duration)
+{
+	std::atomic<int> ready(0);
+	std::atomic<bool> go(false), stop(false);
+	std::vector<double> rates(workloads.size());
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < workloads.size(); ++t) {
+		threads.emplace_back([&, t]() {
+			pinCurrentThread(cpus[t]);
+			ready.fetch_add(1);
+			while (!go.load())
+				std::this_thread::yield();
+			auto start = std::chrono::steady_clock::now();
+			long loops = 0;
+			// measured until the end of own last chunk, so the thread finishing later does not run solo at the end
+			do {
+				workloads[t]->run(chunks[t]);
+				loops += chunks[t];
+			} while (!stop.load(std::memory_order_relaxed));
+			std::chrono::duration<double> elapsed(std::chrono::steady_clock::now()-start);
+			rates[t] = loops/elapsed.count();
+		});
+	}
+	while (ready.load() != (int)workloads.size())
+		std::this_thread::yield();
+	go.store(true);
+	std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+	stop.store(true);
+	for (std::thread &thread: threads)
+		thread.join();
+	return rates;
+}
+
+static const char *verdict(double combined)
+{
+	if (combined >= 1.5)
+		return "share";
+	if (combined >= 1.15)
+		return "partial";
+	return "dedicate";
+}
+
+int runSmt(int argc, char **argv)
+{
+	double duration = 0.5;
+	std::vector<int> cpus;
+	std::vector<std::string> pairs;
+	for (int i = 0; i < argc; ++i) {
+		if (strncmp(argv[i], "--duration=", 11) == 0) {
+			duration = atof(argv[i]+11);
+		}
+		else if (strncmp(argv[i], "--cpus=", 7) == 0) {
+			cpus = parseCpuList(argv[i]+7);
+		}
+		else if (strcmp(argv[i], "--list") == 0) {
+			for (const Workload &workload: allWorkloads())
+				printf("%s\n", workload.name.c_str());
+			return 0;
+		}
+		else if (argv[i][0] != '-' && strchr(argv[i], ':') != NULL) {
+			pairs.push_back(argv[i]);
+		}
+		else {
+			fprintf(stderr, "Usage: smt [--duration=seconds] [--cpus=a,b] [--list] [workload:workload...]\n");
+			return 2;
+		}
+	}
+	if (pairs.empty())
+		pairs.assign(defaultPairs, defaultPairs+sizeof(defaultPairs)/sizeof(defaultPairs[0]));
+
+	if (cpus.empty()) {
+		for (const CpuInfo &info: readCpuTopology()) {
+			if (info.siblings.size() >= 2) {
+				cpus.assign(info.siblings.begin(), info.siblings.begin()+2);
+				break;
+			}
+		}
+		if (cpus.empty()) {
+			fprintf(stderr, "No SMT siblings found (SMT disabled or not supported), use --cpus=a,b to pick CPUs explicitly\n");
+			return 1;
+		}
+	}
+	if (cpus.size() != 2) {
+		fprintf(stderr, "Exactly two CPUs expected: %s\n", formatCpuList(cpus).c_str());
+		return 2;
+	}
+
+	printf("# cpus %d and %d, rates in loops/s, slowdown is solo/paired, combined is sum of paired/solo\n", cpus[0], cpus[1]);
+	printf("%-24s %-24s %10s %10s %10s %10s %10s %10s %9s %s\n", "workload-a", "workload-b", "solo-a", "paired-a", "solo-b", "paired-b", "slowdown-a", "slowdown-b", "combined", "verdict");
+	for (const std::string &pair: pairs) {
+		size_t colon = pair.find(':');
+		std::string names[2] = { pair.substr(0, colon), pair.substr(colon+1) };
+		Workload workloads[2];
+		bool found = true;
+		for (int t = 0; t < 2; ++t) {
+			if (!findWorkload(names[t], &workloads[t])) {
+				fprintf(stderr, "Unknown workload %s, see --list\n", names[t].c_str());
+				found = false;
+			}
+		}
+		if (!found)
+			return 2;
+
+		std::vector<long> chunks(2);
+		double solo[2];
+		for (int t = 0; t < 2; ++t) {
+			chunks[t] = calibrateChunk(workloads[t], cpus[t]);
+			solo[t] = runTogether({ &workloads[t] }, { cpus[t] }, { chunks[t] }, duration)[0];
+		}
+		std::vector<double> paired = runTogether({ &workloads[0], &workloads[1] }, cpus, chunks, duration);
+		double combined = paired[0]/solo[0]+paired[1]/solo[1];
+		printf("%-24s %-24s %10.4g %10.4g %10.4g %10.4g %10.3f %10.3f %9.3f %s\n", names[0].c_str(), names[1].c_str(), solo[0], paired[0], solo[1], paired[1], solo[0]/paired[0], solo[1]/paired[1], combined, verdict(combined));
+		fflush(stdout);
+	}
+	return 0;
+}
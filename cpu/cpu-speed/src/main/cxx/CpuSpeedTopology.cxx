@@ -0,0 +1,230 @@
+/*
+ * CPU topology from sysfs, thread pinning and per-core runs.
+ *
+ * Per-core mode pins the basic probes to each logical CPU in turn and reports its own frequency, then groups the CPUs
+ * into performance classes (hybrid P/E cores, uneven turbo bins) and flags the outliers within the classes.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sched.h>
+#include <pthread.h>
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CpuSpeed.hxx"
+
+
+static bool readSysfsLine(const std::string &path, std::string *value)
+{
+	std::ifstream fd(path);
+	return (bool)getline(fd, *value);
+}
+
+static int readSysfsInt(const std::string &path, int defaultValue)
+{
+	std::string value;
+	return readSysfsLine(path, &value) ? atoi(value.c_str()) : defaultValue;
+}
+
+std::vector<int> parseCpuList(const std::string &list)
+{
+	std::vector<int> cpus;
+	for (size_t pos = 0; pos < list.size(); ) {
+		size_t end = list.find(',', pos);
+		if (end == std::string::npos)
+			end = list.size();
+		std::string range = list.substr(pos, end-pos);
+		size_t dash = range.find('-');
+		if (!range.empty()) {
+			int first = atoi(range.c_str());
+			int last = dash == std::string::npos ? first : atoi(range.c_str()+dash+1);
+			for (int cpu = first; cpu <= last; ++cpu)
+				cpus.push_back(cpu);
+		}
+		pos = end+1;
+	}
+	return cpus;
+}
+
+std::string formatCpuList(std::vector<int> cpus)
+{
+	std::sort(cpus.begin(), cpus.end());
+	std::string result;
+	for (size_t i = 0; i < cpus.size(); ) {
+		size_t end = i+1;
+		while (end < cpus.size() && cpus[end] == cpus[end-1]+1)
+			++end;
+		if (!result.empty())
+			result += ",";
+		result += std::to_string(cpus[i]);
+		if (end-i > 1)
+			result += "-"+std::to_string(cpus[end-1]);
+		i = end;
+	}
+	return result;
+}
+
+std::vector<CpuInfo> readCpuTopology()
+{
+	std::vector<CpuInfo> result;
+	std::string online;
+	std::vector<int> cpus;
+	if (readSysfsLine("/sys/devices/system/cpu/online", &online)) {
+		cpus = parseCpuList(online);
+	}
+	else {
+		for (int cpu = 0; cpu < (int)std::thread::hardware_concurrency(); ++cpu)
+			cpus.push_back(cpu);
+	}
+
+	// Intel hybrid CPUs register separate PMU per core type
+	static const char *const hybridTypes[] = { "cpu_core", "cpu_atom" };
+	std::vector<std::pair<std::string, std::vector<int> > > types;
+	for (const char *type: hybridTypes) {
+		std::string list;
+		if (readSysfsLine(std::string("/sys/devices/")+type+"/cpus", &list))
+			types.push_back(std::make_pair(std::string(type), parseCpuList(list)));
+	}
+
+	for (int cpu: cpus) {
+		std::string base = "/sys/devices/system/cpu/cpu"+std::to_string(cpu)+"/";
+		CpuInfo info;
+		info.cpu = cpu;
+		info.package = readSysfsInt(base+"topology/physical_package_id", 0);
+		info.core = readSysfsInt(base+"topology/core_id", cpu);
+		info.cluster = readSysfsInt(base+"topology/cluster_id", -1);
+		std::string siblings;
+		if (readSysfsLine(base+"topology/thread_siblings_list", &siblings))
+			info.siblings = parseCpuList(siblings);
+		else
+			info.siblings.push_back(cpu);
+		info.capacity = readSysfsInt(base+"cpu_capacity", 0);
+		info.maxFrequency = readSysfsInt(base+"cpufreq/cpuinfo_max_freq", 0)*1000.0;
+		for (const auto &type: types) {
+			if (std::find(type.second.begin(), type.second.end(), cpu) != type.second.end())
+				info.type = type.first;
+		}
+		result.push_back(info);
+	}
+	return result;
+}
+
+std::vector<CpuInfo> filterAllowedCpus(const std::vector<CpuInfo> &topology)
+{
+#ifdef __linux__
+	cpu_set_t allowed;
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+		return topology;
+	std::vector<CpuInfo> result;
+	for (const CpuInfo &info: topology) {
+		if (info.cpu < CPU_SETSIZE && CPU_ISSET(info.cpu, &allowed))
+			result.push_back(info);
+	}
+	return result;
+#else
+	return topology;
+#endif
+}
+
+bool pinCurrentThread(int cpu)
+{
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	(void)cpu;
+	return false;
+#endif
+}
+
+double readCpuFrequency(int cpu)
+{
+	return readSysfsInt("/sys/devices/system/cpu/cpu"+std::to_string(cpu)+"/cpufreq/scaling_cur_freq", 0)*1000.0;
+}
+
+struct CoreResult {
+	CpuInfo info;
+	double depend;
+	double incAln;
+	double frequency;
+	double score;
+};
+
+int runTopology(int argc, char **argv)
+{
+	MeasureOptions options;
+	for (int i = 0; i < argc; ++i) {
+		if (!parseMeasureOption(argv[i], &options)) {
+			fprintf(stderr, "Usage: topology [--budget=seconds] [--precision=percent] [--frequency-trace=file]\n");
+			return 2;
+		}
+	}
+
+#ifdef __linux__
+	cpu_set_t original;
+	pthread_getaffinity_np(pthread_self(), sizeof(original), &original);
+#endif
+	std::vector<CoreResult> results;
+	printf("%-4s %-7s %-5s %-7s %-9s %-9s %8s %8s %12s %12s %9s\n", "cpu", "package", "core", "cluster", "type", "siblings", "max-MHz", "cur-MHz", "depend-Mops", "incAln-Mops", "per-tick");
+	for (const CpuInfo &info: readCpuTopology()) {
+		if (!pinCurrentThread(info.cpu)) {
+			fprintf(stderr, "Failed to pin to cpu %d, skipping\n", info.cpu);
+			continue;
+		}
+		CoreResult result;
+		result.info = info;
+		// calibration of the first probe gets the core out of idle state
+		std::string label = "@"+std::to_string(info.cpu);
+		result.depend = measureRate("depend64"+label, &runDepend64, options).rate*102;
+		Measurement incAln = measureRate("incAln64"+label, &runIncAln64, options);
+		result.incAln = incAln.rate*102;
+		// measured effective frequency, cpufreq report otherwise
+		result.frequency = incAln.frequency.frequency != 0 ? incAln.frequency.frequency : readCpuFrequency(info.cpu);
+		result.score = sqrt(result.depend*result.incAln);
+		results.push_back(result);
+		double clock = incAln.frequency.frequency != 0 ? incAln.frequency.frequency : info.maxFrequency != 0 ? info.maxFrequency : getCpuClock();
+		printf("%-4d %-7d %-5d %-7d %-9s %-9s %8.0f %8.0f %12.1f %12.1f %9.3f%s\n", info.cpu, info.package, info.core, info.cluster, info.type.empty() ? "-" : info.type.c_str(), formatCpuList(info.siblings).c_str(), info.maxFrequency/1e6, result.frequency/1e6, result.depend/1e6, result.incAln/1e6, result.incAln/clock, incAln.frequency.changed ? " frequency-changed" : "");
+		fflush(stdout);
+	}
+#ifdef __linux__
+	pthread_setaffinity_np(pthread_self(), sizeof(original), &original);
+#endif
+	if (results.empty())
+		return 1;
+
+	// Classes: descending by score, new class starts when score drops under 92% of the class leader
+	std::sort(results.begin(), results.end(), [](const CoreResult &l, const CoreResult &r) { return l.score > r.score; });
+	int classIndex = 0;
+	for (size_t begin = 0; begin < results.size(); ++classIndex) {
+		size_t end = begin+1;
+		while (end < results.size() && results[end].score >= results[begin].score*0.92)
+			++end;
+		std::vector<int> cpus;
+		for (size_t i = begin; i < end; ++i)
+			cpus.push_back(results[i].info.cpu);
+		double median = results[begin+(end-begin)/2].score;
+		printf("# class %d: cpus %s, score %.1f, relative to fastest %.3f\n", classIndex, formatCpuList(cpus).c_str(), median/1e6, median/results[0].score);
+		for (size_t i = begin; i < end; ++i) {
+			double deviation = results[i].score/median-1;
+			if (fabs(deviation) > 0.03)
+				printf("# outlier: cpu %d is %.1f%% %s than class %d median\n", results[i].info.cpu, fabs(deviation)*100, deviation < 0 ? "slower" : "faster", classIndex);
+		}
+		begin = end;
+	}
+	return 0;
+}
@@ -0,0 +1,410 @@
+/*
+ * BigInt value type, allocators and arithmetic.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Mp.hxx"
+#include "BigInt.hxx"
+
+
+class BigIntHeapAllocator: public BigIntAllocator
+{
+public:
+	virtual uint64_t *allocate(size_t limbs) override
+	{
+		allocations.fetch_add(1, std::memory_order_relaxed);
+		return new uint64_t[limbs];
+	}
+
+	virtual void deallocate(uint64_t *memory, size_t) override
+	{
+		deallocations.fetch_add(1, std::memory_order_relaxed);
+		delete[] memory;
+	}
+
+	std::atomic<size_t> allocations;
+	std::atomic<size_t> deallocations;
+};
+
+static BigIntHeapAllocator heapAllocator;
+
+thread_local BigIntAllocator *BigIntAllocator::currentAllocator = &heapAllocator;
+
+BigIntAllocator *BigIntAllocator::heap()
+{
+	return &heapAllocator;
+}
+
+BigIntAllocator *BigIntAllocator::current()
+{
+	return currentAllocator;
+}
+
+size_t BigIntAllocator::heapAllocations()
+{
+	return heapAllocator.allocations.load(std::memory_order_relaxed);
+}
+
+size_t BigIntAllocator::heapDeallocations()
+{
+	return heapAllocator.deallocations.load(std::memory_order_relaxed);
+}
+
+BigIntArena::BigIntArena(size_t chunkLimbs):
+	chunkLimbs(chunkLimbs),
+	chunks(1, new uint64_t[chunkLimbs]),
+	pos(chunks[0]),
+	end(chunks[0]+chunkLimbs),
+	chunkCount(1)
+{
+}
+
+BigIntArena::~BigIntArena()
+{
+	for (uint64_t *chunk: chunks)
+		delete[] chunk;
+}
+
+uint64_t *BigIntArena::allocate(size_t limbs)
+{
+	if (limbs > (size_t)(end-pos)) {
+		// the rest of the current chunk is abandoned until reset
+		size_t size = std::max(chunkLimbs, limbs);
+		chunks.push_back(new uint64_t[size]);
+		++chunkCount;
+		pos = chunks.back();
+		end = pos+size;
+	}
+	uint64_t *allocated = pos;
+	pos += limbs;
+	return allocated;
+}
+
+void BigIntArena::deallocate(uint64_t *memory, size_t limbs)
+{
+	if (memory+limbs == pos)
+		pos = memory;
+}
+
+void BigIntArena::reset()
+{
+	for (size_t i = 1; i < chunks.size(); ++i)
+		delete[] chunks[i];
+	chunks.resize(1);
+	pos = chunks[0];
+	end = pos+chunkLimbs;
+}
+
+BigInt::BigInt(const uint64_t *limbs, size_t size, bool negative):
+	data(inlineLimbs),
+	length(0),
+	capacity(INLINE_LIMBS),
+	negative(negative),
+	allocator(BigIntAllocator::current())
+{
+	resize(size);
+	memcpy(data, limbs, size*sizeof(uint64_t));
+	normalize();
+}
+
+BigInt::BigInt(const BigInt &other):
+	data(inlineLimbs),
+	length(0),
+	capacity(INLINE_LIMBS),
+	negative(other.negative),
+	allocator(BigIntAllocator::current())
+{
+	resize(other.length);
+	memcpy(data, other.data, length*sizeof(uint64_t));
+}
+
+BigInt::BigInt(BigInt &&other) noexcept:
+	data(inlineLimbs),
+	length(other.length),
+	capacity(INLINE_LIMBS),
+	negative(other.negative),
+	allocator(other.allocator)
+{
+	if (other.data == other.inlineLimbs) {
+		memcpy(inlineLimbs, other.inlineLimbs, length*sizeof(uint64_t));
+	}
+	else {
+		data = other.data;
+		capacity = other.capacity;
+		other.data = other.inlineLimbs;
+		other.capacity = INLINE_LIMBS;
+	}
+	other.length = 0;
+	other.negative = false;
+}
+
+BigInt &BigInt::operator=(const BigInt &other)
+{
+	if (this != &other) {
+		resize(other.length);
+		memcpy(data, other.data, length*sizeof(uint64_t));
+		negative = other.negative;
+	}
+	return *this;
+}
+
+// Buffers are exchanged only within the same allocator, the other one keeps the old buffer of this as capacity
+BigInt &BigInt::operator=(BigInt &&other)
+{
+	if (this == &other)
+		return *this;
+	if (other.data == other.inlineLimbs || allocator != other.allocator)
+		return *this = (const BigInt &)other;
+	if (data == inlineLimbs) {
+		data = other.data;
+		capacity = other.capacity;
+		other.data = other.inlineLimbs;
+		other.capacity = INLINE_LIMBS;
+	}
+	else {
+		std::swap(data, other.data);
+		std::swap(capacity, other.capacity);
+	}
+	length = other.length;
+	negative = other.negative;
+	other.length = 0;
+	other.negative = false;
+	return *this;
+}
+
+uint64_t *BigInt::prepare(size_t limbs, bool fresh)
+{
+	if (limbs <= capacity && !fresh)
+		return data;
+	if (limbs <= INLINE_LIMBS && data != inlineLimbs)
+		return inlineLimbs;
+	return allocator->allocate(std::max(limbs, capacity*3/2));
+}
+
+void BigInt::commit(uint64_t *prepared, size_t limbs, size_t length)
+{
+	if (prepared != data) {
+		if (data != inlineLimbs)
+			allocator->deallocate(data, capacity);
+		capacity = prepared == inlineLimbs ? INLINE_LIMBS : std::max(limbs, capacity*3/2);
+		data = prepared;
+	}
+	this->length = length;
+}
+
+void BigInt::resize(size_t limbs)
+{
+	if (limbs > capacity) {
+		uint64_t *grown = allocator->allocate(std::max(limbs, capacity*3/2));
+		if (data != inlineLimbs)
+			allocator->deallocate(data, capacity);
+		capacity = std::max(limbs, capacity*3/2);
+		data = grown;
+	}
+	length = limbs;
+}
+
+void BigInt::reserve(size_t limbs)
+{
+	if (limbs > capacity) {
+		uint64_t *grown = allocator->allocate(limbs);
+		memcpy(grown, data, length*sizeof(uint64_t));
+		if (data != inlineLimbs)
+			allocator->deallocate(data, capacity);
+		capacity = limbs;
+		data = grown;
+	}
+}
+
+void BigInt::normalize()
+{
+	while (length > 0 && data[length-1] == 0)
+		--length;
+	if (length == 0)
+		negative = false;
+}
+
+std::string BigInt::toHex() const
+{
+	static const char DIGITS[] = "0123456789abcdef";
+	std::string out = negative ? "-0x" : "0x";
+	if (length == 0)
+		return out+"0";
+	bool leading = true;
+	for (size_t i = length; i-- > 0; ) {
+		for (int shift = 60; shift >= 0; shift -= 4) {
+			unsigned digit = (data[i]>>shift)&15;
+			if (leading && digit == 0)
+				continue;
+			leading = false;
+			out += DIGITS[digit];
+		}
+	}
+	return out;
+}
+
+std::string BigInt::toDecimal() const
+{
+	std::string out(negative+decimalDigitsMp(length), '-');
+	out.resize(negative+toDecimalMp(&out[negative], data, length));
+	return out;
+}
+
+BigInt BigInt::fromDecimal(const std::string &text)
+{
+	bool negative = !text.empty() && text[0] == '-';
+	if (text.size() == (size_t)negative)
+		throw std::invalid_argument("Empty decimal number");
+	BigInt result;
+	result.resize(decimalLimbsMp(text.size()-negative));
+	result.length = fromDecimalMp(result.data, text.data()+negative, text.size()-negative);
+	result.negative = negative && result.length != 0;
+	return result;
+}
+
+static int compareMagnitude(const uint64_t *a, size_t an, const uint64_t *b, size_t bn)
+{
+	if (an != bn)
+		return an < bn ? -1 : 1;
+	for (size_t i = an; i-- > 0; ) {
+		if (a[i] != b[i])
+			return a[i] < b[i] ? -1 : 1;
+	}
+	return 0;
+}
+
+int compare(const BigInt &a, const BigInt &b)
+{
+	if (a.negative != b.negative)
+		return a.negative ? -1 : 1;
+	int magnitude = compareMagnitude(a.data, a.length, b.data, b.length);
+	return a.negative ? -magnitude : magnitude;
+}
+
+bool operator==(const BigInt &a, const BigInt &b)
+{
+	return a.negative == b.negative && a.length == b.length && memcmp(a.data, b.data, a.length*sizeof(uint64_t)) == 0;
+}
+
+// Magnitudes are added when the signs (b negated for SUB) agree, otherwise the smaller is subtracted from the larger,
+// taking its sign.  The kernels run over the shorter operand, the carry (borrow) then over the rest of the longer.
+// result may be a or b: each limb is read before the same limb is written.
+template <bool SUB>
+void BigInt::addSub(BigInt *result, const BigInt &a, const BigInt &b)
+{
+	bool bNegative = b.negative != SUB;
+	if (a.negative == bNegative) {
+		const BigInt &longer = a.length >= b.length ? a : b, &shorter = a.length >= b.length ? b : a;
+		size_t size = longer.length;
+		uint64_t *out = result->prepare(size+1);
+		uint64_t carry = shorter.length == 0 ? 0 : addMp(out, longer.data, shorter.data, shorter.length);
+		for (size_t i = shorter.length; i < size; ++i) {
+			uint64_t limb = longer.data[i]+carry;
+			carry = limb < carry;
+			out[i] = limb;
+		}
+		out[size] = carry;
+		result->commit(out, size+1, size+carry);
+		result->negative = a.negative;
+	}
+	else {
+		int order = compareMagnitude(a.data, a.length, b.data, b.length);
+		const BigInt &larger = order >= 0 ? a : b, &smaller = order >= 0 ? b : a;
+		size_t size = larger.length;
+		uint64_t *out = result->prepare(size);
+		uint64_t borrow = smaller.length == 0 ? 0 : subMp(out, larger.data, smaller.data, smaller.length);
+		for (size_t i = smaller.length; i < size; ++i) {
+			uint64_t limb = larger.data[i];
+			out[i] = limb-borrow;
+			borrow = limb < borrow;
+		}
+		result->commit(out, size, size);
+		result->negative = order >= 0 ? a.negative : bNegative;
+		result->normalize();
+	}
+}
+
+void addBigInt(BigInt *result, const BigInt &a, const BigInt &b)
+{
+	BigInt::addSub<false>(result, a, b);
+}
+
+void subBigInt(BigInt *result, const BigInt &a, const BigInt &b)
+{
+	BigInt::addSub<true>(result, a, b);
+}
+
+// Product into fresh buffer when result is one of the operands, as mulMp cannot write over them, on stack when it
+// is short.  One limb more is reserved for carry of addition which usually follows.  Scratch for Karatsuba and above
+// is kept per thread.
+void mulBigInt(BigInt *result, const BigInt &a, const BigInt &b)
+{
+	static thread_local std::vector<uint64_t> scratch;
+	uint64_t local[2*BigInt::INLINE_LIMBS];
+
+	if (a.length == 0 || b.length == 0) {
+		result->length = 0;
+		result->negative = false;
+		return;
+	}
+	size_t size = a.length+b.length;
+	bool square = &a == &b;
+	size_t needed = square ? sqrMpScratch(a.length) : mulMpScratch(a.length, b.length);
+	if (scratch.size() < needed)
+		scratch.resize(needed);
+	MpArena arena(scratch.data(), scratch.size());
+	bool aliased = result == &a || result == &b;
+	uint64_t *out = aliased && size <= 2*BigInt::INLINE_LIMBS ? local : result->prepare(size+1, aliased);
+	if (square)
+		sqrMp(out, a.data, a.length, &arena);
+	else
+		mulMp(out, a.data, a.length, b.data, b.length, &arena);
+	bool negative = a.negative != b.negative;
+	if (out == local) {
+		out = result->prepare(size+1);
+		memcpy(out, local, size*sizeof(uint64_t));
+	}
+	result->commit(out, size+1, size-(out[size-1] == 0));
+	result->negative = negative;
+}
+
+BigInt &BigInt::operator+=(const BigInt &other)
+{
+	addBigInt(this, *this, other);
+	return *this;
+}
+
+BigInt &BigInt::operator-=(const BigInt &other)
+{
+	subBigInt(this, *this, other);
+	return *this;
+}
+
+BigInt &BigInt::operator*=(const BigInt &other)
+{
+	mulBigInt(this, *this, other);
+	return *this;
+}
+
+BigInt BigInt::operator-() const &
+{
+	BigInt result(*this);
+	result.negative = !negative && length != 0;
+	return result;
+}
+
+BigInt BigInt::operator-() &&
+{
+	negative = !negative && length != 0;
+	return std::move(*this);
+}
@@ -0,0 +1,291 @@
+/*
+ * Signed multiprecision value type over the 64-bit limb kernels.
+ *
+ * Numbers up to INLINE_LIMBS limbs are stored inline, without allocation.  Larger ones get memory from allocator,
+ * which is a property of the variable: moves steal the buffer between variables of the same allocator and copy into the
+ * destination capacity otherwise.  New values, including the results of operators, take the current allocator of the
+ * thread, heap by default, arena within BigIntAllocatorScope, so the temporaries of an expression do not touch heap.
+ * addBigInt, subBigInt and mulBigInt write into the destination capacity, growing it only when short, the operators
+ * reuse the capacity of rvalue operands.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+
+#ifndef BigInt_hxx__
+# define BigInt_hxx__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+class BigIntAllocator
+{
+public:
+	virtual ~BigIntAllocator()
+	{
+	}
+
+	virtual uint64_t *allocate(size_t limbs) = 0;
+
+	virtual void deallocate(uint64_t *memory, size_t limbs) = 0;
+
+	// Heap allocator counting the calls
+	static BigIntAllocator *heap();
+
+	// Allocator for new values in this thread
+	static BigIntAllocator *current();
+
+	static size_t heapAllocations();
+
+	static size_t heapDeallocations();
+
+protected:
+	static thread_local BigIntAllocator *currentAllocator;
+
+	friend class BigIntAllocatorScope;
+};
+
+// Bump allocator over chunks, memory released only by reset or on destruction, except the last allocation which is
+// reused in place.  Must outlive all values using it.
+class BigIntArena: public BigIntAllocator
+{
+public:
+	explicit BigIntArena(size_t chunkLimbs = 1<<14);
+
+	virtual ~BigIntArena();
+
+	BigIntArena(const BigIntArena &) = delete;
+
+	BigIntArena &operator=(const BigIntArena &) = delete;
+
+	virtual uint64_t *allocate(size_t limbs) override;
+
+	virtual void deallocate(uint64_t *memory, size_t limbs) override;
+
+	// Releases all the allocations, keeps the first chunk
+	void reset();
+
+	size_t chunkAllocations() const
+	{
+		return chunkCount;
+	}
+
+private:
+	size_t chunkLimbs;
+	std::vector<uint64_t *> chunks;
+	uint64_t *pos;
+	uint64_t *end;
+	size_t chunkCount;
+};
+
+// Sets the allocator for new values in this thread until the end of scope
+class BigIntAllocatorScope
+{
+public:
+	explicit BigIntAllocatorScope(BigIntAllocator *allocator):
+		previous(BigIntAllocator::currentAllocator)
+	{
+		BigIntAllocator::currentAllocator = allocator;
+	}
+
+	~BigIntAllocatorScope()
+	{
+		BigIntAllocator::currentAllocator = previous;
+	}
+
+	BigIntAllocatorScope(const BigIntAllocatorScope &) = delete;
+
+	BigIntAllocatorScope &operator=(const BigIntAllocatorScope &) = delete;
+
+private:
+	BigIntAllocator *previous;
+};
+
+class BigInt
+{
+public:
+	static const size_t INLINE_LIMBS = 4;
+
+	BigInt(int64_t value = 0):
+		data(inlineLimbs),
+		length(0),
+		capacity(INLINE_LIMBS),
+		negative(value < 0),
+		allocator(BigIntAllocator::current())
+	{
+		uint64_t magnitude = value < 0 ? -(uint64_t)value : (uint64_t)value;
+		inlineLimbs[0] = magnitude;
+		length = magnitude != 0;
+	}
+
+	// Magnitude from size limbs, least significant first
+	BigInt(const uint64_t *limbs, size_t size, bool negative = false);
+
+	BigInt(const BigInt &other);
+
+	BigInt(BigInt &&other) noexcept;
+
+	~BigInt()
+	{
+		if (data != inlineLimbs)
+			allocator->deallocate(data, capacity);
+	}
+
+	BigInt &operator=(const BigInt &other);
+
+	BigInt &operator=(BigInt &&other);
+
+	size_t size() const
+	{
+		return length;
+	}
+
+	const uint64_t *limbs() const
+	{
+		return data;
+	}
+
+	bool isNegative() const
+	{
+		return negative;
+	}
+
+	bool isZero() const
+	{
+		return length == 0;
+	}
+
+	bool isInline() const
+	{
+		return data == inlineLimbs;
+	}
+
+	// Makes room for limbs without changing the value
+	void reserve(size_t limbs);
+
+	// Hexadecimal, for diagnostics
+	std::string toHex() const;
+
+	// Decimal, minus sign if negative
+	std::string toDecimal() const;
+
+	// Optional minus sign and decimal digits, throws std::invalid_argument for anything else
+	static BigInt fromDecimal(const std::string &text);
+
+	BigInt &operator+=(const BigInt &other);
+
+	BigInt &operator-=(const BigInt &other);
+
+	BigInt &operator*=(const BigInt &other);
+
+	BigInt operator-() const &;
+
+	BigInt operator-() &&;
+
+	friend bool operator==(const BigInt &a, const BigInt &b);
+
+	// -1, 0, 1 for a below, equal, above b
+	friend int compare(const BigInt &a, const BigInt &b);
+
+	friend void addBigInt(BigInt *result, const BigInt &a, const BigInt &b);
+
+	friend void subBigInt(BigInt *result, const BigInt &a, const BigInt &b);
+
+	friend void mulBigInt(BigInt *result, const BigInt &a, const BigInt &b);
+
+private:
+	// Size limbs of zeros as the value, content lost
+	void resize(size_t limbs);
+
+	void normalize();
+
+	// Destination for limbs of new value computed from the current ones: data if it has room (or fresh buffer if
+	// fresh is set), adopted by commit with the same limbs and the length of the value
+	uint64_t *prepare(size_t limbs, bool fresh = false);
+
+	void commit(uint64_t *prepared, size_t limbs, size_t length);
+
+	// a+b (SUB false) or a-b (SUB true)
+	template <bool SUB>
+	static void addSub(BigInt *result, const BigInt &a, const BigInt &b);
+
+	uint64_t *data;
+	size_t length;
+	size_t capacity;
+	bool negative;
+	BigIntAllocator *allocator;
+	uint64_t inlineLimbs[INLINE_LIMBS];
+};
+
+inline bool operator!=(const BigInt &a, const BigInt &b)
+{
+	return !(a == b);
+}
+
+inline bool operator<(const BigInt &a, const BigInt &b)
+{
+	return compare(a, b) < 0;
+}
+
+inline BigInt operator+(const BigInt &a, const BigInt &b)
+{
+	BigInt result;
+	addBigInt(&result, a, b);
+	return result;
+}
+
+inline BigInt operator+(BigInt &&a, const BigInt &b)
+{
+	a += b;
+	return std::move(a);
+}
+
+inline BigInt operator+(const BigInt &a, BigInt &&b)
+{
+	b += a;
+	return std::move(b);
+}
+
+inline BigInt operator+(BigInt &&a, BigInt &&b)
+{
+	a += b;
+	return std::move(a);
+}
+
+inline BigInt operator-(const BigInt &a, const BigInt &b)
+{
+	BigInt result;
+	subBigInt(&result, a, b);
+	return result;
+}
+
+inline BigInt operator-(BigInt &&a, const BigInt &b)
+{
+	a -= b;
+	return std::move(a);
+}
+
+inline BigInt operator-(const BigInt &a, BigInt &&b)
+{
+	subBigInt(&b, a, b);
+	return std::move(b);
+}
+
+inline BigInt operator-(BigInt &&a, BigInt &&b)
+{
+	a -= b;
+	return std::move(a);
+}
+
+// The product cannot overlap the operands, so rvalue operands give nothing to reuse
+inline BigInt operator*(const BigInt &a, const BigInt &b)
+{
+	BigInt result;
+	mulBigInt(&result, a, b);
+	return result;
+}
+
+#endif
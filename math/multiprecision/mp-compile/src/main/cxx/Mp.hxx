@@ -0,0 +1,279 @@
+/*
+ * Multiprecision kernels over 64-bit limbs, least significant limb first.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+
+#ifndef Mp_hxx__
+# define Mp_hxx__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+// 32-bit limb originals, carry rebuilt from comparison or from 64-bit sum
+// sumMpOverflowVar misses the carry where b limb is all ones and carry comes in
+int sumMpOverflowVar(unsigned *result, unsigned *a, unsigned *b, size_t size);
+int sumMpOverflowHigher(uint32_t *result, uint32_t *a, uint32_t *b, size_t size);
+
+// Addition and subtraction, result may alias either operand.  Return carry (borrow) out of the top limb.
+typedef uint64_t (*MpAddFunction)(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t size);
+
+// Portable, __builtin_add_overflow
+uint64_t addMp_ref(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t size);
+uint64_t subMp_ref(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t size);
+
+#ifdef __x86_64__
+// _addcarry_u64 / _subborrow_u64
+uint64_t addMp_Intrinsic(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t size);
+uint64_t subMp_Intrinsic(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t size);
+// adc / sbb chain unrolled by 4 in inline asm
+uint64_t addMp_Asm(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t size);
+uint64_t subMp_Asm(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t size);
+// adcx and adox chains over the lower and upper half at once, carry into the upper half rippled afterwards.  Requires
+// ADX.
+uint64_t addMp_Adx(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t size);
+uint64_t subMp_Adx(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t size);
+#endif
+
+// Best kernel for the host, selected at startup
+uint64_t addMp(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t size);
+uint64_t subMp(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t size);
+// Name of the kernels selected by addMp and subMp
+const char *addMpSelected();
+
+// Scratch memory provided by the caller, allocated by bumping and released by rewinding to a mark
+class MpArena
+{
+public:
+	MpArena(uint64_t *memory, size_t limbs):
+		memory(memory),
+		limbs(limbs),
+		used(0)
+	{
+	}
+
+	uint64_t *allocate(size_t count)
+	{
+		if (count > limbs-used)
+			throw std::length_error("MpArena exhausted");
+		uint64_t *allocated = memory+used;
+		used += count;
+		return allocated;
+	}
+
+	size_t mark() const
+	{
+		return used;
+	}
+
+	void rewind(size_t mark)
+	{
+		used = mark;
+	}
+
+private:
+	uint64_t *memory;
+	size_t limbs;
+	size_t used;
+};
+
+// Single limb multiplier: result = a*b returning the high limb, result += a*b returning the carry limb
+uint64_t mulMp_1_ref(uint64_t *result, const uint64_t *a, size_t size, uint64_t b);
+uint64_t addMulMp_1_ref(uint64_t *result, const uint64_t *a, size_t size, uint64_t b);
+#ifdef __x86_64__
+// mulx with adcx and adox chains, requires BMI2 and ADX
+uint64_t mulMp_1_Adx(uint64_t *result, const uint64_t *a, size_t size, uint64_t b);
+uint64_t addMulMp_1_Adx(uint64_t *result, const uint64_t *a, size_t size, uint64_t b);
+#endif
+uint64_t mulMp_1(uint64_t *result, const uint64_t *a, size_t size, uint64_t b);
+uint64_t addMulMp_1(uint64_t *result, const uint64_t *a, size_t size, uint64_t b);
+
+// Schoolbook, result has an+bn limbs and does not alias the operands.  ref uses the portable single limb kernels.
+void mulMp_ref(uint64_t *result, const uint64_t *a, size_t an, const uint64_t *b, size_t bn);
+void mulMp_Schoolbook(uint64_t *result, const uint64_t *a, size_t an, const uint64_t *b, size_t bn);
+// Off-diagonal products once, doubled, diagonal squares added
+void sqrMp_Schoolbook(uint64_t *result, const uint64_t *a, size_t size);
+
+// Operand sizes in limbs from which the algorithm is used, at the given recursion level
+struct MpMulThresholds
+{
+	size_t karatsuba;
+	size_t toom3;
+	size_t sqrKaratsuba;
+	size_t sqrToom3;
+	size_t ntt;
+	size_t sqrNtt;
+};
+
+extern MpMulThresholds mpMulThresholds;
+
+// Multiplication engine: schoolbook, Karatsuba, Toom-3 and NTT by thresholds, unbalanced operands cut into pieces of the
+// shorter size.  result has an+bn limbs (2*size for sqrMp) and does not alias the operands.  Scratch comes from the
+// arena, at least mulMpScratch (sqrMpScratch) limbs for current thresholds.
+void mulMp(uint64_t *result, const uint64_t *a, size_t an, const uint64_t *b, size_t bn, MpArena *arena);
+void sqrMp(uint64_t *result, const uint64_t *a, size_t size, MpArena *arena);
+size_t mulMpScratch(size_t an, size_t bn);
+size_t sqrMpScratch(size_t size);
+const char *mulMpSelected();
+
+// Montgomery arithmetic modulo odd n of size limbs, R = 2^(64*size).  Returns -n0^-1 mod 2^64.
+uint64_t montgomeryInverseMp(uint64_t n0);
+// result = R mod n (one in Montgomery form) and R^2 mod n (conversion factor), by modular doubling
+void montgomeryOneMp(uint64_t *result, const uint64_t *n, size_t size);
+void montgomeryR2Mp(uint64_t *result, const uint64_t *n, size_t size);
+// result = a*b/R mod n, a and b below n.  Scratch 2*size+1 limbs and mulMpScratch(size, size).
+void mulMontgomeryMp(uint64_t *result, const uint64_t *a, const uint64_t *b, const uint64_t *n, size_t size, uint64_t n0inv, MpArena *arena);
+// Fixed window width for modular exponentiation with bits long exponent, minimizing table and window multiplications
+constexpr unsigned montgomeryWindowBits(size_t bits)
+{
+	return bits <= 512 ? 4 : bits <= 1536 ? 5 : 6;
+}
+
+// width bits of x starting at bit, x having size limbs
+inline unsigned windowMp(const uint64_t *x, size_t size, size_t bit, unsigned width)
+{
+	uint64_t bits = x[bit/64]>>(bit%64);
+	if (bit%64+width > 64 && bit/64+1 < size)
+		bits |= x[bit/64+1]<<(64-bit%64);
+	return (unsigned)bits&((1u<<width)-1);
+}
+
+// result = base^exponent in Montgomery form, fixed window, one is R mod n.  Scratch powMontgomeryMpScratch(size)
+// limbs.
+void powMontgomeryMp(uint64_t *result, const uint64_t *base, const uint64_t *exponent, size_t exponentSize, const uint64_t *one, const uint64_t *n, size_t size, uint64_t n0inv, MpArena *arena);
+size_t powMontgomeryMpScratch(size_t size);
+
+// Addition and subtraction split into segments added by threads at once, carries rippled into the following segments
+// afterwards, only over all-ones (all-zeros) limbs.  threads 0 means all CPUs.  Below mpParallelThreshold limbs or
+// with single thread the single thread kernel is called.
+uint64_t addMpParallel(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t size, unsigned threads);
+uint64_t subMpParallel(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t size, unsigned threads);
+extern size_t mpParallelThreshold;
+// Runs task(0) ... task(count-1) over the pool of the parallel addition, task(0) on the calling thread, returns when
+// all are done.  The pool serves single caller at a time, concurrent callers and nested calls from the tasks run all
+// the tasks sequentially on the calling thread instead.
+void runMpThreads(unsigned count, const std::function<void(unsigned index)> &task);
+
+// Batch layout for lane parallel arithmetic of many same size numbers: groups of MP_BATCH_LANES numbers, limb k of lane
+// l in group g at [(g*limbs+k)*MP_BATCH_LANES+l].  Limbs have radix bits (32 or 52) in 64-bit words, the spare bits
+// keep deferred carries, up to 2^(64-radix) additions before normalization.
+static const size_t MP_BATCH_LANES = 8;
+
+// Limbs of batch number holding size 64-bit limbs and carry, groups for count numbers
+size_t batchLimbsMp(size_t size, unsigned radix);
+size_t batchGroupsMp(size_t count);
+// count numbers of size limbs stored one after another to batch layout, missing lanes of the last group are zero
+void toBatchMp(uint64_t *batch, const uint64_t *numbers, size_t count, size_t size, unsigned radix);
+// From normalized batch layout, carries (if not NULL) get the bits above size limbs
+void fromBatchMp(uint64_t *numbers, uint64_t *carries, const uint64_t *batch, size_t count, size_t size, unsigned radix);
+
+// result = a+b lane by lane without carry propagation, words = groups*limbs*MP_BATCH_LANES.  Propagating the
+// deferred carries leaves all limbs but the top below 2^radix.  addNormalize does both in single pass.
+void addBatchMp_ref(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t words);
+void normalizeBatchMp_ref(uint64_t *batch, size_t groups, size_t limbs, unsigned radix);
+void addNormalizeBatchMp_ref(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t groups, size_t limbs, unsigned radix);
+#ifdef __x86_64__
+// 256-bit vectors, two per group, require AVX2
+void addBatchMp_Avx2(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t words);
+void normalizeBatchMp_Avx2(uint64_t *batch, size_t groups, size_t limbs, unsigned radix);
+void addNormalizeBatchMp_Avx2(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t groups, size_t limbs, unsigned radix);
+// 512-bit vector per group, require AVX-512F
+void addBatchMp_Avx512(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t words);
+void normalizeBatchMp_Avx512(uint64_t *batch, size_t groups, size_t limbs, unsigned radix);
+void addNormalizeBatchMp_Avx512(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t groups, size_t limbs, unsigned radix);
+#endif
+void addBatchMp(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t words);
+void normalizeBatchMp(uint64_t *batch, size_t groups, size_t limbs, unsigned radix);
+void addNormalizeBatchMp(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t groups, size_t limbs, unsigned radix);
+const char *batchMpSelected();
+
+// Division, quotient an-dn+1 limbs and remainder dn limbs of a by d, d[dn-1] nonzero, an >= dn.  Single limb
+// division, by hardware divide or by the reciprocal, writes the quotient (may be a) and returns the remainder.  Knuth
+// algorithm D needs divRemMpKnuthScratch limbs of scratch.
+uint64_t divRemMp_1(uint64_t *quotient, const uint64_t *a, size_t size, uint64_t d);
+void divRemMp_Knuth(uint64_t *quotient, uint64_t *remainder, const uint64_t *a, size_t an, const uint64_t *d, size_t dn, MpArena *arena);
+size_t divRemMpKnuthScratch(size_t an, size_t dn);
+// v = floor(B^(2*dn)/d) of dn+1 limbs, d normalized (top bit set), by Newton iteration
+void reciprocalMp(uint64_t *v, const uint64_t *d, size_t dn, MpArena *arena);
+size_t reciprocalMpScratch(size_t dn);
+// Barrett division by normalized d with its reciprocal v, dn <= an <= 2*dn
+void divRemMp_Barrett(uint64_t *quotient, uint64_t *remainder, const uint64_t *a, size_t an, const uint64_t *d, size_t dn, const uint64_t *v, MpArena *arena);
+size_t divRemMpBarrettScratch(size_t an, size_t dn);
+// Single limb divisor shifted to the top bit with its reciprocal floor((B^2-1)/d)-B, each quotient limb by two
+// multiplications instead of hardware division, for repeated division by the same limb
+struct MpDivisor1
+{
+	uint64_t normalized;
+	uint64_t inverse;
+	unsigned shift;
+
+	MpDivisor1(uint64_t d);
+};
+uint64_t divRemMp_1Inverse(uint64_t *quotient, const uint64_t *a, size_t size, const MpDivisor1 &divisor);
+// Divisor of dn limbs, normalized with its Newton reciprocal computed once for repeated division and reduction
+struct MpDivisor
+{
+	std::vector<uint64_t> normalized;
+	std::vector<uint64_t> reciprocal;
+	unsigned shift;
+
+	MpDivisor(const uint64_t *d, size_t dn);
+};
+// Division of any an >= dn by blocks of dn limbs, each one Barrett step by the prepared reciprocal.  modMp computes
+// only the remainder, as for reduction of products modulo the same number.
+void divRemMp_Reciprocal(uint64_t *quotient, uint64_t *remainder, const uint64_t *a, size_t an, const MpDivisor &divisor, MpArena *arena);
+size_t divRemMpReciprocalScratch(size_t an, size_t dn);
+void modMp(uint64_t *remainder, const uint64_t *a, size_t an, const MpDivisor &divisor, MpArena *arena);
+size_t modMpScratch(size_t an, size_t dn);
+// As divRemMp_Reciprocal, with the reciprocal computed in the scratch for the single call
+void divRemMp_Newton(uint64_t *quotient, uint64_t *remainder, const uint64_t *a, size_t an, const uint64_t *d, size_t dn, MpArena *arena);
+size_t divRemMpNewtonScratch(size_t an, size_t dn);
+// Single limb by the reciprocal, Knuth below 600 limbs of divisor or quotient, Newton and Barrett above
+void divRemMp(uint64_t *quotient, uint64_t *remainder, const uint64_t *a, size_t an, const uint64_t *d, size_t dn, MpArena *arena);
+size_t divRemMpScratch(size_t an, size_t dn);
+
+// Decimal conversion, divide and conquer over cached powers 10^(19*2^k) with their reciprocals.  toDecimalMp writes
+// the digits without leading zeros ("0" for zero) to out of decimalDigitsMp(size) chars, returns their count.
+// fromDecimalMp reads length digits to result of decimalLimbsMp(length) limbs, returns the normalized size, throws
+// std::invalid_argument for anything but digits.  The _ref variants go chunk by chunk of 19 digits.
+size_t toDecimalMp(char *out, const uint64_t *a, size_t size);
+size_t toDecimalMp_ref(char *out, const uint64_t *a, size_t size);
+size_t decimalDigitsMp(size_t size);
+size_t fromDecimalMp(uint64_t *result, const char *digits, size_t length);
+size_t fromDecimalMp_ref(uint64_t *result, const char *digits, size_t length);
+size_t decimalLimbsMp(size_t digits);
+// count chunks below 10^19 as 19 digits each
+void formatDigitsMp_ref(char *out, const uint64_t *chunks, size_t count);
+#ifdef __x86_64__
+void formatDigitsMp_Sse2(char *out, const uint64_t *chunks, size_t count);
+#endif
+void formatDigitsMp(char *out, const uint64_t *chunks, size_t count);
+
+// Multiplication by number theoretic transform modulo three primes c*2^40+1 below 2^63, limbs as the coefficients,
+// the product coefficients combined by Chinese remainder theorem.  result has an+bn limbs, up to 2^32, and does not
+// alias the operands.  Transforms run over mpNttThreads threads (0 means all CPUs, default 1).  Scratch
+// mulMpNttScratch (sqrMpNttScratch) limbs, four (three) transforms of the power of two above an+bn-1.
+void mulMp_Ntt(uint64_t *result, const uint64_t *a, size_t an, const uint64_t *b, size_t bn, MpArena *arena);
+void sqrMp_Ntt(uint64_t *result, const uint64_t *a, size_t size, MpArena *arena);
+size_t mulMpNttScratch(size_t an, size_t bn);
+size_t sqrMpNttScratch(size_t size);
+extern unsigned mpNttThreads;
+// Transform of length (power of two up to 2^32) residues modulo prime number 0 to 2, forward from natural order to bit
+// reversed, inverse from bit reversed to natural order, multiplied by length.  ref is scalar, Avx512 runs eight
+// butterflies with 64-bit products from 32-bit ones, requires AVX-512F.
+uint64_t nttPrimeMp(unsigned prime);
+void nttForwardMp_ref(uint64_t *x, size_t length, unsigned prime);
+void nttInverseMp_ref(uint64_t *x, size_t length, unsigned prime);
+#ifdef __x86_64__
+void nttForwardMp_Avx512(uint64_t *x, size_t length, unsigned prime);
+void nttInverseMp_Avx512(uint64_t *x, size_t length, unsigned prime);
+#endif
+void nttForwardMp(uint64_t *x, size_t length, unsigned prime);
+void nttInverseMp(uint64_t *x, size_t length, unsigned prime);
+const char *nttMpSelected();
+
+#endif
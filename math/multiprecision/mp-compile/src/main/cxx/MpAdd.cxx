@@ -0,0 +1,284 @@
+/*
+ * Multiprecision addition and subtraction over 64-bit limbs.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stdint.h>
+#include <stddef.h>
+
+#include <algorithm>
+#include <chrono>
+
+#ifdef __x86_64__
+#include <x86intrin.h>
+#endif
+
+#include "Mp.hxx"
+
+
+uint64_t addMp_ref(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t size)
+{
+	uint64_t carry = 0;
+	for (size_t i = 0; i < size; ++i) {
+		uint64_t sum;
+		uint64_t overflow = __builtin_add_overflow(a[i], b[i], &sum);
+		overflow |= __builtin_add_overflow(sum, carry, &result[i]);
+		carry = overflow;
+	}
+	return carry;
+}
+
+uint64_t subMp_ref(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t size)
+{
+	uint64_t borrow = 0;
+	for (size_t i = 0; i < size; ++i) {
+		uint64_t difference;
+		uint64_t overflow = __builtin_sub_overflow(a[i], b[i], &difference);
+		overflow |= __builtin_sub_overflow(difference, borrow, &result[i]);
+		borrow = overflow;
+	}
+	return borrow;
+}
+
+#ifdef __x86_64__
+
+uint64_t addMp_Intrinsic(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t size)
+{
+	unsigned char carry = 0;
+	for (size_t i = 0; i < size; ++i) {
+		unsigned long long sum;
+		carry = _addcarry_u64(carry, a[i], b[i], &sum);
+		result[i] = sum;
+	}
+	return carry;
+}
+
+uint64_t subMp_Intrinsic(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t size)
+{
+	unsigned char borrow = 0;
+	for (size_t i = 0; i < size; ++i) {
+		unsigned long long difference;
+		borrow = _subborrow_u64(borrow, a[i], b[i], &difference);
+		result[i] = difference;
+	}
+	return borrow;
+}
+
+// Four limbs per iteration, dec keeps CF.  All limbs of the block are loaded before storing, so the result may alias
+// the operands.
+#define MP_ASM_CHAIN(OP) \
+	"1:\n" \
+	"mov (%[a]), %[t0]\n" \
+	"mov 8(%[a]), %[t1]\n" \
+	"mov 16(%[a]), %[t2]\n" \
+	"mov 24(%[a]), %[t3]\n" \
+	OP " (%[b]), %[t0]\n" \
+	OP " 8(%[b]), %[t1]\n" \
+	OP " 16(%[b]), %[t2]\n" \
+	OP " 24(%[b]), %[t3]\n" \
+	"mov %[t0], (%[r])\n" \
+	"mov %[t1], 8(%[r])\n" \
+	"mov %[t2], 16(%[r])\n" \
+	"mov %[t3], 24(%[r])\n" \
+	"lea 32(%[a]), %[a]\n" \
+	"lea 32(%[b]), %[b]\n" \
+	"lea 32(%[r]), %[r]\n" \
+	"dec %[n]\n" \
+	"jnz 1b\n" \
+	"setc %[carry]\n"
+
+uint64_t addMp_Asm(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t size)
+{
+	size_t blocks = size/4;
+	unsigned char carry = 0;
+	if (blocks != 0) {
+		uint64_t t0, t1, t2, t3;
+		__asm__ __volatile__(
+			"clc\n"
+			MP_ASM_CHAIN("adc")
+			: [a] "+&r"(a), [b] "+&r"(b), [r] "+&r"(result), [n] "+&r"(blocks), [carry] "=&q"(carry),
+				[t0] "=&r"(t0), [t1] "=&r"(t1), [t2] "=&r"(t2), [t3] "=&r"(t3)
+			:
+			: "cc", "memory"
+		);
+	}
+	for (size_t i = 0; i < size%4; ++i) {
+		unsigned long long sum;
+		carry = _addcarry_u64(carry, a[i], b[i], &sum);
+		result[i] = sum;
+	}
+	return carry;
+}
+
+uint64_t subMp_Asm(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t size)
+{
+	size_t blocks = size/4;
+	unsigned char borrow = 0;
+	if (blocks != 0) {
+		uint64_t t0, t1, t2, t3;
+		__asm__ __volatile__(
+			"clc\n"
+			MP_ASM_CHAIN("sbb")
+			: [a] "+&r"(a), [b] "+&r"(b), [r] "+&r"(result), [n] "+&r"(blocks), [carry] "=&q"(borrow),
+				[t0] "=&r"(t0), [t1] "=&r"(t1), [t2] "=&r"(t2), [t3] "=&r"(t3)
+			:
+			: "cc", "memory"
+		);
+	}
+	for (size_t i = 0; i < size%4; ++i) {
+		unsigned long long difference;
+		borrow = _subborrow_u64(borrow, a[i], b[i], &difference);
+		result[i] = difference;
+	}
+	return borrow;
+}
+
+// Single limb of both chains: lower limb at OFFSET on CF chain (adcx), upper limb at OFFSET+upper on OF chain (adox).
+// NEGATE is "not" for subtraction, computed as a+~b+1, or empty.
+#define MP_ADX_LIMB(NEGATE, OFFSET, T, U) \
+	"mov " OFFSET "(%[b]), %[" T "]\n" \
+	"mov " OFFSET "(%[b],%[upper]), %[" U "]\n" \
+	NEGATE " %[" T "]\n" \
+	NEGATE " %[" U "]\n" \
+	"adcx " OFFSET "(%[a]), %[" T "]\n" \
+	"adox " OFFSET "(%[a],%[upper]), %[" U "]\n" \
+	"mov %[" T "], " OFFSET "(%[r])\n" \
+	"mov %[" U "], " OFFSET "(%[r],%[upper])\n"
+
+// lea and jrcxz keep both CF and OF
+#define MP_ADX_CHAIN(NEGATE) \
+	"1:\n" \
+	MP_ADX_LIMB(NEGATE, "0", "t0", "u0") \
+	MP_ADX_LIMB(NEGATE, "8", "t1", "u1") \
+	MP_ADX_LIMB(NEGATE, "16", "t0", "u0") \
+	MP_ADX_LIMB(NEGATE, "24", "t1", "u1") \
+	"lea 32(%[a]), %[a]\n" \
+	"lea 32(%[b]), %[b]\n" \
+	"lea 32(%[r]), %[r]\n" \
+	"lea -1(%[n]), %[n]\n" \
+	"jrcxz 2f\n" \
+	"jmp 1b\n" \
+	"2:\n" \
+	"setc %[lowCarry]\n" \
+	"seto %[highCarry]\n"
+
+// a+b (SUB false) or a+~b+1 (SUB true), lower and upper half by independent carry chains.  The upper half starts
+// without carry, the carry out of the lower half is then added to it, rippling further only over all-ones limbs.
+template <bool SUB>
+__attribute__((noinline))
+static uint64_t addSubMp_Adx(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t size)
+{
+	size_t lower = (size/2)&~(size_t)3;
+	if (lower == 0)
+		return SUB ? subMp_Asm(result, a, b, size) : addMp_Asm(result, a, b, size);
+	size_t blocks = lower/4;
+	size_t upper = lower*sizeof(uint64_t);
+	unsigned char lowCarry, highCarry;
+	const uint64_t *ap = a, *bp = b;
+	uint64_t *rp = result;
+	uint64_t t0, t1, u0, u1;
+	if (SUB) {
+		__asm__ __volatile__(
+			"xor %k[t0], %k[t0]\n"
+			"stc\n"
+			MP_ADX_CHAIN("not")
+			: [a] "+&r"(ap), [b] "+&r"(bp), [r] "+&r"(rp), [n] "+&c"(blocks),
+				[lowCarry] "=&q"(lowCarry), [highCarry] "=&q"(highCarry),
+				[t0] "=&r"(t0), [t1] "=&r"(t1), [u0] "=&r"(u0), [u1] "=&r"(u1)
+			: [upper] "r"(upper)
+			: "cc", "memory"
+		);
+	}
+	else {
+		__asm__ __volatile__(
+			"xor %k[t0], %k[t0]\n"
+			MP_ADX_CHAIN("#")
+			: [a] "+&r"(ap), [b] "+&r"(bp), [r] "+&r"(rp), [n] "+&c"(blocks),
+				[lowCarry] "=&q"(lowCarry), [highCarry] "=&q"(highCarry),
+				[t0] "=&r"(t0), [t1] "=&r"(t1), [u0] "=&r"(u0), [u1] "=&r"(u1)
+			: [upper] "r"(upper)
+			: "cc", "memory"
+		);
+	}
+	// upper half tail beyond the lower length, continuing the OF chain
+	for (size_t i = 2*lower; i < size; ++i) {
+		unsigned long long sum;
+		highCarry = _addcarry_u64(highCarry, a[i], SUB ? ~b[i] : b[i], &sum);
+		result[i] = sum;
+	}
+	for (size_t i = lower; lowCarry != 0 && i < size; ++i)
+		lowCarry = ++result[i] == 0;
+	uint64_t carry = highCarry|lowCarry;
+	return SUB ? carry^1 : carry;
+}
+
+uint64_t addMp_Adx(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t size)
+{
+	return addSubMp_Adx<false>(result, a, b, size);
+}
+
+uint64_t subMp_Adx(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t size)
+{
+	return addSubMp_Adx<true>(result, a, b, size);
+}
+
+#endif
+
+struct AddMpSelection
+{
+	MpAddFunction add;
+	MpAddFunction sub;
+	const char *name;
+};
+
+#ifdef __x86_64__
+static const size_t CALIBRATION_LIMBS = 512;
+
+// Best nanoseconds of several short runs
+static double calibrateKernel(MpAddFunction function)
+{
+	static uint64_t a[CALIBRATION_LIMBS], b[CALIBRATION_LIMBS], result[CALIBRATION_LIMBS];
+	for (size_t i = 0; i < CALIBRATION_LIMBS; ++i) {
+		a[i] = i*0x9e3779b97f4a7c15ULL;
+		b[i] = ~a[i]>>1;
+	}
+	double best = 1e30;
+	for (int round = 0; round < 8; ++round) {
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < 16; ++i)
+			function(result, a, b, CALIBRATION_LIMBS);
+		best = std::min(best, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now()-start).count());
+	}
+	return best;
+}
+#endif
+
+// ADX dual chain pays off only where single adc chain is latency bound (adc with two cycle latency), so it is taken
+// only when faster in short calibration
+static AddMpSelection selectAddMp()
+{
+#ifdef __x86_64__
+	if (__builtin_cpu_supports("adx") && calibrateKernel(&addMp_Adx) < calibrateKernel(&addMp_Asm))
+		return AddMpSelection{ &addMp_Adx, &subMp_Adx, "adx" };
+	return AddMpSelection{ &addMp_Asm, &subMp_Asm, "asm" };
+#else
+	return AddMpSelection{ &addMp_ref, &subMp_ref, "ref" };
+#endif
+}
+
+static const AddMpSelection addMpSelection = selectAddMp();
+
+uint64_t addMp(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t size)
+{
+	return addMpSelection.add(result, a, b, size);
+}
+
+uint64_t subMp(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t size)
+{
+	return addMpSelection.sub(result, a, b, size);
+}
+
+const char *addMpSelected()
+{
+	return addMpSelection.name;
+}
@@ -0,0 +1,304 @@
+/*
+ * Batch addition of many independent numbers, limbs of different numbers in vector lanes.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <algorithm>
+
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+#include "Mp.hxx"
+
+
+size_t batchLimbsMp(size_t size, unsigned radix)
+{
+	return (64*size+1+radix-1)/radix;
+}
+
+size_t batchGroupsMp(size_t count)
+{
+	return (count+MP_BATCH_LANES-1)/MP_BATCH_LANES;
+}
+
+// Group by group, limb positions computed once for all lanes, missing lanes of the last group read as zero
+#ifdef __x86_64__
+__attribute__((target_clones("avx512f", "avx2", "default")))
+#endif
+void toBatchMp(uint64_t *batch, const uint64_t *numbers, size_t count, size_t size, unsigned radix)
+{
+	size_t limbs = batchLimbsMp(size, radix);
+	uint64_t mask = ((uint64_t)1<<radix)-1;
+	for (size_t g = 0; g < batchGroupsMp(count); ++g) {
+		uint64_t *out = batch+g*limbs*MP_BATCH_LANES;
+		size_t lanes = std::min(MP_BATCH_LANES, count-g*MP_BATCH_LANES);
+		const uint64_t *x = numbers+g*MP_BATCH_LANES*size;
+		for (size_t k = 0; k < limbs; ++k, out += MP_BATCH_LANES) {
+			size_t bit = k*radix, word = bit/64;
+			unsigned shift = bit%64;
+			if (word >= size) {
+				memset(out, 0, MP_BATCH_LANES*sizeof(uint64_t));
+				continue;
+			}
+			if (shift+radix > 64 && word+1 < size) {
+				for (size_t l = 0; l < lanes; ++l)
+					out[l] = ((x[l*size+word]>>shift)|(x[l*size+word+1]<<(64-shift)))&mask;
+			}
+			else {
+				for (size_t l = 0; l < lanes; ++l)
+					out[l] = (x[l*size+word]>>shift)&mask;
+			}
+			for (size_t l = lanes; l < MP_BATCH_LANES; ++l)
+				out[l] = 0;
+		}
+	}
+}
+
+// Each 64-bit limb collected from the batch limbs overlapping it.  Batch limbs are below 2^radix but the top one, which
+// comes last and continues into the carry.
+#ifdef __x86_64__
+__attribute__((target_clones("avx512f", "avx2", "default")))
+#endif
+void fromBatchMp(uint64_t *numbers, uint64_t *carries, const uint64_t *batch, size_t count, size_t size, unsigned radix)
+{
+	size_t limbs = batchLimbsMp(size, radix);
+	for (size_t g = 0; g < batchGroupsMp(count); ++g) {
+		const uint64_t *in = batch+g*limbs*MP_BATCH_LANES;
+		size_t lanes = std::min(MP_BATCH_LANES, count-g*MP_BATCH_LANES);
+		uint64_t *x = numbers+g*MP_BATCH_LANES*size;
+		for (size_t i = 0; i <= size; ++i) {
+			uint64_t value[MP_BATCH_LANES] = { 0 };
+			for (size_t k = 64*i/radix; k < limbs && k*radix < 64*(i+1); ++k) {
+				const uint64_t *limb = in+k*MP_BATCH_LANES;
+				if (k*radix >= 64*i) {
+					unsigned shift = k*radix-64*i;
+					for (size_t l = 0; l < MP_BATCH_LANES; ++l)
+						value[l] |= limb[l]<<shift;
+				}
+				else {
+					unsigned shift = 64*i-k*radix;
+					for (size_t l = 0; l < MP_BATCH_LANES; ++l)
+						value[l] |= limb[l]>>shift;
+				}
+			}
+			if (i < size) {
+				for (size_t l = 0; l < lanes; ++l)
+					x[l*size+i] = value[l];
+			}
+			else if (carries != NULL) {
+				for (size_t l = 0; l < lanes; ++l)
+					carries[g*MP_BATCH_LANES+l] = value[l];
+			}
+		}
+	}
+}
+
+void addBatchMp_ref(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t words)
+{
+	for (size_t i = 0; i < words; ++i)
+		result[i] = a[i]+b[i];
+}
+
+void normalizeBatchMp_ref(uint64_t *batch, size_t groups, size_t limbs, unsigned radix)
+{
+	uint64_t mask = ((uint64_t)1<<radix)-1;
+	for (size_t g = 0; g < groups; ++g) {
+		uint64_t *p = batch+g*limbs*MP_BATCH_LANES;
+		uint64_t carry[MP_BATCH_LANES] = { 0 };
+		for (size_t k = 0; k+1 < limbs; ++k) {
+			for (size_t l = 0; l < MP_BATCH_LANES; ++l) {
+				uint64_t value = p[k*MP_BATCH_LANES+l]+carry[l];
+				carry[l] = value>>radix;
+				p[k*MP_BATCH_LANES+l] = value&mask;
+			}
+		}
+		for (size_t l = 0; l < MP_BATCH_LANES; ++l)
+			p[(limbs-1)*MP_BATCH_LANES+l] += carry[l];
+	}
+}
+
+void addNormalizeBatchMp_ref(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t groups, size_t limbs, unsigned radix)
+{
+	uint64_t mask = ((uint64_t)1<<radix)-1;
+	for (size_t g = 0; g < groups; ++g) {
+		size_t offset = g*limbs*MP_BATCH_LANES;
+		uint64_t carry[MP_BATCH_LANES] = { 0 };
+		for (size_t k = 0; k+1 < limbs; ++k) {
+			for (size_t l = 0; l < MP_BATCH_LANES; ++l) {
+				size_t i = offset+k*MP_BATCH_LANES+l;
+				uint64_t value = a[i]+b[i]+carry[l];
+				carry[l] = value>>radix;
+				result[i] = value&mask;
+			}
+		}
+		for (size_t l = 0; l < MP_BATCH_LANES; ++l) {
+			size_t i = offset+(limbs-1)*MP_BATCH_LANES+l;
+			result[i] = a[i]+b[i]+carry[l];
+		}
+	}
+}
+
+#ifdef __x86_64__
+
+__attribute__((target("avx2")))
+void addBatchMp_Avx2(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t words)
+{
+	for (size_t i = 0; i < words; i += 4) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)(a+i));
+		__m256i y = _mm256_loadu_si256((const __m256i *)(b+i));
+		_mm256_storeu_si256((__m256i *)(result+i), _mm256_add_epi64(x, y));
+	}
+}
+
+// Two independent chains per group, the lower and upper four lanes
+__attribute__((target("avx2")))
+void normalizeBatchMp_Avx2(uint64_t *batch, size_t groups, size_t limbs, unsigned radix)
+{
+	__m128i shift = _mm_cvtsi32_si128(radix);
+	__m256i mask = _mm256_set1_epi64x(((uint64_t)1<<radix)-1);
+	for (size_t g = 0; g < groups; ++g) {
+		uint64_t *p = batch+g*limbs*MP_BATCH_LANES;
+		__m256i carry0 = _mm256_setzero_si256(), carry1 = _mm256_setzero_si256();
+		for (size_t k = 0; k+1 < limbs; ++k, p += MP_BATCH_LANES) {
+			__m256i x0 = _mm256_add_epi64(_mm256_loadu_si256((const __m256i *)p), carry0);
+			__m256i x1 = _mm256_add_epi64(_mm256_loadu_si256((const __m256i *)(p+4)), carry1);
+			carry0 = _mm256_srl_epi64(x0, shift);
+			carry1 = _mm256_srl_epi64(x1, shift);
+			_mm256_storeu_si256((__m256i *)p, _mm256_and_si256(x0, mask));
+			_mm256_storeu_si256((__m256i *)(p+4), _mm256_and_si256(x1, mask));
+		}
+		_mm256_storeu_si256((__m256i *)p, _mm256_add_epi64(_mm256_loadu_si256((const __m256i *)p), carry0));
+		_mm256_storeu_si256((__m256i *)(p+4), _mm256_add_epi64(_mm256_loadu_si256((const __m256i *)(p+4)), carry1));
+	}
+}
+
+__attribute__((target("avx2")))
+void addNormalizeBatchMp_Avx2(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t groups, size_t limbs, unsigned radix)
+{
+	__m128i shift = _mm_cvtsi32_si128(radix);
+	__m256i mask = _mm256_set1_epi64x(((uint64_t)1<<radix)-1);
+	for (size_t i = 0, g = 0; g < groups; ++g) {
+		__m256i carry0 = _mm256_setzero_si256(), carry1 = _mm256_setzero_si256();
+		for (size_t k = 0; k+1 < limbs; ++k, i += MP_BATCH_LANES) {
+			__m256i x0 = _mm256_add_epi64(_mm256_add_epi64(_mm256_loadu_si256((const __m256i *)(a+i)), _mm256_loadu_si256((const __m256i *)(b+i))), carry0);
+			__m256i x1 = _mm256_add_epi64(_mm256_add_epi64(_mm256_loadu_si256((const __m256i *)(a+i+4)), _mm256_loadu_si256((const __m256i *)(b+i+4))), carry1);
+			carry0 = _mm256_srl_epi64(x0, shift);
+			carry1 = _mm256_srl_epi64(x1, shift);
+			_mm256_storeu_si256((__m256i *)(result+i), _mm256_and_si256(x0, mask));
+			_mm256_storeu_si256((__m256i *)(result+i+4), _mm256_and_si256(x1, mask));
+		}
+		_mm256_storeu_si256((__m256i *)(result+i), _mm256_add_epi64(_mm256_add_epi64(_mm256_loadu_si256((const __m256i *)(a+i)), _mm256_loadu_si256((const __m256i *)(b+i))), carry0));
+		_mm256_storeu_si256((__m256i *)(result+i+4), _mm256_add_epi64(_mm256_add_epi64(_mm256_loadu_si256((const __m256i *)(a+i+4)), _mm256_loadu_si256((const __m256i *)(b+i+4))), carry1));
+		i += MP_BATCH_LANES;
+	}
+}
+
+__attribute__((target("avx512f")))
+void addBatchMp_Avx512(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t words)
+{
+	for (size_t i = 0; i < words; i += 8) {
+		__m512i x = _mm512_loadu_si512(a+i);
+		__m512i y = _mm512_loadu_si512(b+i);
+		_mm512_storeu_si512(result+i, _mm512_add_epi64(x, y));
+	}
+}
+
+// Two groups at once, single group chain is add and shift latency bound
+__attribute__((target("avx512f")))
+void normalizeBatchMp_Avx512(uint64_t *batch, size_t groups, size_t limbs, unsigned radix)
+{
+	__m128i shift = _mm_cvtsi32_si128(radix);
+	__m512i mask = _mm512_set1_epi64(((uint64_t)1<<radix)-1);
+	size_t stride = limbs*MP_BATCH_LANES;
+	size_t g = 0;
+	for (; g+1 < groups; g += 2) {
+		uint64_t *p = batch+g*stride;
+		__m512i carry0 = _mm512_setzero_si512(), carry1 = _mm512_setzero_si512();
+		for (size_t k = 0; k+1 < limbs; ++k, p += MP_BATCH_LANES) {
+			__m512i x0 = _mm512_add_epi64(_mm512_loadu_si512(p), carry0);
+			__m512i x1 = _mm512_add_epi64(_mm512_loadu_si512(p+stride), carry1);
+			carry0 = _mm512_srl_epi64(x0, shift);
+			carry1 = _mm512_srl_epi64(x1, shift);
+			_mm512_storeu_si512(p, _mm512_and_si512(x0, mask));
+			_mm512_storeu_si512(p+stride, _mm512_and_si512(x1, mask));
+		}
+		_mm512_storeu_si512(p, _mm512_add_epi64(_mm512_loadu_si512(p), carry0));
+		_mm512_storeu_si512(p+stride, _mm512_add_epi64(_mm512_loadu_si512(p+stride), carry1));
+	}
+	if (g < groups) {
+		uint64_t *p = batch+g*stride;
+		__m512i carry = _mm512_setzero_si512();
+		for (size_t k = 0; k+1 < limbs; ++k, p += MP_BATCH_LANES) {
+			__m512i x = _mm512_add_epi64(_mm512_loadu_si512(p), carry);
+			carry = _mm512_srl_epi64(x, shift);
+			_mm512_storeu_si512(p, _mm512_and_si512(x, mask));
+		}
+		_mm512_storeu_si512(p, _mm512_add_epi64(_mm512_loadu_si512(p), carry));
+	}
+}
+
+// Single group at once, the chain latency is covered by the loads
+__attribute__((target("avx512f")))
+void addNormalizeBatchMp_Avx512(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t groups, size_t limbs, unsigned radix)
+{
+	__m128i shift = _mm_cvtsi32_si128(radix);
+	__m512i mask = _mm512_set1_epi64(((uint64_t)1<<radix)-1);
+	for (size_t i = 0, g = 0; g < groups; ++g) {
+		__m512i carry = _mm512_setzero_si512();
+		for (size_t k = 0; k+1 < limbs; ++k, i += MP_BATCH_LANES) {
+			__m512i x = _mm512_add_epi64(_mm512_add_epi64(_mm512_loadu_si512(a+i), _mm512_loadu_si512(b+i)), carry);
+			carry = _mm512_srl_epi64(x, shift);
+			_mm512_storeu_si512(result+i, _mm512_and_si512(x, mask));
+		}
+		_mm512_storeu_si512(result+i, _mm512_add_epi64(_mm512_add_epi64(_mm512_loadu_si512(a+i), _mm512_loadu_si512(b+i)), carry));
+		i += MP_BATCH_LANES;
+	}
+}
+
+#endif
+
+struct BatchMpSelection
+{
+	void (*add)(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t words);
+	void (*normalize)(uint64_t *batch, size_t groups, size_t limbs, unsigned radix);
+	void (*addNormalize)(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t groups, size_t limbs, unsigned radix);
+	const char *name;
+};
+
+static BatchMpSelection selectBatchMp()
+{
+#ifdef __x86_64__
+	if (__builtin_cpu_supports("avx512f"))
+		return BatchMpSelection{ &addBatchMp_Avx512, &normalizeBatchMp_Avx512, &addNormalizeBatchMp_Avx512, "avx512" };
+	if (__builtin_cpu_supports("avx2"))
+		return BatchMpSelection{ &addBatchMp_Avx2, &normalizeBatchMp_Avx2, &addNormalizeBatchMp_Avx2, "avx2" };
+#endif
+	return BatchMpSelection{ &addBatchMp_ref, &normalizeBatchMp_ref, &addNormalizeBatchMp_ref, "ref" };
+}
+
+static const BatchMpSelection batchMpSelection = selectBatchMp();
+
+void addBatchMp(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t words)
+{
+	batchMpSelection.add(result, a, b, words);
+}
+
+void normalizeBatchMp(uint64_t *batch, size_t groups, size_t limbs, unsigned radix)
+{
+	batchMpSelection.normalize(batch, groups, limbs, radix);
+}
+
+void addNormalizeBatchMp(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t groups, size_t limbs, unsigned radix)
+{
+	batchMpSelection.addNormalize(result, a, b, groups, limbs, radix);
+}
+
+const char *batchMpSelected()
+{
+	return batchMpSelection.name;
+}
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include <stdint.h>
 #include <sys/resource.h>
 
@@ -9,9 +10,22 @@
 #include <stdexcept>
 #include <string>
 #include <array>
+#include <algorithm>
+#include <chrono>
+
+#ifdef __x86_64__
+#include <x86intrin.h>
+#endif
+
+#include "Mp.hxx"
+#include "MpCompile.hxx"
 
 using namespace std;
 
+// Ticks of single sample at least, so the timer resolution and call overhead do not matter
+static const uint64_t MIN_SAMPLE_TICKS = 2000000;
+static const int REPEAT = 5;
+
 int sumMpOverflowVar(unsigned *result, unsigned *a, unsigned *b, size_t size)
 {
 	uint8_t overflow = 0;
@@ -26,13 +40,110 @@ int sumMpOverflowHigher(uint32_t *result, uint32_t *a, uint32_t *b, size_t size)
 {
 	uint64_t sum = 0;
 	for (int i = 0; i < size; ++i) {
-		result[i] = sum = a[i]+b[i]+(sum>>32);
+		result[i] = sum = (uint64_t)a[i]+b[i]+(sum>>32);
 	}
 	return sum>>32;
 }
 
+uint64_t readTicks()
+{
+#ifdef __x86_64__
+	return __rdtsc();
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+const char *ticksUnit()
+{
+#ifdef __x86_64__
+	return "TSC ticks";
+#else
+	return "ns";
+#endif
+}
+
+double measureTicks(const std::function<void(long iterations)> &run)
+{
+	long iterations = 1;
+	uint64_t ticks;
+	for (;;) {
+		uint64_t start = readTicks();
+		run(iterations);
+		ticks = readTicks()-start;
+		if (ticks >= MIN_SAMPLE_TICKS)
+			break;
+		iterations *= 2;
+	}
+	double best = (double)ticks/iterations;
+	for (int r = 1; r < REPEAT; ++r) {
+		uint64_t start = readTicks();
+		run(iterations);
+		best = std::min(best, (double)(readTicks()-start)/iterations);
+	}
+	return best;
+}
+
+void randomLimbs(uint64_t *limbs, size_t size, uint64_t seed)
+{
+	// splitmix64
+	for (size_t i = 0; i < size; ++i) {
+		uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+		z = (z^(z>>30))*0xbf58476d1ce4e5b9ULL;
+		z = (z^(z>>27))*0x94d049bb133111ebULL;
+		limbs[i] = z^(z>>31);
+	}
+}
 
-int main(void)
+bool parseSizes(int argc, char **argv, std::vector<size_t> *sizes, const std::vector<size_t> &defaults)
 {
-	return 0;
+	for (int i = 0; i < argc; ++i) {
+		char *end;
+		unsigned long size = strtoul(argv[i], &end, 0);
+		if (*end != '\0' || size == 0)
+			return false;
+		sizes->push_back(size);
+	}
+	if (sizes->empty())
+		*sizes = defaults;
+	return true;
+}
+
+static int usage(const char *argv0)
+{
+	fprintf(stderr, "Usage: %s [add [sizes...]|mul [options] [sizes...]|fixed|batch [sizes...]|parallel [--threads=n,...] [sizes...]|bigint [sizes...]|decimal [digits...]|ntt [--tune] [--threads=n] [sizes...]|div [sizes...]]\n", argv0);
+	return 2;
+}
+
+int main(int argc, char **argv)
+{
+	const char *mode = argc > 1 ? argv[1] : "add";
+	if (strcmp(mode, "add") == 0) {
+		return runAdd(argc-2, argv+2);
+	}
+	else if (strcmp(mode, "mul") == 0) {
+		return runMul(argc-2, argv+2);
+	}
+	else if (strcmp(mode, "fixed") == 0) {
+		return runFixed(argc-2, argv+2);
+	}
+	else if (strcmp(mode, "batch") == 0) {
+		return runBatch(argc-2, argv+2);
+	}
+	else if (strcmp(mode, "parallel") == 0) {
+		return runParallel(argc-2, argv+2);
+	}
+	else if (strcmp(mode, "bigint") == 0) {
+		return runBigInt(argc-2, argv+2);
+	}
+	else if (strcmp(mode, "decimal") == 0) {
+		return runDecimal(argc-2, argv+2);
+	}
+	else if (strcmp(mode, "ntt") == 0) {
+		return runNtt(argc-2, argv+2);
+	}
+	else if (strcmp(mode, "div") == 0) {
+		return runDiv(argc-2, argv+2);
+	}
+	return usage(argv[0]);
 }
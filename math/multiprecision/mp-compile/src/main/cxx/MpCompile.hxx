@@ -0,0 +1,39 @@
+/*
+ * MpCompile benchmark harness shared by the modes.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+
+#ifndef MpCompile_hxx__
+# define MpCompile_hxx__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <vector>
+
+// Time stamp counter on x86, ticking at the nominal clock, nanoseconds elsewhere
+uint64_t readTicks();
+const char *ticksUnit();
+
+// Calls run(iterations) with iterations doubled until the call is long enough, returns the best ticks per iteration
+double measureTicks(const std::function<void(long iterations)> &run);
+
+// Deterministic pseudo-random limbs
+void randomLimbs(uint64_t *limbs, size_t size, uint64_t seed);
+
+// Sizes from the arguments, or the defaults if there are none, returns false for invalid argument
+bool parseSizes(int argc, char **argv, std::vector<size_t> *sizes, const std::vector<size_t> &defaults);
+
+int runAdd(int argc, char **argv);
+int runMul(int argc, char **argv);
+int runFixed(int argc, char **argv);
+int runBatch(int argc, char **argv);
+int runParallel(int argc, char **argv);
+int runBigInt(int argc, char **argv);
+int runDecimal(int argc, char **argv);
+int runNtt(int argc, char **argv);
+int runDiv(int argc, char **argv);
+
+#endif
@@ -0,0 +1,169 @@
+/*
+ * Addition and subtraction kernels benchmark.
+ *
+ * Verifies every 64-bit limb kernel, and the 32-bit originals on the same data viewed as 32-bit limbs, against the
+ * portable reference, on random operands and on all-ones runs rippling the carry through the whole number.  Then
+ * reports ticks per 64-bit limb, the 32-bit originals process two limbs for the same width.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "Mp.hxx"
+#include "MpCompile.hxx"
+
+
+struct AddKernel {
+	const char *name;
+	MpAddFunction add;
+	MpAddFunction sub;
+	bool available;
+};
+
+static std::vector<AddKernel> addKernels()
+{
+	return std::vector<AddKernel>{
+		{ "ref", &addMp_ref, &subMp_ref, true },
+#ifdef __x86_64__
+		{ "intrinsic", &addMp_Intrinsic, &subMp_Intrinsic, true },
+		{ "asm", &addMp_Asm, &subMp_Asm, true },
+		{ "adx", &addMp_Adx, &subMp_Adx, __builtin_cpu_supports("adx") != 0 },
+#endif
+		{ "selected", &addMp, &subMp, true },
+	};
+}
+
+// Operands: random, a all ones with b one (carry through everything), and random with all-ones run in the middle
+static void fillOperands(uint64_t *a, uint64_t *b, size_t size, int variant, uint64_t seed)
+{
+	randomLimbs(a, size, seed);
+	randomLimbs(b, size, seed^0x5555);
+	switch (variant) {
+	case 1:
+		std::fill(a, a+size, ~(uint64_t)0);
+		std::fill(b, b+size, 0);
+		b[0] = 1;
+		break;
+	case 2:
+		for (size_t i = size/4; i < size*3/4; ++i)
+			a[i] = ~b[i];
+		break;
+	case 3:
+		std::fill(a, a+size, 0);
+		std::fill(b, b+size, 0);
+		b[0] = 1;
+		break;
+	}
+}
+
+static bool verifyKernel(const AddKernel &kernel, size_t size)
+{
+	std::vector<uint64_t> a(size), b(size), expected(size), result(size);
+	for (int variant = 0; variant < 4; ++variant) {
+		fillOperands(a.data(), b.data(), size, variant, size*4+variant);
+		for (int sub = 0; sub < 2; ++sub) {
+			MpAddFunction reference = sub ? &subMp_ref : &addMp_ref;
+			MpAddFunction function = sub ? kernel.sub : kernel.add;
+			uint64_t expectedCarry = reference(expected.data(), a.data(), b.data(), size);
+			uint64_t carry = function(result.data(), a.data(), b.data(), size);
+			// result aliasing the first operand
+			std::vector<uint64_t> aliased(a);
+			uint64_t aliasedCarry = function(aliased.data(), aliased.data(), b.data(), size);
+			if (carry != expectedCarry || result != expected || aliasedCarry != expectedCarry || aliased != expected) {
+				fprintf(stderr, "%s %s: size %zu operands %d: mismatch, carry %d expected %d\n", kernel.name, sub ? "sub" : "add", size, variant, (int)carry, (int)expectedCarry);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static bool verifyOriginals(size_t size)
+{
+	std::vector<uint64_t> a(size), b(size), expected(size), result(size);
+	for (int variant = 0; variant < 4; ++variant) {
+		fillOperands(a.data(), b.data(), size, variant, size*4+variant);
+		uint64_t expectedCarry = addMp_ref(expected.data(), a.data(), b.data(), size);
+		// little endian, 64-bit limbs are pairs of 32-bit ones
+		int carryVar = sumMpOverflowVar((unsigned *)result.data(), (unsigned *)a.data(), (unsigned *)b.data(), size*2);
+		bool matchVar = result == expected && (uint64_t)carryVar == expectedCarry;
+		int carryHigher = sumMpOverflowHigher((uint32_t *)result.data(), (uint32_t *)a.data(), (uint32_t *)b.data(), size*2);
+		bool matchHigher = result == expected && (uint64_t)carryHigher == expectedCarry;
+		if (!matchVar || !matchHigher) {
+			fprintf(stderr, "%s: size %zu operands %d: mismatch\n", matchVar ? "sumMpOverflowHigher" : "sumMpOverflowVar", size, variant);
+			return false;
+		}
+	}
+	return true;
+}
+
+int runAdd(int argc, char **argv)
+{
+	std::vector<size_t> sizes;
+	if (!parseSizes(argc, argv, &sizes, { 4, 8, 16, 64, 256, 1024, 4096, 16384, 100000 })) {
+		fprintf(stderr, "Usage: add [sizes...]\n");
+		return 2;
+	}
+	std::vector<AddKernel> kernels = addKernels();
+
+	std::vector<size_t> verifySizes;
+	for (size_t size = 1; size <= 80; ++size)
+		verifySizes.push_back(size);
+	verifySizes.insert(verifySizes.end(), sizes.begin(), sizes.end());
+	for (size_t size: verifySizes) {
+		if (!verifyOriginals(size))
+			return 1;
+		for (const AddKernel &kernel: kernels) {
+			if (kernel.available && !verifyKernel(kernel, size))
+				return 1;
+		}
+	}
+
+	printf("# %s per 64-bit limb, selected kernel: %s\n", ticksUnit(), addMpSelected());
+	printf("%-4s %8s %10s %10s", "op", "limbs", "var32", "higher32");
+	for (const AddKernel &kernel: kernels)
+		printf(" %10s", kernel.name);
+	printf("\n");
+	for (int sub = 0; sub < 2; ++sub) {
+		for (size_t size: sizes) {
+			std::vector<uint64_t> a(size), b(size), result(size);
+			fillOperands(a.data(), b.data(), size, 0, size);
+			printf("%-4s %8zu", sub ? "sub" : "add", size);
+			if (sub) {
+				printf(" %10s %10s", "-", "-");
+			}
+			else {
+				double var = measureTicks([&](long iterations) {
+					for (long i = 0; i < iterations; ++i)
+						sumMpOverflowVar((unsigned *)result.data(), (unsigned *)a.data(), (unsigned *)b.data(), size*2);
+				});
+				double higher = measureTicks([&](long iterations) {
+					for (long i = 0; i < iterations; ++i)
+						sumMpOverflowHigher((uint32_t *)result.data(), (uint32_t *)a.data(), (uint32_t *)b.data(), size*2);
+				});
+				printf(" %10.3f %10.3f", var/size, higher/size);
+			}
+			for (const AddKernel &kernel: kernels) {
+				if (!kernel.available) {
+					printf(" %10s", "-");
+					continue;
+				}
+				MpAddFunction function = sub ? kernel.sub : kernel.add;
+				double ticks = measureTicks([&](long iterations) {
+					for (long i = 0; i < iterations; ++i)
+						function(result.data(), a.data(), b.data(), size);
+				});
+				printf(" %10.3f", ticks/size);
+			}
+			printf("\n");
+			fflush(stdout);
+		}
+	}
+	return 0;
+}
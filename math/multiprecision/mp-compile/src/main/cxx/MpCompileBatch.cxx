@@ -0,0 +1,210 @@
+/*
+ * Batch addition benchmark.
+ *
+ * Adds COUNT independent pairs of numbers: one by one with the scalar carry chain kernels (the 32-bit limb original
+ * sumMpOverflowHigher and the selected addMp), and lane parallel in the batch layout with radix 2^52 and 2^32 limbs
+ * on each instruction set available.  Batch results are verified against addMp_ref, including the carry out and
+ * deferred accumulation of many numbers normalized once.  Reports ticks per number of lane addition alone (deferred
+ * carries), with normalization pass, with normalization fused into the addition, and the fused one with conversion of
+ * both operands to batch layout and the result back.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "Mp.hxx"
+#include "MpCompile.hxx"
+
+
+static const size_t COUNT = 4096;
+static const size_t ACCUMULATED = 1000;
+static const unsigned RADIXES[] = { 52, 32 };
+
+struct BatchKernels
+{
+	const char *name;
+	void (*add)(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t words);
+	void (*normalize)(uint64_t *batch, size_t groups, size_t limbs, unsigned radix);
+	void (*addNormalize)(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t groups, size_t limbs, unsigned radix);
+};
+
+static std::vector<BatchKernels> availableKernels()
+{
+	std::vector<BatchKernels> kernels;
+	kernels.push_back(BatchKernels{ "ref", &addBatchMp_ref, &normalizeBatchMp_ref, &addNormalizeBatchMp_ref });
+#ifdef __x86_64__
+	if (__builtin_cpu_supports("avx2"))
+		kernels.push_back(BatchKernels{ "avx2", &addBatchMp_Avx2, &normalizeBatchMp_Avx2, &addNormalizeBatchMp_Avx2 });
+	if (__builtin_cpu_supports("avx512f"))
+		kernels.push_back(BatchKernels{ "avx512", &addBatchMp_Avx512, &normalizeBatchMp_Avx512, &addNormalizeBatchMp_Avx512 });
+#endif
+	return kernels;
+}
+
+struct Batch
+{
+	size_t count, size, limbs, groups;
+	unsigned radix;
+	std::vector<uint64_t> a, b, result;
+
+	Batch(size_t count, size_t size, unsigned radix):
+		count(count),
+		size(size),
+		limbs(batchLimbsMp(size, radix)),
+		groups(batchGroupsMp(count)),
+		radix(radix),
+		a(groups*limbs*MP_BATCH_LANES),
+		b(a.size()),
+		result(a.size())
+	{
+	}
+
+	size_t words() const
+	{
+		return groups*limbs*MP_BATCH_LANES;
+	}
+};
+
+static bool verify(const BatchKernels &kernels, size_t count, size_t size, unsigned radix)
+{
+	std::vector<uint64_t> a(count*size), b(count*size), expected(count*size), result(count*size), carries(count);
+	randomLimbs(a.data(), a.size(), size*3+radix);
+	randomLimbs(b.data(), b.size(), size*5+radix);
+	// all ones against one, so the carry ripples through the whole number
+	memset(a.data(), 0xff, size*sizeof(uint64_t));
+	memset(b.data(), 0, size*sizeof(uint64_t));
+	b[0] = 1;
+	Batch batch(count, size, radix);
+	toBatchMp(batch.a.data(), a.data(), count, size, radix);
+	toBatchMp(batch.b.data(), b.data(), count, size, radix);
+	for (int fused = 0; fused < 2; ++fused) {
+		if (fused) {
+			kernels.addNormalize(batch.result.data(), batch.a.data(), batch.b.data(), batch.groups, batch.limbs, radix);
+		}
+		else {
+			kernels.add(batch.result.data(), batch.a.data(), batch.b.data(), batch.words());
+			kernels.normalize(batch.result.data(), batch.groups, batch.limbs, radix);
+		}
+		fromBatchMp(result.data(), carries.data(), batch.result.data(), count, size, radix);
+		for (size_t n = 0; n < count; ++n) {
+			uint64_t carry = addMp_ref(&expected[n*size], &a[n*size], &b[n*size], size);
+			if (carry != carries[n] || memcmp(&expected[n*size], &result[n*size], size*sizeof(uint64_t)) != 0) {
+				fprintf(stderr, "batch %s radix %u fused %d: %zu limbs number %zu: mismatch\n", kernels.name, radix, fused, size, n);
+				return false;
+			}
+		}
+	}
+
+	// sum of ACCUMULATED numbers in each lane with deferred carries, normalized once
+	std::vector<uint64_t> sum(count*size), sumCarries(count);
+	memset(batch.result.data(), 0, batch.words()*sizeof(uint64_t));
+	for (size_t i = 0; i < ACCUMULATED; ++i) {
+		randomLimbs(a.data(), a.size(), i);
+		toBatchMp(batch.a.data(), a.data(), count, size, radix);
+		kernels.add(batch.result.data(), batch.result.data(), batch.a.data(), batch.words());
+		for (size_t n = 0; n < count; ++n)
+			sumCarries[n] += addMp_ref(&sum[n*size], &sum[n*size], &a[n*size], size);
+	}
+	kernels.normalize(batch.result.data(), batch.groups, batch.limbs, radix);
+	fromBatchMp(result.data(), carries.data(), batch.result.data(), count, size, radix);
+	if (result != sum || carries != sumCarries) {
+		fprintf(stderr, "batch %s radix %u: %zu limbs accumulation: mismatch\n", kernels.name, radix, size);
+		return false;
+	}
+	return true;
+}
+
+static void printRow(size_t size, const char *kernel, unsigned radix, double add, double normalized, double fused, double converted, double baseline)
+{
+	if (normalized < 0)
+		printf("%8zu %-10s %6u %12.2f %12s %12s %12s %9.2fx\n", size, kernel, radix, add, "-", "-", "-", baseline/add);
+	else
+		printf("%8zu %-10s %6u %12.2f %12.2f %12.2f %12.2f %9.2fx\n", size, kernel, radix, add, normalized, fused, converted, baseline/fused);
+}
+
+static void benchmark(size_t size, const std::vector<BatchKernels> &kernels)
+{
+	std::vector<uint64_t> a(COUNT*size), b(COUNT*size), result(COUNT*size), carries(COUNT);
+	randomLimbs(a.data(), a.size(), size);
+	randomLimbs(b.data(), b.size(), size^0x5555);
+	std::vector<uint32_t> a32(2*COUNT*size), b32(2*COUNT*size), result32(2*COUNT*size);
+	memcpy(a32.data(), a.data(), a.size()*sizeof(uint64_t));
+	memcpy(b32.data(), b.data(), b.size()*sizeof(uint64_t));
+
+	double higher = measureTicks([&](long iterations) {
+		for (long i = 0; i < iterations; ++i) {
+			for (size_t n = 0; n < COUNT; ++n)
+				sumMpOverflowHigher(&result32[2*n*size], &a32[2*n*size], &b32[2*n*size], 2*size);
+		}
+	})/COUNT;
+	double scalar = measureTicks([&](long iterations) {
+		for (long i = 0; i < iterations; ++i) {
+			for (size_t n = 0; n < COUNT; ++n)
+				carries[n] = addMp(&result[n*size], &a[n*size], &b[n*size], size);
+		}
+	})/COUNT;
+	printRow(size, "higher32", 32, higher, -1, -1, -1, scalar);
+	printRow(size, addMpSelected(), 64, scalar, -1, -1, -1, scalar);
+
+	for (unsigned radix: RADIXES) {
+		Batch batch(COUNT, size, radix);
+		toBatchMp(batch.a.data(), a.data(), COUNT, size, radix);
+		toBatchMp(batch.b.data(), b.data(), COUNT, size, radix);
+		for (const BatchKernels &kernel: kernels) {
+			double add = measureTicks([&](long iterations) {
+				for (long i = 0; i < iterations; ++i)
+					kernel.add(batch.result.data(), batch.a.data(), batch.b.data(), batch.words());
+			})/COUNT;
+			double normalized = measureTicks([&](long iterations) {
+				for (long i = 0; i < iterations; ++i) {
+					kernel.add(batch.result.data(), batch.a.data(), batch.b.data(), batch.words());
+					kernel.normalize(batch.result.data(), batch.groups, batch.limbs, radix);
+				}
+			})/COUNT;
+			double fused = measureTicks([&](long iterations) {
+				for (long i = 0; i < iterations; ++i)
+					kernel.addNormalize(batch.result.data(), batch.a.data(), batch.b.data(), batch.groups, batch.limbs, radix);
+			})/COUNT;
+			double converted = measureTicks([&](long iterations) {
+				for (long i = 0; i < iterations; ++i) {
+					toBatchMp(batch.a.data(), a.data(), COUNT, size, radix);
+					toBatchMp(batch.b.data(), b.data(), COUNT, size, radix);
+					kernel.addNormalize(batch.result.data(), batch.a.data(), batch.b.data(), batch.groups, batch.limbs, radix);
+					fromBatchMp(result.data(), carries.data(), batch.result.data(), COUNT, size, radix);
+				}
+			})/COUNT;
+			printRow(size, kernel.name, radix, add, normalized, fused, converted, scalar);
+		}
+	}
+	fflush(stdout);
+}
+
+int runBatch(int argc, char **argv)
+{
+	std::vector<size_t> sizes;
+	if (!parseSizes(argc, argv, &sizes, { 1, 4, 6, 8, 16, 32, 64 })) {
+		fprintf(stderr, "Usage: batch [sizes...]\n");
+		return 2;
+	}
+	std::vector<BatchKernels> kernels = availableKernels();
+	for (const BatchKernels &kernel: kernels) {
+		for (unsigned radix: RADIXES) {
+			for (size_t size: { 1, 2, 3, 4, 5, 8, 13 }) {
+				// partial last group
+				if (!verify(kernel, 3*MP_BATCH_LANES+5, size, radix))
+					return 1;
+			}
+		}
+	}
+
+	printf("# %s per number of %zu independent additions, sizes in 64-bit limbs; batch selected: %s; add keeps the carries deferred, normalized propagates them in second pass, fused in the same pass, converted adds layout conversion of operands and result to fused; speedup of fused against %s\n", ticksUnit(), COUNT, batchMpSelected(), addMpSelected());
+	printf("%8s %-10s %6s %12s %12s %12s %12s %10s\n", "limbs", "kernel", "radix", "add", "normalized", "fused", "converted", "speedup");
+	for (size_t size: sizes)
+		benchmark(size, kernels);
+	return 0;
+}
@@ -0,0 +1,321 @@
+/*
+ * BigInt expression benchmark.
+ *
+ * Evaluates r = (a*b + c*d) - a*d over COUNT signed operand sets: with naive value type allocating fresh vector for
+ * every result, with BigInt operators on heap, with BigInt operators and arena scope for the temporaries (reset after
+ * each expression), and with the BigInt primitives into long lived temporaries.  Verifies algebraic identities and
+ * that all the variants agree.  Reports ticks and heap allocations per expression, BigInt ones counted by the heap allocator,
+ * naive ones by its vector allocator.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "Mp.hxx"
+#include "BigInt.hxx"
+#include "MpCompile.hxx"
+
+
+static const size_t COUNT = 1024;
+
+static size_t naiveAllocations;
+
+template <typename T>
+struct NaiveCountingAllocator: std::allocator<T>
+{
+	template <typename U>
+	struct rebind
+	{
+		typedef NaiveCountingAllocator<U> other;
+	};
+
+	NaiveCountingAllocator()
+	{
+	}
+
+	template <typename U>
+	NaiveCountingAllocator(const NaiveCountingAllocator<U> &)
+	{
+	}
+
+	T *allocate(size_t n)
+	{
+		++naiveAllocations;
+		return std::allocator<T>::allocate(n);
+	}
+};
+
+// Sign and magnitude in vector, every operation returns new value
+struct NaiveBigInt
+{
+	std::vector<uint64_t, NaiveCountingAllocator<uint64_t>> limbs;
+	bool negative = false;
+
+	NaiveBigInt()
+	{
+	}
+
+	NaiveBigInt(const uint64_t *limbs, size_t size, bool negative):
+		limbs(limbs, limbs+size),
+		negative(negative)
+	{
+		normalize();
+	}
+
+	void normalize()
+	{
+		while (!limbs.empty() && limbs.back() == 0)
+			limbs.pop_back();
+		if (limbs.empty())
+			negative = false;
+	}
+};
+
+static NaiveBigInt naiveAddSub(const NaiveBigInt &a, const NaiveBigInt &b, bool sub)
+{
+	NaiveBigInt result;
+	bool bNegative = b.negative != sub;
+	const NaiveBigInt *x = &a, *y = &b;
+	bool add = a.negative == bNegative;
+	if (!add && (a.limbs.size() < b.limbs.size() || (a.limbs.size() == b.limbs.size() && std::lexicographical_compare(a.limbs.rbegin(), a.limbs.rend(), b.limbs.rbegin(), b.limbs.rend()))))
+		std::swap(x, y);
+	if (add && x->limbs.size() < y->limbs.size())
+		std::swap(x, y);
+	result.limbs.assign(x->limbs.size()+1, 0);
+	std::copy(y->limbs.begin(), y->limbs.end(), result.limbs.begin());
+	uint64_t carry = 0;
+	for (size_t i = 0; i < x->limbs.size(); ++i) {
+		uint64_t limb = x->limbs[i];
+		if (add) {
+			uint64_t sum = limb+result.limbs[i];
+			uint64_t out = sum+carry;
+			carry = (sum < limb) | (out < sum);
+			result.limbs[i] = out;
+		}
+		else {
+			uint64_t difference = limb-result.limbs[i];
+			uint64_t out = difference-carry;
+			carry = (difference > limb) | (out > difference);
+			result.limbs[i] = out;
+		}
+	}
+	result.limbs[x->limbs.size()] = add ? carry : 0;
+	result.negative = x == &a ? a.negative : bNegative;
+	result.normalize();
+	return result;
+}
+
+static NaiveBigInt operator+(const NaiveBigInt &a, const NaiveBigInt &b)
+{
+	return naiveAddSub(a, b, false);
+}
+
+static NaiveBigInt operator-(const NaiveBigInt &a, const NaiveBigInt &b)
+{
+	return naiveAddSub(a, b, true);
+}
+
+static NaiveBigInt operator*(const NaiveBigInt &a, const NaiveBigInt &b)
+{
+	NaiveBigInt result;
+	if (a.limbs.empty() || b.limbs.empty())
+		return result;
+	std::vector<uint64_t, NaiveCountingAllocator<uint64_t>> scratch(mulMpScratch(a.limbs.size(), b.limbs.size()));
+	MpArena arena(scratch.data(), scratch.size());
+	result.limbs.resize(a.limbs.size()+b.limbs.size());
+	mulMp(result.limbs.data(), a.limbs.data(), a.limbs.size(), b.limbs.data(), b.limbs.size(), &arena);
+	result.negative = a.negative != b.negative;
+	result.normalize();
+	return result;
+}
+
+static bool sameValue(const NaiveBigInt &naive, const BigInt &value)
+{
+	return naive.negative == value.isNegative() && naive.limbs.size() == value.size() && memcmp(naive.limbs.data(), value.limbs(), value.size()*sizeof(uint64_t)) == 0;
+}
+
+struct Operands
+{
+	std::vector<BigInt> a, b, c, d, result;
+	std::vector<NaiveBigInt> naiveA, naiveB, naiveC, naiveD, naiveResult;
+
+	// Sizes vary between size/2 and size limbs, signs at random
+	Operands(size_t size):
+		result(COUNT),
+		naiveResult(COUNT)
+	{
+		std::vector<uint64_t> limbs(size+1);
+		uint64_t seed = size*1000;
+		for (auto set: { std::make_pair(&a, &naiveA), std::make_pair(&b, &naiveB), std::make_pair(&c, &naiveC), std::make_pair(&d, &naiveD) }) {
+			for (size_t i = 0; i < COUNT; ++i) {
+				randomLimbs(limbs.data(), size+1, ++seed);
+				size_t length = size-(limbs[size]%(size/2+1));
+				bool negative = (limbs[size]>>32)&1;
+				set.first->emplace_back(limbs.data(), length, negative);
+				set.second->emplace_back(limbs.data(), length, negative);
+			}
+		}
+	}
+
+	void naive()
+	{
+		for (size_t i = 0; i < COUNT; ++i)
+			naiveResult[i] = (naiveA[i]*naiveB[i]+naiveC[i]*naiveD[i])-naiveA[i]*naiveD[i];
+	}
+
+	void operators()
+	{
+		for (size_t i = 0; i < COUNT; ++i)
+			result[i] = (a[i]*b[i]+c[i]*d[i])-a[i]*d[i];
+	}
+
+	// Temporaries from arena, released after each expression
+	void operators(BigIntArena *arena)
+	{
+		BigIntAllocatorScope scope(arena);
+		for (size_t i = 0; i < COUNT; ++i) {
+			result[i] = (a[i]*b[i]+c[i]*d[i])-a[i]*d[i];
+			arena->reset();
+		}
+	}
+
+	void primitives(BigInt *first, BigInt *second)
+	{
+		for (size_t i = 0; i < COUNT; ++i) {
+			mulBigInt(first, a[i], b[i]);
+			mulBigInt(second, c[i], d[i]);
+			addBigInt(first, *first, *second);
+			mulBigInt(second, a[i], d[i]);
+			subBigInt(&result[i], *first, *second);
+		}
+	}
+};
+
+static bool verifyIdentities()
+{
+	std::vector<uint64_t> ones(9, ~(uint64_t)0);
+	for (size_t size: { 1, 2, 3, 4, 5, 8, 9 }) {
+		for (int variant = 0; variant < 4; ++variant) {
+			std::vector<uint64_t> limbs(2*size);
+			randomLimbs(limbs.data(), limbs.size(), size*4+variant);
+			BigInt x = variant == 0 ? BigInt(ones.data(), size) : BigInt(limbs.data(), size, variant&1);
+			BigInt y = variant == 0 ? BigInt(1) : BigInt(limbs.data()+size, size-variant/2, variant&2);
+			BigInt sum = x+y, difference = x-y;
+			if (sum-y != x || difference+y != x || (x-y)+(y-x) != BigInt() || x*y != y*x ||
+					sum*difference != x*x-y*y || -(y-x) != difference || compare(sum, difference) != compare(y, -y)) {
+				fprintf(stderr, "bigint: %zu limbs variant %d: identity mismatch for x=%s y=%s\n", size, variant, x.toHex().c_str(), y.toHex().c_str());
+				return false;
+			}
+			// results written over the operands
+			BigInt z = x;
+			z += z;
+			z -= y;
+			z *= z;
+			BigInt expected = (x+x-y)*(x+x-y);
+			if (z != expected) {
+				fprintf(stderr, "bigint: %zu limbs variant %d: in place mismatch %s expected %s\n", size, variant, z.toHex().c_str(), expected.toHex().c_str());
+				return false;
+			}
+		}
+	}
+	BigInt parsed = BigInt::fromDecimal("-340282366920938463463374607431768211457");
+	if (parsed != -(BigInt(ones.data(), 2)+BigInt(2)) || parsed.toDecimal() != "-340282366920938463463374607431768211457" || BigInt::fromDecimal("-0").toDecimal() != "0") {
+		fprintf(stderr, "bigint: decimal mismatch %s\n", parsed.toDecimal().c_str());
+		return false;
+	}
+	BigInt carried = BigInt(ones.data(), 4)+BigInt(1);
+	if (carried.size() != 5 || carried.isInline() || carried.limbs()[4] != 1) {
+		fprintf(stderr, "bigint: carry out of inline storage: %s\n", carried.toHex().c_str());
+		return false;
+	}
+	return true;
+}
+
+static bool verify(size_t size)
+{
+	Operands operands(size);
+	operands.naive();
+	std::vector<BigInt> expected(COUNT);
+	operands.operators();
+	expected = operands.result;
+	{
+		BigIntArena arena;
+		operands.operators(&arena);
+	}
+	if (operands.result != expected) {
+		fprintf(stderr, "bigint: %zu limbs: arena results differ\n", size);
+		return false;
+	}
+	BigInt first, second;
+	operands.primitives(&first, &second);
+	for (size_t i = 0; i < COUNT; ++i) {
+		if (operands.result[i] != expected[i] || !sameValue(operands.naiveResult[i], expected[i])) {
+			fprintf(stderr, "bigint: %zu limbs expression %zu: mismatch %s expected %s\n", size, i, operands.result[i].toHex().c_str(), expected[i].toHex().c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+struct Measured
+{
+	double ticks;
+	double allocations;
+};
+
+static Measured measure(const std::function<size_t()> &allocations, const std::function<void()> &pass)
+{
+	pass();
+	size_t before = allocations();
+	pass();
+	double counted = (double)(allocations()-before)/COUNT;
+	double ticks = measureTicks([&](long iterations) {
+		for (long i = 0; i < iterations; ++i)
+			pass();
+	})/COUNT;
+	return Measured{ ticks, counted };
+}
+
+static void benchmark(size_t size)
+{
+	Operands operands(size);
+	BigIntArena arena;
+	BigInt first, second;
+	Measured naive = measure([]() { return naiveAllocations; }, [&]() { operands.naive(); });
+	Measured heap = measure(&BigIntAllocator::heapAllocations, [&]() { operands.operators(); });
+	Measured arenaScoped = measure(&BigIntAllocator::heapAllocations, [&]() { operands.operators(&arena); });
+	Measured primitives = measure(&BigIntAllocator::heapAllocations, [&]() { operands.primitives(&first, &second); });
+	printf("%8zu", size);
+	for (const Measured &measured: { naive, heap, arenaScoped, primitives })
+		printf(" %10.1f %6.2f", measured.ticks, measured.allocations);
+	printf(" %9.2fx\n", naive.ticks/arenaScoped.ticks);
+	fflush(stdout);
+}
+
+int runBigInt(int argc, char **argv)
+{
+	std::vector<size_t> sizes;
+	if (!parseSizes(argc, argv, &sizes, { 1, 2, 4, 8, 16, 64, 256 })) {
+		fprintf(stderr, "Usage: bigint [sizes...]\n");
+		return 2;
+	}
+	if (!verifyIdentities())
+		return 1;
+	for (size_t size: { 1, 2, 3, 4, 7, 40 }) {
+		if (!verify(size))
+			return 1;
+	}
+
+	printf("# %s and heap allocations per expression r = (a*b + c*d) - a*d, operands of size/2 to size 64-bit limbs, %zu expressions per pass; inline storage up to %zu limbs; speedup of arena against naive\n", ticksUnit(), COUNT, BigInt::INLINE_LIMBS);
+	printf("%8s %10s %6s %10s %6s %10s %6s %10s %6s %10s\n", "limbs", "naive", "allocs", "heap", "allocs", "arena", "allocs", "primitive", "allocs", "speedup");
+	for (size_t size: sizes)
+		benchmark(size);
+	return 0;
+}
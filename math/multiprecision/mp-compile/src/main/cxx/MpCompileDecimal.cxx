@@ -0,0 +1,214 @@
+/*
+ * Decimal conversion benchmark.
+ *
+ * Verifies the SSE2 digit formatting against the scalar one, and the divide and conquer conversions against the chunk
+ * by chunk ones for random and edge numbers (zero, powers of ten, all nines, leading zeros, random limbs, the split
+ * powers and their neighbours, B^k), including the round trip.  Then reports ticks per digit of both directions for
+ * both algorithms by the number of digits, the quadratic ones only up to NAIVE_MAX_DIGITS, and the formatting kernels
+ * per chunk of 19 digits.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "Mp.hxx"
+#include "MpCompile.hxx"
+
+
+static const size_t NAIVE_MAX_DIGITS = 100000;
+static const size_t FORMAT_CHUNKS = 1024;
+
+static std::string randomDigits(size_t length, uint64_t seed)
+{
+	std::vector<uint64_t> random(length);
+	randomLimbs(random.data(), length, seed);
+	std::string digits(length, '0');
+	for (size_t i = 0; i < length; ++i)
+		digits[i] = '0'+random[i]%10;
+	if (digits[0] == '0')
+		digits[0] = '1';
+	return digits;
+}
+
+static bool verifyFormat()
+{
+	std::vector<uint64_t> chunks(FORMAT_CHUNKS);
+	randomLimbs(chunks.data(), chunks.size(), 19);
+	for (size_t i = 0; i < chunks.size(); ++i)
+		chunks[i] %= 10000000000000000000ULL>>(i%64);
+	const uint64_t edges[] = { 0, 1, 9, 10, 99999999, 100000000, 9999999999999999ULL, 10000000000000000ULL, 9999999999999999999ULL };
+	std::copy(std::begin(edges), std::end(edges), chunks.begin());
+	std::string expected(19*chunks.size(), ' '), result(expected);
+	formatDigitsMp_ref(&expected[0], chunks.data(), chunks.size());
+#ifdef __x86_64__
+	formatDigitsMp_Sse2(&result[0], chunks.data(), chunks.size());
+	if (result != expected) {
+		fprintf(stderr, "formatDigitsMp_Sse2: mismatch\n");
+		return false;
+	}
+#endif
+	return true;
+}
+
+static bool verifyDigits(const std::string &digits)
+{
+	std::vector<uint64_t> expected(decimalLimbsMp(digits.size())), result(expected.size());
+	size_t expectedSize = fromDecimalMp_ref(expected.data(), digits.data(), digits.size());
+	size_t size = fromDecimalMp(result.data(), digits.data(), digits.size());
+	if (size != expectedSize || memcmp(result.data(), expected.data(), size*sizeof(uint64_t)) != 0) {
+		fprintf(stderr, "fromDecimalMp: %zu digits: mismatch\n", digits.size());
+		return false;
+	}
+	size_t skip = digits.find_first_not_of('0');
+	std::string stripped = skip == std::string::npos ? "0" : digits.substr(skip);
+	std::string text(decimalDigitsMp(size), ' ');
+	text.resize(toDecimalMp(&text[0], result.data(), size));
+	if (text != stripped) {
+		fprintf(stderr, "toDecimalMp: %zu digits: round trip mismatch\n", digits.size());
+		return false;
+	}
+	return true;
+}
+
+static bool verifyLimbs(const std::vector<uint64_t> &limbs)
+{
+	size_t size = limbs.size();
+	std::vector<uint64_t> back(decimalLimbsMp(decimalDigitsMp(size)));
+	std::string expected(decimalDigitsMp(size), ' '), text(expected);
+	expected.resize(toDecimalMp_ref(&expected[0], limbs.data(), size));
+	text.resize(toDecimalMp(&text[0], limbs.data(), size));
+	if (text != expected) {
+		fprintf(stderr, "toDecimalMp: %zu limbs: mismatch\n", size);
+		return false;
+	}
+	if (fromDecimalMp(back.data(), text.data(), text.size()) != size || memcmp(back.data(), limbs.data(), size*sizeof(uint64_t)) != 0) {
+		fprintf(stderr, "fromDecimalMp: %zu limbs: round trip mismatch\n", size);
+		return false;
+	}
+	return true;
+}
+
+static bool verify()
+{
+	if (!verifyFormat())
+		return false;
+	for (size_t length: { 1, 2, 18, 19, 20, 37, 38, 39, 100, 607, 608, 609, 620, 1000, 1234, 1300, 2500, 5000, 20000, 50000 }) {
+		std::string nines(length, '9'), power = "1"+std::string(length, '0');
+		std::string leading = std::string(length, '0')+randomDigits(length, length);
+		for (const std::string &digits: { randomDigits(length, length*3), nines, power, leading }) {
+			if (!verifyDigits(digits))
+				return false;
+		}
+	}
+	if (!verifyDigits("0") || !verifyDigits(""))
+		return false;
+	// the split powers 10^(19*2^k), just below and above them
+	for (size_t digits = 19; digits <= 19*2048; digits *= 2) {
+		std::string power = "1"+std::string(digits, '0'), above = power.substr(0, digits)+"1";
+		for (const std::string &value: { std::string(digits, '9'), power, above }) {
+			if (!verifyDigits(value))
+				return false;
+		}
+	}
+	for (size_t size: { 1, 31, 32, 33, 34, 64, 65, 100, 257, 1000, 1136, 3001 }) {
+		std::vector<uint64_t> limbs(size);
+		randomLimbs(limbs.data(), size, size*11);
+		if (!verifyLimbs(limbs))
+			return false;
+	}
+	// B^k, below the power of the same size for some k
+	for (size_t k: { 32, 33, 63, 64, 65, 127, 128, 255, 256, 1000, 1135 }) {
+		std::vector<uint64_t> limbs(k+1);
+		limbs[k] = 1;
+		if (!verifyLimbs(limbs))
+			return false;
+	}
+	try {
+		uint64_t limbs[2];
+		fromDecimalMp(limbs, "12a4", 4);
+		fprintf(stderr, "fromDecimalMp: invalid digit accepted\n");
+		return false;
+	}
+	catch (std::invalid_argument &ex) {
+	}
+	return true;
+}
+
+static void benchmarkFormat()
+{
+	std::vector<uint64_t> chunks(FORMAT_CHUNKS);
+	randomLimbs(chunks.data(), chunks.size(), 7);
+	for (uint64_t &chunk: chunks)
+		chunk %= 10000000000000000000ULL;
+	std::vector<char> out(19*chunks.size());
+	struct { const char *name; void (*format)(char *out, const uint64_t *chunks, size_t count); } kernels[] = {
+		{ "ref", &formatDigitsMp_ref },
+#ifdef __x86_64__
+		{ "sse2", &formatDigitsMp_Sse2 },
+#endif
+	};
+	printf("# formatting, %s per chunk of 19 digits:", ticksUnit());
+	for (const auto &kernel: kernels) {
+		double ticks = measureTicks([&](long iterations) {
+			for (long i = 0; i < iterations; ++i)
+				kernel.format(out.data(), chunks.data(), chunks.size());
+		})/chunks.size();
+		printf(" %s %.2f", kernel.name, ticks);
+	}
+	printf("\n");
+}
+
+static void benchmark(size_t length)
+{
+	std::string digits = randomDigits(length, length);
+	std::vector<uint64_t> limbs(decimalLimbsMp(length));
+	size_t size = fromDecimalMp(limbs.data(), digits.data(), length);
+	std::vector<char> text(decimalDigitsMp(size));
+	bool naive = length <= NAIVE_MAX_DIGITS;
+
+	double to = measureTicks([&](long iterations) {
+		for (long i = 0; i < iterations; ++i)
+			toDecimalMp(text.data(), limbs.data(), size);
+	})/length;
+	double from = measureTicks([&](long iterations) {
+		for (long i = 0; i < iterations; ++i)
+			fromDecimalMp(limbs.data(), digits.data(), length);
+	})/length;
+	double toRef = !naive ? -1 : measureTicks([&](long iterations) {
+		for (long i = 0; i < iterations; ++i)
+			toDecimalMp_ref(text.data(), limbs.data(), size);
+	})/length;
+	double fromRef = !naive ? -1 : measureTicks([&](long iterations) {
+		for (long i = 0; i < iterations; ++i)
+			fromDecimalMp_ref(limbs.data(), digits.data(), length);
+	})/length;
+	if (naive)
+		printf("%9zu %8zu %10.2f %10.2f %8.2fx %10.2f %10.2f %8.2fx\n", length, size, toRef, to, toRef/to, fromRef, from, fromRef/from);
+	else
+		printf("%9zu %8zu %10s %10.2f %9s %10s %10.2f %9s\n", length, size, "-", to, "-", "-", from, "-");
+	fflush(stdout);
+}
+
+int runDecimal(int argc, char **argv)
+{
+	std::vector<size_t> sizes;
+	if (!parseSizes(argc, argv, &sizes, { 1, 10, 100, 1000, 10000, 100000, 1000000 })) {
+		fprintf(stderr, "Usage: decimal [digits...]\n");
+		return 2;
+	}
+	if (!verify())
+		return 1;
+
+	benchmarkFormat();
+	printf("# %s per digit, chunk by chunk (ref, up to %zu digits) and divide and conquer (dc) to decimal and from decimal\n", ticksUnit(), NAIVE_MAX_DIGITS);
+	printf("%9s %8s %10s %10s %9s %10s %10s %9s\n", "digits", "limbs", "to-ref", "to-dc", "speedup", "from-ref", "from-dc", "speedup");
+	for (size_t length: sizes)
+		benchmark(length);
+	return 0;
+}
@@ -0,0 +1,277 @@
+/*
+ * Division benchmark.
+ *
+ * Verifies single limb division by the reciprocal against hardware division for edge divisors, and all the multi
+ * limb divisions (Knuth, Newton, cached reciprocal, modMp and the dispatching divRemMp) by the identity q*d + r == a
+ * with r < d and against each other.  The operands are random and adversarial: all ones over all ones, divisors
+ * B^k-1, B^k and 2^63*B^k, remainders d-1 and 0 of known quotients, numerators as long as the divisor and many times
+ * longer.  Then reports ticks per division of 2n by n limbs for each algorithm by the size and ticks per limb of single
+ * limb division.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "Mp.hxx"
+#include "MpCompile.hxx"
+
+
+// Knuth division is quadratic, benchmarked only up to this
+static const size_t KNUTH_MAX_LIMBS = 30000;
+static const size_t SINGLE_LIMBS = 1024;
+
+static bool verifySingle()
+{
+	const uint64_t divisors[] = { 1, 2, 3, 7, 10, 10000000000000000000ULL, 0xffffffffULL, 0x100000001ULL, 0x7fffffffffffffffULL, 0x8000000000000000ULL, 0x8000000000000001ULL, ~(uint64_t)0 };
+	std::vector<uint64_t> random(8);
+	randomLimbs(random.data(), random.size(), 50);
+	std::vector<uint64_t> all(std::begin(divisors), std::end(divisors));
+	for (uint64_t r: random) {
+		all.push_back(r);
+		all.push_back(r>>(r%64));
+	}
+	for (uint64_t d: all) {
+		MpDivisor1 divisor(d);
+		for (size_t size: { 0, 1, 2, 3, 17 }) {
+			for (int pattern = 0; pattern < 3; ++pattern) {
+				std::vector<uint64_t> a(size);
+				if (pattern == 0)
+					randomLimbs(a.data(), size, d+size);
+				else if (pattern == 1)
+					std::fill(a.begin(), a.end(), ~(uint64_t)0);
+				else if (size != 0)
+					a[size-1] = d-1;
+				std::vector<uint64_t> expected(size), quotient(size), inPlace(a);
+				uint64_t expectedRemainder = divRemMp_1(expected.data(), a.data(), size, d);
+				uint64_t remainder = divRemMp_1Inverse(quotient.data(), a.data(), size, divisor);
+				uint64_t inPlaceRemainder = divRemMp_1Inverse(inPlace.data(), inPlace.data(), size, divisor);
+				if (remainder != expectedRemainder || quotient != expected || inPlaceRemainder != expectedRemainder || inPlace != expected) {
+					fprintf(stderr, "divRemMp_1Inverse: divisor %#llx, %zu limbs, pattern %d: mismatch\n", (unsigned long long)d, size, pattern);
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+// q*d + r == a and r < d
+static bool checkIdentity(const char *name, const uint64_t *a, size_t an, const uint64_t *d, size_t dn, const uint64_t *q, const uint64_t *r)
+{
+	size_t qn = an-dn+1;
+	std::vector<uint64_t> product(qn+dn), scratch(mulMpScratch(qn, dn));
+	MpArena arena(scratch.data(), scratch.size());
+	mulMp(product.data(), q, qn, d, dn, &arena);
+	uint64_t carry = addMp(product.data(), product.data(), r, dn);
+	for (size_t i = dn; carry != 0 && i < qn+dn; ++i)
+		carry = ++product[i] == 0;
+	bool below = false;
+	for (size_t i = dn; i-- > 0; ) {
+		if (r[i] != d[i]) {
+			below = r[i] < d[i];
+			break;
+		}
+	}
+	if (carry != 0 || product[qn+dn-1] != 0 || memcmp(product.data(), a, an*sizeof(uint64_t)) != 0 || !below) {
+		fprintf(stderr, "%s: %zu by %zu limbs: %s\n", name, an, dn, below ? "q*d + r differs from a" : "remainder not below divisor");
+		return false;
+	}
+	return true;
+}
+
+// Pattern 0 random, 1 all ones by all ones, 2 all ones by B^(dn-1), 3 random by 2^63*B^(dn-1), 4 quotient of known q
+// and remainder d-1 with divisor of low limbs all ones, 5 all ones quotient and zero remainder
+static bool verifyDivision(size_t an, size_t dn, int pattern)
+{
+	std::vector<uint64_t> a(an), d(dn), known;
+	randomLimbs(a.data(), an, an*7+dn*3+pattern);
+	randomLimbs(d.data(), dn, an*5+dn*11+pattern);
+	switch (pattern) {
+	case 1:
+		std::fill(a.begin(), a.end(), ~(uint64_t)0);
+		std::fill(d.begin(), d.end(), ~(uint64_t)0);
+		break;
+	case 2:
+		std::fill(a.begin(), a.end(), ~(uint64_t)0);
+		std::fill(d.begin(), d.end(), 0);
+		d[dn-1] = 1;
+		break;
+	case 3:
+		std::fill(d.begin(), d.end(), 0);
+		d[dn-1] = 0x8000000000000000ULL;
+		break;
+	case 4:
+	case 5: {
+		if (pattern == 4) {
+			std::fill(d.begin(), d.end()-1, ~(uint64_t)0);
+			d[dn-1] = 1;
+		}
+		else {
+			d[dn-1] |= 1;
+		}
+		known.assign(an-dn+1, 0);
+		randomLimbs(known.data(), an-dn, an+dn);
+		if (pattern == 5)
+			std::fill(known.begin(), known.end()-1, ~(uint64_t)0);
+		if (an > dn)
+			known[an-dn-1] >>= 1;
+		std::vector<uint64_t> product(an+1), scratch(mulMpScratch(an-dn+1, dn));
+		MpArena arena(scratch.data(), scratch.size());
+		mulMp(product.data(), known.data(), an-dn+1, d.data(), dn, &arena);
+		std::copy(product.begin(), product.begin()+an, a.begin());
+		if (pattern == 4) {
+			uint64_t carry = addMp(a.data(), a.data(), d.data(), dn);
+			for (size_t i = dn; carry != 0 && i < an; ++i)
+				carry = ++a[i] == 0;
+			for (size_t i = 0; a[i]-- == 0; ++i)
+				;
+		}
+		break;
+	}
+	}
+	while (d[dn-1] == 0)
+		d[dn-1] = 1;
+
+	size_t qn = an-dn+1;
+	std::vector<uint64_t> scratch(std::max({ divRemMpKnuthScratch(an, dn), divRemMpNewtonScratch(an, dn), divRemMpReciprocalScratch(an, dn), modMpScratch(an, dn), divRemMpScratch(an, dn) }));
+	MpArena arena(scratch.data(), scratch.size());
+	std::vector<uint64_t> expectedQuotient(qn), expectedRemainder(dn);
+	divRemMp_Knuth(expectedQuotient.data(), expectedRemainder.data(), a.data(), an, d.data(), dn, &arena);
+	if (!checkIdentity("divRemMp_Knuth", a.data(), an, d.data(), dn, expectedQuotient.data(), expectedRemainder.data()))
+		return false;
+	if (!known.empty()) {
+		std::vector<uint64_t> remainder(dn);
+		if (pattern == 4) {
+			remainder = d;
+			for (size_t i = 0; remainder[i]-- == 0; ++i)
+				;
+		}
+		if (expectedQuotient != known || expectedRemainder != remainder) {
+			fprintf(stderr, "divRemMp_Knuth: %zu by %zu limbs, pattern %d: differs from known quotient and remainder\n", an, dn, pattern);
+			return false;
+		}
+	}
+
+	MpDivisor divisor(d.data(), dn);
+	std::vector<uint64_t> quotient(qn), remainder(dn);
+	struct { const char *name; std::function<void()> divide; bool quotient; } divisions[] = {
+		{ "divRemMp_Newton", [&]() { divRemMp_Newton(quotient.data(), remainder.data(), a.data(), an, d.data(), dn, &arena); }, true },
+		{ "divRemMp_Reciprocal", [&]() { divRemMp_Reciprocal(quotient.data(), remainder.data(), a.data(), an, divisor, &arena); }, true },
+		{ "modMp", [&]() { modMp(remainder.data(), a.data(), an, divisor, &arena); }, false },
+		{ "divRemMp", [&]() { divRemMp(quotient.data(), remainder.data(), a.data(), an, d.data(), dn, &arena); }, true },
+	};
+	for (const auto &division: divisions) {
+		std::fill(quotient.begin(), quotient.end(), 0x5a5a5a5a5a5a5a5aULL);
+		std::fill(remainder.begin(), remainder.end(), 0x5a5a5a5a5a5a5a5aULL);
+		division.divide();
+		if ((division.quotient && quotient != expectedQuotient) || remainder != expectedRemainder) {
+			fprintf(stderr, "%s: %zu by %zu limbs, pattern %d: mismatch against Knuth\n", division.name, an, dn, pattern);
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool verify()
+{
+	if (!verifySingle())
+		return false;
+	for (size_t dn: { 1, 2, 3, 4, 31, 32, 33, 64, 200, 599, 600, 601, 1300 }) {
+		for (size_t an: { dn, dn+1, 2*dn-1, 2*dn, 2*dn+1, 3*dn+5, 7*dn }) {
+			for (int pattern = 0; pattern < 6; ++pattern) {
+				if (!verifyDivision(an, dn, pattern))
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+static void benchmarkSingle()
+{
+	std::vector<uint64_t> a(SINGLE_LIMBS), quotient(SINGLE_LIMBS);
+	randomLimbs(a.data(), a.size(), 13);
+	printf("# single limb division, %s per limb of %zu:", ticksUnit(), SINGLE_LIMBS);
+	for (uint64_t d: { 10000000000000000000ULL, 10ULL }) {
+		MpDivisor1 divisor(d);
+		double hardware = measureTicks([&](long iterations) {
+			for (long i = 0; i < iterations; ++i)
+				divRemMp_1(quotient.data(), a.data(), a.size(), d);
+		})/a.size();
+		double inverse = measureTicks([&](long iterations) {
+			for (long i = 0; i < iterations; ++i)
+				divRemMp_1Inverse(quotient.data(), a.data(), a.size(), divisor);
+		})/a.size();
+		printf(" by %llu divq %.2f inverse %.2f;", (unsigned long long)d, hardware, inverse);
+	}
+	printf("\n");
+}
+
+static void printMeasured(double ticks)
+{
+	if (ticks < 0)
+		printf(" %12s", "-");
+	else
+		printf(" %12.0f", ticks);
+}
+
+static void benchmark(size_t size)
+{
+	size_t an = 2*size;
+	std::vector<uint64_t> a(an), d(size), quotient(an-size+1), remainder(size);
+	randomLimbs(a.data(), an, size*3);
+	randomLimbs(d.data(), size, size*5);
+	std::vector<uint64_t> scratch(std::max({ divRemMpKnuthScratch(an, size), divRemMpNewtonScratch(an, size), divRemMpReciprocalScratch(an, size), divRemMpScratch(an, size) }));
+	MpArena arena(scratch.data(), scratch.size());
+	MpDivisor divisor(d.data(), size);
+
+	double knuth = size > KNUTH_MAX_LIMBS ? -1 : measureTicks([&](long iterations) {
+		for (long i = 0; i < iterations; ++i)
+			divRemMp_Knuth(quotient.data(), remainder.data(), a.data(), an, d.data(), size, &arena);
+	});
+	double newton = measureTicks([&](long iterations) {
+		for (long i = 0; i < iterations; ++i)
+			divRemMp_Newton(quotient.data(), remainder.data(), a.data(), an, d.data(), size, &arena);
+	});
+	double cached = measureTicks([&](long iterations) {
+		for (long i = 0; i < iterations; ++i)
+			divRemMp_Reciprocal(quotient.data(), remainder.data(), a.data(), an, divisor, &arena);
+	});
+	double dispatched = measureTicks([&](long iterations) {
+		for (long i = 0; i < iterations; ++i)
+			divRemMp(quotient.data(), remainder.data(), a.data(), an, d.data(), size, &arena);
+	});
+	printf("%8zu", size);
+	for (double ticks: { knuth, newton, cached, dispatched })
+		printMeasured(ticks);
+	printf(" %10.2f", dispatched/an);
+	if (knuth < 0)
+		printf(" %9s\n", "-");
+	else
+		printf(" %8.2fx\n", knuth/cached);
+	fflush(stdout);
+}
+
+int runDiv(int argc, char **argv)
+{
+	std::vector<size_t> sizes;
+	if (!parseSizes(argc, argv, &sizes, { 2, 8, 32, 64, 100, 200, 300, 1000, 3000, 10000, 30000, 100000 })) {
+		fprintf(stderr, "Usage: div [sizes...]\n");
+		return 2;
+	}
+	if (!verify())
+		return 1;
+
+	benchmarkSingle();
+	printf("# %s per division of 2n by n limbs: Knuth (up to %zu limbs), Newton reciprocal per call, cached reciprocal (MpDivisor) and divRemMp dispatch, its ticks per numerator limb, speedup of cached against Knuth\n", ticksUnit(), KNUTH_MAX_LIMBS);
+	printf("%8s %12s %12s %12s %12s %10s %9s\n", "limbs", "knuth", "newton", "cached", "divRemMp", "per-limb", "speedup");
+	for (size_t size: sizes)
+		benchmark(size);
+	return 0;
+}
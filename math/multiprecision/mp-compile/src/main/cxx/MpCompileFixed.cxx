@@ -0,0 +1,255 @@
+/*
+ * Fixed size Montgomery arithmetic benchmark.
+ *
+ * Verifies UInt add, sub and mul against the variable length kernels, the fixed Montgomery multiplication (CIOS, and
+ * full product followed by reduction) against the generic mulMontgomeryMp, exponentiation against the generic
+ * powMontgomeryMp and by Fermat little theorem on the 2^255-19 and P-384 primes.  Then reports ticks per modular
+ * multiplication and per exponentiation with full size exponent, for 256, 384, 2048 and 4096 bits.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "Mp.hxx"
+#include "MpFixed.hxx"
+#include "MpCompile.hxx"
+
+
+// 2^255-19
+static const UInt<256> PRIME_256 = {{ 0xffffffffffffffedULL, 0xffffffffffffffffULL, 0xffffffffffffffffULL, 0x7fffffffffffffffULL }};
+// P-384, 2^384-2^128-2^96+2^32-1
+static const UInt<384> PRIME_384 = {{ 0x00000000ffffffffULL, 0xffffffff00000000ULL, 0xfffffffffffffffeULL, 0xffffffffffffffffULL, 0xffffffffffffffffULL, 0xffffffffffffffffULL }};
+
+template <size_t BITS>
+static UInt<BITS> randomUInt(uint64_t seed)
+{
+	UInt<BITS> value;
+	randomLimbs(value.limb, UInt<BITS>::LIMBS, seed);
+	return value;
+}
+
+// Odd modulus with the top bit set
+template <size_t BITS>
+static UInt<BITS> randomModulus(uint64_t seed)
+{
+	UInt<BITS> modulus = randomUInt<BITS>(seed);
+	modulus.limb[0] |= 1;
+	modulus.limb[UInt<BITS>::LIMBS-1] |= (uint64_t)1<<63;
+	return modulus;
+}
+
+// Random value below the modulus
+template <size_t BITS>
+static UInt<BITS> randomBelow(const UInt<BITS> &modulus, uint64_t seed)
+{
+	UInt<BITS> value = randomUInt<BITS>(seed);
+	value.limb[UInt<BITS>::LIMBS-1] %= modulus.limb[UInt<BITS>::LIMBS-1];
+	return value;
+}
+
+// Generic variable length path over the same modulus
+template <size_t BITS>
+struct Generic
+{
+	static const size_t LIMBS = UInt<BITS>::LIMBS;
+
+	UInt<BITS> modulus;
+	uint64_t n0inv;
+	UInt<BITS> one;
+	std::vector<uint64_t> scratch;
+	MpArena arena;
+
+	Generic(const UInt<BITS> &modulus):
+		modulus(modulus),
+		n0inv(montgomeryInverseMp(modulus.limb[0])),
+		scratch(powMontgomeryMpScratch(LIMBS)),
+		arena(scratch.data(), scratch.size())
+	{
+		montgomeryOneMp(one.limb, modulus.limb, LIMBS);
+	}
+
+	UInt<BITS> mul(const UInt<BITS> &a, const UInt<BITS> &b)
+	{
+		UInt<BITS> result;
+		mulMontgomeryMp(result.limb, a.limb, b.limb, modulus.limb, LIMBS, n0inv, &arena);
+		return result;
+	}
+
+	UInt<BITS> pow(const UInt<BITS> &base, const UInt<BITS> &exponent)
+	{
+		UInt<BITS> result;
+		powMontgomeryMp(result.limb, base.limb, exponent.limb, LIMBS, one.limb, modulus.limb, LIMBS, n0inv, &arena);
+		return result;
+	}
+};
+
+template <size_t BITS>
+static bool equal(const UInt<BITS> &a, const UInt<BITS> &b)
+{
+	return memcmp(a.limb, b.limb, sizeof(a.limb)) == 0;
+}
+
+template <size_t BITS>
+static bool verifyArithmetic(uint64_t seed)
+{
+	const size_t LIMBS = UInt<BITS>::LIMBS;
+	UInt<BITS> a = randomUInt<BITS>(seed), b = randomUInt<BITS>(seed+1), result, expected;
+	if (seed%3 == 0)
+		memset(b.limb, 0xff, sizeof(b.limb));
+	uint64_t carry = addUInt(&result, a, b);
+	if (carry != addMp_ref(expected.limb, a.limb, b.limb, LIMBS) || !equal(result, expected)) {
+		fprintf(stderr, "addUInt<%zu>: mismatch\n", BITS);
+		return false;
+	}
+	uint64_t borrow = subUInt(&result, a, b);
+	if (borrow != subMp_ref(expected.limb, a.limb, b.limb, LIMBS) || !equal(result, expected)) {
+		fprintf(stderr, "subUInt<%zu>: mismatch\n", BITS);
+		return false;
+	}
+	UInt<2*BITS> product, expectedProduct;
+	mulUInt(&product, a, b);
+	mulMp_ref(expectedProduct.limb, a.limb, LIMBS, b.limb, LIMBS);
+	if (!equal(product, expectedProduct)) {
+		fprintf(stderr, "mulUInt<%zu>: mismatch\n", BITS);
+		return false;
+	}
+	return true;
+}
+
+template <size_t BITS>
+static bool verifyMontgomery(const UInt<BITS> &modulus, uint64_t seed)
+{
+	Montgomery<BITS> montgomery(modulus);
+	Generic<BITS> generic(modulus);
+	UInt<BITS> minusOne = modulus;
+	minusOne.limb[0] -= 1;
+	for (int i = 0; i < 20; ++i) {
+		UInt<BITS> a = randomBelow(modulus, seed+2*i), b = randomBelow(modulus, seed+2*i+1);
+		if (i == 0)
+			a = b = minusOne;
+		UInt<BITS> expected = generic.mul(a, b);
+		if (!equal(montgomery.mul(a, b), expected)) {
+			fprintf(stderr, "Montgomery<%zu>::mul: mismatch\n", BITS);
+			return false;
+		}
+		UInt<2*BITS> product;
+		mulUInt(&product, a, b);
+		if (!equal(montgomery.reduce(product), expected)) {
+			fprintf(stderr, "Montgomery<%zu>::reduce: mismatch\n", BITS);
+			return false;
+		}
+		if (!equal(montgomery.fromMontgomery(montgomery.toMontgomery(a)), a)) {
+			fprintf(stderr, "Montgomery<%zu>: conversion does not round trip\n", BITS);
+			return false;
+		}
+	}
+	UInt<BITS> base = montgomery.toMontgomery(randomBelow(modulus, seed+100));
+	UInt<BITS> exponent = randomUInt<BITS>(seed+101);
+	UInt<BITS> expected = generic.pow(base, exponent);
+	if (!equal(montgomery.pow(base, exponent), expected) || !equal(montgomery.template pow<true>(base, exponent), expected)) {
+		fprintf(stderr, "Montgomery<%zu>::pow: mismatch\n", BITS);
+		return false;
+	}
+	return true;
+}
+
+// base^(p-1) = 1 for prime p
+template <size_t BITS>
+static bool verifyFermat(const UInt<BITS> &prime)
+{
+	Montgomery<BITS> montgomery(prime);
+	UInt<BITS> exponent = prime;
+	exponent.limb[0] -= 1;
+	UInt<BITS> one = {{ 1 }};
+	for (uint64_t seed = 1; seed < 4; ++seed) {
+		UInt<BITS> base = montgomery.toMontgomery(randomBelow(prime, seed));
+		if (!equal(montgomery.fromMontgomery(montgomery.pow(base, exponent)), one) || !equal(montgomery.fromMontgomery(montgomery.template pow<true>(base, exponent)), one)) {
+			fprintf(stderr, "Montgomery<%zu>::pow: Fermat test failed\n", BITS);
+			return false;
+		}
+	}
+	return true;
+}
+
+template <size_t BITS>
+static bool verifySize(const UInt<BITS> &modulus)
+{
+	for (uint64_t seed = 0; seed < 6; ++seed) {
+		if (!verifyArithmetic<BITS>(seed))
+			return false;
+	}
+	return verifyMontgomery(modulus, BITS) && verifyMontgomery(randomModulus<BITS>(BITS+1), BITS+2);
+}
+
+template <size_t BITS>
+static void benchmark(const UInt<BITS> &modulus)
+{
+	Montgomery<BITS> montgomery(modulus);
+	Generic<BITS> generic(modulus);
+	UInt<BITS> a = montgomery.toMontgomery(randomBelow(modulus, 1)), b = montgomery.toMontgomery(randomBelow(modulus, 2));
+	UInt<BITS> exponent = randomUInt<BITS>(3);
+	exponent.limb[UInt<BITS>::LIMBS-1] |= (uint64_t)1<<63;
+	// each multiplication depends on the previous, so the latency is measured as in exponentiation
+	double cios = measureTicks([&](long iterations) {
+		UInt<BITS> x = a;
+		for (long i = 0; i < iterations; ++i)
+			x = montgomery.mul(x, b);
+		a = x;
+	});
+	double separate = measureTicks([&](long iterations) {
+		UInt<BITS> x = a;
+		UInt<2*BITS> product;
+		for (long i = 0; i < iterations; ++i) {
+			mulUInt(&product, x, b);
+			x = montgomery.reduce(product);
+		}
+		a = x;
+	});
+	double genericMul = measureTicks([&](long iterations) {
+		UInt<BITS> x = a;
+		for (long i = 0; i < iterations; ++i)
+			x = generic.mul(x, b);
+		a = x;
+	});
+	double pow = measureTicks([&](long iterations) {
+		for (long i = 0; i < iterations; ++i)
+			a = montgomery.pow(a, exponent);
+	});
+	double powConstant = measureTicks([&](long iterations) {
+		for (long i = 0; i < iterations; ++i)
+			a = montgomery.template pow<true>(a, exponent);
+	});
+	double genericPow = measureTicks([&](long iterations) {
+		for (long i = 0; i < iterations; ++i)
+			a = generic.pow(a, exponent);
+	});
+	printf("%6zu %12.1f %12.1f %12.1f %8.2fx %14.0f %14.0f %14.0f %8.2fx\n", BITS, cios, separate, genericMul, genericMul/cios, pow, powConstant, genericPow, genericPow/pow);
+	fflush(stdout);
+}
+
+int runFixed(int argc, char **argv)
+{
+	if (argc != 0) {
+		fprintf(stderr, "Usage: fixed\n");
+		return 2;
+	}
+	UInt<2048> modulus2048 = randomModulus<2048>(2048);
+	UInt<4096> modulus4096 = randomModulus<4096>(4096);
+	if (!verifySize(PRIME_256) || !verifySize(PRIME_384) || !verifySize(modulus2048) || !verifySize(modulus4096))
+		return 1;
+	if (!verifyFermat(PRIME_256) || !verifyFermat(PRIME_384))
+		return 1;
+
+	printf("# %s per modular multiplication and per exponentiation with full size exponent; cios and separate (full product and reduction) are fixed size, generic is variable length over mulMp\n", ticksUnit());
+	printf("%6s %12s %12s %12s %9s %14s %14s %14s %9s\n", "bits", "cios", "separate", "generic", "speedup", "pow", "pow-const", "pow-generic", "speedup");
+	benchmark(PRIME_256);
+	benchmark(PRIME_384);
+	benchmark(modulus2048);
+	benchmark(modulus4096);
+	return 0;
+}
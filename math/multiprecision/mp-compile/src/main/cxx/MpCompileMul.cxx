@@ -0,0 +1,211 @@
+/*
+ * Multiplication engine benchmark and threshold tuning.
+ *
+ * Verifies the engine against the portable schoolbook with low thresholds, so Karatsuba and Toom-3 recurse into each
+ * other on small operands, for balanced, unbalanced and all-ones operands.  With --tune it finds the thresholds on
+ * this host: the smallest size from which one level of the algorithm beats the one below at two sizes in a row.
+ * Then it reports ticks per multiplication of the plain portable schoolbook, the mulx/ADX schoolbook, the engine and
+ * the engine squaring.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "Mp.hxx"
+#include "MpCompile.hxx"
+
+
+static bool verifyMul(size_t an, size_t bn, int variant)
+{
+	std::vector<uint64_t> a(an), b(bn), expected(an+bn), result(an+bn);
+	randomLimbs(a.data(), an, an*31+bn*7+variant);
+	randomLimbs(b.data(), bn, an*17+bn*3+variant);
+	if (variant == 1) {
+		std::fill(a.begin(), a.end(), ~(uint64_t)0);
+		std::fill(b.begin(), b.end(), ~(uint64_t)0);
+	}
+	std::vector<uint64_t> scratch(std::max(mulMpScratch(an, bn), sqrMpScratch(an)));
+	MpArena arena(scratch.data(), scratch.size());
+	mulMp_ref(expected.data(), a.data(), an, b.data(), bn);
+	mulMp(result.data(), a.data(), an, b.data(), bn, &arena);
+	if (result != expected) {
+		fprintf(stderr, "mulMp: %zu x %zu limbs operands %d: mismatch\n", an, bn, variant);
+		return false;
+	}
+	mulMp_Schoolbook(result.data(), a.data(), an, b.data(), bn);
+	if (result != expected) {
+		fprintf(stderr, "mulMp_Schoolbook: %zu x %zu limbs operands %d: mismatch\n", an, bn, variant);
+		return false;
+	}
+	if (an == bn) {
+		std::vector<uint64_t> square(2*an);
+		mulMp_ref(expected.data(), a.data(), an, a.data(), an);
+		sqrMp(square.data(), a.data(), an, &arena);
+		if (square != expected) {
+			fprintf(stderr, "sqrMp: %zu limbs operands %d: mismatch\n", an, variant);
+			return false;
+		}
+		sqrMp_Schoolbook(square.data(), a.data(), an);
+		if (square != expected) {
+			fprintf(stderr, "sqrMp_Schoolbook: %zu limbs operands %d: mismatch\n", an, variant);
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool verify()
+{
+	MpMulThresholds saved = mpMulThresholds;
+	const size_t none = std::numeric_limits<size_t>::max();
+	const MpMulThresholds levels[] = {
+		{ 4, 9, 4, 9, none, none },
+		{ 4, 30, 6, 40, 100, 120 },
+		{ 1000000, 9, 1000000, 9, none, none },
+		{ 1000000, 1000000, 1000000, 1000000, 1, 1 },
+	};
+	bool ok = true;
+	for (const MpMulThresholds &level: levels) {
+		mpMulThresholds = level;
+		for (size_t n = 1; ok && n <= 160; ++n) {
+			for (int variant = 0; ok && variant < 2; ++variant)
+				ok = verifyMul(n, n, variant) && verifyMul(n, n/3+1, variant) && verifyMul(n+n/2+1, n, variant);
+		}
+	}
+	mpMulThresholds = saved;
+	return ok && verifyMul(1000, 1000, 0) && verifyMul(3000, 700, 0) && verifyMul(2000, 2000, 1);
+}
+
+struct Operands {
+	std::vector<uint64_t> a, b, result, scratch;
+
+	Operands(size_t size):
+		a(size),
+		b(size),
+		result(2*size)
+	{
+		randomLimbs(a.data(), size, size);
+		randomLimbs(b.data(), size, size^0x3333);
+	}
+
+	MpArena arena(size_t limbs)
+	{
+		scratch.resize(limbs);
+		return MpArena(scratch.data(), limbs);
+	}
+};
+
+static double timeMul(size_t size)
+{
+	Operands operands(size);
+	MpArena arena = operands.arena(mulMpScratch(size, size));
+	return measureTicks([&](long iterations) {
+		for (long i = 0; i < iterations; ++i)
+			mulMp(operands.result.data(), operands.a.data(), size, operands.b.data(), size, &arena);
+	});
+}
+
+static double timeSqr(size_t size)
+{
+	Operands operands(size);
+	MpArena arena = operands.arena(sqrMpScratch(size));
+	return measureTicks([&](long iterations) {
+		for (long i = 0; i < iterations; ++i)
+			sqrMp(operands.result.data(), operands.a.data(), size, &arena);
+	});
+}
+
+// Smallest size from which the threshold set to the size (the algorithm used at the top level only) beats the
+// threshold disabled, at two sizes in a row
+static size_t tuneThreshold(size_t *threshold, size_t from, size_t to, double (*time)(size_t size))
+{
+	size_t found = 0;
+	for (size_t size = from; size <= to; size += std::max((size_t)1, size/10)) {
+		*threshold = std::numeric_limits<size_t>::max();
+		double below = time(size);
+		*threshold = size;
+		double above = time(size);
+		if (above < below) {
+			if (found != 0) {
+				*threshold = found;
+				return found;
+			}
+			found = size;
+		}
+		else {
+			found = 0;
+		}
+	}
+	*threshold = found != 0 ? found : to;
+	return *threshold;
+}
+
+static void tune()
+{
+	MpMulThresholds &t = mpMulThresholds;
+	t.toom3 = t.sqrToom3 = std::numeric_limits<size_t>::max();
+	tuneThreshold(&t.karatsuba, 4, 400, &timeMul);
+	tuneThreshold(&t.sqrKaratsuba, 4, 400, &timeSqr);
+	tuneThreshold(&t.toom3, std::max((size_t)9, t.karatsuba*3/2), 2000, &timeMul);
+	tuneThreshold(&t.sqrToom3, std::max((size_t)9, t.sqrKaratsuba*3/2), 2000, &timeSqr);
+	printf("# tuned thresholds: --thresholds=%zu,%zu,%zu,%zu\n", t.karatsuba, t.toom3, t.sqrKaratsuba, t.sqrToom3);
+}
+
+static int usage()
+{
+	fprintf(stderr, "Usage: mul [--tune] [--thresholds=karatsuba,toom3,sqrKaratsuba,sqrToom3[,ntt,sqrNtt]] [sizes...]\n");
+	return 2;
+}
+
+int runMul(int argc, char **argv)
+{
+	bool tuning = false;
+	int i;
+	for (i = 0; i < argc && argv[i][0] == '-'; ++i) {
+		MpMulThresholds &t = mpMulThresholds;
+		if (strcmp(argv[i], "--tune") == 0)
+			tuning = true;
+		else if (strncmp(argv[i], "--thresholds=", 13) == 0) {
+			int count = sscanf(argv[i]+13, "%zu,%zu,%zu,%zu,%zu,%zu", &t.karatsuba, &t.toom3, &t.sqrKaratsuba, &t.sqrToom3, &t.ntt, &t.sqrNtt);
+			if (count != 4 && count != 6)
+				return usage();
+		}
+		else
+			return usage();
+	}
+	std::vector<size_t> sizes;
+	if (!parseSizes(argc-i, argv+i, &sizes, { 1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 10000 }))
+		return usage();
+	if (!verify())
+		return 1;
+	if (tuning)
+		tune();
+
+	const MpMulThresholds &t = mpMulThresholds;
+	printf("# %s per multiplication, base case: %s, thresholds karatsuba %zu, toom3 %zu, square karatsuba %zu, square toom3 %zu, ntt %zu, square ntt %zu\n", ticksUnit(), mulMpSelected(), t.karatsuba, t.toom3, t.sqrKaratsuba, t.sqrToom3, t.ntt, t.sqrNtt);
+	printf("%8s %14s %14s %14s %14s %9s %9s\n", "limbs", "ref", "schoolbook", "mul", "sqr", "mul/ref", "sqr/mul");
+	for (size_t size: sizes) {
+		Operands operands(size);
+		double ref = measureTicks([&](long iterations) {
+			for (long i = 0; i < iterations; ++i)
+				mulMp_ref(operands.result.data(), operands.a.data(), size, operands.b.data(), size);
+		});
+		double schoolbook = measureTicks([&](long iterations) {
+			for (long i = 0; i < iterations; ++i)
+				mulMp_Schoolbook(operands.result.data(), operands.a.data(), size, operands.b.data(), size);
+		});
+		double mul = timeMul(size);
+		double sqr = timeSqr(size);
+		printf("%8zu %14.1f %14.1f %14.1f %14.1f %8.2fx %9.2f\n", size, ref, schoolbook, mul, sqr, ref/mul, sqr/mul);
+		fflush(stdout);
+	}
+	return 0;
+}
@@ -0,0 +1,352 @@
+/*
+ * NTT multiplication benchmark and crossover tuning.
+ *
+ * Verifies the transforms of the kernels against each other and the inverse against the forward, over the direct and
+ * four step lengths, then the NTT multiplication and squaring against the engine without NTT for random, all-ones
+ * and unbalanced operands, on single thread and over threads.  With --tune it finds the crossover from Toom-3 to NTT
+ * on this host, the same way as the mul mode.  Then it reports ticks of forward transform per coefficient of the
+ * kernels, and ticks per multiplication of the engine without NTT (up to TOOM_MAX_LIMBS), the NTT multiplication and
+ * squaring.  The huge products are checked modulo 2^61-1, the sizes which would not fit in the memory are skipped.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "Mp.hxx"
+#include "MpCompile.hxx"
+
+
+typedef unsigned __int128 uint128_t;
+
+static const size_t TOOM_MAX_LIMBS = 1000000;
+static const size_t TRANSFORM_MAX_LENGTH = (size_t)1<<21;
+// From this size timed by single run
+static const size_t HUGE_LIMBS = 4000000;
+static const uint64_t CHECK_MODULUS = ((uint64_t)1<<61)-1;
+
+static uint64_t reduceCheck(uint128_t x)
+{
+	x = (x&CHECK_MODULUS)+(x>>61);
+	uint64_t reduced = (uint64_t)((x&CHECK_MODULUS)+(x>>61));
+	return reduced >= CHECK_MODULUS ? reduced-CHECK_MODULUS : reduced;
+}
+
+// x mod 2^61-1, where 2^64 is 8
+static uint64_t checkResidue(const uint64_t *x, size_t size)
+{
+	uint64_t residue = 0;
+	for (size_t i = size; i-- > 0; )
+		residue = reduceCheck((uint128_t)residue*8+x[i]);
+	return residue;
+}
+
+static bool checkProduct(const char *name, const uint64_t *result, const uint64_t *a, size_t an, const uint64_t *b, size_t bn)
+{
+	if (checkResidue(result, an+bn) != reduceCheck((uint128_t)checkResidue(a, an)*checkResidue(b, bn))) {
+		fprintf(stderr, "%s: %zu x %zu limbs: residue mismatch\n", name, an, bn);
+		return false;
+	}
+	return true;
+}
+
+static bool verifyTransform(size_t length, unsigned prime)
+{
+	uint64_t p = nttPrimeMp(prime);
+	std::vector<uint64_t> original(length), x(length), y(length);
+	randomLimbs(original.data(), length, length*3+prime);
+	for (uint64_t &limb: original)
+		limb %= p;
+	x = original;
+	nttForwardMp_ref(x.data(), length, prime);
+#ifdef __x86_64__
+	if (__builtin_cpu_supports("avx512f")) {
+		y = original;
+		nttForwardMp_Avx512(y.data(), length, prime);
+		if (y != x) {
+			fprintf(stderr, "nttForwardMp_Avx512: length %zu prime %u: mismatch\n", length, prime);
+			return false;
+		}
+		nttInverseMp_Avx512(y.data(), length, prime);
+	}
+#endif
+	nttInverseMp_ref(x.data(), length, prime);
+	for (size_t i = 0; i < length; ++i) {
+		uint64_t expected = (uint64_t)((uint128_t)original[i]*length%p);
+		if (x[i] != expected) {
+			fprintf(stderr, "nttInverseMp_ref: length %zu prime %u: mismatch at %zu\n", length, prime, i);
+			return false;
+		}
+	}
+#ifdef __x86_64__
+	if (__builtin_cpu_supports("avx512f") && y != x) {
+		fprintf(stderr, "nttInverseMp_Avx512: length %zu prime %u: mismatch\n", length, prime);
+		return false;
+	}
+#endif
+	return true;
+}
+
+static bool verifyMul(size_t an, size_t bn, int variant)
+{
+	std::vector<uint64_t> a(an), b(bn), expected(an+bn), result(an+bn);
+	randomLimbs(a.data(), an, an*13+bn*5+variant);
+	randomLimbs(b.data(), bn, an*7+bn*11+variant);
+	if (variant == 1) {
+		std::fill(a.begin(), a.end(), ~(uint64_t)0);
+		std::fill(b.begin(), b.end(), ~(uint64_t)0);
+	}
+	MpMulThresholds saved = mpMulThresholds;
+	mpMulThresholds.ntt = mpMulThresholds.sqrNtt = std::numeric_limits<size_t>::max();
+	std::vector<uint64_t> scratch(std::max({ mulMpScratch(an, bn), sqrMpScratch(an), mulMpNttScratch(an, bn) }));
+	MpArena arena(scratch.data(), scratch.size());
+	mulMp(expected.data(), a.data(), an, b.data(), bn, &arena);
+	mpMulThresholds = saved;
+	mulMp_Ntt(result.data(), a.data(), an, b.data(), bn, &arena);
+	if (result != expected) {
+		fprintf(stderr, "mulMp_Ntt: %zu x %zu limbs operands %d: mismatch\n", an, bn, variant);
+		return false;
+	}
+	if (an == bn) {
+		mpMulThresholds.ntt = mpMulThresholds.sqrNtt = std::numeric_limits<size_t>::max();
+		sqrMp(expected.data(), a.data(), an, &arena);
+		mpMulThresholds = saved;
+		sqrMp_Ntt(result.data(), a.data(), an, &arena);
+		if (result != expected) {
+			fprintf(stderr, "sqrMp_Ntt: %zu limbs operands %d: mismatch\n", an, variant);
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool verify()
+{
+	for (size_t length = 1; length <= (size_t)1<<18; length *= 2) {
+		for (unsigned prime = 0; prime < 3; ++prime) {
+			if (!verifyTransform(length, prime))
+				return false;
+		}
+	}
+	unsigned saved = mpNttThreads;
+	bool ok = true;
+	for (unsigned threads: { 1, 3 }) {
+		mpNttThreads = threads;
+		for (size_t size: { 1, 2, 3, 7, 8, 9, 16, 17, 100, 1000, 4097, 20000, 40000 }) {
+			for (int variant = 0; ok && variant < 2; ++variant)
+				ok = verifyMul(size, size, variant) && verifyMul(size, size/3+1, variant) && verifyMul(size+size/2+1, size, variant);
+		}
+		ok = ok && verifyMul(513, 512, 1) && verifyMul(1, 1, 1) && verifyMul(70000, 5, 0);
+	}
+	mpNttThreads = saved;
+	return ok;
+}
+
+struct Operands {
+	std::vector<uint64_t> a, b, result, scratch;
+
+	Operands(size_t size):
+		a(size),
+		b(size),
+		result(2*size)
+	{
+		randomLimbs(a.data(), size, size);
+		randomLimbs(b.data(), size, size^0x5555);
+	}
+
+	MpArena arena(size_t limbs)
+	{
+		scratch.resize(limbs);
+		return MpArena(scratch.data(), limbs);
+	}
+};
+
+// Best of measureTicks, single run for the huge sizes
+static double timeRun(size_t size, const std::function<void()> &run)
+{
+	if (size >= HUGE_LIMBS) {
+		uint64_t start = readTicks();
+		run();
+		return (double)(readTicks()-start);
+	}
+	return measureTicks([&](long iterations) {
+		for (long i = 0; i < iterations; ++i)
+			run();
+	});
+}
+
+static double timeMul(size_t size)
+{
+	Operands operands(size);
+	MpArena arena = operands.arena(mulMpScratch(size, size));
+	return timeRun(size, [&]() {
+		mulMp(operands.result.data(), operands.a.data(), size, operands.b.data(), size, &arena);
+	});
+}
+
+static double timeSqr(size_t size)
+{
+	Operands operands(size);
+	MpArena arena = operands.arena(sqrMpScratch(size));
+	return timeRun(size, [&]() {
+		sqrMp(operands.result.data(), operands.a.data(), size, &arena);
+	});
+}
+
+// Smallest size from which NTT at the top level beats the engine without it, at two sizes in a row
+static size_t tuneThreshold(size_t *threshold, size_t from, size_t to, double (*time)(size_t size))
+{
+	size_t found = 0;
+	for (size_t size = from; size <= to; size += size/10) {
+		*threshold = std::numeric_limits<size_t>::max();
+		double below = time(size);
+		*threshold = size;
+		double above = time(size);
+		if (above < below) {
+			if (found != 0) {
+				*threshold = found;
+				return found;
+			}
+			found = size;
+		}
+		else {
+			found = 0;
+		}
+	}
+	*threshold = found != 0 ? found : to;
+	return *threshold;
+}
+
+static void tune()
+{
+	MpMulThresholds &t = mpMulThresholds;
+	tuneThreshold(&t.ntt, 2000, 200000, &timeMul);
+	tuneThreshold(&t.sqrNtt, 2000, 200000, &timeSqr);
+	printf("# tuned thresholds: ntt %zu, square ntt %zu\n", t.ntt, t.sqrNtt);
+}
+
+static double physicalMemory()
+{
+	return (double)sysconf(_SC_PHYS_PAGES)*sysconf(_SC_PAGESIZE);
+}
+
+// Column of width, "-" for value not measured
+static void printMeasured(int width, const char *format, double value)
+{
+	putchar(' ');
+	if (value < 0)
+		printf("%*s", width, "-");
+	else
+		printf(format, value);
+}
+
+static bool benchmark(size_t size)
+{
+	size_t length = mulMpNttScratch(size, size)/4;
+	bool toom = size <= TOOM_MAX_LIMBS, transform = length <= TRANSFORM_MAX_LENGTH;
+	MpMulThresholds saved = mpMulThresholds;
+	mpMulThresholds.ntt = mpMulThresholds.sqrNtt = std::numeric_limits<size_t>::max();
+	size_t scratch = std::max(mulMpNttScratch(size, size), toom ? mulMpScratch(size, size) : 0);
+	mpMulThresholds = saved;
+	double needed = (double)(4*size+scratch+(transform ? length : 0))*sizeof(uint64_t);
+	if (needed > physicalMemory()) {
+		printf("%10zu %10zu  skipped, needs %.1f GB of %.1f GB memory\n", size, length, needed/1e9, physicalMemory()/1e9);
+		fflush(stdout);
+		return true;
+	}
+
+	double transformRef = -1, transformVector = -1;
+	if (transform) {
+		std::vector<uint64_t> x(length);
+		randomLimbs(x.data(), length, length);
+		for (uint64_t &limb: x)
+			limb >>= 2;
+		transformRef = measureTicks([&](long iterations) {
+			for (long i = 0; i < iterations; ++i)
+				nttForwardMp_ref(x.data(), length, 0);
+		})/length;
+#ifdef __x86_64__
+		if (__builtin_cpu_supports("avx512f")) {
+			transformVector = measureTicks([&](long iterations) {
+				for (long i = 0; i < iterations; ++i)
+					nttForwardMp_Avx512(x.data(), length, 0);
+			})/length;
+		}
+#endif
+	}
+
+	Operands operands(size);
+	MpArena arena = operands.arena(scratch);
+	double engine = -1;
+	if (toom) {
+		mpMulThresholds.ntt = mpMulThresholds.sqrNtt = std::numeric_limits<size_t>::max();
+		engine = timeRun(size, [&]() {
+			mulMp(operands.result.data(), operands.a.data(), size, operands.b.data(), size, &arena);
+		});
+		mpMulThresholds = saved;
+	}
+	double ntt = timeRun(size, [&]() {
+		mulMp_Ntt(operands.result.data(), operands.a.data(), size, operands.b.data(), size, &arena);
+	});
+	if (!checkProduct("mulMp_Ntt", operands.result.data(), operands.a.data(), size, operands.b.data(), size))
+		return false;
+	double sqr = timeRun(size, [&]() {
+		sqrMp_Ntt(operands.result.data(), operands.a.data(), size, &arena);
+	});
+	if (!checkProduct("sqrMp_Ntt", operands.result.data(), operands.a.data(), size, operands.a.data(), size))
+		return false;
+
+	printf("%10zu %10zu", size, length);
+	printMeasured(10, "%10.2f", transformRef);
+	printMeasured(10, "%10.2f", transformVector);
+	printMeasured(16, "%16.0f", engine);
+	printf(" %16.0f %16.0f", ntt, sqr);
+	if (toom)
+		printf(" %8.2fx\n", engine/ntt);
+	else
+		printf(" %9s\n", "-");
+	fflush(stdout);
+	return true;
+}
+
+static int usage()
+{
+	fprintf(stderr, "Usage: ntt [--tune] [--threads=n] [sizes...]\n");
+	return 2;
+}
+
+int runNtt(int argc, char **argv)
+{
+	bool tuning = false;
+	int i;
+	for (i = 0; i < argc && argv[i][0] == '-'; ++i) {
+		if (strcmp(argv[i], "--tune") == 0)
+			tuning = true;
+		else if (strncmp(argv[i], "--threads=", 10) != 0 || sscanf(argv[i]+10, "%u", &mpNttThreads) != 1)
+			return usage();
+	}
+	std::vector<size_t> sizes;
+	if (!parseSizes(argc-i, argv+i, &sizes, { 1000, 3000, 10000, 30000, 100000, 300000, 1000000, 3000000, 10000000, 30000000, 100000000 }))
+		return usage();
+	if (!verify())
+		return 1;
+	if (tuning)
+		tune();
+
+	const MpMulThresholds &t = mpMulThresholds;
+	printf("# kernel %s, %u threads, thresholds ntt %zu, square ntt %zu; forward transform %s per coefficient (up to length %zu), %s per multiplication of engine without NTT (up to %zu limbs), NTT multiplication and squaring\n",
+		nttMpSelected(), mpNttThreads, t.ntt, t.sqrNtt, ticksUnit(), TRANSFORM_MAX_LENGTH, ticksUnit(), TOOM_MAX_LIMBS);
+	printf("%10s %10s %10s %10s %16s %16s %16s %9s\n", "limbs", "length", "fwd-ref", "fwd-avx512", "toom3", "ntt", "ntt-sqr", "speedup");
+	for (size_t size: sizes) {
+		if (!benchmark(size))
+			return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,198 @@
+/*
+ * Parallel addition benchmark.
+ *
+ * Verifies addMpParallel and subMpParallel against the portable kernels for random operands and for carry (borrow)
+ * runs crossing the segments, up to the whole number.  Then reports ticks per limb of the single thread addMp and
+ * of the parallel addition over the thread counts and sizes, and finds the crossover, the smallest size from which the
+ * parallel addition with the most threads beats single thread at two sizes in a row, set as mpParallelThreshold.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include "Mp.hxx"
+#include "MpCompile.hxx"
+
+
+static const size_t CROSSOVER_MIN = 1024;
+static const size_t CROSSOVER_MAX = 1<<24;
+
+static bool verifyCase(size_t size, unsigned threads, int variant)
+{
+	std::vector<uint64_t> a(size), b(size), expected(size), result(size);
+	randomLimbs(a.data(), size, size+variant);
+	randomLimbs(b.data(), size, size*7+variant);
+	switch (variant) {
+	case 1:
+		// all ones plus one, the carry ripples through all segments
+		std::fill(a.begin(), a.end(), ~(uint64_t)0);
+		std::fill(b.begin(), b.end(), 0);
+		b[0] = 1;
+		break;
+	case 2:
+		// run of all ones sums over the middle third, carry coming into it
+		for (size_t i = size/3; i < 2*size/3; ++i)
+			a[i] = ~b[i];
+		a[size/3-1] = ~(uint64_t)0;
+		b[size/3-1] = 1;
+		break;
+	}
+	uint64_t carry = addMp_ref(expected.data(), a.data(), b.data(), size);
+	if (addMpParallel(result.data(), a.data(), b.data(), size, threads) != carry || result != expected) {
+		fprintf(stderr, "addMpParallel: %zu limbs %u threads operands %d: mismatch\n", size, threads, variant);
+		return false;
+	}
+	// zero minus one borrows through everything, run of zero differences over the middle third with borrow coming into it
+	if (variant == 1) {
+		std::fill(a.begin(), a.end(), 0);
+	}
+	else if (variant == 2) {
+		std::copy(b.begin()+size/3, b.begin()+2*size/3, a.begin()+size/3);
+		a[size/3-1] = 0;
+		b[size/3-1] = 1;
+	}
+	uint64_t borrow = subMp_ref(expected.data(), a.data(), b.data(), size);
+	if (subMpParallel(result.data(), a.data(), b.data(), size, threads) != borrow || result != expected) {
+		fprintf(stderr, "subMpParallel: %zu limbs %u threads operands %d: mismatch\n", size, threads, variant);
+		return false;
+	}
+	return true;
+}
+
+static bool verify()
+{
+	size_t saved = mpParallelThreshold;
+	mpParallelThreshold = 0;
+	bool ok = true;
+	for (size_t size: { 100, 1000, 4099, 100000 }) {
+		for (unsigned threads: { 2, 3, 4, 7 }) {
+			for (int variant = 0; ok && variant < 3; ++variant)
+				ok = verifyCase(size, threads, variant);
+		}
+	}
+	mpParallelThreshold = saved;
+	return ok;
+}
+
+struct Operands {
+	std::vector<uint64_t> a, b, result;
+
+	Operands(size_t size):
+		a(size),
+		b(size),
+		result(size)
+	{
+		randomLimbs(a.data(), size, size);
+		randomLimbs(b.data(), size, size^0x7777);
+	}
+};
+
+static double timeSingle(Operands &operands)
+{
+	size_t size = operands.a.size();
+	return measureTicks([&](long iterations) {
+		for (long i = 0; i < iterations; ++i)
+			addMp(operands.result.data(), operands.a.data(), operands.b.data(), size);
+	})/size;
+}
+
+// Parallel regardless of the threshold
+static double timeParallel(Operands &operands, unsigned threads)
+{
+	size_t size = operands.a.size();
+	size_t saved = mpParallelThreshold;
+	mpParallelThreshold = 0;
+	double ticks = measureTicks([&](long iterations) {
+		for (long i = 0; i < iterations; ++i)
+			addMpParallel(operands.result.data(), operands.a.data(), operands.b.data(), size, threads);
+	})/size;
+	mpParallelThreshold = saved;
+	return ticks;
+}
+
+static size_t findCrossover(unsigned threads)
+{
+	size_t found = 0;
+	for (size_t size = CROSSOVER_MIN; size <= CROSSOVER_MAX; size *= 2) {
+		Operands operands(size);
+		if (timeParallel(operands, threads) < timeSingle(operands)) {
+			if (found != 0)
+				return found;
+			found = size;
+		}
+		else {
+			found = 0;
+		}
+	}
+	return std::numeric_limits<size_t>::max();
+}
+
+static int usage()
+{
+	fprintf(stderr, "Usage: parallel [--threads=n,n,...] [sizes...]\n");
+	return 2;
+}
+
+int runParallel(int argc, char **argv)
+{
+	unsigned cpus = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<unsigned> threadCounts;
+	int i = 0;
+	if (argc > 0 && strncmp(argv[0], "--threads=", 10) == 0) {
+		for (const char *p = argv[0]+10; *p != '\0'; ) {
+			char *end;
+			unsigned long count = strtoul(p, &end, 10);
+			if (end == p || count == 0 || (*end != ',' && *end != '\0'))
+				return usage();
+			threadCounts.push_back((unsigned)count);
+			p = *end == ',' ? end+1 : end;
+		}
+		i = 1;
+	}
+	else {
+		for (unsigned count = 1; count < cpus; count *= 2)
+			threadCounts.push_back(count);
+		threadCounts.push_back(cpus);
+	}
+	std::vector<size_t> sizes;
+	if (!parseSizes(argc-i, argv+i, &sizes, { 1000, 10000, 100000, 1000000, 10000000 }))
+		return usage();
+	if (!verify())
+		return 1;
+
+	printf("# %s per limb, %u CPUs, single thread kernel %s; speedup against single thread\n", ticksUnit(), cpus, addMpSelected());
+	printf("%10s %10s", "limbs", "single");
+	for (unsigned threads: threadCounts)
+		printf(" %8u-thr %8s", threads, "speedup");
+	printf("\n");
+	for (size_t size: sizes) {
+		Operands operands(size);
+		double single = timeSingle(operands);
+		printf("%10zu %10.3f", size, single);
+		for (unsigned threads: threadCounts) {
+			double parallel = timeParallel(operands, threads);
+			printf(" %12.3f %7.2fx", parallel, single/parallel);
+		}
+		printf("\n");
+		fflush(stdout);
+	}
+
+	unsigned most = *std::max_element(threadCounts.begin(), threadCounts.end());
+	if (most > 1) {
+		size_t crossover = findCrossover(most);
+		mpParallelThreshold = crossover;
+		if (crossover == std::numeric_limits<size_t>::max())
+			printf("# crossover with %u threads: none up to %zu limbs, mpParallelThreshold set to keep single thread\n", most, CROSSOVER_MAX);
+		else
+			printf("# crossover with %u threads: %zu limbs, set as mpParallelThreshold\n", most, crossover);
+	}
+	return 0;
+}
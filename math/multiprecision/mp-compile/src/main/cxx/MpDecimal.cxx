@@ -0,0 +1,353 @@
+/*
+ * Decimal conversion of multiprecision numbers by divide and conquer over powers 10^(19*2^k).
+ *
+ * To decimal: the number is divided by the power of about half its size, quotient and remainder converted
+ * recursively, the remainder zero padded to the digits of the power.  The division is Barrett by the reciprocal cached
+ * with the power, so a level costs few multiplications of its size.  From decimal: the digits split at the power, both
+ * parts parsed recursively and combined by one multiplication.  Small numbers go chunk by chunk of 19 digits, divided
+ * off by the reciprocal of 10^19, the chunks formatted by SSE2 sixteen digits at once.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+#include "Mp.hxx"
+
+
+static const uint64_t CHUNK = 10000000000000000000ULL;
+static const size_t CHUNK_DIGITS = 19;
+
+// Numbers up to this size are converted chunk by chunk, quadratic but without the multiplications
+static const size_t DECIMAL_BASE_LIMBS = 32;
+
+// 10^(19*2^k) with its normalized copy and reciprocal for Barrett division
+struct DecimalPower
+{
+	std::vector<uint64_t> limbs;
+	MpDivisor divisor;
+
+	DecimalPower(std::vector<uint64_t> &&limbs):
+		limbs(std::move(limbs)),
+		divisor(this->limbs.data(), this->limbs.size())
+	{
+	}
+};
+
+// Computed on first use by squaring the previous one, kept for the whole run
+static const DecimalPower &decimalPower(unsigned level)
+{
+	static std::mutex mutex;
+	static std::deque<DecimalPower> powers;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	while (powers.size() <= level) {
+		std::vector<uint64_t> limbs;
+		if (powers.empty()) {
+			limbs.push_back(CHUNK);
+		}
+		else {
+			const std::vector<uint64_t> &previous = powers.back().limbs;
+			size_t size = previous.size();
+			limbs.resize(2*size);
+			std::vector<uint64_t> scratch(sqrMpScratch(size));
+			MpArena arena(scratch.data(), scratch.size());
+			sqrMp(limbs.data(), previous.data(), size, &arena);
+			if (limbs.back() == 0)
+				limbs.pop_back();
+		}
+		powers.emplace_back(std::move(limbs));
+	}
+	return powers[level];
+}
+
+static size_t normalizedSize(const uint64_t *a, size_t size)
+{
+	while (size > 0 && a[size-1] == 0)
+		--size;
+	return size;
+}
+
+void formatDigitsMp_ref(char *out, const uint64_t *chunks, size_t count)
+{
+	for (size_t i = 0; i < count; ++i) {
+		uint64_t chunk = chunks[i];
+		for (size_t j = CHUNK_DIGITS; j-- > 0; ) {
+			out[j] = '0'+chunk%10;
+			chunk /= 10;
+		}
+		out += CHUNK_DIGITS;
+	}
+}
+
+#ifdef __x86_64__
+
+// Digits of x below 10^8 in 16-bit lanes, most significant first.  x/10^4 and x%10^4 by multiplication, then each
+// copied to four lanes and divided by 1000, 100, 10 and 1 by 16-bit high multiplications, the digit is the lane minus
+// ten times the lane before.  The four times scaled inputs keep precision of the reciprocals.
+static inline __m128i digits8(uint32_t x)
+{
+	const __m128i divide10000 = _mm_set1_epi32((int)0xd1b71759);
+	const __m128i powers = _mm_setr_epi16(8389, 5243, 13108, -32768, 8389, 5243, 13108, -32768);
+	const __m128i shifts = _mm_setr_epi16(1<<7, 1<<11, 1<<13, -32768, 1<<7, 1<<11, 1<<13, -32768);
+	__m128i value = _mm_cvtsi32_si128(x);
+	__m128i high = _mm_srli_epi64(_mm_mul_epu32(value, divide10000), 45);
+	__m128i low = _mm_sub_epi32(value, _mm_mul_epu32(high, _mm_set1_epi32(10000)));
+	__m128i pair = _mm_slli_epi64(_mm_unpacklo_epi16(high, low), 2);
+	__m128i spread = _mm_unpacklo_epi16(pair, pair);
+	spread = _mm_unpacklo_epi32(spread, spread);
+	__m128i prefixes = _mm_mulhi_epu16(_mm_mulhi_epu16(spread, powers), shifts);
+	__m128i tens = _mm_slli_epi64(_mm_mullo_epi16(prefixes, _mm_set1_epi16(10)), 16);
+	return _mm_sub_epi16(prefixes, tens);
+}
+
+// Top three digits scalar, the remaining sixteen as two vectors of eight packed to bytes
+void formatDigitsMp_Sse2(char *out, const uint64_t *chunks, size_t count)
+{
+	for (size_t i = 0; i < count; ++i) {
+		uint64_t chunk = chunks[i];
+		uint32_t top = (uint32_t)(chunk/10000000000000000ULL);
+		uint64_t rest = chunk%10000000000000000ULL;
+		out[0] = '0'+top/100;
+		out[1] = '0'+top/10%10;
+		out[2] = '0'+top%10;
+		__m128i digits = _mm_packus_epi16(digits8((uint32_t)(rest/100000000)), digits8((uint32_t)(rest%100000000)));
+		_mm_storeu_si128((__m128i *)(out+3), _mm_add_epi8(digits, _mm_set1_epi8('0')));
+		out += CHUNK_DIGITS;
+	}
+}
+
+#endif
+
+void formatDigitsMp(char *out, const uint64_t *chunks, size_t count)
+{
+#ifdef __x86_64__
+	formatDigitsMp_Sse2(out, chunks, count);
+#else
+	formatDigitsMp_ref(out, chunks, count);
+#endif
+}
+
+// Base case: chunks by repeated division by 10^19 through its reciprocal, padded to width digits, or without leading
+// zeros if width is 0
+static size_t writeDecimalBase(char *out, const uint64_t *a, size_t size, size_t width)
+{
+	static const MpDivisor1 chunkDivisor(CHUNK);
+	uint64_t number[DECIMAL_BASE_LIMBS];
+	uint64_t chunks[DECIMAL_BASE_LIMBS*64/63+2];
+	memcpy(number, a, size*sizeof(uint64_t));
+	size_t count = 0;
+	while (size > 0) {
+		chunks[DECIMAL_BASE_LIMBS*64/63+1-count] = divRemMp_1Inverse(number, number, size, chunkDivisor);
+		++count;
+		size = normalizedSize(number, size);
+	}
+	const uint64_t *first = chunks+DECIMAL_BASE_LIMBS*64/63+2-count;
+	if (width != 0) {
+		size_t padding = width-count*CHUNK_DIGITS;
+		memset(out, '0', padding);
+		formatDigitsMp(out+padding, first, count);
+		return width;
+	}
+	if (count == 0) {
+		out[0] = '0';
+		return 1;
+	}
+	char leading[CHUNK_DIGITS];
+	formatDigitsMp_ref(leading, first, 1);
+	size_t skip = 0;
+	while (leading[skip] == '0')
+		++skip;
+	memcpy(out, leading+skip, CHUNK_DIGITS-skip);
+	formatDigitsMp(out+CHUNK_DIGITS-skip, first+1, count-1);
+	return count*CHUNK_DIGITS-skip;
+}
+
+// Compares a and b of normalized sizes
+static int compare(const uint64_t *a, size_t an, const uint64_t *b, size_t bn)
+{
+	if (an != bn)
+		return an < bn ? -1 : 1;
+	for (size_t i = an; i-- > 0; ) {
+		if (a[i] != b[i])
+			return a[i] < b[i] ? -1 : 1;
+	}
+	return 0;
+}
+
+// Padded to width digits (19*2^(k+1), the value below 10^width) or without leading zeros if width is 0.  Split by
+// 10^(19*2^k) into quotient and remainder of half the digits each, in padded case.  Without padding the power of
+// about half the size is taken, the number below B^(2n-1) of its n limbs, so the division is single Barrett step.
+// If the number is below that power (same size as it), the power of the level below splits it, zero quotient would
+// repeat the same call.
+static size_t writeDecimal(char *out, const uint64_t *a, size_t size, size_t width)
+{
+	size = normalizedSize(a, size);
+	if (size <= DECIMAL_BASE_LIMBS)
+		return writeDecimalBase(out, a, size, width);
+	unsigned level = 0;
+	if (width != 0) {
+		while (CHUNK_DIGITS<<(level+1) < width)
+			++level;
+	}
+	else {
+		while (2*decimalPower(level).limbs.size() < size+1)
+			++level;
+		while (level > 0 && compare(a, size, decimalPower(level).limbs.data(), decimalPower(level).limbs.size()) < 0)
+			--level;
+	}
+	const DecimalPower &power = decimalPower(level);
+	size_t n = power.limbs.size();
+	if (size < n) {
+		size_t written = writeDecimal(out, a, 0, width/2);
+		return written+writeDecimal(out+written, a, size, CHUNK_DIGITS<<level);
+	}
+	std::vector<uint64_t> quotient(size-n+1), remainder(n);
+	std::vector<uint64_t> scratch(divRemMpReciprocalScratch(size, n));
+	MpArena arena(scratch.data(), scratch.size());
+	divRemMp_Reciprocal(quotient.data(), remainder.data(), a, size, power.divisor, &arena);
+	size_t written = writeDecimal(out, quotient.data(), quotient.size(), width/2);
+	return written+writeDecimal(out+written, remainder.data(), n, CHUNK_DIGITS<<level);
+}
+
+size_t toDecimalMp(char *out, const uint64_t *a, size_t size)
+{
+	return writeDecimal(out, a, size, 0);
+}
+
+size_t toDecimalMp_ref(char *out, const uint64_t *a, size_t size)
+{
+	size = normalizedSize(a, size);
+	if (size == 0) {
+		out[0] = '0';
+		return 1;
+	}
+	std::vector<uint64_t> number(a, a+size);
+	std::vector<uint64_t> chunks;
+	while (size > 0) {
+		chunks.push_back(divRemMp_1(number.data(), number.data(), size, CHUNK));
+		size = normalizedSize(number.data(), size);
+	}
+	std::reverse(chunks.begin(), chunks.end());
+	char leading[CHUNK_DIGITS];
+	formatDigitsMp_ref(leading, chunks.data(), 1);
+	size_t skip = 0;
+	while (leading[skip] == '0')
+		++skip;
+	memcpy(out, leading+skip, CHUNK_DIGITS-skip);
+	formatDigitsMp_ref(out+CHUNK_DIGITS-skip, chunks.data()+1, chunks.size()-1);
+	return chunks.size()*CHUNK_DIGITS-skip;
+}
+
+size_t decimalDigitsMp(size_t size)
+{
+	return size*20+1;
+}
+
+size_t decimalLimbsMp(size_t digits)
+{
+	return digits/CHUNK_DIGITS+1;
+}
+
+// Eight digits at once: pairs, quadruples and the whole by multiply and shift within the word
+static inline uint64_t parseDigits8(const char *digits)
+{
+	uint64_t value;
+	memcpy(&value, digits, 8);
+	value -= 0x3030303030303030ULL;
+	value = (value*10+(value>>8))&0x00ff00ff00ff00ffULL;
+	value = (value*100+(value>>16))&0x0000ffff0000ffffULL;
+	return (value*10000+(value>>32))&0xffffffffULL;
+}
+
+static uint64_t parseDigits(const char *digits, size_t length)
+{
+	uint64_t value = 0;
+	for (; length >= 8; digits += 8, length -= 8)
+		value = value*100000000+parseDigits8(digits);
+	for (; length > 0; ++digits, --length)
+		value = value*10+(*digits-'0');
+	return value;
+}
+
+// Base case: chunk by chunk of 19 digits, the first one shorter, accumulated by multiplication by 10^19
+static size_t readDecimalBase(uint64_t *result, const char *digits, size_t length)
+{
+	size_t first = (length+CHUNK_DIGITS-1)%CHUNK_DIGITS+1;
+	result[0] = parseDigits(digits, first);
+	size_t size = 1;
+	for (size_t i = first; i < length; i += CHUNK_DIGITS) {
+		uint64_t carry = mulMp_1(result, result, size, CHUNK);
+		uint64_t chunk = parseDigits(digits+i, CHUNK_DIGITS);
+		for (size_t j = 0; chunk != 0 && j < size; ++j) {
+			result[j] += chunk;
+			chunk = result[j] < chunk;
+		}
+		result[size++] = carry+chunk;
+	}
+	return normalizedSize(result, size);
+}
+
+// High digits times 10^(19*2^k) plus the low 19*2^k digits, the largest such power below the length
+static size_t readDecimal(uint64_t *result, const char *digits, size_t length)
+{
+	if (length <= DECIMAL_BASE_LIMBS*CHUNK_DIGITS)
+		return readDecimalBase(result, digits, length);
+	unsigned level = 0;
+	while (CHUNK_DIGITS<<(level+1) < length)
+		++level;
+	size_t lowDigits = CHUNK_DIGITS<<level, highDigits = length-lowDigits;
+	const DecimalPower &power = decimalPower(level);
+	size_t n = power.limbs.size();
+	std::vector<uint64_t> high(decimalLimbsMp(highDigits)), low(decimalLimbsMp(lowDigits));
+	size_t hn = readDecimal(high.data(), digits, highDigits);
+	size_t ln = readDecimal(low.data(), digits+highDigits, lowDigits);
+	size_t size = decimalLimbsMp(length);
+	memset(result, 0, size*sizeof(uint64_t));
+	if (hn != 0) {
+		std::vector<uint64_t> product(hn+n);
+		std::vector<uint64_t> scratch(mulMpScratch(hn, n));
+		MpArena arena(scratch.data(), scratch.size());
+		mulMp(product.data(), high.data(), hn, power.limbs.data(), n, &arena);
+		memcpy(result, product.data(), std::min(hn+n, size)*sizeof(uint64_t));
+	}
+	uint64_t carry = ln == 0 ? 0 : addMp(result, result, low.data(), ln);
+	for (size_t i = ln; carry != 0 && i < size; ++i)
+		carry = ++result[i] == 0;
+	return normalizedSize(result, size);
+}
+
+static void checkDigits(const char *digits, size_t length)
+{
+	for (size_t i = 0; i < length; ++i) {
+		if ((unsigned char)(digits[i]-'0') > 9)
+			throw std::invalid_argument("Invalid decimal digit");
+	}
+}
+
+size_t fromDecimalMp(uint64_t *result, const char *digits, size_t length)
+{
+	checkDigits(digits, length);
+	if (length == 0)
+		return 0;
+	return readDecimal(result, digits, length);
+}
+
+size_t fromDecimalMp_ref(uint64_t *result, const char *digits, size_t length)
+{
+	checkDigits(digits, length);
+	if (length == 0)
+		return 0;
+	return readDecimalBase(result, digits, length);
+}
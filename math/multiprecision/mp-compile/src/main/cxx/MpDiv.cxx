@@ -0,0 +1,400 @@
+/*
+ * Multiprecision division over 64-bit limbs: single limb, Knuth algorithm D, Newton reciprocal and Barrett division.
+ *
+ * Single limb divisors go by the precomputed reciprocal of Moller and Granlund, two multiplications per limb instead of
+ * hardware division, Knuth D estimates its quotient limbs by the same.  Large divisors get their reciprocal by Newton
+ * iteration and the numerator is reduced from the top in blocks of the divisor size, each one Barrett step.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "Mp.hxx"
+
+
+typedef unsigned __int128 uint128_t;
+
+// Below this the reciprocal is computed by Knuth division, above by Newton iteration from reciprocal of the upper half
+static const size_t RECIPROCAL_NEWTON_MIN = 32;
+
+// Divisor and quotient sizes from which divRemMp goes by Newton reciprocal and Barrett instead of Knuth, Knuth is
+// still faster at 500 limbs
+static const size_t DIV_NEWTON_MIN = 600;
+
+static const uint64_t ONE[1] = { 1 };
+
+// (hi:lo)/d, hi below d
+static inline uint64_t divWide(uint64_t hi, uint64_t lo, uint64_t d, uint64_t *remainder)
+{
+#ifdef __x86_64__
+	uint64_t quotient;
+	__asm__("divq %[d]" : "=a"(quotient), "=d"(*remainder) : "a"(lo), "d"(hi), [d] "rm"(d) : "cc");
+	return quotient;
+#else
+	uint128_t numerator = ((uint128_t)hi<<64)|lo;
+	*remainder = (uint64_t)(numerator%d);
+	return (uint64_t)(numerator/d);
+#endif
+}
+
+// (hi:lo)/d, hi below d, d normalized with its reciprocal floor((B^2-1)/d)-B.  The quotient estimate from
+// inverse*hi+(hi+1:lo) is at most one off after the first correction.
+static inline uint64_t divPreinverted(uint64_t hi, uint64_t lo, uint64_t d, uint64_t inverse, uint64_t *remainder)
+{
+	uint128_t estimate = (uint128_t)inverse*hi+(((uint128_t)(hi+1)<<64)|lo);
+	uint64_t quotient = (uint64_t)(estimate>>64);
+	uint64_t rest = lo-quotient*d;
+	if (rest > (uint64_t)estimate) {
+		--quotient;
+		rest += d;
+	}
+	if (__builtin_expect(rest >= d, 0)) {
+		++quotient;
+		rest -= d;
+	}
+	*remainder = rest;
+	return quotient;
+}
+
+static inline uint64_t reciprocal_1(uint64_t d)
+{
+	uint64_t remainder;
+	return divWide(~d, ~(uint64_t)0, d, &remainder);
+}
+
+// result -= a*b, returns the borrow limb
+static uint64_t subMulMp_1(uint64_t *result, const uint64_t *a, size_t size, uint64_t b)
+{
+	uint64_t carry = 0;
+	for (size_t i = 0; i < size; ++i) {
+		uint128_t product = (uint128_t)a[i]*b+carry;
+		uint64_t low = (uint64_t)product, limb = result[i];
+		carry = (uint64_t)(product>>64)+(limb < low);
+		result[i] = limb-low;
+	}
+	return carry;
+}
+
+// Shift by 0 to 63 bits, result may be a, returns the bits shifted out
+static uint64_t shiftLeft(uint64_t *result, const uint64_t *a, size_t size, unsigned shift)
+{
+	if (shift == 0) {
+		memmove(result, a, size*sizeof(uint64_t));
+		return 0;
+	}
+	uint64_t out = a[size-1]>>(64-shift);
+	for (size_t i = size-1; i > 0; --i)
+		result[i] = (a[i]<<shift)|(a[i-1]>>(64-shift));
+	result[0] = a[0]<<shift;
+	return out;
+}
+
+static void shiftRight(uint64_t *result, const uint64_t *a, size_t size, unsigned shift)
+{
+	if (shift == 0) {
+		memmove(result, a, size*sizeof(uint64_t));
+		return;
+	}
+	for (size_t i = 0; i+1 < size; ++i)
+		result[i] = (a[i]>>shift)|(a[i+1]<<(64-shift));
+	result[size-1] = a[size-1]>>shift;
+}
+
+// x of xn limbs at least d of dn limbs, xn >= dn
+static bool atLeast(const uint64_t *x, size_t xn, const uint64_t *d, size_t dn)
+{
+	for (size_t i = xn; i > dn; --i) {
+		if (x[i-1] != 0)
+			return true;
+	}
+	for (size_t i = dn; i-- > 0; ) {
+		if (x[i] != d[i])
+			return x[i] > d[i];
+	}
+	return true;
+}
+
+// x += d (x -= d for SUB), d of dn limbs, carry propagated over xn limbs
+template <bool SUB>
+static void addSubInto(uint64_t *x, size_t xn, const uint64_t *d, size_t dn)
+{
+	uint64_t carry = SUB ? subMp(x, x, d, dn) : addMp(x, x, d, dn);
+	for (size_t i = dn; carry != 0 && i < xn; ++i)
+		carry = SUB ? x[i]-- == 0 : ++x[i] == 0;
+}
+
+uint64_t divRemMp_1(uint64_t *quotient, const uint64_t *a, size_t size, uint64_t d)
+{
+	uint64_t remainder = 0;
+	for (size_t i = size; i-- > 0; )
+		quotient[i] = divWide(remainder, a[i], d, &remainder);
+	return remainder;
+}
+
+MpDivisor1::MpDivisor1(uint64_t d):
+	shift(__builtin_clzll(d))
+{
+	normalized = d<<shift;
+	inverse = reciprocal_1(normalized);
+}
+
+// Numerator shifted on the fly by the divisor shift, the quotient is the same, the remainder shifted back
+uint64_t divRemMp_1Inverse(uint64_t *quotient, const uint64_t *a, size_t size, const MpDivisor1 &divisor)
+{
+	if (size == 0)
+		return 0;
+	unsigned shift = divisor.shift;
+	uint64_t d = divisor.normalized, inverse = divisor.inverse;
+	uint64_t remainder = 0;
+	if (shift == 0) {
+		for (size_t i = size; i-- > 0; )
+			quotient[i] = divPreinverted(remainder, a[i], d, inverse, &remainder);
+		return remainder;
+	}
+	remainder = a[size-1]>>(64-shift);
+	for (size_t i = size-1; i > 0; --i)
+		quotient[i] = divPreinverted(remainder, (a[i]<<shift)|(a[i-1]>>(64-shift)), d, inverse, &remainder);
+	quotient[0] = divPreinverted(remainder, a[0]<<shift, d, inverse, &remainder);
+	return remainder>>shift;
+}
+
+// Operands shifted so the divisor top bit is set, then each quotient limb estimated from the top two limbs of the
+// remainder and the top limb of the divisor, corrected by the second limb, which leaves it at most one above, fixed
+// by adding back.
+void divRemMp_Knuth(uint64_t *quotient, uint64_t *remainder, const uint64_t *a, size_t an, const uint64_t *d, size_t dn, MpArena *arena)
+{
+	if (dn == 1) {
+		remainder[0] = divRemMp_1Inverse(quotient, a, an, MpDivisor1(d[0]));
+		return;
+	}
+	size_t mark = arena->mark();
+	unsigned shift = __builtin_clzll(d[dn-1]);
+	uint64_t *dnorm = arena->allocate(dn);
+	uint64_t *un = arena->allocate(an+1);
+	shiftLeft(dnorm, d, dn, shift);
+	un[an] = shiftLeft(un, a, an, shift);
+	uint64_t dtop = dnorm[dn-1], dsecond = dnorm[dn-2], inverse = reciprocal_1(dtop);
+	for (size_t j = an-dn+1; j-- > 0; ) {
+		uint64_t qhat, rhat;
+		bool rhatOverflow;
+		if (un[j+dn] >= dtop) {
+			qhat = ~(uint64_t)0;
+			rhat = un[j+dn-1]+dtop;
+			rhatOverflow = rhat < dtop;
+		}
+		else {
+			qhat = divPreinverted(un[j+dn], un[j+dn-1], dtop, inverse, &rhat);
+			rhatOverflow = false;
+		}
+		while (!rhatOverflow && (uint128_t)qhat*dsecond > (((uint128_t)rhat<<64)|un[j+dn-2])) {
+			--qhat;
+			rhat += dtop;
+			rhatOverflow = rhat < dtop;
+		}
+		uint64_t borrow = subMulMp_1(un+j, dnorm, dn, qhat);
+		if (un[j+dn] < borrow) {
+			--qhat;
+			un[j+dn] = un[j+dn]-borrow+addMp(un+j, un+j, dnorm, dn);
+		}
+		else {
+			un[j+dn] -= borrow;
+		}
+		quotient[j] = qhat;
+	}
+	shiftRight(remainder, un, dn, shift);
+	arena->rewind(mark);
+}
+
+size_t divRemMpKnuthScratch(size_t an, size_t dn)
+{
+	return an+1+dn;
+}
+
+// Newton step from the reciprocal vh of the upper h limbs of d, scaled by B^(n-h): v = 2*vh*B^(n-h) - vh^2*d/B^(2h).
+// With h = n/2+2 the error of vh squares below one, so the result is corrected by few additions of d to the
+// remainder B^(2n) - v*d until it is in [0, d).
+void reciprocalMp(uint64_t *v, const uint64_t *d, size_t n, MpArena *arena)
+{
+	size_t mark = arena->mark();
+	if (n < RECIPROCAL_NEWTON_MIN) {
+		uint64_t *numerator = arena->allocate(2*n+1);
+		uint64_t *quotient = arena->allocate(n+2);
+		uint64_t *remainder = arena->allocate(n);
+		memset(numerator, 0, 2*n*sizeof(uint64_t));
+		numerator[2*n] = 1;
+		divRemMp_Knuth(quotient, remainder, numerator, 2*n+1, d, n, arena);
+		memcpy(v, quotient, (n+1)*sizeof(uint64_t));
+		arena->rewind(mark);
+		return;
+	}
+	size_t h = n/2+2;
+	uint64_t *vh = arena->allocate(h+1);
+	reciprocalMp(vh, d+n-h, h, arena);
+	uint64_t *square = arena->allocate(2*h+2);
+	sqrMp(square, vh, h+1, arena);
+	uint64_t *product = arena->allocate(2*h+2+n);
+	mulMp(product, square, 2*h+2, d, n, arena);
+	uint64_t *estimate = arena->allocate(n+2);
+	memset(estimate, 0, (n-h)*sizeof(uint64_t));
+	estimate[n+1] = shiftLeft(estimate+n-h, vh, h+1, 1);
+	subMp(estimate, estimate, product+2*h, n+2);
+
+	uint64_t *rest = arena->allocate(2*n+2);
+	mulMp(rest, estimate, n+2, d, n, arena);
+	for (size_t i = 0; i < 2*n+2; ++i)
+		rest[i] = ~rest[i];
+	addSubInto<false>(rest, 2*n+2, ONE, 1);
+	addSubInto<false>(rest+2*n, 2, ONE, 1);
+	while ((int64_t)rest[2*n+1] < 0) {
+		addSubInto<false>(rest, 2*n+2, d, n);
+		addSubInto<true>(estimate, n+2, ONE, 1);
+	}
+	while (atLeast(rest, 2*n+2, d, n)) {
+		addSubInto<true>(rest, 2*n+2, d, n);
+		addSubInto<false>(estimate, n+2, ONE, 1);
+	}
+	memcpy(v, estimate, (n+1)*sizeof(uint64_t));
+	arena->rewind(mark);
+}
+
+size_t reciprocalMpScratch(size_t n)
+{
+	if (n < RECIPROCAL_NEWTON_MIN)
+		return (2*n+1)+(n+2)+n+divRemMpKnuthScratch(2*n+1, n);
+	size_t h = n/2+2;
+	size_t step = (2*h+2)+(2*h+2+n)+(n+2)+(2*n+2)+std::max({ sqrMpScratch(h+1), mulMpScratch(2*h+2, n), mulMpScratch(n+2, n) });
+	return h+1+std::max(reciprocalMpScratch(h), step);
+}
+
+// Quotient estimate from the top limbs of a times the reciprocal is at most two below, remainder corrected by
+// subtracting d.  The remainder is written only after a is consumed, so it may be the low limbs of a.
+void divRemMp_Barrett(uint64_t *quotient, uint64_t *remainder, const uint64_t *a, size_t an, const uint64_t *d, size_t dn, const uint64_t *v, MpArena *arena)
+{
+	size_t mark = arena->mark();
+	size_t qn = an-dn+1;
+	uint64_t *estimate = arena->allocate(qn+dn+1);
+	mulMp(estimate, a+dn-1, qn, v, dn+1, arena);
+	memcpy(quotient, estimate+dn+1, qn*sizeof(uint64_t));
+	uint64_t *product = arena->allocate(qn+dn);
+	mulMp(product, quotient, qn, d, dn, arena);
+	uint64_t *rest = arena->allocate(dn+1);
+	rest[dn] = 0;
+	memcpy(rest, a, std::min(an, dn+1)*sizeof(uint64_t));
+	subMp(rest, rest, product, dn+1);
+	while (atLeast(rest, dn+1, d, dn)) {
+		addSubInto<true>(rest, dn+1, d, dn);
+		addSubInto<false>(quotient, qn, ONE, 1);
+	}
+	memcpy(remainder, rest, dn*sizeof(uint64_t));
+	arena->rewind(mark);
+}
+
+size_t divRemMpBarrettScratch(size_t an, size_t dn)
+{
+	size_t qn = an-dn+1;
+	return (qn+dn+1)+(qn+dn)+(dn+1)+std::max(mulMpScratch(qn, dn+1), mulMpScratch(qn, dn));
+}
+
+// Numerator shifted with the divisor, then reduced from the top: the first block takes up to 2*dn limbs, so the rest
+// splits to whole blocks of dn limbs, each next block below the remainder of the previous one makes 2*dn limb
+// numerator with quotient below B^dn.  The remainders are written in place, so the numerator is always contiguous.
+static void divRemBlocks(uint64_t *quotient, uint64_t *remainder, const uint64_t *a, size_t an, const uint64_t *d, size_t dn, unsigned shift, const uint64_t *v, MpArena *arena)
+{
+	size_t mark = arena->mark();
+	uint64_t *shifted = arena->allocate(an+1);
+	shifted[an] = shiftLeft(shifted, a, an, shift);
+	size_t sn = an+(shifted[an] != 0);
+	size_t qn = an-dn+1;
+	uint64_t *part = arena->allocate(dn+1);
+	size_t length = sn <= 2*dn ? sn : dn+(sn-dn-1)%dn+1;
+	size_t position = sn-length;
+	divRemMp_Barrett(part, shifted+position, shifted+position, length, d, dn, v, arena);
+	memcpy(quotient+position, part, std::min(length-dn+1, qn-position)*sizeof(uint64_t));
+	while (position > 0) {
+		position -= dn;
+		divRemMp_Barrett(part, shifted+position, shifted+position, 2*dn, d, dn, v, arena);
+		memcpy(quotient+position, part, dn*sizeof(uint64_t));
+	}
+	shiftRight(remainder, shifted, dn, shift);
+	arena->rewind(mark);
+}
+
+static size_t divRemBlocksScratch(size_t an, size_t dn)
+{
+	return (an+1)+(dn+1)+divRemMpBarrettScratch(std::min(an+1, 2*dn), dn);
+}
+
+MpDivisor::MpDivisor(const uint64_t *d, size_t dn):
+	normalized(dn),
+	reciprocal(dn+1),
+	shift(__builtin_clzll(d[dn-1]))
+{
+	shiftLeft(normalized.data(), d, dn, shift);
+	std::vector<uint64_t> scratch(reciprocalMpScratch(dn));
+	MpArena arena(scratch.data(), scratch.size());
+	reciprocalMp(reciprocal.data(), normalized.data(), dn, &arena);
+}
+
+void divRemMp_Reciprocal(uint64_t *quotient, uint64_t *remainder, const uint64_t *a, size_t an, const MpDivisor &divisor, MpArena *arena)
+{
+	divRemBlocks(quotient, remainder, a, an, divisor.normalized.data(), divisor.normalized.size(), divisor.shift, divisor.reciprocal.data(), arena);
+}
+
+size_t divRemMpReciprocalScratch(size_t an, size_t dn)
+{
+	return divRemBlocksScratch(an, dn);
+}
+
+void modMp(uint64_t *remainder, const uint64_t *a, size_t an, const MpDivisor &divisor, MpArena *arena)
+{
+	size_t mark = arena->mark();
+	uint64_t *quotient = arena->allocate(an-divisor.normalized.size()+1);
+	divRemMp_Reciprocal(quotient, remainder, a, an, divisor, arena);
+	arena->rewind(mark);
+}
+
+size_t modMpScratch(size_t an, size_t dn)
+{
+	return (an-dn+1)+divRemMpReciprocalScratch(an, dn);
+}
+
+void divRemMp_Newton(uint64_t *quotient, uint64_t *remainder, const uint64_t *a, size_t an, const uint64_t *d, size_t dn, MpArena *arena)
+{
+	size_t mark = arena->mark();
+	unsigned shift = __builtin_clzll(d[dn-1]);
+	uint64_t *normalized = arena->allocate(dn);
+	uint64_t *v = arena->allocate(dn+1);
+	shiftLeft(normalized, d, dn, shift);
+	reciprocalMp(v, normalized, dn, arena);
+	divRemBlocks(quotient, remainder, a, an, normalized, dn, shift, v, arena);
+	arena->rewind(mark);
+}
+
+size_t divRemMpNewtonScratch(size_t an, size_t dn)
+{
+	return dn+(dn+1)+std::max(reciprocalMpScratch(dn), divRemBlocksScratch(an, dn));
+}
+
+void divRemMp(uint64_t *quotient, uint64_t *remainder, const uint64_t *a, size_t an, const uint64_t *d, size_t dn, MpArena *arena)
+{
+	if (dn == 1)
+		remainder[0] = divRemMp_1Inverse(quotient, a, an, MpDivisor1(d[0]));
+	else if (dn < DIV_NEWTON_MIN || an-dn+1 < DIV_NEWTON_MIN)
+		divRemMp_Knuth(quotient, remainder, a, an, d, dn, arena);
+	else
+		divRemMp_Newton(quotient, remainder, a, an, d, dn, arena);
+}
+
+size_t divRemMpScratch(size_t an, size_t dn)
+{
+	if (dn == 1)
+		return 0;
+	if (dn < DIV_NEWTON_MIN || an-dn+1 < DIV_NEWTON_MIN)
+		return divRemMpKnuthScratch(an, dn);
+	return divRemMpNewtonScratch(an, dn);
+}
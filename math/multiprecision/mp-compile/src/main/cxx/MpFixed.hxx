@@ -0,0 +1,311 @@
+/*
+ * Fixed size multiprecision integers, limb loops unrolled at compile time.
+ *
+ * The loops over limbs are template recursions calling lambda with the limb index, which becomes constant after
+ * inlining, so the carry chain is straight code over registers.  Operand scanning rows are unrolled completely up to
+ * MP_FIXED_UNROLL_LIMBS limbs, above that the row body stays unrolled and the rows run in loop, keeping the code size
+ * linear with the size.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+
+#ifndef MpFixed_hxx__
+# define MpFixed_hxx__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __x86_64__
+#include <x86intrin.h>
+#endif
+
+#include "Mp.hxx"
+
+// Lambda bodies of the unrolled loops, inliner limits would leave them as calls otherwise
+#define MP_FIXED_INLINE __attribute__((always_inline))
+
+#ifndef MP_FIXED_UNROLL_LIMBS
+# define MP_FIXED_UNROLL_LIMBS 8
+#endif
+
+// Calls function(I), ..., function(N-1)
+template <size_t I, size_t N>
+struct MpUnroll
+{
+	template <typename Function>
+	__attribute__((always_inline))
+	static inline void run(const Function &function)
+	{
+		function(I);
+		MpUnroll<I+1, N>::run(function);
+	}
+};
+
+template <size_t N>
+struct MpUnroll<N, N>
+{
+	template <typename Function>
+	__attribute__((always_inline))
+	static inline void run(const Function &)
+	{
+	}
+};
+
+// Calls function(0), ..., function(N-1), unrolled up to MP_FIXED_UNROLL_LIMBS
+template <size_t N, bool UNROLL = (N <= MP_FIXED_UNROLL_LIMBS)>
+struct MpRows
+{
+	template <typename Function>
+	__attribute__((always_inline))
+	static inline void run(const Function &function)
+	{
+		MpUnroll<0, N>::run(function);
+	}
+};
+
+template <size_t N>
+struct MpRows<N, false>
+{
+	template <typename Function>
+	__attribute__((always_inline))
+	static inline void run(const Function &function)
+	{
+		for (size_t i = 0; i < N; ++i)
+			function(i);
+	}
+};
+
+// a+b+carry, carry updated
+__attribute__((always_inline))
+inline uint64_t mpFixedAdc(uint64_t a, uint64_t b, unsigned char *carry)
+{
+#ifdef __x86_64__
+	unsigned long long sum;
+	*carry = _addcarry_u64(*carry, a, b, &sum);
+	return sum;
+#else
+	uint64_t sum, result;
+	unsigned char overflow = __builtin_add_overflow(a, b, &sum);
+	overflow |= __builtin_add_overflow(sum, (uint64_t)*carry, &result);
+	*carry = overflow;
+	return result;
+#endif
+}
+
+// a-b-borrow, borrow updated
+__attribute__((always_inline))
+inline uint64_t mpFixedSbb(uint64_t a, uint64_t b, unsigned char *borrow)
+{
+#ifdef __x86_64__
+	unsigned long long difference;
+	*borrow = _subborrow_u64(*borrow, a, b, &difference);
+	return difference;
+#else
+	uint64_t difference, result;
+	unsigned char overflow = __builtin_sub_overflow(a, b, &difference);
+	overflow |= __builtin_sub_overflow(difference, (uint64_t)*borrow, &result);
+	*borrow = overflow;
+	return result;
+#endif
+}
+
+// low limb of a*b+t+carry, carry set to the high limb; cannot overflow
+__attribute__((always_inline))
+inline uint64_t mpFixedMac(uint64_t a, uint64_t b, uint64_t t, uint64_t *carry)
+{
+	unsigned __int128 product = (unsigned __int128)a*b+t+*carry;
+	*carry = (uint64_t)(product>>64);
+	return (uint64_t)product;
+}
+
+template <size_t BITS>
+struct UInt
+{
+	static_assert(BITS%64 == 0 && BITS > 0, "UInt size must be positive multiple of 64 bits");
+
+	static const size_t LIMBS = BITS/64;
+
+	uint64_t limb[LIMBS];
+};
+
+// result = a+b, returns carry.  result may alias the operands.
+template <size_t BITS>
+inline uint64_t addUInt(UInt<BITS> *result, const UInt<BITS> &a, const UInt<BITS> &b)
+{
+	unsigned char carry = 0;
+	MpUnroll<0, UInt<BITS>::LIMBS>::run([&](size_t i) MP_FIXED_INLINE { result->limb[i] = mpFixedAdc(a.limb[i], b.limb[i], &carry); });
+	return carry;
+}
+
+// result = a-b, returns borrow.  result may alias the operands.
+template <size_t BITS>
+inline uint64_t subUInt(UInt<BITS> *result, const UInt<BITS> &a, const UInt<BITS> &b)
+{
+	unsigned char borrow = 0;
+	MpUnroll<0, UInt<BITS>::LIMBS>::run([&](size_t i) MP_FIXED_INLINE { result->limb[i] = mpFixedSbb(a.limb[i], b.limb[i], &borrow); });
+	return borrow;
+}
+
+// result = a*b, operand scanning.  result does not alias the operands.
+template <size_t BITS>
+inline void mulUInt(UInt<2*BITS> *result, const UInt<BITS> &a, const UInt<BITS> &b)
+{
+	const size_t N = UInt<BITS>::LIMBS;
+	uint64_t *r = result->limb;
+	uint64_t carry = 0;
+	MpUnroll<0, N>::run([&](size_t j) MP_FIXED_INLINE { r[j] = mpFixedMac(a.limb[0], b.limb[j], 0, &carry); });
+	r[N] = carry;
+	MpRows<N-1>::run([&](size_t row) MP_FIXED_INLINE {
+		size_t i = row+1;
+		uint64_t ai = a.limb[i];
+		uint64_t carry = 0;
+		MpUnroll<0, N>::run([&](size_t j) MP_FIXED_INLINE { r[i+j] = mpFixedMac(ai, b.limb[j], r[i+j], &carry); });
+		r[i+N] = carry;
+	});
+}
+
+// result = mask ? a : b without branch, mask is all ones or zero
+template <size_t BITS>
+inline void selectUInt(UInt<BITS> *result, uint64_t mask, const UInt<BITS> &a, const UInt<BITS> &b)
+{
+	MpUnroll<0, UInt<BITS>::LIMBS>::run([&](size_t i) MP_FIXED_INLINE { result->limb[i] = (a.limb[i]&mask)|(b.limb[i]&~mask); });
+}
+
+// Montgomery arithmetic modulo odd n, R = 2^BITS.  Values in Montgomery form are below n, all operations run in time
+// independent of the values, exponentiation optionally independent of the exponent too.
+template <size_t BITS>
+class Montgomery
+{
+public:
+	typedef UInt<BITS> Value;
+
+	static const size_t LIMBS = Value::LIMBS;
+
+	explicit Montgomery(const Value &modulus):
+		modulus(modulus),
+		n0inv(montgomeryInverseMp(modulus.limb[0]))
+	{
+		montgomeryOneMp(oneValue.limb, modulus.limb, LIMBS);
+		montgomeryR2Mp(r2.limb, modulus.limb, LIMBS);
+	}
+
+	const Value &one() const
+	{
+		return oneValue;
+	}
+
+	Value toMontgomery(const Value &a) const
+	{
+		return mul(a, r2);
+	}
+
+	Value fromMontgomery(const Value &a) const
+	{
+		UInt<2*BITS> wide;
+		memcpy(wide.limb, a.limb, sizeof(a.limb));
+		memset(wide.limb+LIMBS, 0, sizeof(a.limb));
+		return reduce(wide);
+	}
+
+	// a*b/R mod n, interleaved: each row adds a[i]*b and then m*n clearing the limb i.  Rows address the accumulator
+	// by offset instead of shifting it, so rows in loop keep it in memory rather than in spilled scalars.
+	Value mul(const Value &a, const Value &b) const
+	{
+		uint64_t t[2*LIMBS];
+		memset(t, 0, LIMBS*sizeof(uint64_t));
+		unsigned char overflow = 0;
+		MpRows<LIMBS>::run([&](size_t i) MP_FIXED_INLINE {
+			uint64_t ai = a.limb[i];
+			uint64_t carry = 0;
+			MpUnroll<0, LIMBS>::run([&](size_t j) MP_FIXED_INLINE { t[i+j] = mpFixedMac(ai, b.limb[j], t[i+j], &carry); });
+			uint64_t m = t[i]*n0inv;
+			uint64_t reduceCarry = 0;
+			MpUnroll<0, LIMBS>::run([&](size_t j) MP_FIXED_INLINE { t[i+j] = mpFixedMac(m, modulus.limb[j], t[i+j], &reduceCarry); });
+			t[i+LIMBS] = mpFixedAdc(carry, reduceCarry, &overflow);
+		});
+		return subtractModulus(t+LIMBS, overflow);
+	}
+
+	Value sqr(const Value &a) const
+	{
+		return mul(a, a);
+	}
+
+	// t/R mod n for t below n*R, limb by limb, the carry out of each row added at the next one
+	Value reduce(const UInt<2*BITS> &t) const
+	{
+		uint64_t r[2*LIMBS];
+		memcpy(r, t.limb, sizeof(r));
+		unsigned char overflow = 0;
+		MpRows<LIMBS>::run([&](size_t i) MP_FIXED_INLINE {
+			uint64_t m = r[i]*n0inv;
+			uint64_t carry = 0;
+			MpUnroll<0, LIMBS>::run([&](size_t j) MP_FIXED_INLINE { r[i+j] = mpFixedMac(m, modulus.limb[j], r[i+j], &carry); });
+			r[i+LIMBS] = mpFixedAdc(r[i+LIMBS], carry, &overflow);
+		});
+		return subtractModulus(r+LIMBS, overflow);
+	}
+
+	// base^exponent in Montgomery form by fixed window.  CONSTANT_TIME reads whole table for every window and
+	// multiplies by zero windows too, so neither time nor memory access depend on the exponent.
+	template <bool CONSTANT_TIME = false, size_t EBITS = BITS>
+	Value pow(const Value &base, const UInt<EBITS> &exponent) const
+	{
+		const unsigned WIDTH = montgomeryWindowBits(EBITS);
+		const size_t ENTRIES = (size_t)1<<WIDTH;
+		Value table[ENTRIES];
+		table[0] = oneValue;
+		table[1] = base;
+		for (size_t i = 2; i < ENTRIES; ++i)
+			table[i] = mul(table[i-1], base);
+		size_t bit = EBITS;
+		unsigned first = bit%WIDTH != 0 ? bit%WIDTH : WIDTH;
+		bit -= first;
+		Value result = lookup<CONSTANT_TIME>(table, ENTRIES, windowMp(exponent.limb, UInt<EBITS>::LIMBS, bit, first));
+		while (bit > 0) {
+			bit -= WIDTH;
+			for (unsigned i = 0; i < WIDTH; ++i)
+				result = sqr(result);
+			unsigned window = windowMp(exponent.limb, UInt<EBITS>::LIMBS, bit, WIDTH);
+			if (CONSTANT_TIME || window != 0)
+				result = mul(result, lookup<CONSTANT_TIME>(table, ENTRIES, window));
+		}
+		return result;
+	}
+
+private:
+	// t-n if t (with top bit) is not below n, t otherwise
+	Value subtractModulus(const uint64_t *t, uint64_t top) const
+	{
+		Value value, difference;
+		memcpy(value.limb, t, sizeof(value.limb));
+		unsigned char borrow = 0;
+		MpUnroll<0, LIMBS>::run([&](size_t i) MP_FIXED_INLINE { difference.limb[i] = mpFixedSbb(t[i], modulus.limb[i], &borrow); });
+		mpFixedSbb(top, 0, &borrow);
+		selectUInt(&value, -(uint64_t)borrow, value, difference);
+		return value;
+	}
+
+	template <bool CONSTANT_TIME>
+	static Value lookup(const Value *table, size_t entries, unsigned index)
+	{
+		if (!CONSTANT_TIME)
+			return table[index];
+		Value value;
+		memset(value.limb, 0, sizeof(value.limb));
+		for (size_t i = 0; i < entries; ++i) {
+			// all ones for matching entry: (i^index)-1 has the top bit set only when zero
+			uint64_t mask = -(((uint64_t)(i^index)-1)>>63);
+			MpUnroll<0, LIMBS>::run([&](size_t j) MP_FIXED_INLINE { value.limb[j] |= table[i].limb[j]&mask; });
+		}
+		return value;
+	}
+
+	Value modulus;
+	uint64_t n0inv;
+	Value oneValue;
+	Value r2;
+};
+
+#endif
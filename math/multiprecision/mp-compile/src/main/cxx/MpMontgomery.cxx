@@ -0,0 +1,107 @@
+/*
+ * Variable length Montgomery arithmetic over the multiplication engine.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "Mp.hxx"
+
+
+uint64_t montgomeryInverseMp(uint64_t n0)
+{
+	// n0*n0 = 1 mod 8 for odd n0, each Newton step doubles the correct bits: 3, 6, 12, 24, 48, 96
+	uint64_t inverse = n0;
+	for (int i = 0; i < 5; ++i)
+		inverse *= 2-n0*inverse;
+	return -inverse;
+}
+
+static bool notBelow(const uint64_t *x, const uint64_t *y, size_t size)
+{
+	for (size_t i = size; i-- > 0; ) {
+		if (x[i] != y[i])
+			return x[i] > y[i];
+	}
+	return true;
+}
+
+// result = 2^doublings mod n
+static void powerOfTwoMod(uint64_t *result, const uint64_t *n, size_t size, size_t doublings)
+{
+	memset(result, 0, size*sizeof(uint64_t));
+	result[0] = 1;
+	for (size_t i = 0; i < doublings; ++i) {
+		uint64_t carry = addMp(result, result, result, size);
+		if (carry != 0 || notBelow(result, n, size))
+			subMp(result, result, n, size);
+	}
+}
+
+void montgomeryOneMp(uint64_t *result, const uint64_t *n, size_t size)
+{
+	powerOfTwoMod(result, n, size, 64*size);
+}
+
+void montgomeryR2Mp(uint64_t *result, const uint64_t *n, size_t size)
+{
+	powerOfTwoMod(result, n, size, 128*size);
+}
+
+void mulMontgomeryMp(uint64_t *result, const uint64_t *a, const uint64_t *b, const uint64_t *n, size_t size, uint64_t n0inv, MpArena *arena)
+{
+	size_t mark = arena->mark();
+	uint64_t *t = arena->allocate(2*size+1);
+	if (a == b)
+		sqrMp(t, a, size, arena);
+	else
+		mulMp(t, a, size, b, size, arena);
+	t[2*size] = 0;
+	// t+m*n divisible by 2^64 one limb after another, the carry limb rippled up
+	for (size_t i = 0; i < size; ++i) {
+		uint64_t carry = addMulMp_1(t+i, n, size, t[i]*n0inv);
+		for (size_t j = i+size; carry != 0; ++j) {
+			uint64_t limb = t[j]+carry;
+			carry = limb < carry;
+			t[j] = limb;
+		}
+	}
+	if (t[2*size] != 0 || notBelow(t+size, n, size))
+		subMp(result, t+size, n, size);
+	else
+		memcpy(result, t+size, size*sizeof(uint64_t));
+	arena->rewind(mark);
+}
+
+size_t powMontgomeryMpScratch(size_t size)
+{
+	return ((size_t)1<<montgomeryWindowBits(64*size))*size+2*size+1+mulMpScratch(size, size);
+}
+
+void powMontgomeryMp(uint64_t *result, const uint64_t *base, const uint64_t *exponent, size_t exponentSize, const uint64_t *one, const uint64_t *n, size_t size, uint64_t n0inv, MpArena *arena)
+{
+	const unsigned width = montgomeryWindowBits(64*size);
+	size_t mark = arena->mark();
+	// table[i] = base^i
+	uint64_t *table = arena->allocate(((size_t)1<<width)*size);
+	memcpy(table, one, size*sizeof(uint64_t));
+	memcpy(table+size, base, size*sizeof(uint64_t));
+	for (size_t i = 2; i < ((size_t)1<<width); ++i)
+		mulMontgomeryMp(table+i*size, table+(i-1)*size, base, n, size, n0inv, arena);
+	// the top window takes the remainder bits, starting from table entry saves squaring of one
+	size_t bit = exponentSize*64;
+	unsigned first = bit%width != 0 ? bit%width : width;
+	bit -= first;
+	memcpy(result, table+windowMp(exponent, exponentSize, bit, first)*size, size*sizeof(uint64_t));
+	while (bit > 0) {
+		bit -= width;
+		for (unsigned i = 0; i < width; ++i)
+			mulMontgomeryMp(result, result, result, n, size, n0inv, arena);
+		unsigned window = windowMp(exponent, exponentSize, bit, width);
+		if (window != 0)
+			mulMontgomeryMp(result, result, table+window*size, n, size, n0inv, arena);
+	}
+	arena->rewind(mark);
+}
@@ -0,0 +1,567 @@
+/*
+ * Multiprecision multiplication over 64-bit limbs: schoolbook base case on mulx/ADX, Karatsuba and Toom-3, NTT for
+ * the huge ones (MpNtt.cxx).
+ *
+ * Karatsuba is the subtractive variant, |a0-a1|*|b1-b0| with sign, so the middle product does not grow.  Toom-3
+ * evaluates at 0, 1, -1, 2 and infinity and interpolates by Bodrato's sequence; the intermediate values may be
+ * negative, they are kept as two's complement numbers of 2k+2 limbs, where the divisions by 2 and 3 are exact.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "Mp.hxx"
+
+
+typedef unsigned __int128 uint128_t;
+
+// Smallest sizes the splits work for, whatever the thresholds are
+static const size_t KARATSUBA_MIN = 4;
+static const size_t TOOM3_MIN = 9;
+// Below this the squaring schoolbook does not recover the cost of the doubling pass
+static const size_t SQR_SCHOOLBOOK_MIN = 8;
+
+MpMulThresholds mpMulThresholds = { 24, 120, 32, 160, 8000, 8000 };
+
+uint64_t mulMp_1_ref(uint64_t *result, const uint64_t *a, size_t size, uint64_t b)
+{
+	uint64_t carry = 0;
+	for (size_t i = 0; i < size; ++i) {
+		uint128_t product = (uint128_t)a[i]*b+carry;
+		result[i] = (uint64_t)product;
+		carry = (uint64_t)(product>>64);
+	}
+	return carry;
+}
+
+uint64_t addMulMp_1_ref(uint64_t *result, const uint64_t *a, size_t size, uint64_t b)
+{
+	uint64_t carry = 0;
+	for (size_t i = 0; i < size; ++i) {
+		uint128_t product = (uint128_t)a[i]*b+result[i]+carry;
+		result[i] = (uint64_t)product;
+		carry = (uint64_t)(product>>64);
+	}
+	return carry;
+}
+
+#ifdef __x86_64__
+
+// Four limbs per iteration, the limbs before are done by the portable kernel whose carry limb starts the chain
+uint64_t mulMp_1_Adx(uint64_t *result, const uint64_t *a, size_t size, uint64_t b)
+{
+	size_t head = size%4;
+	uint64_t carry = mulMp_1_ref(result, a, head, b);
+	size_t blocks = size/4;
+	if (blocks == 0)
+		return carry;
+	const uint64_t *ap = a+head;
+	uint64_t *rp = result+head;
+	uint64_t lo, hi;
+	// mulx, mov and lea keep the flags, the high limb of each product goes to the next limb by adcx
+	__asm__ __volatile__(
+		"xor %k[lo], %k[lo]\n"
+		"1:\n"
+		"mulx (%[a]), %[lo], %[hi]\n"
+		"adcx %[carry], %[lo]\n"
+		"mov %[lo], (%[r])\n"
+		"mulx 8(%[a]), %[lo], %[carry]\n"
+		"adcx %[hi], %[lo]\n"
+		"mov %[lo], 8(%[r])\n"
+		"mulx 16(%[a]), %[lo], %[hi]\n"
+		"adcx %[carry], %[lo]\n"
+		"mov %[lo], 16(%[r])\n"
+		"mulx 24(%[a]), %[lo], %[carry]\n"
+		"adcx %[hi], %[lo]\n"
+		"mov %[lo], 24(%[r])\n"
+		"lea 32(%[a]), %[a]\n"
+		"lea 32(%[r]), %[r]\n"
+		"lea -1(%[n]), %[n]\n"
+		"jrcxz 2f\n"
+		"jmp 1b\n"
+		"2:\n"
+		"mov $0, %k[lo]\n"
+		"adcx %[lo], %[carry]\n"
+		: [a] "+&r"(ap), [r] "+&r"(rp), [n] "+&c"(blocks), [carry] "+&r"(carry), [lo] "=&r"(lo), [hi] "=&r"(hi)
+		: "d"(b)
+		: "cc", "memory"
+	);
+	return carry;
+}
+
+// Product low limbs are added to the result on CF chain, high limbs of the previous products on OF chain
+uint64_t addMulMp_1_Adx(uint64_t *result, const uint64_t *a, size_t size, uint64_t b)
+{
+	size_t head = size%4;
+	uint64_t carry = addMulMp_1_ref(result, a, head, b);
+	size_t blocks = size/4;
+	if (blocks == 0)
+		return carry;
+	const uint64_t *ap = a+head;
+	uint64_t *rp = result+head;
+	uint64_t lo, hi;
+	__asm__ __volatile__(
+		"xor %k[lo], %k[lo]\n"
+		"1:\n"
+		"mulx (%[a]), %[lo], %[hi]\n"
+		"adcx (%[r]), %[lo]\n"
+		"adox %[carry], %[lo]\n"
+		"mov %[lo], (%[r])\n"
+		"mulx 8(%[a]), %[lo], %[carry]\n"
+		"adcx 8(%[r]), %[lo]\n"
+		"adox %[hi], %[lo]\n"
+		"mov %[lo], 8(%[r])\n"
+		"mulx 16(%[a]), %[lo], %[hi]\n"
+		"adcx 16(%[r]), %[lo]\n"
+		"adox %[carry], %[lo]\n"
+		"mov %[lo], 16(%[r])\n"
+		"mulx 24(%[a]), %[lo], %[carry]\n"
+		"adcx 24(%[r]), %[lo]\n"
+		"adox %[hi], %[lo]\n"
+		"mov %[lo], 24(%[r])\n"
+		"lea 32(%[a]), %[a]\n"
+		"lea 32(%[r]), %[r]\n"
+		"lea -1(%[n]), %[n]\n"
+		"jrcxz 2f\n"
+		"jmp 1b\n"
+		"2:\n"
+		"mov $0, %k[lo]\n"
+		"adcx %[lo], %[carry]\n"
+		"adox %[lo], %[carry]\n"
+		: [a] "+&r"(ap), [r] "+&r"(rp), [n] "+&c"(blocks), [carry] "+&r"(carry), [lo] "=&r"(lo), [hi] "=&r"(hi)
+		: "d"(b)
+		: "cc", "memory"
+	);
+	return carry;
+}
+
+#endif
+
+struct MulMpSelection
+{
+	uint64_t (*mul_1)(uint64_t *result, const uint64_t *a, size_t size, uint64_t b);
+	uint64_t (*addMul_1)(uint64_t *result, const uint64_t *a, size_t size, uint64_t b);
+	const char *name;
+};
+
+static MulMpSelection selectMulMp()
+{
+#ifdef __x86_64__
+	if (__builtin_cpu_supports("bmi2") && __builtin_cpu_supports("adx"))
+		return MulMpSelection{ &mulMp_1_Adx, &addMulMp_1_Adx, "adx" };
+#endif
+	return MulMpSelection{ &mulMp_1_ref, &addMulMp_1_ref, "ref" };
+}
+
+static const MulMpSelection mulMpSelection = selectMulMp();
+
+uint64_t mulMp_1(uint64_t *result, const uint64_t *a, size_t size, uint64_t b)
+{
+	return mulMpSelection.mul_1(result, a, size, b);
+}
+
+uint64_t addMulMp_1(uint64_t *result, const uint64_t *a, size_t size, uint64_t b)
+{
+	return mulMpSelection.addMul_1(result, a, size, b);
+}
+
+const char *mulMpSelected()
+{
+	return mulMpSelection.name;
+}
+
+typedef uint64_t (*MpMul1Function)(uint64_t *result, const uint64_t *a, size_t size, uint64_t b);
+
+static void mulSchoolbook(uint64_t *result, const uint64_t *a, size_t an, const uint64_t *b, size_t bn, MpMul1Function mul_1, MpMul1Function addMul_1)
+{
+	if (an < bn) {
+		std::swap(a, b);
+		std::swap(an, bn);
+	}
+	if (bn == 0) {
+		memset(result, 0, an*sizeof(uint64_t));
+		return;
+	}
+	result[an] = mul_1(result, a, an, b[0]);
+	for (size_t j = 1; j < bn; ++j)
+		result[an+j] = addMul_1(result+j, a, an, b[j]);
+}
+
+void mulMp_ref(uint64_t *result, const uint64_t *a, size_t an, const uint64_t *b, size_t bn)
+{
+	mulSchoolbook(result, a, an, b, bn, &mulMp_1_ref, &addMulMp_1_ref);
+}
+
+void mulMp_Schoolbook(uint64_t *result, const uint64_t *a, size_t an, const uint64_t *b, size_t bn)
+{
+	mulSchoolbook(result, a, an, b, bn, mulMpSelection.mul_1, mulMpSelection.addMul_1);
+}
+
+void sqrMp_Schoolbook(uint64_t *result, const uint64_t *a, size_t size)
+{
+	if (size == 0)
+		return;
+	// off-diagonal products a[i]*a[j], i < j
+	result[0] = 0;
+	result[size] = mulMp_1(result+1, a+1, size-1, a[0]);
+	for (size_t i = 1; i < size; ++i)
+		result[size+i] = addMulMp_1(result+2*i+1, a+i+1, size-1-i, a[i]);
+	result[2*size-1] = 0;
+	// doubled, cannot overflow as the off-diagonal sum is below half of the square
+	uint64_t shifted = 0;
+	for (size_t i = 0; i < 2*size; ++i) {
+		uint64_t limb = result[i];
+		result[i] = (limb<<1)|shifted;
+		shifted = limb>>63;
+	}
+	uint64_t carry = 0;
+	for (size_t i = 0; i < size; ++i) {
+		uint128_t square = (uint128_t)a[i]*a[i];
+		uint128_t low = (uint128_t)result[2*i]+(uint64_t)square+carry;
+		result[2*i] = (uint64_t)low;
+		uint128_t high = (uint128_t)result[2*i+1]+(uint64_t)(square>>64)+(uint64_t)(low>>64);
+		result[2*i+1] = (uint64_t)high;
+		carry = (uint64_t)(high>>64);
+	}
+}
+
+// result (rn limbs) += x (xn <= rn limbs), returns the carry out of result
+static uint64_t addInto(uint64_t *result, size_t rn, const uint64_t *x, size_t xn)
+{
+	uint64_t carry = addMp(result, result, x, xn);
+	for (size_t i = xn; carry != 0 && i < rn; ++i)
+		carry = ++result[i] == 0;
+	return carry;
+}
+
+// result (rn limbs) -= x (xn <= rn limbs), returns the borrow out of result
+static uint64_t subFrom(uint64_t *result, size_t rn, const uint64_t *x, size_t xn)
+{
+	uint64_t borrow = subMp(result, result, x, xn);
+	for (size_t i = xn; borrow != 0 && i < rn; ++i)
+		borrow = result[i]-- == 0;
+	return borrow;
+}
+
+// Compares x and y, both of size limbs
+static int compare(const uint64_t *x, const uint64_t *y, size_t size)
+{
+	for (size_t i = size; i-- > 0; ) {
+		if (x[i] != y[i])
+			return x[i] < y[i] ? -1 : 1;
+	}
+	return 0;
+}
+
+// result = |x-y| in xn limbs, y has yn <= xn limbs, returns true if x < y
+static bool absDiff(uint64_t *result, const uint64_t *x, size_t xn, const uint64_t *y, size_t yn)
+{
+	bool higher = false;
+	for (size_t i = yn; i < xn; ++i)
+		higher = higher || x[i] != 0;
+	if (higher || compare(x, y, yn) >= 0) {
+		memcpy(result, x, xn*sizeof(uint64_t));
+		subFrom(result, xn, y, yn);
+		return false;
+	}
+	subMp(result, y, x, yn);
+	memset(result+yn, 0, (xn-yn)*sizeof(uint64_t));
+	return true;
+}
+
+// result = |x-y|, x has xn limbs, y has yn limbs, result max(xn, yn) limbs, returns true if x < y (or equal)
+static bool absDiffAny(uint64_t *result, const uint64_t *x, size_t xn, const uint64_t *y, size_t yn)
+{
+	if (xn >= yn)
+		return absDiff(result, x, xn, y, yn);
+	return !absDiff(result, y, yn, x, xn);
+}
+
+static void mulBalanced(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t n, MpArena *arena, bool square);
+
+// Restores the arena on scope exit
+class ArenaScope
+{
+public:
+	ArenaScope(MpArena *arena):
+		arena(arena),
+		mark(arena->mark())
+	{
+	}
+
+	~ArenaScope()
+	{
+		arena->rewind(mark);
+	}
+
+private:
+	MpArena *arena;
+	size_t mark;
+};
+
+// a*b with a = a1*X+a0, b = b1*X+b0, X = 2^(64h): the middle term is z0+z2+(a0-a1)*(b1-b0), for square always
+// z0+z2-(a0-a1)^2
+static void mulKaratsuba(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t n, MpArena *arena, bool square)
+{
+	size_t h = n/2, l = n-h;
+	mulBalanced(result, a, b, h, arena, square);
+	mulBalanced(result+2*h, a+h, b+h, l, arena, square);
+	ArenaScope scope(arena);
+	uint64_t *da = arena->allocate(l);
+	uint64_t *db = square ? da : arena->allocate(l);
+	uint64_t *p = arena->allocate(2*l);
+	uint64_t *t = arena->allocate(2*l+1);
+	bool negative = absDiffAny(da, a, h, a+h, l);
+	negative = square || negative != absDiffAny(db, b+h, l, b, h);
+	mulBalanced(p, da, db, l, arena, square);
+	memcpy(t, result+2*h, 2*l*sizeof(uint64_t));
+	t[2*l] = addInto(t, 2*l, result, 2*h);
+	if (negative)
+		subFrom(t, 2*l+1, p, 2*l);
+	else
+		addInto(t, 2*l+1, p, 2*l);
+	addInto(result+h, 2*n-h, t, 2*l+1);
+}
+
+// result (size limbs) = -result, two's complement
+static void negate(uint64_t *result, size_t size)
+{
+	uint64_t carry = 1;
+	for (size_t i = 0; i < size; ++i) {
+		uint64_t limb = ~result[i]+carry;
+		carry = carry && limb == 0;
+		result[i] = limb;
+	}
+}
+
+// Arithmetic shift right by one of two's complement number
+static void halve(uint64_t *result, size_t size)
+{
+	for (size_t i = 0; i+1 < size; ++i)
+		result[i] = (result[i]>>1)|(result[i+1]<<63);
+	result[size-1] = (uint64_t)((int64_t)result[size-1]>>1);
+}
+
+// Exact division by 3 modulo 2^(64*size), valid for two's complement numbers too.  q*3 = x+k*2^64 with k the number
+// of the thresholds 2^64/3 and 2^65/3 q reaches, k goes as borrow to the next limb.
+static void divideExact3(uint64_t *result, size_t size)
+{
+	const uint64_t inverse = 0xaaaaaaaaaaaaaaabULL;
+	uint64_t borrow = 0;
+	for (size_t i = 0; i < size; ++i) {
+		uint64_t limb = result[i];
+		uint64_t x = limb-borrow;
+		borrow = x > limb;
+		uint64_t q = x*inverse;
+		result[i] = q;
+		borrow += (q >= 0x5555555555555556ULL)+(q >= 0xaaaaaaaaaaaaaaabULL);
+	}
+}
+
+// Copies x (xn limbs) into result (size limbs), zero extended
+static void extend(uint64_t *result, size_t size, const uint64_t *x, size_t xn)
+{
+	memcpy(result, x, xn*sizeof(uint64_t));
+	memset(result+xn, 0, (size-xn)*sizeof(uint64_t));
+}
+
+// Toom-3 evaluation of x = x2*X^2+x1*X+x0 (x0, x1 of k limbs, x2 of r limbs) at 1, -1 (magnitude, returns sign) and 2,
+// each k+1 limbs
+static bool evaluateToom3(uint64_t *at1, uint64_t *atMinus1, uint64_t *at2, const uint64_t *x, size_t k, size_t r)
+{
+	const uint64_t *x0 = x, *x1 = x+k, *x2 = x+2*k;
+	// x0+x2
+	extend(at2, k+1, x0, k);
+	addInto(at2, k+1, x2, r);
+	// x0+x1+x2
+	memcpy(at1, at2, (k+1)*sizeof(uint64_t));
+	addInto(at1, k+1, x1, k);
+	// x0-x1+x2
+	bool negative = absDiff(atMinus1, at2, k+1, x1, k);
+	// ((2*x2+x1)*2)+x0
+	extend(at2, k+1, x2, r);
+	uint64_t shifted = 0;
+	for (size_t i = 0; i < k+1; ++i) {
+		uint64_t limb = at2[i];
+		at2[i] = (limb<<1)|shifted;
+		shifted = limb>>63;
+	}
+	addInto(at2, k+1, x1, k);
+	shifted = 0;
+	for (size_t i = 0; i < k+1; ++i) {
+		uint64_t limb = at2[i];
+		at2[i] = (limb<<1)|shifted;
+		shifted = limb>>63;
+	}
+	addInto(at2, k+1, x0, k);
+	return negative;
+}
+
+// Five point product c(X) = c4*X^4+...+c0, X = 2^(64k), values in m = 2k+2 limbs:
+//   w0 = c(0), w1 = c(1), wm1 = c(-1), w2 = c(2), w4 = c(inf)
+//   t3 = (w2-wm1)/3, t1 = (w1-wm1)/2, t2 = w1-w0, t3 = (t3-t2)/2-2*w4, t2 = t2-t1-w4, t1 = t1-t3
+// gives c1 = t1, c2 = t2, c3 = t3.
+static void mulToom3(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t n, MpArena *arena, bool square)
+{
+	size_t k = (n+2)/3, r = n-2*k, m = 2*k+2;
+	ArenaScope scope(arena);
+	uint64_t *w0 = arena->allocate(m);
+	uint64_t *w1 = arena->allocate(m);
+	uint64_t *wm1 = arena->allocate(m);
+	uint64_t *w2 = arena->allocate(m);
+	uint64_t *w4 = arena->allocate(m);
+	uint64_t *a1 = arena->allocate(k+1), *am1 = arena->allocate(k+1), *a2 = arena->allocate(k+1);
+	uint64_t *b1 = a1, *bm1 = am1, *b2 = a2;
+	bool negative = evaluateToom3(a1, am1, a2, a, k, r);
+	if (!square) {
+		b1 = arena->allocate(k+1);
+		bm1 = arena->allocate(k+1);
+		b2 = arena->allocate(k+1);
+		negative = negative != evaluateToom3(b1, bm1, b2, b, k, r);
+	}
+	else {
+		negative = false;
+	}
+
+	mulBalanced(w0, a, b, k, arena, square);
+	memset(w0+2*k, 0, 2*sizeof(uint64_t));
+	mulBalanced(w4, a+2*k, b+2*k, r, arena, square);
+	memset(w4+2*r, 0, (m-2*r)*sizeof(uint64_t));
+	mulBalanced(w1, a1, b1, k+1, arena, square);
+	mulBalanced(wm1, am1, bm1, k+1, arena, square);
+	if (negative)
+		negate(wm1, m);
+	mulBalanced(w2, a2, b2, k+1, arena, square);
+
+	// t3 = (w2-wm1)/3 in w2
+	subMp(w2, w2, wm1, m);
+	divideExact3(w2, m);
+	// t1 = (w1-wm1)/2 in wm1
+	subMp(wm1, w1, wm1, m);
+	halve(wm1, m);
+	// t2 = w1-w0 in w1
+	subMp(w1, w1, w0, m);
+	// t3 = (t3-t2)/2-2*w4
+	subMp(w2, w2, w1, m);
+	halve(w2, m);
+	subMp(w2, w2, w4, m);
+	subMp(w2, w2, w4, m);
+	// t2 = t2-t1-w4
+	subMp(w1, w1, wm1, m);
+	subMp(w1, w1, w4, m);
+	// t1 = t1-t3
+	subMp(wm1, wm1, w2, m);
+
+	// coefficients are non-negative and their weighted sum fits 2n limbs, so truncated additions are exact
+	extend(result, 2*n, w0, 2*k);
+	const uint64_t *coefficients[] = { wm1, w1, w2, w4 };
+	for (size_t i = 1; i <= 4; ++i) {
+		size_t offset = i*k;
+		addInto(result+offset, 2*n-offset, coefficients[i-1], std::min(m, 2*n-offset));
+	}
+}
+
+static void mulBalanced(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t n, MpArena *arena, bool square)
+{
+	size_t karatsuba = square ? mpMulThresholds.sqrKaratsuba : mpMulThresholds.karatsuba;
+	size_t toom3 = square ? mpMulThresholds.sqrToom3 : mpMulThresholds.toom3;
+	size_t ntt = square ? mpMulThresholds.sqrNtt : mpMulThresholds.ntt;
+	if (n >= ntt) {
+		if (square)
+			sqrMp_Ntt(result, a, n, arena);
+		else
+			mulMp_Ntt(result, a, n, b, n, arena);
+	}
+	else if (n >= std::max(toom3, TOOM3_MIN))
+		mulToom3(result, a, b, n, arena, square);
+	else if (n >= std::max(karatsuba, KARATSUBA_MIN))
+		mulKaratsuba(result, a, b, n, arena, square);
+	else if (square && n >= SQR_SCHOOLBOOK_MIN)
+		sqrMp_Schoolbook(result, a, n);
+	else
+		mulMp_Schoolbook(result, a, n, b, n);
+}
+
+static size_t scratchBalanced(size_t n, bool square)
+{
+	size_t karatsuba = square ? mpMulThresholds.sqrKaratsuba : mpMulThresholds.karatsuba;
+	size_t toom3 = square ? mpMulThresholds.sqrToom3 : mpMulThresholds.toom3;
+	size_t ntt = square ? mpMulThresholds.sqrNtt : mpMulThresholds.ntt;
+	if (n >= ntt) {
+		return square ? sqrMpNttScratch(n) : mulMpNttScratch(n, n);
+	}
+	else if (n >= std::max(toom3, TOOM3_MIN)) {
+		size_t k = (n+2)/3, r = n-2*k;
+		size_t own = 5*(2*k+2)+(square ? 3 : 6)*(k+1);
+		return own+std::max(scratchBalanced(k+1, square), std::max(scratchBalanced(k, square), scratchBalanced(r, square)));
+	}
+	else if (n >= std::max(karatsuba, KARATSUBA_MIN)) {
+		size_t h = n/2, l = n-h;
+		size_t own = (square ? 1 : 2)*l+2*l+2*l+1;
+		return own+std::max(scratchBalanced(l, square), scratchBalanced(h, square));
+	}
+	return 0;
+}
+
+void mulMp(uint64_t *result, const uint64_t *a, size_t an, const uint64_t *b, size_t bn, MpArena *arena)
+{
+	if (an < bn) {
+		std::swap(a, b);
+		std::swap(an, bn);
+	}
+	if (an == bn) {
+		mulBalanced(result, a, b, an, arena, false);
+		return;
+	}
+	if (bn < std::max(mpMulThresholds.karatsuba, KARATSUBA_MIN)) {
+		mulMp_Schoolbook(result, a, an, b, bn);
+		return;
+	}
+	// transform covers unbalanced operands as they are
+	if (bn >= mpMulThresholds.ntt) {
+		mulMp_Ntt(result, a, an, b, bn, arena);
+		return;
+	}
+	// pieces of a by bn limbs, each product added at the piece offset
+	mulBalanced(result, a, b, bn, arena, false);
+	ArenaScope scope(arena);
+	uint64_t *product = arena->allocate(2*bn);
+	for (size_t offset = bn; offset < an; offset += bn) {
+		size_t piece = std::min(bn, an-offset);
+		mulMp(product, b, bn, a+offset, piece, arena);
+		memcpy(result+offset+bn, product+bn, piece*sizeof(uint64_t));
+		addInto(result+offset, bn+piece, product, bn);
+	}
+}
+
+void sqrMp(uint64_t *result, const uint64_t *a, size_t size, MpArena *arena)
+{
+	mulBalanced(result, a, a, size, arena, true);
+}
+
+size_t mulMpScratch(size_t an, size_t bn)
+{
+	if (an < bn)
+		std::swap(an, bn);
+	if (an == bn)
+		return scratchBalanced(an, false);
+	if (bn < std::max(mpMulThresholds.karatsuba, KARATSUBA_MIN))
+		return 0;
+	if (bn >= mpMulThresholds.ntt)
+		return mulMpNttScratch(an, bn);
+	size_t scratch = scratchBalanced(bn, false);
+	size_t last = an%bn;
+	scratch = std::max(scratch, 2*bn+scratchBalanced(bn, false));
+	if (last != 0)
+		scratch = std::max(scratch, 2*bn+mulMpScratch(bn, last));
+	return scratch;
+}
+
+size_t sqrMpScratch(size_t size)
+{
+	return scratchBalanced(size, true);
+}
@@ -0,0 +1,763 @@
+/*
+ * Multiplication of huge numbers by number theoretic transform modulo three primes c*2^40+1 below 2^63.  The limbs are
+ * the coefficients, the product coefficients (below 2^189 up to 2^61 limbs) are rebuilt from the three residues by
+ * Garner's algorithm.
+ *
+ * Residues are kept below p and the twiddles in Montgomery form (times R = 2^64), so Montgomery product by twiddle
+ * gives plain residue.  Forward transform is decimation in frequency, natural order in and bit reversed out, inverse
+ * is decimation in time from bit reversed order, so the pointwise product needs no reordering.  Up to 2*NTT_TABLE the
+ * transform goes depth-first over halves and level by level once the block fits in cache.  Longer ones use four step
+ * (Bailey) layout of about square root of the length rows by columns: transform of the columns over strips of
+ * NTT_STRIP limbs, multiplication of row r by w^(c*rev(r)) and transform of each row, so all the levels read the
+ * twiddles from per level tables and the passes over memory are two.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+#include "Mp.hxx"
+
+
+typedef unsigned __int128 uint128_t;
+
+unsigned mpNttThreads = 1;
+
+static const unsigned NTT_PRIME_COUNT = 3;
+// p = c*2^40+1, so both p and p^-1 mod 2^64 have the low half 1, which the vector Montgomery product relies on
+static const uint64_t NTT_PRIMES[NTT_PRIME_COUNT] = { 0x7ffffe0000000001ULL, 0x7fffef0000000001ULL, 0x7fffe90000000001ULL };
+static const uint64_t NTT_GENERATORS[NTT_PRIME_COUNT] = { 7, 5, 7 };
+static const unsigned NTT_PRIME_LOG = 40;
+
+// Per level twiddle tables for half sizes up to this, so direct transform up to 2*NTT_TABLE and four step up to its
+// square
+static const size_t NTT_TABLE = (size_t)1<<15;
+static const unsigned NTT_MAX_LOG = 32;
+// Blocks up to this size are transformed level by level, above depth-first over halves
+static const size_t NTT_BLOCK = (size_t)1<<12;
+// Columns of four step transformed together, cache line of limbs
+static const size_t NTT_STRIP = 8;
+
+struct NttPrime
+{
+	uint64_t p;
+	// p^-1 mod 2^64
+	uint64_t inverse;
+	// R mod p and R^2 mod p
+	uint64_t one;
+	uint64_t r2;
+	// roots[k] of order 2^k, in Montgomery form, and their inverses
+	uint64_t roots[NTT_PRIME_LOG+1];
+	uint64_t inverseRoots[NTT_PRIME_LOG+1];
+	// forward[m+j] = roots[log(2*m)]^j for m power of two up to NTT_TABLE and j < m, backward from the inverse roots
+	std::vector<uint64_t> forward;
+	std::vector<uint64_t> backward;
+};
+
+// a*b/R mod p, a*b below p*R
+static inline uint64_t mulMod(uint64_t a, uint64_t b, const NttPrime &prime)
+{
+	uint128_t product = (uint128_t)a*b;
+	uint64_t m = (uint64_t)product*prime.inverse;
+	uint64_t high = (uint64_t)(product>>64), correction = (uint64_t)(((uint128_t)m*prime.p)>>64);
+	return high-correction+(high < correction ? prime.p : 0);
+}
+
+static inline uint64_t addMod(uint64_t a, uint64_t b, uint64_t p)
+{
+	uint64_t sum = a+b;
+	return std::min(sum, sum-p);
+}
+
+static inline uint64_t subMod(uint64_t a, uint64_t b, uint64_t p)
+{
+	uint64_t difference = a-b+p;
+	return std::min(difference, difference-p);
+}
+
+// base^exponent, base in Montgomery form
+static uint64_t powMod(uint64_t base, uint64_t exponent, const NttPrime &prime)
+{
+	uint64_t result = prime.one;
+	for (; exponent != 0; exponent >>= 1) {
+		if (exponent&1)
+			result = mulMod(result, base, prime);
+		base = mulMod(base, base, prime);
+	}
+	return result;
+}
+
+// x in Montgomery form
+static uint64_t toMontgomery(uint64_t x, const NttPrime &prime)
+{
+	return mulMod(x, prime.r2, prime);
+}
+
+static NttPrime makePrime(unsigned index)
+{
+	NttPrime prime;
+	uint64_t p = NTT_PRIMES[index];
+	prime.p = p;
+	// Newton iteration doubles the correct low bits
+	prime.inverse = 1;
+	for (int i = 0; i < 6; ++i)
+		prime.inverse *= 2-p*prime.inverse;
+	prime.one = (uint64_t)(((uint128_t)1<<64)%p);
+	prime.r2 = (uint64_t)(((uint128_t)prime.one<<64)%p);
+	uint64_t root = powMod(toMontgomery(NTT_GENERATORS[index], prime), (p-1)>>NTT_PRIME_LOG, prime);
+	uint64_t inverseRoot = powMod(root, ((uint64_t)1<<NTT_PRIME_LOG)-1, prime);
+	for (unsigned k = NTT_PRIME_LOG+1; k-- > 0; ) {
+		prime.roots[k] = root;
+		prime.inverseRoots[k] = inverseRoot;
+		root = mulMod(root, root, prime);
+		inverseRoot = mulMod(inverseRoot, inverseRoot, prime);
+	}
+	prime.forward.resize(2*NTT_TABLE);
+	prime.backward.resize(2*NTT_TABLE);
+	for (size_t m = 1, k = 1; m <= NTT_TABLE; m *= 2, ++k) {
+		prime.forward[m] = prime.backward[m] = prime.one;
+		for (size_t j = 1; j < m; ++j) {
+			prime.forward[m+j] = mulMod(prime.forward[m+j-1], prime.roots[k], prime);
+			prime.backward[m+j] = mulMod(prime.backward[m+j-1], prime.inverseRoots[k], prime);
+		}
+	}
+	return prime;
+}
+
+static const NttPrime nttPrimes[NTT_PRIME_COUNT] = { makePrime(0), makePrime(1), makePrime(2) };
+
+// Garner's algorithm in Montgomery form: x1 = r1, x2 = (r2-x1)/p1 mod p2, x3 = (r3-x1-p1*x2)/(p1*p2) mod p3, the
+// coefficient is x1+p1*x2+p1*p2*x3
+struct NttCrt
+{
+	// p1^-1 mod p2, p1 mod p3, (p1*p2)^-1 mod p3
+	uint64_t inverse12;
+	uint64_t p1mod3;
+	uint64_t inverse123;
+	// p1*p2
+	uint64_t p12[2];
+};
+
+static NttCrt makeCrt()
+{
+	const NttPrime &p2 = nttPrimes[1], &p3 = nttPrimes[2];
+	uint64_t p1 = nttPrimes[0].p;
+	NttCrt crt;
+	crt.inverse12 = powMod(toMontgomery(p1%p2.p, p2), p2.p-2, p2);
+	crt.p1mod3 = toMontgomery(p1%p3.p, p3);
+	crt.inverse123 = powMod(mulMod(crt.p1mod3, toMontgomery(p2.p%p3.p, p3), p3), p3.p-2, p3);
+	uint128_t p12 = (uint128_t)p1*p2.p;
+	crt.p12[0] = (uint64_t)p12;
+	crt.p12[1] = (uint64_t)(p12>>64);
+	return crt;
+}
+
+static const NttCrt nttCrt = makeCrt();
+
+static size_t reverseBits(size_t x, unsigned bits)
+{
+	size_t reversed = 0;
+	for (unsigned i = 0; i < bits; ++i, x >>= 1)
+		reversed = (reversed<<1)|(x&1);
+	return reversed;
+}
+
+// Butterflies of x[j], x[j+m] over the blocks of 2*m limbs in n, twiddles[j] for j < m.  Forward x+y, (x-y)*w,
+// inverse x+y*w, x-y*w.
+static void difLevel_ref(const NttPrime &prime, uint64_t *x, size_t n, size_t m, const uint64_t *twiddles)
+{
+	uint64_t p = prime.p;
+	for (size_t block = 0; block < n; block += 2*m) {
+		uint64_t *u = x+block, *v = u+m;
+		for (size_t j = 0; j < m; ++j) {
+			uint64_t a = u[j], b = v[j];
+			u[j] = addMod(a, b, p);
+			v[j] = mulMod(a-b+p, twiddles[j], prime);
+		}
+	}
+}
+
+static void ditLevel_ref(const NttPrime &prime, uint64_t *x, size_t n, size_t m, const uint64_t *twiddles)
+{
+	uint64_t p = prime.p;
+	for (size_t block = 0; block < n; block += 2*m) {
+		uint64_t *u = x+block, *v = u+m;
+		for (size_t j = 0; j < m; ++j) {
+			uint64_t a = u[j], b = mulMod(v[j], twiddles[j], prime);
+			u[j] = addMod(a, b, p);
+			v[j] = subMod(a, b, p);
+		}
+	}
+}
+
+// Butterflies of x[i], y[i] for i < count by single twiddle
+static void difRows_ref(const NttPrime &prime, uint64_t *x, uint64_t *y, size_t count, uint64_t twiddle)
+{
+	uint64_t p = prime.p;
+	for (size_t i = 0; i < count; ++i) {
+		uint64_t a = x[i], b = y[i];
+		x[i] = addMod(a, b, p);
+		y[i] = mulMod(a-b+p, twiddle, prime);
+	}
+}
+
+static void ditRows_ref(const NttPrime &prime, uint64_t *x, uint64_t *y, size_t count, uint64_t twiddle)
+{
+	uint64_t p = prime.p;
+	for (size_t i = 0; i < count; ++i) {
+		uint64_t a = x[i], b = mulMod(y[i], twiddle, prime);
+		x[i] = addMod(a, b, p);
+		y[i] = subMod(a, b, p);
+	}
+}
+
+// x[i] *= w^i, w in Montgomery form
+static void scalePowers_ref(const NttPrime &prime, uint64_t *x, size_t count, uint64_t w)
+{
+	uint64_t power = prime.one;
+	for (size_t i = 0; i < count; ++i) {
+		x[i] = mulMod(x[i], power, prime);
+		power = mulMod(power, w, prime);
+	}
+}
+
+// x[i] = x[i]*y[i]*scale/R^2
+static void pointwise_ref(const NttPrime &prime, uint64_t *x, const uint64_t *y, size_t count, uint64_t scale)
+{
+	for (size_t i = 0; i < count; ++i)
+		x[i] = mulMod(mulMod(x[i], y[i], prime), scale, prime);
+}
+
+#ifdef __x86_64__
+
+struct NttVectorPrime
+{
+	__m512i p;
+	// high halves of p and p^-1 mod 2^64, the low ones are 1
+	__m512i pHigh;
+	__m512i inverseHigh;
+};
+
+__attribute__((target("avx512f")))
+static inline NttVectorPrime vectorPrime(const NttPrime &prime)
+{
+	return NttVectorPrime{ _mm512_set1_epi64(prime.p), _mm512_set1_epi64(prime.p>>32), _mm512_set1_epi64(prime.inverse>>32) };
+}
+
+// Montgomery product lane by lane, 64-bit products from four 32-bit ones, while m = low*p^-1 and the high half of
+// m*p need only one and two thanks to the low halves 1
+__attribute__((target("avx512f")))
+static inline __m512i mulModAvx512(__m512i a, __m512i b, const NttVectorPrime &prime)
+{
+	const __m512i low32 = _mm512_set1_epi64(0xffffffffULL);
+	__m512i aHigh = _mm512_srli_epi64(a, 32), bHigh = _mm512_srli_epi64(b, 32);
+	__m512i ll = _mm512_mul_epu32(a, b), lh = _mm512_mul_epu32(a, bHigh);
+	__m512i hl = _mm512_mul_epu32(aHigh, b), hh = _mm512_mul_epu32(aHigh, bHigh);
+	__m512i middle = _mm512_add_epi64(_mm512_add_epi64(_mm512_srli_epi64(ll, 32), _mm512_and_si512(lh, low32)), _mm512_and_si512(hl, low32));
+	__m512i high = _mm512_add_epi64(_mm512_add_epi64(hh, _mm512_srli_epi64(lh, 32)), _mm512_add_epi64(_mm512_srli_epi64(hl, 32), _mm512_srli_epi64(middle, 32)));
+	__m512i low = _mm512_or_si512(_mm512_slli_epi64(middle, 32), _mm512_and_si512(ll, low32));
+	__m512i m = _mm512_add_epi64(low, _mm512_slli_epi64(_mm512_mul_epu32(low, prime.inverseHigh), 32));
+	// m*p = m + (mLow*pHigh)<<32 + (mHigh*pHigh)<<64
+	__m512i x = _mm512_mul_epu32(m, prime.pHigh), y = _mm512_mul_epu32(_mm512_srli_epi64(m, 32), prime.pHigh);
+	__m512i sum = _mm512_add_epi64(m, _mm512_slli_epi64(x, 32));
+	__m512i correction = _mm512_add_epi64(y, _mm512_srli_epi64(x, 32));
+	correction = _mm512_mask_add_epi64(correction, _mm512_cmplt_epu64_mask(sum, m), correction, _mm512_set1_epi64(1));
+	__m512i result = _mm512_sub_epi64(high, correction);
+	return _mm512_mask_add_epi64(result, _mm512_cmplt_epu64_mask(high, correction), result, prime.p);
+}
+
+__attribute__((target("avx512f")))
+static inline void difButterflyAvx512(__m512i *a, __m512i *b, __m512i w, const NttVectorPrime &prime)
+{
+	__m512i sum = _mm512_add_epi64(*a, *b);
+	__m512i difference = _mm512_add_epi64(_mm512_sub_epi64(*a, *b), prime.p);
+	*a = _mm512_min_epu64(sum, _mm512_sub_epi64(sum, prime.p));
+	*b = mulModAvx512(difference, w, prime);
+}
+
+__attribute__((target("avx512f")))
+static inline void ditButterflyAvx512(__m512i *a, __m512i *b, __m512i w, const NttVectorPrime &prime)
+{
+	__m512i t = mulModAvx512(*b, w, prime);
+	__m512i sum = _mm512_add_epi64(*a, t);
+	__m512i difference = _mm512_add_epi64(_mm512_sub_epi64(*a, t), prime.p);
+	*a = _mm512_min_epu64(sum, _mm512_sub_epi64(sum, prime.p));
+	*b = _mm512_min_epu64(difference, _mm512_sub_epi64(difference, prime.p));
+}
+
+// Half sizes below the vector: two vectors of 16 limbs permuted into the u and v lanes and back
+struct NttSmallLevel
+{
+	__m512i gatherU;
+	__m512i gatherV;
+	__m512i scatter0;
+	__m512i scatter1;
+	__m512i twiddles;
+};
+
+__attribute__((target("avx512f")))
+static NttSmallLevel smallLevel(size_t m, const uint64_t *twiddles)
+{
+	uint64_t gatherU[8], gatherV[8], scatter[16], w[8];
+	for (unsigned e = 0, u = 0, v = 0; e < 16; ++e) {
+		if ((e&m) == 0) {
+			w[u] = twiddles[e&(m-1)];
+			gatherU[u] = e;
+			scatter[e] = u++;
+		}
+		else {
+			gatherV[v] = e;
+			scatter[e] = 8+v++;
+		}
+	}
+	return NttSmallLevel{ _mm512_loadu_si512(gatherU), _mm512_loadu_si512(gatherV), _mm512_loadu_si512(scatter), _mm512_loadu_si512(scatter+8), _mm512_loadu_si512(w) };
+}
+
+template <bool DIT>
+__attribute__((target("avx512f")))
+static void levelAvx512(const NttPrime &prime, uint64_t *x, size_t n, size_t m, const uint64_t *twiddles)
+{
+	NttVectorPrime vector = vectorPrime(prime);
+	if (m >= 8) {
+		for (size_t block = 0; block < n; block += 2*m) {
+			uint64_t *u = x+block, *v = u+m;
+			for (size_t j = 0; j < m; j += 8) {
+				__m512i a = _mm512_loadu_si512(u+j), b = _mm512_loadu_si512(v+j), w = _mm512_loadu_si512(twiddles+j);
+				if (DIT)
+					ditButterflyAvx512(&a, &b, w, vector);
+				else
+					difButterflyAvx512(&a, &b, w, vector);
+				_mm512_storeu_si512(u+j, a);
+				_mm512_storeu_si512(v+j, b);
+			}
+		}
+	}
+	else if (n >= 16) {
+		NttSmallLevel level = smallLevel(m, twiddles);
+		for (size_t i = 0; i < n; i += 16) {
+			__m512i x0 = _mm512_loadu_si512(x+i), x1 = _mm512_loadu_si512(x+i+8);
+			__m512i a = _mm512_permutex2var_epi64(x0, level.gatherU, x1), b = _mm512_permutex2var_epi64(x0, level.gatherV, x1);
+			if (DIT)
+				ditButterflyAvx512(&a, &b, level.twiddles, vector);
+			else
+				difButterflyAvx512(&a, &b, level.twiddles, vector);
+			_mm512_storeu_si512(x+i, _mm512_permutex2var_epi64(a, level.scatter0, b));
+			_mm512_storeu_si512(x+i+8, _mm512_permutex2var_epi64(a, level.scatter1, b));
+		}
+	}
+	else if (DIT) {
+		ditLevel_ref(prime, x, n, m, twiddles);
+	}
+	else {
+		difLevel_ref(prime, x, n, m, twiddles);
+	}
+}
+
+__attribute__((target("avx512f")))
+static void difLevel_Avx512(const NttPrime &prime, uint64_t *x, size_t n, size_t m, const uint64_t *twiddles)
+{
+	levelAvx512<false>(prime, x, n, m, twiddles);
+}
+
+__attribute__((target("avx512f")))
+static void ditLevel_Avx512(const NttPrime &prime, uint64_t *x, size_t n, size_t m, const uint64_t *twiddles)
+{
+	levelAvx512<true>(prime, x, n, m, twiddles);
+}
+
+__attribute__((target("avx512f")))
+static void difRows_Avx512(const NttPrime &prime, uint64_t *x, uint64_t *y, size_t count, uint64_t twiddle)
+{
+	NttVectorPrime vector = vectorPrime(prime);
+	__m512i w = _mm512_set1_epi64(twiddle);
+	size_t i = 0;
+	for (; i+8 <= count; i += 8) {
+		__m512i a = _mm512_loadu_si512(x+i), b = _mm512_loadu_si512(y+i);
+		difButterflyAvx512(&a, &b, w, vector);
+		_mm512_storeu_si512(x+i, a);
+		_mm512_storeu_si512(y+i, b);
+	}
+	difRows_ref(prime, x+i, y+i, count-i, twiddle);
+}
+
+__attribute__((target("avx512f")))
+static void ditRows_Avx512(const NttPrime &prime, uint64_t *x, uint64_t *y, size_t count, uint64_t twiddle)
+{
+	NttVectorPrime vector = vectorPrime(prime);
+	__m512i w = _mm512_set1_epi64(twiddle);
+	size_t i = 0;
+	for (; i+8 <= count; i += 8) {
+		__m512i a = _mm512_loadu_si512(x+i), b = _mm512_loadu_si512(y+i);
+		ditButterflyAvx512(&a, &b, w, vector);
+		_mm512_storeu_si512(x+i, a);
+		_mm512_storeu_si512(y+i, b);
+	}
+	ditRows_ref(prime, x+i, y+i, count-i, twiddle);
+}
+
+// Eight powers at once, stepped by w^8
+__attribute__((target("avx512f")))
+static void scalePowers_Avx512(const NttPrime &prime, uint64_t *x, size_t count, uint64_t w)
+{
+	NttVectorPrime vector = vectorPrime(prime);
+	uint64_t first[8];
+	first[0] = prime.one;
+	for (int l = 1; l < 8; ++l)
+		first[l] = mulMod(first[l-1], w, prime);
+	__m512i powers = _mm512_loadu_si512(first), step = _mm512_set1_epi64(mulMod(first[7], w, prime));
+	size_t i = 0;
+	for (; i+8 <= count; i += 8) {
+		_mm512_storeu_si512(x+i, mulModAvx512(_mm512_loadu_si512(x+i), powers, vector));
+		powers = mulModAvx512(powers, step, vector);
+	}
+	_mm512_storeu_si512(first, powers);
+	for (size_t l = 0; i < count; ++i, ++l)
+		x[i] = mulMod(x[i], first[l], prime);
+}
+
+__attribute__((target("avx512f")))
+static void pointwise_Avx512(const NttPrime &prime, uint64_t *x, const uint64_t *y, size_t count, uint64_t scale)
+{
+	NttVectorPrime vector = vectorPrime(prime);
+	__m512i s = _mm512_set1_epi64(scale);
+	size_t i = 0;
+	for (; i+8 <= count; i += 8)
+		_mm512_storeu_si512(x+i, mulModAvx512(mulModAvx512(_mm512_loadu_si512(x+i), _mm512_loadu_si512(y+i), vector), s, vector));
+	pointwise_ref(prime, x+i, y+i, count-i, scale);
+}
+
+#endif
+
+struct NttKernel
+{
+	void (*difLevel)(const NttPrime &prime, uint64_t *x, size_t n, size_t m, const uint64_t *twiddles);
+	void (*ditLevel)(const NttPrime &prime, uint64_t *x, size_t n, size_t m, const uint64_t *twiddles);
+	void (*difRows)(const NttPrime &prime, uint64_t *x, uint64_t *y, size_t count, uint64_t twiddle);
+	void (*ditRows)(const NttPrime &prime, uint64_t *x, uint64_t *y, size_t count, uint64_t twiddle);
+	void (*scalePowers)(const NttPrime &prime, uint64_t *x, size_t count, uint64_t w);
+	void (*pointwise)(const NttPrime &prime, uint64_t *x, const uint64_t *y, size_t count, uint64_t scale);
+	const char *name;
+};
+
+static const NttKernel nttKernelRef = { &difLevel_ref, &ditLevel_ref, &difRows_ref, &ditRows_ref, &scalePowers_ref, &pointwise_ref, "ref" };
+#ifdef __x86_64__
+static const NttKernel nttKernelAvx512 = { &difLevel_Avx512, &ditLevel_Avx512, &difRows_Avx512, &ditRows_Avx512, &scalePowers_Avx512, &pointwise_Avx512, "avx512" };
+#endif
+
+static const NttKernel &selectNttKernel()
+{
+#ifdef __x86_64__
+	if (__builtin_cpu_supports("avx512f"))
+		return nttKernelAvx512;
+#endif
+	return nttKernelRef;
+}
+
+static const NttKernel &nttKernel = selectNttKernel();
+
+static unsigned resolveThreads()
+{
+	return mpNttThreads != 0 ? mpNttThreads : std::max(1u, std::thread::hardware_concurrency());
+}
+
+// task(begin, end) over contiguous ranges of count, one per thread
+static void forRanges(unsigned threads, size_t count, const std::function<void(size_t begin, size_t end)> &task)
+{
+	unsigned used = (unsigned)std::min((size_t)threads, count);
+	if (used <= 1) {
+		task(0, count);
+		return;
+	}
+	runMpThreads(used, [&](unsigned index) {
+		task(count*index/used, count*(index+1)/used);
+	});
+}
+
+static void forwardDirect(const NttKernel &kernel, const NttPrime &prime, uint64_t *x, size_t n)
+{
+	if (n > NTT_BLOCK) {
+		kernel.difLevel(prime, x, n, n/2, prime.forward.data()+n/2);
+		forwardDirect(kernel, prime, x, n/2);
+		forwardDirect(kernel, prime, x+n/2, n/2);
+		return;
+	}
+	for (size_t m = n/2; m >= 1; m /= 2)
+		kernel.difLevel(prime, x, n, m, prime.forward.data()+m);
+}
+
+static void inverseDirect(const NttKernel &kernel, const NttPrime &prime, uint64_t *x, size_t n)
+{
+	if (n > NTT_BLOCK) {
+		inverseDirect(kernel, prime, x, n/2);
+		inverseDirect(kernel, prime, x+n/2, n/2);
+		kernel.ditLevel(prime, x, n, n/2, prime.backward.data()+n/2);
+		return;
+	}
+	for (size_t m = 1; m < n; m *= 2)
+		kernel.ditLevel(prime, x, n, m, prime.backward.data()+m);
+}
+
+// Strip of columns over rows stride limbs apart, depth-first over halves of the rows
+static void forwardColumns(const NttKernel &kernel, const NttPrime &prime, uint64_t *x, size_t rows, size_t stride)
+{
+	size_t m = rows/2;
+	for (size_t r = 0; r < m; ++r)
+		kernel.difRows(prime, x+r*stride, x+(r+m)*stride, NTT_STRIP, prime.forward[m+r]);
+	if (m > 1) {
+		forwardColumns(kernel, prime, x, m, stride);
+		forwardColumns(kernel, prime, x+m*stride, m, stride);
+	}
+}
+
+static void inverseColumns(const NttKernel &kernel, const NttPrime &prime, uint64_t *x, size_t rows, size_t stride)
+{
+	size_t m = rows/2;
+	if (m > 1) {
+		inverseColumns(kernel, prime, x, m, stride);
+		inverseColumns(kernel, prime, x+m*stride, m, stride);
+	}
+	for (size_t r = 0; r < m; ++r)
+		kernel.ditRows(prime, x+r*stride, x+(r+m)*stride, NTT_STRIP, prime.backward[m+r]);
+}
+
+// Strip of NTT_STRIP limbs over rows between the power of two strides, which would map to the same cache sets
+static void copyStrip(uint64_t *target, size_t targetStride, const uint64_t *source, size_t sourceStride, size_t rows)
+{
+	for (size_t r = 0; r < rows; ++r)
+		memcpy(target+r*targetStride, source+r*sourceStride, NTT_STRIP*sizeof(uint64_t));
+}
+
+static unsigned lengthLog(size_t length)
+{
+	if (length > (size_t)1<<NTT_MAX_LOG)
+		throw std::length_error("NTT length exceeds 2^32");
+	return __builtin_ctzll(length);
+}
+
+// Four step: with length = rows*columns and index c+columns*r, the transform is column transforms over r, row r times
+// w^(c*rev(r)) and row transforms over c, which leaves the whole in bit reversed order
+static void forward(const NttKernel &kernel, const NttPrime &prime, uint64_t *x, size_t length, unsigned threads)
+{
+	unsigned log = lengthLog(length);
+	if (length <= 2*NTT_TABLE) {
+		forwardDirect(kernel, prime, x, length);
+		return;
+	}
+	unsigned rowsLog = log/2;
+	size_t rows = (size_t)1<<rowsLog, columns = length/rows;
+	forRanges(threads, columns/NTT_STRIP, [&](size_t begin, size_t end) {
+		std::vector<uint64_t> buffer(rows*NTT_STRIP);
+		for (size_t strip = begin; strip < end; ++strip) {
+			copyStrip(buffer.data(), NTT_STRIP, x+strip*NTT_STRIP, columns, rows);
+			forwardColumns(kernel, prime, buffer.data(), rows, NTT_STRIP);
+			copyStrip(x+strip*NTT_STRIP, columns, buffer.data(), NTT_STRIP, rows);
+		}
+	});
+	forRanges(threads, rows, [&](size_t begin, size_t end) {
+		for (size_t r = begin; r < end; ++r) {
+			kernel.scalePowers(prime, x+r*columns, columns, powMod(prime.roots[log], reverseBits(r, rowsLog), prime));
+			forwardDirect(kernel, prime, x+r*columns, columns);
+		}
+	});
+}
+
+static void inverse(const NttKernel &kernel, const NttPrime &prime, uint64_t *x, size_t length, unsigned threads)
+{
+	unsigned log = lengthLog(length);
+	if (length <= 2*NTT_TABLE) {
+		inverseDirect(kernel, prime, x, length);
+		return;
+	}
+	unsigned rowsLog = log/2;
+	size_t rows = (size_t)1<<rowsLog, columns = length/rows;
+	forRanges(threads, rows, [&](size_t begin, size_t end) {
+		for (size_t r = begin; r < end; ++r) {
+			inverseDirect(kernel, prime, x+r*columns, columns);
+			kernel.scalePowers(prime, x+r*columns, columns, powMod(prime.inverseRoots[log], reverseBits(r, rowsLog), prime));
+		}
+	});
+	forRanges(threads, columns/NTT_STRIP, [&](size_t begin, size_t end) {
+		std::vector<uint64_t> buffer(rows*NTT_STRIP);
+		for (size_t strip = begin; strip < end; ++strip) {
+			copyStrip(buffer.data(), NTT_STRIP, x+strip*NTT_STRIP, columns, rows);
+			inverseColumns(kernel, prime, buffer.data(), rows, NTT_STRIP);
+			copyStrip(x+strip*NTT_STRIP, columns, buffer.data(), NTT_STRIP, rows);
+		}
+	});
+}
+
+static size_t transformLength(size_t an, size_t bn)
+{
+	size_t length = 1;
+	while (length < an+bn-1)
+		length *= 2;
+	lengthLog(length);
+	return length;
+}
+
+// x = a mod p, zero padded to length
+static void load(uint64_t *x, size_t length, const uint64_t *a, size_t an, uint64_t p, unsigned threads)
+{
+	forRanges(threads, length, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < std::min(end, an); ++i) {
+			uint64_t reduced = std::min(a[i], a[i]-2*p);
+			x[i] = std::min(reduced, reduced-p);
+		}
+		if (end > an)
+			memset(x+std::max(begin, an), 0, (end-std::max(begin, an))*sizeof(uint64_t));
+	});
+}
+
+// Coefficients begin to end added to result limbs, the part above end returned in spill
+static void combineRange(uint64_t *result, size_t begin, size_t end, uint64_t *const residues[], size_t length, uint64_t spill[2])
+{
+	const NttPrime &prime2 = nttPrimes[1], &prime3 = nttPrimes[2];
+	uint64_t p1 = nttPrimes[0].p, p2 = prime2.p, p3 = prime3.p;
+	uint64_t low = 0, high = 0;
+	for (size_t i = begin; i < end; ++i) {
+		uint64_t x1 = 0, x2 = 0, x3 = 0;
+		if (i < length) {
+			x1 = residues[0][i];
+			x2 = mulMod(residues[1][i]-std::min(x1, x1-p2)+p2, nttCrt.inverse12, prime2);
+			uint64_t known = addMod(std::min(x1, x1-p3), mulMod(x2, nttCrt.p1mod3, prime3), p3);
+			x3 = mulMod(residues[2][i]-known+p3, nttCrt.inverse123, prime3);
+		}
+		uint128_t first = (uint128_t)p1*x2+x1;
+		uint128_t second = (uint128_t)nttCrt.p12[0]*x3;
+		uint128_t third = (uint128_t)nttCrt.p12[1]*x3;
+		uint128_t sum = (uint128_t)low+(uint64_t)first+(uint64_t)second;
+		result[i] = (uint64_t)sum;
+		sum = (sum>>64)+high+(uint64_t)(first>>64)+(uint64_t)(second>>64)+(uint64_t)third;
+		low = (uint64_t)sum;
+		high = (uint64_t)(sum>>64)+(uint64_t)(third>>64);
+	}
+	spill[0] = low;
+	spill[1] = high;
+}
+
+// Ranges combined by threads, each spill carried into the following range afterwards
+static void combine(uint64_t *result, size_t size, uint64_t *const residues[], size_t length, unsigned threads)
+{
+	unsigned used = (unsigned)std::min((size_t)threads, size/2);
+	if (used <= 1) {
+		uint64_t spill[2];
+		combineRange(result, 0, size, residues, length, spill);
+		return;
+	}
+	std::vector<uint64_t> spills(2*used);
+	runMpThreads(used, [&](unsigned index) {
+		combineRange(result, size*index/used, size*(index+1)/used, residues, length, &spills[2*index]);
+	});
+	for (unsigned index = 0; index+1 < used; ++index) {
+		size_t end = size*(index+1)/used;
+		uint64_t carry = addMp(result+end, result+end, &spills[2*index], 2);
+		for (size_t i = end+2; carry != 0 && i < size; ++i)
+			carry = ++result[i] == 0;
+	}
+}
+
+static void mulNtt(const NttKernel &kernel, uint64_t *result, const uint64_t *a, size_t an, const uint64_t *b, size_t bn, MpArena *arena, bool square)
+{
+	size_t length = transformLength(an, bn);
+	unsigned threads = resolveThreads();
+	size_t mark = arena->mark();
+	uint64_t *residues[NTT_PRIME_COUNT];
+	for (unsigned k = 0; k < NTT_PRIME_COUNT; ++k)
+		residues[k] = arena->allocate(length);
+	uint64_t *other = square ? nullptr : arena->allocate(length);
+	for (unsigned k = 0; k < NTT_PRIME_COUNT; ++k) {
+		const NttPrime &prime = nttPrimes[k];
+		uint64_t *x = residues[k];
+		load(x, length, a, an, prime.p, threads);
+		forward(kernel, prime, x, length, threads);
+		const uint64_t *y = x;
+		if (!square) {
+			load(other, length, b, bn, prime.p, threads);
+			forward(kernel, prime, other, length, threads);
+			y = other;
+		}
+		// R^2/length cancels the R^-1 of the product and the length of the inverse transform
+		uint64_t scale = toMontgomery(toMontgomery(prime.p-(prime.p-1)/length, prime), prime);
+		forRanges(threads, length, [&](size_t begin, size_t end) {
+			kernel.pointwise(prime, x+begin, y+begin, end-begin, scale);
+		});
+		inverse(kernel, prime, x, length, threads);
+	}
+	combine(result, an+bn, residues, length, threads);
+	arena->rewind(mark);
+}
+
+void mulMp_Ntt(uint64_t *result, const uint64_t *a, size_t an, const uint64_t *b, size_t bn, MpArena *arena)
+{
+	mulNtt(nttKernel, result, a, an, b, bn, arena, false);
+}
+
+void sqrMp_Ntt(uint64_t *result, const uint64_t *a, size_t size, MpArena *arena)
+{
+	mulNtt(nttKernel, result, a, size, a, size, arena, true);
+}
+
+size_t mulMpNttScratch(size_t an, size_t bn)
+{
+	return (NTT_PRIME_COUNT+1)*transformLength(an, bn);
+}
+
+size_t sqrMpNttScratch(size_t size)
+{
+	return NTT_PRIME_COUNT*transformLength(size, size);
+}
+
+uint64_t nttPrimeMp(unsigned prime)
+{
+	return NTT_PRIMES[prime];
+}
+
+void nttForwardMp_ref(uint64_t *x, size_t length, unsigned prime)
+{
+	forward(nttKernelRef, nttPrimes[prime], x, length, resolveThreads());
+}
+
+void nttInverseMp_ref(uint64_t *x, size_t length, unsigned prime)
+{
+	inverse(nttKernelRef, nttPrimes[prime], x, length, resolveThreads());
+}
+
+#ifdef __x86_64__
+
+void nttForwardMp_Avx512(uint64_t *x, size_t length, unsigned prime)
+{
+	forward(nttKernelAvx512, nttPrimes[prime], x, length, resolveThreads());
+}
+
+void nttInverseMp_Avx512(uint64_t *x, size_t length, unsigned prime)
+{
+	inverse(nttKernelAvx512, nttPrimes[prime], x, length, resolveThreads());
+}
+
+#endif
+
+void nttForwardMp(uint64_t *x, size_t length, unsigned prime)
+{
+	forward(nttKernel, nttPrimes[prime], x, length, resolveThreads());
+}
+
+void nttInverseMp(uint64_t *x, size_t length, unsigned prime)
+{
+	inverse(nttKernel, nttPrimes[prime], x, length, resolveThreads());
+}
+
+const char *nttMpSelected()
+{
+	return nttKernel.name;
+}
@@ -0,0 +1,157 @@
+/*
+ * Parallel addition and subtraction of very large numbers over segments.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stdint.h>
+#include <stddef.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Mp.hxx"
+
+
+size_t mpParallelThreshold = 1<<17;
+
+// Segment boundaries on cache lines, so the threads do not share them
+static const size_t SEGMENT_ALIGN = 8;
+
+// Workers started on first use and kept waiting for the next task, as thread start costs more than addition of
+// hundred thousand limbs
+class MpThreadPool
+{
+public:
+	MpThreadPool():
+		busy(false),
+		task(nullptr),
+		generation(0),
+		count(0),
+		pending(0),
+		stopping(false)
+	{
+	}
+
+	~MpThreadPool()
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread &worker: workers)
+			worker.join();
+	}
+
+	// Runs task(0) ... task(count-1), task(0) on the calling thread, returns when all are done.  The pool serves single
+	// call at a time, concurrent callers and tasks calling it again run all the tasks on their own thread in order.
+	void run(unsigned count, const std::function<void(unsigned index)> &task)
+	{
+		if (busy.exchange(true, std::memory_order_acquire)) {
+			for (unsigned index = 0; index < count; ++index)
+				task(index);
+			return;
+		}
+		std::unique_lock<std::mutex> lock(mutex);
+		while (workers.size()+1 < count)
+			workers.emplace_back(&MpThreadPool::work, this, (unsigned)workers.size()+1);
+		this->task = &task;
+		this->count = count;
+		pending = count-1;
+		++generation;
+		lock.unlock();
+		wake.notify_all();
+		task(0);
+		lock.lock();
+		done.wait(lock, [this]() { return pending == 0; });
+		this->task = nullptr;
+		lock.unlock();
+		busy.store(false, std::memory_order_release);
+	}
+
+private:
+	void work(unsigned index)
+	{
+		unsigned seen = 0;
+		std::unique_lock<std::mutex> lock(mutex);
+		for (;;) {
+			wake.wait(lock, [this, seen]() { return stopping || generation != seen; });
+			if (stopping)
+				return;
+			seen = generation;
+			if (index >= count)
+				continue;
+			const std::function<void(unsigned)> &current = *task;
+			lock.unlock();
+			current(index);
+			lock.lock();
+			if (--pending == 0)
+				done.notify_one();
+		}
+	}
+
+	std::atomic<bool> busy;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	std::vector<std::thread> workers;
+	const std::function<void(unsigned)> *task;
+	unsigned generation;
+	unsigned count;
+	unsigned pending;
+	bool stopping;
+};
+
+static MpThreadPool &threadPool()
+{
+	static MpThreadPool pool;
+	return pool;
+}
+
+void runMpThreads(unsigned count, const std::function<void(unsigned index)> &task)
+{
+	threadPool().run(count, task);
+}
+
+// Segments computed without carry in, then the carry (borrow) out of each is rippled into the next one in order.  The
+// ripple stops at the first limb not all ones (all zeros), so it is single limb per segment unless the segment result
+// is all ones, where it carries further.
+template <bool SUB>
+static uint64_t addSubMpParallel(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t size, unsigned threads)
+{
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	size_t segment = (size/threads+SEGMENT_ALIGN-1)&~(SEGMENT_ALIGN-1);
+	if (threads == 1 || size < mpParallelThreshold || segment == 0)
+		return SUB ? subMp(result, a, b, size) : addMp(result, a, b, size);
+	unsigned segments = (unsigned)((size+segment-1)/segment);
+	std::vector<uint64_t> carries(segments);
+	threadPool().run(segments, [&](unsigned index) {
+		size_t begin = index*segment, length = std::min(segment, size-begin);
+		carries[index] = SUB ? subMp(result+begin, a+begin, b+begin, length) : addMp(result+begin, a+begin, b+begin, length);
+	});
+	uint64_t carry = 0;
+	for (unsigned index = 0; index < segments; ++index) {
+		size_t begin = index*segment, end = std::min(begin+segment, size);
+		for (size_t i = begin; carry != 0 && i < end; ++i)
+			carry = SUB ? result[i]-- == 0 : ++result[i] == 0;
+		// both cannot be set: segment result all ones (zeros) excludes carry (borrow) out of it
+		carry |= carries[index];
+	}
+	return carry;
+}
+
+uint64_t addMpParallel(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t size, unsigned threads)
+{
+	return addSubMpParallel<false>(result, a, b, size, threads);
+}
+
+uint64_t subMpParallel(uint64_t *result, const uint64_t *a, const uint64_t *b, size_t size, unsigned threads)
+{
+	return addSubMpParallel<true>(result, a, b, size, threads);
+}
@@ -43,5 +43,11 @@ union Vector4 {
 #endif
 };
 
+// Axis aligned bounding box, as center and non-negative half-extent, w components are ignored on input
+struct Aabb {
+	Vector4 center;
+	Vector4 extent;
+};
+
 
 #endif
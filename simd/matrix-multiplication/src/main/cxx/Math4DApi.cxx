@@ -0,0 +1,360 @@
+/*
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <string.h>
+#include <atomic>
+#include <chrono>
+
+#include "Math4DKernels.hxx"
+#include "Math4DApi.h"
+
+
+typedef void (*MatmultFunction)(Mat44 *out, const Mat44 &A, const Mat44 &B);
+typedef void (*VecmultFunction)(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m);
+typedef void (*VecTmultFunction)(Vector4 *out, const Mat44 &m, const Vector4 *in, size_t count);
+typedef void (*AabbmultFunction)(Aabb *out, const Aabb *in, size_t count, const Mat44 &m);
+typedef void (*SpheremultFunction)(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m);
+typedef void (*AabbcullFunction)(uint64_t *visible, const Aabb *in, size_t count, const Mat44 &m, const Vector4 *planes);
+
+// Selected variants, indexes into variant tables, -1 if not selected yet
+static std::atomic<int> matmultSelected(-1);
+static std::atomic<int> vecmultSelected(-1);
+static std::atomic<int> vecTmultSelected(-1);
+static std::atomic<int> aabbmultSelected(-1);
+static std::atomic<int> spheremultSelected(-1);
+static std::atomic<int> aabbcullSelected(-1);
+
+bool math4dCpuSupports(unsigned features)
+{
+#ifdef __x86_64__
+	__builtin_cpu_init();
+	if ((features&MATH4D_SSE3) && !__builtin_cpu_supports("sse3"))
+		return false;
+	if ((features&MATH4D_AVX) && !__builtin_cpu_supports("avx"))
+		return false;
+	if ((features&MATH4D_AVX2_FMA) && !(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")))
+		return false;
+	if ((features&MATH4D_AVX512) && !(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("fma")))
+		return false;
+	return true;
+#else
+	return features == 0;
+#endif
+}
+
+// Calibration data, the values only need to be finite and not trivial
+static void calibrationData(Mat44 *m, Vector4 *vectors, size_t count)
+{
+	for (int i = 0; i < 4; ++i) {
+		for (int j = 0; j < 4; ++j) {
+			m->m[i][j] = (float)(i*4+j+1)/16;
+		}
+	}
+	for (size_t c = 0; c < count; ++c) {
+		for (int j = 0; j < 4; ++j) {
+			vectors[c].m[j] = (float)(c+j)/8;
+		}
+	}
+}
+
+// Runs the benchmark few times and returns the best time, as in benchmark, the best is least affected by interruptions
+template <typename F>
+static double calibrationTime(F benchmark)
+{
+	double best = 1e30;
+	for (int run = 0; run < 8; ++run) {
+		auto start = std::chrono::steady_clock::now();
+		for (int r = 0; r < 64; ++r) {
+			benchmark();
+		}
+		std::chrono::duration<double> duration(std::chrono::steady_clock::now()-start);
+		if (duration.count() < best)
+			best = duration.count();
+	}
+	return best;
+}
+
+static int calibrateMatmult()
+{
+	static const size_t count = 16;
+	Mat44 m, in[count], out[count];
+	Vector4 unused[1];
+	calibrationData(&m, unused, 0);
+	for (size_t c = 0; c < count; ++c)
+		in[c] = m;
+
+	int best = 0;
+	double bestTime = 1e30;
+	for (size_t i = 0; i < matmult_variants_count; ++i) {
+		if (!math4dCpuSupports(matmult_variants[i].features))
+			continue;
+		MatmultFunction matmult = matmult_variants[i].matmult;
+		double time = calibrationTime([&]() { for (size_t c = 0; c < count; ++c) matmult(&out[c], in[c], m); });
+		if (time < bestTime) {
+			bestTime = time;
+			best = (int)i;
+		}
+	}
+	return best;
+}
+
+static int calibrateVecmult()
+{
+	static const size_t count = 64;
+	Mat44 m;
+	Vector4 in[count], out[count];
+	calibrationData(&m, in, count);
+
+	int best = 0;
+	double bestTime = 1e30;
+	for (size_t i = 0; i < vecmult_variants_count; ++i) {
+		if (!math4dCpuSupports(vecmult_variants[i].features))
+			continue;
+		VecmultFunction vecmult = vecmult_variants[i].vecmult;
+		double time = calibrationTime([&]() { vecmult(out, in, count, m); });
+		if (time < bestTime) {
+			bestTime = time;
+			best = (int)i;
+		}
+	}
+	return best;
+}
+
+static int calibrateVecTmult()
+{
+	static const size_t count = 64;
+	Mat44 m;
+	Vector4 in[count], out[count];
+	calibrationData(&m, in, count);
+
+	int best = 0;
+	double bestTime = 1e30;
+	for (size_t i = 0; i < vecTmult_variants_count; ++i) {
+		if (!math4dCpuSupports(vecTmult_variants[i].features))
+			continue;
+		VecTmultFunction vecTmult = vecTmult_variants[i].vecTmult;
+		double time = calibrationTime([&]() { vecTmult(out, m, in, count); });
+		if (time < bestTime) {
+			bestTime = time;
+			best = (int)i;
+		}
+	}
+	return best;
+}
+
+// Boxes built from the calibration vectors, the matrix is made affine
+static void calibrationBoxes(Mat44 *m, Aabb *boxes, Vector4 *planes, size_t count)
+{
+	calibrationData(m, NULL, 0);
+	for (int i = 0; i < 3; ++i)
+		m->m[i][3] = 0;
+	m->m[3][3] = 1;
+	for (size_t c = 0; c < count; ++c) {
+		for (int j = 0; j < 4; ++j) {
+			boxes[c].center.m[j] = (float)(c+j)/8;
+			boxes[c].extent.m[j] = (float)(j+1)/8;
+		}
+	}
+	for (int p = 0; p < 6; ++p) {
+		for (int j = 0; j < 3; ++j)
+			planes[p].m[j] = (p/2 == j) ? (p%2 == 0 ? 1 : -1) : 0;
+		planes[p].m[3] = (float)count/8;
+	}
+}
+
+static int calibrateAabbmult()
+{
+	static const size_t count = 64;
+	Mat44 m;
+	Aabb in[count], out[count];
+	Vector4 planes[6];
+	calibrationBoxes(&m, in, planes, count);
+
+	int best = 0;
+	double bestTime = 1e30;
+	for (size_t i = 0; i < aabbmult_variants_count; ++i) {
+		if (!math4dCpuSupports(aabbmult_variants[i].features))
+			continue;
+		AabbmultFunction aabbmult = aabbmult_variants[i].aabbmult;
+		double time = calibrationTime([&]() { aabbmult(out, in, count, m); });
+		if (time < bestTime) {
+			bestTime = time;
+			best = (int)i;
+		}
+	}
+	return best;
+}
+
+static int calibrateSpheremult()
+{
+	static const size_t count = 64;
+	Mat44 m;
+	Aabb boxes[count];
+	Vector4 in[count], out[count], planes[6];
+	calibrationBoxes(&m, boxes, planes, count);
+	for (size_t c = 0; c < count; ++c)
+		in[c] = boxes[c].center;
+
+	int best = 0;
+	double bestTime = 1e30;
+	for (size_t i = 0; i < spheremult_variants_count; ++i) {
+		if (!math4dCpuSupports(spheremult_variants[i].features))
+			continue;
+		SpheremultFunction spheremult = spheremult_variants[i].spheremult;
+		double time = calibrationTime([&]() { spheremult(out, in, count, m); });
+		if (time < bestTime) {
+			bestTime = time;
+			best = (int)i;
+		}
+	}
+	return best;
+}
+
+static int calibrateAabbcull()
+{
+	static const size_t count = 64;
+	Mat44 m;
+	Aabb in[count];
+	Vector4 planes[6];
+	uint64_t visible[(count+63)/64];
+	calibrationBoxes(&m, in, planes, count);
+
+	int best = 0;
+	double bestTime = 1e30;
+	for (size_t i = 0; i < aabbcull_variants_count; ++i) {
+		if (!math4dCpuSupports(aabbcull_variants[i].features))
+			continue;
+		AabbcullFunction aabbcull = aabbcull_variants[i].aabbcull;
+		double time = calibrationTime([&]() { aabbcull(visible, in, count, m, planes); });
+		if (time < bestTime) {
+			bestTime = time;
+			best = (int)i;
+		}
+	}
+	return best;
+}
+
+// Concurrent first calls may calibrate in parallel, which is harmless, they just pick possibly different variant
+static int selectedVariant(std::atomic<int> *selected, int (*calibrate)())
+{
+	int index = selected->load(std::memory_order_relaxed);
+	if (index < 0) {
+		index = calibrate();
+		int expected = -1;
+		if (!selected->compare_exchange_strong(expected, index))
+			index = expected;
+	}
+	return index;
+}
+
+// Variants not supported by the running CPU are not found, so they cannot be forced either
+template <typename V>
+static int findVariant(const V *variants, size_t count, const char *name)
+{
+	for (size_t i = 0; i < count; ++i) {
+		if (strcmp(variants[i].name, name) == 0)
+			return math4dCpuSupports(variants[i].features) ? (int)i : -1;
+	}
+	return -1;
+}
+
+extern "C" void math4d_matmult(float *out, const float *a, const float *b, size_t count)
+{
+	MatmultFunction matmult = matmult_variants[selectedVariant(&matmultSelected, &calibrateMatmult)].matmult;
+	Mat44 *outm = reinterpret_cast<Mat44 *>(out);
+	const Mat44 *am = reinterpret_cast<const Mat44 *>(a);
+	const Mat44 *bm = reinterpret_cast<const Mat44 *>(b);
+	for (size_t i = 0; i < count; ++i) {
+		if (&outm[i] != &bm[i]) {
+			matmult(&outm[i], am[i], bm[i]);
+		}
+		else {
+			// some variants store first rows before reading B completely
+			Mat44 t;
+			matmult(&t, am[i], bm[i]);
+			outm[i] = t;
+		}
+	}
+}
+
+extern "C" void math4d_vecmult(float *out, const float *in, size_t count, const float *m)
+{
+	vecmult_variants[selectedVariant(&vecmultSelected, &calibrateVecmult)].vecmult(reinterpret_cast<Vector4 *>(out), reinterpret_cast<const Vector4 *>(in), count, *reinterpret_cast<const Mat44 *>(m));
+}
+
+extern "C" void math4d_vecTmult(float *out, const float *mT, const float *in, size_t count)
+{
+	vecTmult_variants[selectedVariant(&vecTmultSelected, &calibrateVecTmult)].vecTmult(reinterpret_cast<Vector4 *>(out), *reinterpret_cast<const Mat44 *>(mT), reinterpret_cast<const Vector4 *>(in), count);
+}
+
+extern "C" void math4d_aabbmult(float *out, const float *in, size_t count, const float *m)
+{
+	aabbmult_variants[selectedVariant(&aabbmultSelected, &calibrateAabbmult)].aabbmult(reinterpret_cast<Aabb *>(out), reinterpret_cast<const Aabb *>(in), count, *reinterpret_cast<const Mat44 *>(m));
+}
+
+extern "C" void math4d_spheremult(float *out, const float *in, size_t count, const float *m)
+{
+	spheremult_variants[selectedVariant(&spheremultSelected, &calibrateSpheremult)].spheremult(reinterpret_cast<Vector4 *>(out), reinterpret_cast<const Vector4 *>(in), count, *reinterpret_cast<const Mat44 *>(m));
+}
+
+extern "C" void math4d_aabbcull(uint64_t *visible, const float *in, size_t count, const float *m, const float *planes)
+{
+	aabbcull_variants[selectedVariant(&aabbcullSelected, &calibrateAabbcull)].aabbcull(visible, reinterpret_cast<const Aabb *>(in), count, *reinterpret_cast<const Mat44 *>(m), reinterpret_cast<const Vector4 *>(planes));
+}
+
+extern "C" const char *math4d_variant(int op)
+{
+	switch (op) {
+	case MATH4D_MATMULT:
+		return matmult_variants[selectedVariant(&matmultSelected, &calibrateMatmult)].name;
+	case MATH4D_VECMULT:
+		return vecmult_variants[selectedVariant(&vecmultSelected, &calibrateVecmult)].name;
+	case MATH4D_VECTMULT:
+		return vecTmult_variants[selectedVariant(&vecTmultSelected, &calibrateVecTmult)].name;
+	case MATH4D_AABBMULT:
+		return aabbmult_variants[selectedVariant(&aabbmultSelected, &calibrateAabbmult)].name;
+	case MATH4D_SPHEREMULT:
+		return spheremult_variants[selectedVariant(&spheremultSelected, &calibrateSpheremult)].name;
+	case MATH4D_AABBCULL:
+		return aabbcull_variants[selectedVariant(&aabbcullSelected, &calibrateAabbcull)].name;
+	}
+	return NULL;
+}
+
+extern "C" int math4d_select_variant(int op, const char *name)
+{
+	int index;
+	switch (op) {
+	case MATH4D_MATMULT:
+		if ((index = findVariant(matmult_variants, matmult_variants_count, name)) < 0)
+			return -1;
+		matmultSelected.store(index);
+		return 0;
+	case MATH4D_VECMULT:
+		if ((index = findVariant(vecmult_variants, vecmult_variants_count, name)) < 0)
+			return -1;
+		vecmultSelected.store(index);
+		return 0;
+	case MATH4D_VECTMULT:
+		if ((index = findVariant(vecTmult_variants, vecTmult_variants_count, name)) < 0)
+			return -1;
+		vecTmultSelected.store(index);
+		return 0;
+	case MATH4D_AABBMULT:
+		if ((index = findVariant(aabbmult_variants, aabbmult_variants_count, name)) < 0)
+			return -1;
+		aabbmultSelected.store(index);
+		return 0;
+	case MATH4D_SPHEREMULT:
+		if ((index = findVariant(spheremult_variants, spheremult_variants_count, name)) < 0)
+			return -1;
+		spheremultSelected.store(index);
+		return 0;
+	case MATH4D_AABBCULL:
+		if ((index = findVariant(aabbcull_variants, aabbcull_variants_count, name)) < 0)
+			return -1;
+		aabbcullSelected.store(index);
+		return 0;
+	}
+	return -1;
+}
@@ -0,0 +1,104 @@
+/*
+ * Math4D public interface, kernels are selected for the fastest variant on the running host.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+
+#ifndef Math4DApi_h__
+# define Math4DApi_h__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Operations, used for variant selection and reporting.
+ */
+enum math4d_op {
+	MATH4D_MATMULT = 0,
+	MATH4D_VECMULT = 1,
+	MATH4D_VECTMULT = 2,
+	MATH4D_AABBMULT = 3,
+	MATH4D_SPHEREMULT = 4,
+	MATH4D_AABBCULL = 5,
+};
+
+/*
+ * Matrices are row-major float[16], vectors are float[4], all 16-byte aligned.  Output may be the same as input.
+ */
+
+/* out[i] = a[i] * b[i], for count matrices */
+void math4d_matmult(float *out, const float *a, const float *b, size_t count);
+
+/* out[i] = in[i] * m, for count row vectors */
+void math4d_vecmult(float *out, const float *in, size_t count, const float *m);
+
+/* out[i] = in[i] * transpose(mT), for count row vectors, matrix is column-major */
+void math4d_vecTmult(float *out, const float *mT, const float *in, size_t count);
+
+/*
+ * Bounding volumes, matrix must be affine (last column 0, 0, 0, 1).  Box is float[8], center followed by half-extent,
+ * sphere is float[4] as x, y, z, radius.
+ */
+
+/* out[i] = bounding box of in[i] transformed by m */
+void math4d_aabbmult(float *out, const float *in, size_t count, const float *m);
+
+/*
+ * out[i] = bounding sphere of in[i] transformed by m, radius is scaled by upper bound of the largest singular value of
+ * the 3x3 part, exact for rotation with uniform scale, larger than needed for strongly sheared matrices
+ */
+void math4d_spheremult(float *out, const float *in, size_t count, const float *m);
+
+/*
+ * Sets bit i%64 of visible[i/64] if in[i] transformed by m intersects the frustum, planes are float[6][4] with inside
+ * where a*x+b*y+c*z+d >= 0.  The test is conservative, box crossing plane extensions near corners is still visible.
+ */
+void math4d_aabbcull(uint64_t *visible, const float *in, size_t count, const float *m, const float *planes);
+
+/* Returns name of the variant selected for operation, selecting the fastest one if not done yet, NULL for invalid op */
+const char *math4d_variant(int op);
+
+/* Forces variant for operation, returns 0 on success, -1 if no such variant exists */
+int math4d_select_variant(int op, const char *name);
+
+#ifdef __cplusplus
+}
+
+#include "Math4D.hxx"
+
+inline void math4d_matmult(Mat44 *out, const Mat44 *A, const Mat44 *B, size_t count)
+{
+	math4d_matmult(reinterpret_cast<float *>(out), reinterpret_cast<const float *>(A), reinterpret_cast<const float *>(B), count);
+}
+
+inline void math4d_vecmult(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m)
+{
+	math4d_vecmult(reinterpret_cast<float *>(out), reinterpret_cast<const float *>(in), count, m.m[0]);
+}
+
+inline void math4d_vecTmult(Vector4 *out, const Mat44 &mT, const Vector4 *in, size_t count)
+{
+	math4d_vecTmult(reinterpret_cast<float *>(out), mT.m[0], reinterpret_cast<const float *>(in), count);
+}
+
+inline void math4d_aabbmult(Aabb *out, const Aabb *in, size_t count, const Mat44 &m)
+{
+	math4d_aabbmult(reinterpret_cast<float *>(out), reinterpret_cast<const float *>(in), count, m.m[0]);
+}
+
+inline void math4d_spheremult(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m)
+{
+	math4d_spheremult(reinterpret_cast<float *>(out), reinterpret_cast<const float *>(in), count, m.m[0]);
+}
+
+inline void math4d_aabbcull(uint64_t *visible, const Aabb *in, size_t count, const Mat44 &m, const Vector4 *planes)
+{
+	math4d_aabbcull(visible, reinterpret_cast<const float *>(in), count, m.m[0], reinterpret_cast<const float *>(planes));
+}
+#endif
+
+#endif
@@ -0,0 +1,283 @@
+/*
+ * Bounding volumes transformation and frustum culling.
+ *
+ * AABB is transformed by center/extent method: center is transformed as point, extent by matrix with absolute values,
+ * which gives the same box as transforming all eight corners.  Sphere radius is scaled by upper bound of the largest
+ * stretch of the matrix, exact for rotation with uniform scale.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "Math4DBounds.hxx"
+
+
+// C loop implementation (may be vectorized by compiler in newer versions)
+void aabbmult_ref(Aabb *out, const Aabb *in, size_t count, const Mat44 &m)
+{
+	for (size_t c = 0; c < count; ++c) {
+		Aabb t;
+		for (int j = 0; j < 4; j++) {
+			t.center.m[j] = in[c].center.m[0]*m.m[0][j] + in[c].center.m[1]*m.m[1][j] + in[c].center.m[2]*m.m[2][j] + m.m[3][j];
+			t.extent.m[j] = in[c].extent.m[0]*fabsf(m.m[0][j]) + in[c].extent.m[1]*fabsf(m.m[1][j]) + in[c].extent.m[2]*fabsf(m.m[2][j]);
+		}
+
+		out[c] = t;
+	}
+}
+
+// C loop implementation (may be vectorized by compiler in newer versions)
+void spheremult_ref(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m)
+{
+	float scale = matrixMaxScale(m);
+	for (size_t c = 0; c < count; ++c) {
+		Vector4 t;
+		for (int j = 0; j < 3; j++) {
+			t.m[j] = in[c].m[0]*m.m[0][j] + in[c].m[1]*m.m[1][j] + in[c].m[2]*m.m[2][j] + m.m[3][j];
+		}
+		t.m[3] = in[c].m[3]*scale;
+
+		out[c] = t;
+	}
+}
+
+// C loop implementation (may be vectorized by compiler in newer versions)
+void aabbcull_ref(uint64_t *visible, const Aabb *in, size_t count, const Mat44 &m, const Vector4 *planes)
+{
+	VisibilityWriter writer(visible);
+	for (size_t c = 0; c < count; ++c) {
+		Aabb t;
+		aabbmult_ref(&t, &in[c], 1, m);
+		bool inside = true;
+		for (int p = 0; p < 6; ++p) {
+			const float *plane = planes[p].m;
+			float distance = plane[0]*t.center.m[0] + plane[1]*t.center.m[1] + plane[2]*t.center.m[2] + plane[3];
+			float radius = fabsf(plane[0])*t.extent.m[0] + fabsf(plane[1])*t.extent.m[1] + fabsf(plane[2])*t.extent.m[2];
+			if (distance+radius < 0)
+				inside = false;
+		}
+		writer.add(c, inside, 1);
+	}
+	writer.finish(count);
+}
+
+#ifdef __SSE__
+static inline __m128 absMask_Sse()
+{
+	return _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+}
+
+// Center as point (w taken from row 3), extent as direction by absolute matrix
+static inline void aabbTransform_Sse(__m128 *center, __m128 *extent, const __m128 c, const __m128 e, const __m128 r0, const __m128 r1, const __m128 r2, const __m128 r3, const __m128 a0, const __m128 a1, const __m128 a2)
+{
+	__m128 rc = _mm_add_ps(r3, _mm_mul_ps(_mm_shuffle_ps(c, c, 0x00), r0));
+	rc = _mm_add_ps(rc, _mm_mul_ps(_mm_shuffle_ps(c, c, 0x55), r1));
+	rc = _mm_add_ps(rc, _mm_mul_ps(_mm_shuffle_ps(c, c, 0xaa), r2));
+	__m128 re = _mm_mul_ps(_mm_shuffle_ps(e, e, 0x00), a0);
+	re = _mm_add_ps(re, _mm_mul_ps(_mm_shuffle_ps(e, e, 0x55), a1));
+	re = _mm_add_ps(re, _mm_mul_ps(_mm_shuffle_ps(e, e, 0xaa), a2));
+	*center = rc;
+	*extent = re;
+}
+
+// SSE based:
+void aabbmult_Sse(Aabb *out, const Aabb *in, size_t count, const Mat44 &m)
+{
+	__m128 r0 = m.row[0], r1 = m.row[1], r2 = m.row[2], r3 = m.row[3];
+	__m128 a0 = _mm_and_ps(r0, absMask_Sse()), a1 = _mm_and_ps(r1, absMask_Sse()), a2 = _mm_and_ps(r2, absMask_Sse());
+
+	for (size_t c = 0; c < count; ++c) {
+		__m128 center, extent;
+		aabbTransform_Sse(&center, &extent, in[c].center.row, in[c].extent.row, r0, r1, r2, r3, a0, a1, a2);
+		out[c].center.row = center;
+		out[c].extent.row = extent;
+	}
+}
+
+// SSE based, sphere as vector by matrix with radius scale in w column:
+void spheremult_Sse(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m)
+{
+	__m128 xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	__m128 r0 = _mm_and_ps(m.row[0], xyzMask);
+	__m128 r1 = _mm_and_ps(m.row[1], xyzMask);
+	__m128 r2 = _mm_and_ps(m.row[2], xyzMask);
+	__m128 r3 = _mm_and_ps(m.row[3], xyzMask);
+	__m128 rs = _mm_set_ps(matrixMaxScale(m), 0, 0, 0);
+
+	for (size_t c = 0; c < count; ++c) {
+		__m128 s = in[c].row;
+		__m128 result = _mm_add_ps(r3, _mm_mul_ps(_mm_shuffle_ps(s, s, 0x00), r0));
+		result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(s, s, 0x55), r1));
+		result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(s, s, 0xaa), r2));
+		result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(s, s, 0xff), rs));
+		out[c].row = result;
+	}
+}
+
+// SSE based, planes in two groups of four:
+void aabbcull_Sse(uint64_t *visible, const Aabb *in, size_t count, const Mat44 &m, const Vector4 *planes)
+{
+	CullPlanes cp(planes);
+	__m128 px0 = _mm_loadu_ps(cp.px), px1 = _mm_loadu_ps(cp.px+4);
+	__m128 py0 = _mm_loadu_ps(cp.py), py1 = _mm_loadu_ps(cp.py+4);
+	__m128 pz0 = _mm_loadu_ps(cp.pz), pz1 = _mm_loadu_ps(cp.pz+4);
+	__m128 pw0 = _mm_loadu_ps(cp.pw), pw1 = _mm_loadu_ps(cp.pw+4);
+	__m128 apx0 = _mm_loadu_ps(cp.apx), apx1 = _mm_loadu_ps(cp.apx+4);
+	__m128 apy0 = _mm_loadu_ps(cp.apy), apy1 = _mm_loadu_ps(cp.apy+4);
+	__m128 apz0 = _mm_loadu_ps(cp.apz), apz1 = _mm_loadu_ps(cp.apz+4);
+	__m128 r0 = m.row[0], r1 = m.row[1], r2 = m.row[2], r3 = m.row[3];
+	__m128 a0 = _mm_and_ps(r0, absMask_Sse()), a1 = _mm_and_ps(r1, absMask_Sse()), a2 = _mm_and_ps(r2, absMask_Sse());
+	__m128 zero = _mm_setzero_ps();
+
+	VisibilityWriter writer(visible);
+	for (size_t c = 0; c < count; ++c) {
+		__m128 center, extent;
+		aabbTransform_Sse(&center, &extent, in[c].center.row, in[c].extent.row, r0, r1, r2, r3, a0, a1, a2);
+		__m128 cx = _mm_shuffle_ps(center, center, 0x00), cy = _mm_shuffle_ps(center, center, 0x55), cz = _mm_shuffle_ps(center, center, 0xaa);
+		__m128 ex = _mm_shuffle_ps(extent, extent, 0x00), ey = _mm_shuffle_ps(extent, extent, 0x55), ez = _mm_shuffle_ps(extent, extent, 0xaa);
+		__m128 d0 = _mm_add_ps(_mm_add_ps(_mm_add_ps(pw0, _mm_mul_ps(px0, cx)), _mm_add_ps(_mm_mul_ps(py0, cy), _mm_mul_ps(pz0, cz))), _mm_add_ps(_mm_add_ps(_mm_mul_ps(apx0, ex), _mm_mul_ps(apy0, ey)), _mm_mul_ps(apz0, ez)));
+		__m128 d1 = _mm_add_ps(_mm_add_ps(_mm_add_ps(pw1, _mm_mul_ps(px1, cx)), _mm_add_ps(_mm_mul_ps(py1, cy), _mm_mul_ps(pz1, cz))), _mm_add_ps(_mm_add_ps(_mm_mul_ps(apx1, ex), _mm_mul_ps(apy1, ey)), _mm_mul_ps(apz1, ez)));
+		int outside = _mm_movemask_ps(_mm_or_ps(_mm_cmplt_ps(d0, zero), _mm_cmplt_ps(d1, zero)));
+		writer.add(c, outside == 0, 1);
+	}
+	writer.finish(count);
+}
+#endif
+
+#ifdef __aarch64__
+static inline void aabbTransform_Neon(float32x4_t *center, float32x4_t *extent, const float32x4_t c, const float32x4_t e, const float32x4_t r0, const float32x4_t r1, const float32x4_t r2, const float32x4_t r3, const float32x4_t a0, const float32x4_t a1, const float32x4_t a2)
+{
+	float32x4_t rc = vfmaq_laneq_f32(r3, r0, c, 0);
+	rc = vfmaq_laneq_f32(rc, r1, c, 1);
+	rc = vfmaq_laneq_f32(rc, r2, c, 2);
+	float32x4_t re = vmulq_laneq_f32(a0, e, 0);
+	re = vfmaq_laneq_f32(re, a1, e, 1);
+	re = vfmaq_laneq_f32(re, a2, e, 2);
+	*center = rc;
+	*extent = re;
+}
+
+// Neon based:
+void aabbmult_Neon(Aabb *out, const Aabb *in, size_t count, const Mat44 &m)
+{
+	float32x4_t r0 = m.row[0], r1 = m.row[1], r2 = m.row[2], r3 = m.row[3];
+	float32x4_t a0 = vabsq_f32(r0), a1 = vabsq_f32(r1), a2 = vabsq_f32(r2);
+
+	for (size_t c = 0; c < count; ++c) {
+		float32x4_t center, extent;
+		aabbTransform_Neon(&center, &extent, in[c].center.row, in[c].extent.row, r0, r1, r2, r3, a0, a1, a2);
+		out[c].center.row = center;
+		out[c].extent.row = extent;
+	}
+}
+
+// Neon based, sphere as vector by matrix with radius scale in w column:
+void spheremult_Neon(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m)
+{
+	float32x4_t r0 = vsetq_lane_f32(0, m.row[0], 3);
+	float32x4_t r1 = vsetq_lane_f32(0, m.row[1], 3);
+	float32x4_t r2 = vsetq_lane_f32(0, m.row[2], 3);
+	float32x4_t r3 = vsetq_lane_f32(0, m.row[3], 3);
+	float32x4_t rs = vsetq_lane_f32(matrixMaxScale(m), vdupq_n_f32(0), 3);
+
+	for (size_t c = 0; c < count; ++c) {
+		float32x4_t s = in[c].row;
+		float32x4_t result = vfmaq_laneq_f32(r3, r0, s, 0);
+		result = vfmaq_laneq_f32(result, r1, s, 1);
+		result = vfmaq_laneq_f32(result, r2, s, 2);
+		result = vfmaq_laneq_f32(result, rs, s, 3);
+		out[c].row = result;
+	}
+}
+
+// Neon based, planes in two groups of four:
+void aabbcull_Neon(uint64_t *visible, const Aabb *in, size_t count, const Mat44 &m, const Vector4 *planes)
+{
+	CullPlanes cp(planes);
+	float32x4_t px0 = vld1q_f32(cp.px), px1 = vld1q_f32(cp.px+4);
+	float32x4_t py0 = vld1q_f32(cp.py), py1 = vld1q_f32(cp.py+4);
+	float32x4_t pz0 = vld1q_f32(cp.pz), pz1 = vld1q_f32(cp.pz+4);
+	float32x4_t pw0 = vld1q_f32(cp.pw), pw1 = vld1q_f32(cp.pw+4);
+	float32x4_t apx0 = vld1q_f32(cp.apx), apx1 = vld1q_f32(cp.apx+4);
+	float32x4_t apy0 = vld1q_f32(cp.apy), apy1 = vld1q_f32(cp.apy+4);
+	float32x4_t apz0 = vld1q_f32(cp.apz), apz1 = vld1q_f32(cp.apz+4);
+	float32x4_t r0 = m.row[0], r1 = m.row[1], r2 = m.row[2], r3 = m.row[3];
+	float32x4_t a0 = vabsq_f32(r0), a1 = vabsq_f32(r1), a2 = vabsq_f32(r2);
+	float32x4_t zero = vdupq_n_f32(0);
+
+	VisibilityWriter writer(visible);
+	for (size_t c = 0; c < count; ++c) {
+		float32x4_t center, extent;
+		aabbTransform_Neon(&center, &extent, in[c].center.row, in[c].extent.row, r0, r1, r2, r3, a0, a1, a2);
+		float32x4_t d0 = vfmaq_laneq_f32(pw0, px0, center, 0);
+		float32x4_t d1 = vfmaq_laneq_f32(pw1, px1, center, 0);
+		d0 = vfmaq_laneq_f32(d0, py0, center, 1);
+		d1 = vfmaq_laneq_f32(d1, py1, center, 1);
+		d0 = vfmaq_laneq_f32(d0, pz0, center, 2);
+		d1 = vfmaq_laneq_f32(d1, pz1, center, 2);
+		d0 = vfmaq_laneq_f32(d0, apx0, extent, 0);
+		d1 = vfmaq_laneq_f32(d1, apx1, extent, 0);
+		d0 = vfmaq_laneq_f32(d0, apy0, extent, 1);
+		d1 = vfmaq_laneq_f32(d1, apy1, extent, 1);
+		d0 = vfmaq_laneq_f32(d0, apz0, extent, 2);
+		d1 = vfmaq_laneq_f32(d1, apz1, extent, 2);
+		uint32x4_t outside = vorrq_u32(vcltq_f32(d0, zero), vcltq_f32(d1, zero));
+		writer.add(c, vmaxvq_u32(outside) == 0, 1);
+	}
+	writer.finish(count);
+}
+#endif
+
+
+// aabbmult variants
+const AabbmultVariant aabbmult_variants[] = {
+	{ "aabbmult_ref",      aabbmult_ref,      0 },
+#ifdef __SSE__
+	{ "aabbmult_Sse",      aabbmult_Sse,      0 },
+#endif
+#ifdef __x86_64__
+	{ "aabbmult_Fma256",   aabbmult_Fma256,   MATH4D_AVX2_FMA },
+	{ "aabbmult_Avx512",   aabbmult_Avx512,   MATH4D_AVX512 },
+#endif
+#if (defined __aarch64__)
+	{ "aabbmult_Neon",     aabbmult_Neon,     0 },
+#endif
+};
+
+const size_t aabbmult_variants_count = sizeof(aabbmult_variants)/sizeof(aabbmult_variants[0]);
+
+// spheremult variants
+const SpheremultVariant spheremult_variants[] = {
+	{ "spheremult_ref",    spheremult_ref,    0 },
+#ifdef __SSE__
+	{ "spheremult_Sse",    spheremult_Sse,    0 },
+#endif
+#ifdef __x86_64__
+	{ "spheremult_Fma256", spheremult_Fma256, MATH4D_AVX2_FMA },
+	{ "spheremult_Avx512", spheremult_Avx512, MATH4D_AVX512 },
+#endif
+#if (defined __aarch64__)
+	{ "spheremult_Neon",   spheremult_Neon,   0 },
+#endif
+};
+
+const size_t spheremult_variants_count = sizeof(spheremult_variants)/sizeof(spheremult_variants[0]);
+
+// aabbcull variants
+const AabbcullVariant aabbcull_variants[] = {
+	{ "aabbcull_ref",      aabbcull_ref,      0 },
+#ifdef __SSE__
+	{ "aabbcull_Sse",      aabbcull_Sse,      0 },
+#endif
+#ifdef __x86_64__
+	{ "aabbcull_Fma256",   aabbcull_Fma256,   MATH4D_AVX2_FMA },
+	{ "aabbcull_Avx512",   aabbcull_Avx512,   MATH4D_AVX512 },
+#endif
+#if (defined __aarch64__)
+	{ "aabbcull_Neon",     aabbcull_Neon,     0 },
+#endif
+};
+
+const size_t aabbcull_variants_count = sizeof(aabbcull_variants)/sizeof(aabbcull_variants[0]);
@@ -0,0 +1,100 @@
+/*
+ * Helpers shared by the bounding volume kernels of all ISA levels.  They are in anonymous namespace so each file,
+ * compiled with its own ISA flags, keeps its own copy instead of linker picking one compiled for wider ISA.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+
+#ifndef Math4DBounds_hxx__
+# define Math4DBounds_hxx__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "Math4DKernels.hxx"
+
+
+namespace {
+
+// Upper bound of the largest stretch of affine matrix, for sphere radius.  Longest row is not enough for non-orthogonal
+// matrix, so this is square root of Gershgorin bound of the largest eigenvalue of G = M*M^T (3x3 part), which is exact
+// for rotation with uniform scale and never below the largest singular value.
+static inline float matrixMaxScale(const Mat44 &m)
+{
+	float g[3][3];
+	for (int i = 0; i < 3; i++) {
+		for (int k = 0; k < 3; k++)
+			g[i][k] = m.m[i][0]*m.m[k][0] + m.m[i][1]*m.m[k][1] + m.m[i][2]*m.m[k][2];
+	}
+	float s0 = g[0][0] + fabsf(g[0][1]) + fabsf(g[0][2]);
+	float s1 = fabsf(g[1][0]) + g[1][1] + fabsf(g[1][2]);
+	float s2 = fabsf(g[2][0]) + fabsf(g[2][1]) + g[2][2];
+	return sqrtf(fmaxf(s0, fmaxf(s1, s2)));
+}
+
+#if (defined __FMA__) && (defined __AVX2__)
+// Whole AABB in single register, center in low half, extent in high half.  Rows contain [ row | abs(row) ] and
+// translation is [ row3 | 0 ]
+static inline __m256 aabbTransform_Fma256(const __m256 ce, const __m256 r00, const __m256 r11, const __m256 r22, const __m256 t)
+{
+	__m256 result = _mm256_fmadd_ps(_mm256_permute_ps(ce, 0x00), r00, t);
+	result = _mm256_fmadd_ps(_mm256_permute_ps(ce, 0x55), r11, result);
+	result = _mm256_fmadd_ps(_mm256_permute_ps(ce, 0xaa), r22, result);
+	return result;
+}
+
+static inline __m256 aabbRow_Fma256(const __m128 row)
+{
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(row), _mm_andnot_ps(_mm_set1_ps(-0.0f), row), 1);
+}
+#endif
+
+// Planes in SoA layout, padded to eight by planes which never cull anything
+struct CullPlanes {
+	float px[8], py[8], pz[8], pw[8];
+	float apx[8], apy[8], apz[8];
+
+	explicit CullPlanes(const Vector4 *planes)
+	{
+		for (int p = 0; p < 8; ++p) {
+			const float *plane = p < 6 ? planes[p].m : NULL;
+			px[p] = plane ? plane[0] : 0;
+			py[p] = plane ? plane[1] : 0;
+			pz[p] = plane ? plane[2] : 0;
+			pw[p] = plane ? plane[3] : 1;
+			apx[p] = fabsf(px[p]);
+			apy[p] = fabsf(py[p]);
+			apz[p] = fabsf(pz[p]);
+		}
+	}
+};
+
+// Collects visibility bits and stores them by whole words
+struct VisibilityWriter {
+	uint64_t *visible;
+	uint64_t bits;
+
+	explicit VisibilityWriter(uint64_t *visible_): visible(visible_), bits(0) {}
+
+	// Adds n bits at position c, n is power of two so the bits never cross the word
+	inline void add(size_t c, uint64_t mask, size_t n)
+	{
+		bits |= mask << (c&63);
+		if (((c+n)&63) == 0) {
+			visible[c >> 6] = bits;
+			bits = 0;
+		}
+	}
+
+	inline void finish(size_t count)
+	{
+		if ((count&63) != 0)
+			visible[count >> 6] = bits;
+	}
+};
+
+}
+
+
+#endif
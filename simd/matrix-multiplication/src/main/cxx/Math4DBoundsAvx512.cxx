@@ -0,0 +1,130 @@
+/*
+ * Bounding volume AVX-512 kernels, compiled with -mavx512f -mavx512dq -mfma and dispatched only on CPUs supporting it.
+ *
+ * Based on existing public code, extended by Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "Math4DBounds.hxx"
+
+
+#if (defined __AVX512F__)
+// Both halves set to the same 256-bit value, f32x8 variants would require AVX512DQ
+static inline __m512 duplicate256_Avx512(const __m256 v)
+{
+	return _mm512_castpd_ps(_mm512_broadcast_f64x4(_mm256_castps_pd(v)));
+}
+
+// Two AABBs in single register, [ center0 | extent0 | center1 | extent1 ]
+static inline __m512 aabbTransform_Avx512(const __m512 ce, const __m512 r0000, const __m512 r1111, const __m512 r2222, const __m512 t)
+{
+	__m512 result = _mm512_fmadd_ps(_mm512_permute_ps(ce, 0x00), r0000, t);
+	result = _mm512_fmadd_ps(_mm512_permute_ps(ce, 0x55), r1111, result);
+	result = _mm512_fmadd_ps(_mm512_permute_ps(ce, 0xaa), r2222, result);
+	return result;
+}
+
+static inline __m512 aabbRow_Avx512(const __m128 row)
+{
+	__m256 r = _mm256_insertf128_ps(_mm256_castps128_ps256(row), _mm_andnot_ps(_mm_set1_ps(-0.0f), row), 1);
+	return duplicate256_Avx512(r);
+}
+
+// AVX-512 based:
+void aabbmult_Avx512(Aabb *out, const Aabb *in, size_t count, const Mat44 &m)
+{
+	__m512 r0000 = aabbRow_Avx512(m.row[0]);
+	__m512 r1111 = aabbRow_Avx512(m.row[1]);
+	__m512 r2222 = aabbRow_Avx512(m.row[2]);
+	__m256 t0 = _mm256_insertf128_ps(_mm256_castps128_ps256(m.row[3]), _mm_setzero_ps(), 1);
+	__m512 t = duplicate256_Avx512(t0);
+
+	size_t count0 = count&~1;
+	for (size_t c = 0; c < count0; c += 2) {
+		_mm512_storeu_ps(out[c].center.m, aabbTransform_Avx512(_mm512_loadu_ps(in[c].center.m), r0000, r1111, r2222, t));
+	}
+	if ((count&1) != 0) {
+		_mm256_storeu_ps(out[count-1].center.m, aabbTransform_Fma256(_mm256_loadu_ps(in[count-1].center.m), _mm512_castps512_ps256(r0000), _mm512_castps512_ps256(r1111), _mm512_castps512_ps256(r2222), t0));
+	}
+}
+
+// AVX-512 based, four spheres at time:
+void spheremult_Avx512(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m)
+{
+	__mmask16 xyz = 0x7777;
+	__m512 r0000 = _mm512_maskz_broadcast_f32x4(xyz, m.row[0]);
+	__m512 r1111 = _mm512_maskz_broadcast_f32x4(xyz, m.row[1]);
+	__m512 r2222 = _mm512_maskz_broadcast_f32x4(xyz, m.row[2]);
+	__m512 r3333 = _mm512_maskz_broadcast_f32x4(xyz, m.row[3]);
+	__m512 rs = _mm512_maskz_mov_ps(0x8888, _mm512_set1_ps(matrixMaxScale(m)));
+
+	size_t count0 = count&~3;
+	for (size_t c = 0; c < count0; c += 4) {
+		__m512 s = _mm512_loadu_ps(in[c].m);
+		__m512 result = _mm512_fmadd_ps(_mm512_permute_ps(s, 0x00), r0000, r3333);
+		result = _mm512_fmadd_ps(_mm512_permute_ps(s, 0x55), r1111, result);
+		result = _mm512_fmadd_ps(_mm512_permute_ps(s, 0xaa), r2222, result);
+		result = _mm512_fmadd_ps(_mm512_permute_ps(s, 0xff), rs, result);
+		_mm512_storeu_ps(out[c].m, result);
+	}
+	for (size_t c = count0; c < count; ++c) {
+		__m128 s = in[c].row;
+		__m128 result = _mm_fmadd_ps(_mm_permute_ps(s, 0x00), _mm512_castps512_ps128(r0000), _mm512_castps512_ps128(r3333));
+		result = _mm_fmadd_ps(_mm_permute_ps(s, 0x55), _mm512_castps512_ps128(r1111), result);
+		result = _mm_fmadd_ps(_mm_permute_ps(s, 0xaa), _mm512_castps512_ps128(r2222), result);
+		result = _mm_fmadd_ps(_mm_permute_ps(s, 0xff), _mm512_castps512_ps128(rs), result);
+		out[c].row = result;
+	}
+}
+
+// AVX-512 based, two AABBs at time, eight (padded) planes for each:
+void aabbcull_Avx512(uint64_t *visible, const Aabb *in, size_t count, const Mat44 &m, const Vector4 *planes)
+{
+	CullPlanes cp(planes);
+	__m512 px = duplicate256_Avx512(_mm256_loadu_ps(cp.px)), py = duplicate256_Avx512(_mm256_loadu_ps(cp.py));
+	__m512 pz = duplicate256_Avx512(_mm256_loadu_ps(cp.pz)), pw = duplicate256_Avx512(_mm256_loadu_ps(cp.pw));
+	__m512 apx = duplicate256_Avx512(_mm256_loadu_ps(cp.apx)), apy = duplicate256_Avx512(_mm256_loadu_ps(cp.apy));
+	__m512 apz = duplicate256_Avx512(_mm256_loadu_ps(cp.apz));
+	__m512 r0000 = aabbRow_Avx512(m.row[0]);
+	__m512 r1111 = aabbRow_Avx512(m.row[1]);
+	__m512 r2222 = aabbRow_Avx512(m.row[2]);
+	__m256 t0 = _mm256_insertf128_ps(_mm256_castps128_ps256(m.row[3]), _mm_setzero_ps(), 1);
+	__m512 t = duplicate256_Avx512(t0);
+	// lanes 0-7 take component of the first box, lanes 8-15 of the second one
+	__m512i ix = _mm512_set_epi32(8, 8, 8, 8, 8, 8, 8, 8, 0, 0, 0, 0, 0, 0, 0, 0);
+	__m512i one = _mm512_set1_epi32(1);
+	__m512i iy = _mm512_add_epi32(ix, one), iz = _mm512_add_epi32(iy, one);
+	__m512i four = _mm512_set1_epi32(4);
+	__m512i iex = _mm512_add_epi32(ix, four), iey = _mm512_add_epi32(iy, four), iez = _mm512_add_epi32(iz, four);
+	__m512 zero = _mm512_setzero_ps();
+
+	VisibilityWriter writer(visible);
+	size_t count0 = count&~1;
+	for (size_t c = 0; c < count0; c += 2) {
+		__m512 ce = aabbTransform_Avx512(_mm512_loadu_ps(in[c].center.m), r0000, r1111, r2222, t);
+		__m512 d = _mm512_fmadd_ps(px, _mm512_permutexvar_ps(ix, ce), pw);
+		d = _mm512_fmadd_ps(py, _mm512_permutexvar_ps(iy, ce), d);
+		d = _mm512_fmadd_ps(pz, _mm512_permutexvar_ps(iz, ce), d);
+		d = _mm512_fmadd_ps(apx, _mm512_permutexvar_ps(iex, ce), d);
+		d = _mm512_fmadd_ps(apy, _mm512_permutexvar_ps(iey, ce), d);
+		d = _mm512_fmadd_ps(apz, _mm512_permutexvar_ps(iez, ce), d);
+		__mmask16 outside = _mm512_cmp_ps_mask(d, zero, _CMP_LT_OQ);
+		writer.add(c, ((outside&0xff) == 0) | (((outside >> 8) == 0) << 1), 2);
+	}
+	if ((count&1) != 0) {
+		__m256 ce = aabbTransform_Fma256(_mm256_loadu_ps(in[count-1].center.m), _mm512_castps512_ps256(r0000), _mm512_castps512_ps256(r1111), _mm512_castps512_ps256(r2222), t0);
+		__m512 ce2 = _mm512_castps256_ps512(ce);
+		__m512 d = _mm512_fmadd_ps(px, _mm512_permutexvar_ps(ix, ce2), pw);
+		d = _mm512_fmadd_ps(py, _mm512_permutexvar_ps(iy, ce2), d);
+		d = _mm512_fmadd_ps(pz, _mm512_permutexvar_ps(iz, ce2), d);
+		d = _mm512_fmadd_ps(apx, _mm512_permutexvar_ps(iex, ce2), d);
+		d = _mm512_fmadd_ps(apy, _mm512_permutexvar_ps(iey, ce2), d);
+		d = _mm512_fmadd_ps(apz, _mm512_permutexvar_ps(iez, ce2), d);
+		__mmask16 outside = _mm512_cmp_ps_mask(d, zero, _CMP_LT_OQ);
+		writer.add(count-1, (outside&0xff) == 0, 1);
+	}
+	writer.finish(count);
+}
+#endif
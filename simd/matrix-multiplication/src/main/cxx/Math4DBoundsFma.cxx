@@ -0,0 +1,87 @@
+/*
+ * Bounding volume FMA kernels, compiled with -mavx2 -mfma and dispatched only on CPUs supporting both.
+ *
+ * Based on existing public code, extended by Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "Math4DBounds.hxx"
+
+
+#if (defined __FMA__) && (defined __AVX2__)
+// FMA256 based:
+void aabbmult_Fma256(Aabb *out, const Aabb *in, size_t count, const Mat44 &m)
+{
+	__m256 r00 = aabbRow_Fma256(m.row[0]);
+	__m256 r11 = aabbRow_Fma256(m.row[1]);
+	__m256 r22 = aabbRow_Fma256(m.row[2]);
+	__m256 t = _mm256_insertf128_ps(_mm256_castps128_ps256(m.row[3]), _mm_setzero_ps(), 1);
+
+	for (size_t c = 0; c < count; ++c) {
+		_mm256_storeu_ps(out[c].center.m, aabbTransform_Fma256(_mm256_loadu_ps(in[c].center.m), r00, r11, r22, t));
+	}
+}
+
+// FMA256 based, two spheres at time:
+void spheremult_Fma256(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m)
+{
+	__m128 xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	__m256 r00 = _mm256_broadcast_ps(&m.row[0]);
+	__m256 r11 = _mm256_broadcast_ps(&m.row[1]);
+	__m256 r22 = _mm256_broadcast_ps(&m.row[2]);
+	__m256 r33 = _mm256_broadcast_ps(&m.row[3]);
+	__m256 mask = _mm256_insertf128_ps(_mm256_castps128_ps256(xyzMask), xyzMask, 1);
+	r00 = _mm256_and_ps(r00, mask);
+	r11 = _mm256_and_ps(r11, mask);
+	r22 = _mm256_and_ps(r22, mask);
+	r33 = _mm256_and_ps(r33, mask);
+	float scale = matrixMaxScale(m);
+	__m256 rs = _mm256_set_ps(scale, 0, 0, 0, scale, 0, 0, 0);
+
+	size_t count0 = count&~1;
+	for (size_t c = 0; c < count0; c += 2) {
+		__m256 s = _mm256_loadu_ps(in[c].m);
+		__m256 result = _mm256_fmadd_ps(_mm256_permute_ps(s, 0x00), r00, r33);
+		result = _mm256_fmadd_ps(_mm256_permute_ps(s, 0x55), r11, result);
+		result = _mm256_fmadd_ps(_mm256_permute_ps(s, 0xaa), r22, result);
+		result = _mm256_fmadd_ps(_mm256_permute_ps(s, 0xff), rs, result);
+		_mm256_storeu_ps(out[c].m, result);
+	}
+	if ((count&1) != 0) {
+		__m128 s = in[count-1].row;
+		__m128 result = _mm_fmadd_ps(_mm_permute_ps(s, 0x00), _mm256_castps256_ps128(r00), _mm256_castps256_ps128(r33));
+		result = _mm_fmadd_ps(_mm_permute_ps(s, 0x55), _mm256_castps256_ps128(r11), result);
+		result = _mm_fmadd_ps(_mm_permute_ps(s, 0xaa), _mm256_castps256_ps128(r22), result);
+		result = _mm_fmadd_ps(_mm_permute_ps(s, 0xff), _mm256_castps256_ps128(rs), result);
+		out[count-1].row = result;
+	}
+}
+
+// FMA256 based, all eight (padded) planes at time:
+void aabbcull_Fma256(uint64_t *visible, const Aabb *in, size_t count, const Mat44 &m, const Vector4 *planes)
+{
+	CullPlanes cp(planes);
+	__m256 px = _mm256_loadu_ps(cp.px), py = _mm256_loadu_ps(cp.py), pz = _mm256_loadu_ps(cp.pz), pw = _mm256_loadu_ps(cp.pw);
+	__m256 apx = _mm256_loadu_ps(cp.apx), apy = _mm256_loadu_ps(cp.apy), apz = _mm256_loadu_ps(cp.apz);
+	__m256 r00 = aabbRow_Fma256(m.row[0]);
+	__m256 r11 = aabbRow_Fma256(m.row[1]);
+	__m256 r22 = aabbRow_Fma256(m.row[2]);
+	__m256 t = _mm256_insertf128_ps(_mm256_castps128_ps256(m.row[3]), _mm_setzero_ps(), 1);
+	__m256 zero = _mm256_setzero_ps();
+
+	VisibilityWriter writer(visible);
+	for (size_t c = 0; c < count; ++c) {
+		__m256 ce = aabbTransform_Fma256(_mm256_loadu_ps(in[c].center.m), r00, r11, r22, t);
+		__m256 d = _mm256_fmadd_ps(px, _mm256_permutevar8x32_ps(ce, _mm256_set1_epi32(0)), pw);
+		d = _mm256_fmadd_ps(py, _mm256_permutevar8x32_ps(ce, _mm256_set1_epi32(1)), d);
+		d = _mm256_fmadd_ps(pz, _mm256_permutevar8x32_ps(ce, _mm256_set1_epi32(2)), d);
+		d = _mm256_fmadd_ps(apx, _mm256_permutevar8x32_ps(ce, _mm256_set1_epi32(4)), d);
+		d = _mm256_fmadd_ps(apy, _mm256_permutevar8x32_ps(ce, _mm256_set1_epi32(5)), d);
+		d = _mm256_fmadd_ps(apz, _mm256_permutevar8x32_ps(ce, _mm256_set1_epi32(6)), d);
+		writer.add(c, _mm256_movemask_ps(_mm256_cmp_ps(d, zero, _CMP_LT_OQ)) == 0, 1);
+	}
+	writer.finish(count);
+}
+#endif
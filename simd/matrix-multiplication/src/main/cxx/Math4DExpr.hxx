@@ -0,0 +1,196 @@
+/*
+ * Math4D C++ value interface, based on expression templates.
+ *
+ * Matrix products are evaluated lazily, whole expression like out = in * (M1 * M2) * M3 first multiplies the matrices
+ * and then transforms the vectors in single vecmult pass.  All the computations go through the dispatched kernels in
+ * Math4DApi.h.
+ *
+ * Expressions keep references to the Mat44 operands, so they are meant to be evaluated within the full expression,
+ * not stored.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+
+#ifndef Math4DExpr_hxx__
+# define Math4DExpr_hxx__
+
+#include <assert.h>
+#include <stddef.h>
+#include <type_traits>
+
+#include "Math4D.hxx"
+#include "Math4DApi.h"
+
+
+// Base of all matrix expressions, only marks the type
+struct Mat44Expr {
+};
+
+// Mat44 operand, Mat44 is plain union shared with C code, so it is wrapped when entering the expression
+struct Mat44Leaf: Mat44Expr {
+	const Mat44 *m;
+
+	explicit Mat44Leaf(const Mat44 &m_): m(&m_) {}
+
+	const Mat44 &evaluate(Mat44 *) const
+	{
+		return *m;
+	}
+};
+
+template <typename L, typename R>
+struct Mat44Product: Mat44Expr {
+	L left;
+	R right;
+
+	Mat44Product(const L &left_, const R &right_): left(left_), right(right_) {}
+
+	// Evaluates into tmp, returning reference to it
+	const Mat44 &evaluate(Mat44 *tmp) const
+	{
+		Mat44 lt, rt;
+		math4d_matmult(tmp, &left.evaluate(&lt), &right.evaluate(&rt), 1);
+		return *tmp;
+	}
+
+	operator Mat44() const
+	{
+		Mat44 out;
+		evaluate(&out);
+		return out;
+	}
+};
+
+// Maps operand type to expression type, Mat44 to leaf and expression to itself
+template <typename T, typename Enable = void>
+struct Mat44Operand {
+};
+
+template <>
+struct Mat44Operand<Mat44> {
+	typedef Mat44Leaf Type;
+
+	static Mat44Leaf wrap(const Mat44 &m)
+	{
+		return Mat44Leaf(m);
+	}
+};
+
+template <typename E>
+struct Mat44Operand<E, typename std::enable_if<std::is_base_of<Mat44Expr, E>::value>::type> {
+	typedef E Type;
+
+	static const E &wrap(const E &e)
+	{
+		return e;
+	}
+};
+
+template <typename L, typename R>
+inline Mat44Product<typename Mat44Operand<L>::Type, typename Mat44Operand<R>::Type> operator*(const L &left, const R &right)
+{
+	return Mat44Product<typename Mat44Operand<L>::Type, typename Mat44Operand<R>::Type>(Mat44Operand<L>::wrap(left), Mat44Operand<R>::wrap(right));
+}
+
+template <typename R>
+inline Mat44 &operator*=(Mat44 &left, const R &right)
+{
+	Mat44 rt;
+	math4d_matmult(&left, &left, &Mat44Operand<R>::wrap(right).evaluate(&rt), 1);
+	return left;
+}
+
+
+// Read-only array of vectors
+struct ConstVectorSpan {
+	const Vector4 *data;
+	size_t count;
+
+	ConstVectorSpan(const Vector4 *data_, size_t count_): data(data_), count(count_) {}
+
+	template <size_t N>
+	ConstVectorSpan(const Vector4 (&array)[N]): data(array), count(N) {}
+};
+
+// Lazy transformation of vectors by matrix expression
+template <typename M>
+struct VectorTransform {
+	ConstVectorSpan in;
+	M matrix;
+
+	VectorTransform(const ConstVectorSpan &in_, const M &matrix_): in(in_), matrix(matrix_) {}
+};
+
+// Writable array of vectors, assigning transformation evaluates it
+struct VectorSpan {
+	Vector4 *data;
+	size_t count;
+
+	VectorSpan(Vector4 *data_, size_t count_): data(data_), count(count_) {}
+
+	template <size_t N>
+	VectorSpan(Vector4 (&array)[N]): data(array), count(N) {}
+
+	operator ConstVectorSpan() const
+	{
+		return ConstVectorSpan(data, count);
+	}
+
+	template <typename M>
+	VectorSpan &operator=(const VectorTransform<M> &transform)
+	{
+		assert(transform.in.count == count);
+		Mat44 tmp;
+		math4d_vecmult(data, transform.in.data, count, transform.matrix.evaluate(&tmp));
+		return *this;
+	}
+
+	// In-place transformation
+	template <typename R>
+	VectorSpan &operator*=(const R &right)
+	{
+		Mat44 tmp;
+		math4d_vecmult(data, data, count, Mat44Operand<R>::wrap(right).evaluate(&tmp));
+		return *this;
+	}
+};
+
+template <typename R>
+inline VectorTransform<typename Mat44Operand<R>::Type> operator*(const ConstVectorSpan &in, const R &right)
+{
+	return VectorTransform<typename Mat44Operand<R>::Type>(in, Mat44Operand<R>::wrap(right));
+}
+
+template <typename R>
+inline VectorTransform<typename Mat44Operand<R>::Type> operator*(const VectorSpan &in, const R &right)
+{
+	return VectorTransform<typename Mat44Operand<R>::Type>(in, Mat44Operand<R>::wrap(right));
+}
+
+// Further matrices are fused into the matrix expression, vectors are still transformed only once
+template <typename M, typename R>
+inline VectorTransform<Mat44Product<M, typename Mat44Operand<R>::Type>> operator*(const VectorTransform<M> &transform, const R &right)
+{
+	return VectorTransform<Mat44Product<M, typename Mat44Operand<R>::Type>>(transform.in, Mat44Product<M, typename Mat44Operand<R>::Type>(transform.matrix, Mat44Operand<R>::wrap(right)));
+}
+
+// Single vector, evaluated immediately
+template <typename R>
+inline Vector4 operator*(const Vector4 &in, const R &right)
+{
+	Mat44 tmp;
+	Vector4 out;
+	math4d_vecmult(&out, &in, 1, Mat44Operand<R>::wrap(right).evaluate(&tmp));
+	return out;
+}
+
+template <typename R>
+inline Vector4 &operator*=(Vector4 &in, const R &right)
+{
+	Mat44 tmp;
+	math4d_vecmult(&in, &in, 1, Mat44Operand<R>::wrap(right).evaluate(&tmp));
+	return in;
+}
+
+
+#endif
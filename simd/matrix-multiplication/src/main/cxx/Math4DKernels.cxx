@@ -0,0 +1,523 @@
+/*
+ * Based on existing public code, extended by Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __ARM_FEATURE_SVE
+# include <arm_sve.h>
+#endif
+
+#include "Math4DKernels.hxx"
+
+
+void mat_transpose(Mat44 *out, const Mat44 &in)
+{
+	float f00 = in.m[0][0], f01 = in.m[0][1], f02 = in.m[0][2], f03 = in.m[0][3];
+	float f10 = in.m[1][0], f11 = in.m[1][1], f12 = in.m[1][2], f13 = in.m[1][3];
+	float f20 = in.m[2][0], f21 = in.m[2][1], f22 = in.m[2][2], f23 = in.m[2][3];
+	float f30 = in.m[3][0], f31 = in.m[3][1], f32 = in.m[3][2], f33 = in.m[3][3];
+
+	out->m[0][0] = f00; out->m[0][1] = f10; out->m[0][2] = f20; out->m[0][3] = f30;
+	out->m[1][0] = f01; out->m[1][1] = f11; out->m[1][2] = f21; out->m[1][3] = f31;
+	out->m[2][0] = f02; out->m[2][1] = f12; out->m[2][2] = f22; out->m[2][3] = f32;
+	out->m[3][0] = f03; out->m[3][1] = f13; out->m[3][2] = f23; out->m[3][3] = f33;
+}
+
+// C loop implementation (may be vectorized by compiler in newer versions)
+void matmult_ref(Mat44 *out, const Mat44 &A, const Mat44 &B)
+{
+	Mat44 t;
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < 4; j++) {
+			t.m[i][j] = A.m[i][0]*B.m[0][j] + A.m[i][1]*B.m[1][j] + A.m[i][2]*B.m[2][j] + A.m[i][3]*B.m[3][j];
+		}
+	}
+
+	*out = t;
+}
+
+// C loop implementation (may be vectorized by compiler in newer versions)
+void vecmult_ref(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m)
+{
+	for (size_t c = 0; c < count; ++c) {
+		Vector4 t;
+		for (int j = 0; j < 4; j++) {
+			t.m[j] = in[c].m[0]*m.m[0][j] + in[c].m[1]*m.m[1][j] + in[c].m[2]*m.m[2][j] + in[c].m[3]*m.m[3][j];
+		}
+
+		out[c] = t;
+	}
+}
+
+// C loop implementation (may be vectorized by compiler in newer versions)
+void vecTmult_ref(Vector4 *out, const Mat44 &m, const Vector4 *in, size_t count)
+{
+	for (size_t c = 0; c < count; ++c) {
+		Vector4 t;
+		for (int j = 0; j < 4; j++) {
+			t.m[j] = in[c].m[0]*m.m[j][0] + in[c].m[1]*m.m[j][1] + in[c].m[2]*m.m[j][2] + in[c].m[3]*m.m[j][3];
+		}
+
+		out[c] = t;
+	}
+}
+
+#ifdef __SSE__
+// Vector by matrix multiplication, SSE based:
+static inline __m128 vectorMultiplyMatrix_Sse(const __m128 a, const Mat44 &B)
+{
+	__m128 result;
+	result = _mm_mul_ps(_mm_shuffle_ps(a, a, 0x00), B.row[0]);
+	result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(a, a, 0x55), B.row[1]));
+	result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(a, a, 0xaa), B.row[2]));
+	result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(a, a, 0xff), B.row[3]));
+	return result;
+}
+
+static inline __m128 vectorMultiplyMatrix_Sse(const __m128 a, const __m128 b0, const __m128 b1, const __m128 b2, const __m128 b3)
+{
+	__m128 result;
+	result = _mm_mul_ps(_mm_shuffle_ps(a, a, 0x00), b0);
+	result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(a, a, 0x55), b1));
+	result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(a, a, 0xaa), b2));
+	result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(a, a, 0xff), b3));
+	return result;
+}
+
+// SSE based:
+void matmult_Sse(Mat44 *out, const Mat44 &A, const Mat44 &B)
+{
+	__m128 out0x = vectorMultiplyMatrix_Sse(A.row[0], B);
+	__m128 out1x = vectorMultiplyMatrix_Sse(A.row[1], B);
+	__m128 out2x = vectorMultiplyMatrix_Sse(A.row[2], B);
+	__m128 out3x = vectorMultiplyMatrix_Sse(A.row[3], B);
+
+	out->row[0] = out0x;
+	out->row[1] = out1x;
+	out->row[2] = out2x;
+	out->row[3] = out3x;
+}
+
+void vecmult_Sse(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m)
+{
+	for (size_t c = 0; c < count; ++c) {
+		out[c].row = vectorMultiplyMatrix_Sse(in[c].row, m);
+	}
+}
+
+void vecmult_SsePar2(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m)
+{
+	__m128 b0 = m.row[0];
+	__m128 b1 = m.row[1];
+	__m128 b2 = m.row[2];
+	__m128 b3 = m.row[3];
+
+	size_t count0 = count&~1;
+	for (size_t c = 0; c < count0; c += 2) {
+		__m128 v0 = in[c].row;
+		__m128 v1 = in[c+1].row;
+		out[c].row = vectorMultiplyMatrix_Sse(v0, b0, b1, b2, b3);
+		out[c+1].row = vectorMultiplyMatrix_Sse(v1, b0, b1, b2, b3);
+	}
+	if ((count&1) != 0) {
+		out[count-1].row = vectorMultiplyMatrix_Sse(in[count-1].row, b0, b1, b2, b3);
+	}
+}
+
+// _mm_hadd_ps is SSE3, above the x86_64 baseline
+__attribute__((target("sse3")))
+void vecTmult_SseSingles(Vector4 *out, const Mat44 &m, const Vector4 *in, size_t count)
+{
+	for (size_t c = 0; c < count; c += 1) {
+		__m128 v = in[c].row;
+		__m128 x0 = _mm_mul_ps(v, m.row[0]);
+		__m128 x1 = _mm_mul_ps(v, m.row[1]);
+		__m128 x2 = _mm_mul_ps(v, m.row[2]);
+		__m128 x3 = _mm_mul_ps(v, m.row[3]);
+		__m128 s01 = _mm_hadd_ps(x0, x1);
+		__m128 s23 = _mm_hadd_ps(x2, x3);
+		__m128 s0123 = _mm_hadd_ps(s01, s23);
+		out[c].row = s0123;
+	}
+}
+#endif
+
+#ifdef __aarch64__
+// Vector by matrix multiplication, Neon based:
+static inline float32x4_t vectorMultiplyMatrix_Neon(const float32x4_t a, const float32x4_t b0, const float32x4_t b1, const float32x4_t b2, const float32x4_t b3)
+{
+	float32x4_t result = vmulq_laneq_f32(b0, a, 0);
+	result = vfmaq_laneq_f32(result, b1, a, 1);
+	result = vfmaq_laneq_f32(result, b2, a, 2);
+	result = vfmaq_laneq_f32(result, b3, a, 3);
+	return result;
+}
+
+// Neon based:
+void matmult_Neon(Mat44 *out, const Mat44 &A, const Mat44 &B)
+{
+	float32x4_t b0 = B.row[0];
+	float32x4_t b1 = B.row[1];
+	float32x4_t b2 = B.row[2];
+	float32x4_t b3 = B.row[3];
+
+	out->row[0] = vectorMultiplyMatrix_Neon(A.row[0], b0, b1, b2, b3);
+	out->row[1] = vectorMultiplyMatrix_Neon(A.row[1], b0, b1, b2, b3);
+	out->row[2] = vectorMultiplyMatrix_Neon(A.row[2], b0, b1, b2, b3);
+	out->row[3] = vectorMultiplyMatrix_Neon(A.row[3], b0, b1, b2, b3);
+}
+
+void matmult_NeonPar2(Mat44 *out, const Mat44 &A, const Mat44 &B)
+{
+	float32x4_t b0 = B.row[0];
+	float32x4_t b1 = B.row[1];
+	float32x4_t b2 = B.row[2];
+	float32x4_t b3 = B.row[3];
+
+	float32x4_t a0 = A.row[0];
+	float32x4_t a1 = A.row[1];
+	float32x4_t a2 = A.row[2];
+	float32x4_t a3 = A.row[3];
+	out->row[0] = vectorMultiplyMatrix_Neon(a0, b0, b1, b2, b3);
+	out->row[1] = vectorMultiplyMatrix_Neon(a1, b0, b1, b2, b3);
+	out->row[2] = vectorMultiplyMatrix_Neon(a2, b0, b1, b2, b3);
+	out->row[3] = vectorMultiplyMatrix_Neon(a3, b0, b1, b2, b3);
+}
+
+void matmult_NeonPar4(Mat44 *out, const Mat44 &A, const Mat44 &B)
+{
+	float32x4_t b0 = B.row[0];
+	float32x4_t b1 = B.row[1];
+	float32x4_t b2 = B.row[2];
+	float32x4_t b3 = B.row[3];
+
+	float32x4_t a0 = A.row[0];
+	float32x4_t a1 = A.row[1];
+	float32x4_t a2 = A.row[2];
+	float32x4_t a3 = A.row[3];
+
+	float32x4_t c0 = vmulq_laneq_f32(b0, a0, 0);
+	float32x4_t c1 = vmulq_laneq_f32(b0, a1, 0);
+	float32x4_t c2 = vmulq_laneq_f32(b0, a2, 0);
+	float32x4_t c3 = vmulq_laneq_f32(b0, a3, 0);
+
+	c0 = vfmaq_laneq_f32(c0, b1, a0, 1);
+	c1 = vfmaq_laneq_f32(c1, b1, a1, 1);
+	c2 = vfmaq_laneq_f32(c2, b1, a2, 1);
+	c3 = vfmaq_laneq_f32(c3, b1, a3, 1);
+
+	c0 = vfmaq_laneq_f32(c0, b2, a0, 2);
+	c1 = vfmaq_laneq_f32(c1, b2, a1, 2);
+	c2 = vfmaq_laneq_f32(c2, b2, a2, 2);
+	c3 = vfmaq_laneq_f32(c3, b2, a3, 2);
+
+	c0 = vfmaq_laneq_f32(c0, b3, a0, 3);
+	c1 = vfmaq_laneq_f32(c1, b3, a1, 3);
+	c2 = vfmaq_laneq_f32(c2, b3, a2, 3);
+	c3 = vfmaq_laneq_f32(c3, b3, a3, 3);
+
+	out->row[0] = c0;
+	out->row[1] = c1;
+	out->row[2] = c2;
+	out->row[3] = c3;
+}
+
+void vecmult_Neon(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m)
+{
+	float32x4_t b0 = m.row[0];
+	float32x4_t b1 = m.row[1];
+	float32x4_t b2 = m.row[2];
+	float32x4_t b3 = m.row[3];
+
+	for (size_t c = 0; c < count; ++c) {
+		out[c].row = vectorMultiplyMatrix_Neon(in[c].row, b0, b1, b2, b3);
+	}
+}
+
+void vecmult_NeonPar2(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m)
+{
+	float32x4_t b0 = m.row[0];
+	float32x4_t b1 = m.row[1];
+	float32x4_t b2 = m.row[2];
+	float32x4_t b3 = m.row[3];
+
+	size_t count0 = count&~1;
+	for (size_t c = 0; c < count0; c += 2) {
+		float32x4_t a0 = in[c].row;
+		float32x4_t a1 = in[c+1].row;
+		float32x4_t r0 = vmulq_laneq_f32(b0, a0, 0);
+		float32x4_t r1 = vmulq_laneq_f32(b0, a1, 0);
+		r0 = vfmaq_laneq_f32(r0, b1, a0, 1);
+		r1 = vfmaq_laneq_f32(r1, b1, a1, 1);
+		r0 = vfmaq_laneq_f32(r0, b2, a0, 2);
+		r1 = vfmaq_laneq_f32(r1, b2, a1, 2);
+		r0 = vfmaq_laneq_f32(r0, b3, a0, 3);
+		r1 = vfmaq_laneq_f32(r1, b3, a1, 3);
+		out[c].row = r0;
+		out[c+1].row = r1;
+	}
+	if (count&1) {
+		out[count-1].row = vectorMultiplyMatrix_Neon(in[count-1].row, b0, b1, b2, b3);
+	}
+}
+
+void vecTmult_Neon(Vector4 *out, const Mat44 &m, const Vector4 *in, size_t count)
+{
+	float32x4_t b0 = m.row[0];
+	float32x4_t b1 = m.row[1];
+	float32x4_t b2 = m.row[2];
+	float32x4_t b3 = m.row[3];
+
+	for (size_t c = 0; c < count; ++c) {
+		float32x4_t v = in[c].row;
+		float32x4_t r0 = vmulq_f32(v, b0);
+		float32x4_t r1 = vmulq_f32(v, b1);
+		float32x4_t r2 = vmulq_f32(v, b2);
+		float32x4_t r3 = vmulq_f32(v, b3);
+		float32x4_t s01 = vpaddq_f32(r0, r1);
+		float32x4_t s23 = vpaddq_f32(r2, r3);
+		float32x4_t s0123 = vpaddq_f32(s01, s23);
+		out[c].row = s0123;
+	}
+}
+
+void vecTmult_NeonPar2(Vector4 *out, const Mat44 &m, const Vector4 *in, size_t count)
+{
+	float32x4_t b0 = m.row[0];
+	float32x4_t b1 = m.row[1];
+	float32x4_t b2 = m.row[2];
+	float32x4_t b3 = m.row[3];
+
+	size_t count0 = count&~1;
+	for (size_t c = 0; c < count0; c += 2) {
+		float32x4_t v0 = in[c].row;
+		float32x4_t v1 = in[c+1].row;
+		float32x4_t v0r0 = vmulq_f32(v0, b0);
+		float32x4_t v1r0 = vmulq_f32(v1, b0);
+		float32x4_t v0r1 = vmulq_f32(v0, b1);
+		float32x4_t v1r1 = vmulq_f32(v1, b1);
+		float32x4_t v0r2 = vmulq_f32(v0, b2);
+		float32x4_t v1r2 = vmulq_f32(v1, b2);
+		float32x4_t v0r3 = vmulq_f32(v0, b3);
+		float32x4_t v1r3 = vmulq_f32(v1, b3);
+		float32x4_t v0s01 = vpaddq_f32(v0r0, v0r1);
+		float32x4_t v1s01 = vpaddq_f32(v1r0, v1r1);
+		float32x4_t v0s23 = vpaddq_f32(v0r2, v0r3);
+		float32x4_t v1s23 = vpaddq_f32(v1r2, v1r3);
+		float32x4_t v0s0123 = vpaddq_f32(v0s01, v0s23);
+		float32x4_t v1s0123 = vpaddq_f32(v1s01, v1s23);
+		out[c].row = v0s0123;
+		out[c+1].row = v1s0123;
+	}
+}
+#endif
+
+#ifdef __ARM_FEATURE_SVE
+// SVE based:
+
+void matmult_SveRows(Mat44 *out, const Mat44 &A, const Mat44 &B)
+{
+	const size_t n = 4;
+	// these are the rows A
+	svfloat32_t A0;
+	svfloat32_t A1;
+	svfloat32_t A2;
+	svfloat32_t A3;
+
+	// these are the rows B
+	svfloat32_t B0;
+	svfloat32_t B1;
+	svfloat32_t B2;
+	svfloat32_t B3;
+
+	// these are the rows C
+	svfloat32_t C0;
+	svfloat32_t C1;
+	svfloat32_t C2;
+	svfloat32_t C3;
+
+	svbool_t pred = svwhilelt_b32_u32(0, n);
+
+	B0 = svld1_f32(pred, &B.row[0][0]);
+	B1 = svld1_f32(pred, &B.row[1][0]);
+	B2 = svld1_f32(pred, &B.row[2][0]);
+	B3 = svld1_f32(pred, &B.row[3][0]);
+
+	// Zero accumulators for C values
+	C0 = svdup_n_f32(0);
+	C1 = svdup_n_f32(0);
+	C2 = svdup_n_f32(0);
+	C3 = svdup_n_f32(0);
+
+	// Multiply accumulate in 4x1 blocks, that is each row in C
+	A0 = svld1rq_f32(svptrue_b32(), &A.row[0][0]);
+	C0 = svmla_lane_f32(C0, B0, A0, 0);
+	C0 = svmla_lane_f32(C0, B1, A0, 1);
+	C0 = svmla_lane_f32(C0, B2, A0, 2);
+	C0 = svmla_lane_f32(C0, B3, A0, 3);
+	svst1_f32(pred, &out->row[0][0], C0);
+
+	A1 = svld1rq_f32(svptrue_b32(), &A.row[1][0]);
+	C1 = svmla_lane_f32(C1, B0, A1, 0);
+	C1 = svmla_lane_f32(C1, B1, A1, 1);
+	C1 = svmla_lane_f32(C1, B2, A1, 2);
+	C1 = svmla_lane_f32(C1, B3, A1, 3);
+	svst1_f32(pred, &out->row[1][0], C1);
+
+	A2 = svld1rq_f32(svptrue_b32(), &A.row[2][0]);
+	C2 = svmla_lane_f32(C2, B0, A2, 0);
+	C2 = svmla_lane_f32(C2, B1, A2, 1);
+	C2 = svmla_lane_f32(C2, B2, A2, 2);
+	C2 = svmla_lane_f32(C2, B3, A2, 3);
+	svst1_f32(pred, &out->row[2][0], C2);
+
+	A3 = svld1rq_f32(svptrue_b32(), &A.row[3][0]);
+	C3 = svmla_lane_f32(C3, B0, A3, 0);
+	C3 = svmla_lane_f32(C3, B1, A3, 1);
+	C3 = svmla_lane_f32(C3, B2, A3, 2);
+	C3 = svmla_lane_f32(C3, B3, A3, 3);
+	svst1_f32(pred, &out->row[3][0], C3);
+}
+
+void matmult_SveSingle(Mat44 *out, const Mat44 &A, const Mat44 &B)
+{
+	// we have 4 rows, 4*4 floats
+	const size_t n = 4;
+
+	// these are the rows A
+	svfloat32_t A0;
+	svfloat32_t A1;
+	svfloat32_t A2;
+	svfloat32_t A3;
+
+	// these are the rows B
+	svfloat32_t B0;
+	svfloat32_t B1;
+	svfloat32_t B2;
+	svfloat32_t B3;
+
+	// this is full result
+	svfloat32_t Ca;
+
+	svbool_t pred = svwhilelt_b32_u32(0, n);
+
+	B0 = svld1_f32(svptrue_b32(), &B.row[0][0]);
+	B1 = svld1_f32(svptrue_b32(), &B.row[1][0]);
+	B2 = svld1_f32(svptrue_b32(), &B.row[2][0]);
+	B3 = svld1_f32(svptrue_b32(), &B.row[3][0]);
+
+	// Multiply accumulate in 4x1 blocks, that is each row in C
+	A0 = svld1rq_f32(pred, &A.row[0][0]);
+	Ca = svmul_lane_f32(B0, A0, 0);
+	Ca = svmla_lane_f32(Ca, B1, A0, 1);
+	Ca = svmla_lane_f32(Ca, B2, A0, 2);
+	Ca = svmla_lane_f32(Ca, B3, A0, 3);
+	svst1_f32(pred, &out->row[0][0], Ca);
+}
+
+void vecmult_Sve(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m)
+{
+	const size_t n = count;
+
+	// these are the rows M
+	svfloat32_t M0;
+	svfloat32_t M1;
+	svfloat32_t M2;
+	svfloat32_t M3;
+
+	// these are the rows B
+	svfloat32_t A0;
+
+	// these are the rows C
+	svfloat32_t C0;
+
+	svbool_t pred = svwhilelt_b32_u32(0, n);
+
+	M0 = svld1rq_f32(svptrue_b32(), &m.row[0][0]);
+	M1 = svld1rq_f32(svptrue_b32(), &m.row[1][0]);
+	M2 = svld1rq_f32(svptrue_b32(), &m.row[2][0]);
+	M3 = svld1rq_f32(svptrue_b32(), &m.row[3][0]);
+
+	A0 = svld1_f32(pred, &in[0].row[0]);
+
+	// Multiply accumulate in 4x1 blocks, that is each row in C
+	C0 = svmul_lane_f32(M0, A0, 0);
+	C0 = svmla_lane_f32(C0, M1, A0, 1);
+	C0 = svmla_lane_f32(C0, M2, A0, 2);
+	C0 = svmla_lane_f32(C0, M3, A0, 3);
+	svst1_f32(pred, &out[0].row[0], C0);
+}
+
+#endif
+
+
+// matmult variants
+const MatmultVariant matmult_variants[] = {
+	{ "matmult_ref",       matmult_ref,       0 },
+#ifdef __SSE__
+	{ "matmult_Sse",       matmult_Sse,       0 },
+#endif
+#ifdef __x86_64__
+	{ "matmult_Avx4Mem",   matmult_Avx4Mem,   MATH4D_AVX },
+	{ "matmult_Avx8",      matmult_Avx8,      MATH4D_AVX },
+	{ "matmult_Fma",       matmult_Fma,       MATH4D_AVX2_FMA },
+	{ "matmult_FmaExp",    matmult_FmaExp,    MATH4D_AVX2_FMA },
+	{ "matmult_Fma256Exp", matmult_Fma256Exp, MATH4D_AVX2_FMA },
+	{ "matmult_Fma256Pre", matmult_Fma256Pre, MATH4D_AVX2_FMA },
+	{ "matmult_Avx512",    matmult_Avx512,    MATH4D_AVX512 },
+#endif
+#if (defined __aarch64__)
+	{ "matmult_Neon",      matmult_Neon,      0 },
+	{ "matmult_NeonPar2",  matmult_NeonPar2,  0 },
+	{ "matmult_NeonPar4",  matmult_NeonPar4,  0 },
+#endif
+#ifdef __ARM_FEATURE_SVE
+	{ "matmult_SveRows",   matmult_SveRows,   0 },
+	{ "matmult_SveSingle", matmult_SveSingle, 0 },
+#endif
+};
+
+const size_t matmult_variants_count = sizeof(matmult_variants)/sizeof(matmult_variants[0]);
+
+// vecmult variants
+const VecmultVariant vecmult_variants[] = {
+	{ "vecmult_ref",       vecmult_ref,       0 },
+#ifdef __SSE__
+	{ "vecmult_Sse",       vecmult_Sse,       0 },
+	{ "vecmult_SsePar2",   vecmult_SsePar2,   0 },
+#endif
+#ifdef __x86_64__
+	{ "vecmult_FmaExp",    vecmult_FmaExp,    MATH4D_AVX2_FMA },
+	{ "vecmult_Fma256Exp", vecmult_Fma256Exp, MATH4D_AVX2_FMA },
+	{ "vecmult_Avx512",    vecmult_Avx512,    MATH4D_AVX512 },
+#endif
+#if (defined __aarch64__)
+	{ "vecmult_Neon",      vecmult_Neon,      0 },
+	{ "vecmult_NeonPar2",  vecmult_NeonPar2,  0 },
+#endif
+#if (defined __ARM_FEATURE_SVE)
+	{ "vecmult_Sve",       vecmult_Sve,       0 },
+#endif
+};
+
+const size_t vecmult_variants_count = sizeof(vecmult_variants)/sizeof(vecmult_variants[0]);
+
+// vecTmult variants
+const VecTmultVariant vecTmult_variants[] = {
+	{ "vecTmult_ref",           vecTmult_ref,           0 },
+#ifdef __SSE__
+	{ "vecTmult_SseSingles",    vecTmult_SseSingles,    MATH4D_SSE3 },
+#endif
+#ifdef __x86_64__
+	{ "vecTmult_Avx256Singles", vecTmult_Avx256Singles, MATH4D_AVX },
+	{ "vecTmult_TransFma256",   vecTmult_TransFma256,   MATH4D_AVX2_FMA },
+	{ "vecTmult_Avx512Singles", vecTmult_Avx512Singles, MATH4D_AVX512 },
+#endif
+#if (defined __aarch64__)
+	{ "vecTmult_Neon",          vecTmult_Neon,          0 },
+	{ "vecTmult_NeonPar2",      vecTmult_NeonPar2,      0 },
+#endif
+};
+
+const size_t vecTmult_variants_count = sizeof(vecTmult_variants)/sizeof(vecTmult_variants[0]);
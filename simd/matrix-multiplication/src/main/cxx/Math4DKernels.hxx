@@ -0,0 +1,180 @@
+/*
+ * Based on existing public code, extended by Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+
+#ifndef Math4DKernels_hxx__
+# define Math4DKernels_hxx__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Math4D.hxx"
+
+
+void mat_transpose(Mat44 *out, const Mat44 &in);
+
+void matmult_ref(Mat44 *out, const Mat44 &A, const Mat44 &B);
+void vecmult_ref(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m);
+void vecTmult_ref(Vector4 *out, const Mat44 &m, const Vector4 *in, size_t count);
+
+// Benchmark only, built into the benchmark executable and never dispatched by the library
+void matmult_novec(Mat44 *out, const Mat44 &A, const Mat44 &B);
+void vecmult_novec(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m);
+
+#ifdef __x86_64__
+void matmult_Fpu87(Mat44 *out, const Mat44 &A, const Mat44 &B);
+void vecmult_Fpu87(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m);
+#endif
+
+// The library is built for the baseline ISA, x86 variants above it are compiled in their own files with their own
+// flags, so they are declared for any x86_64 build and dispatched only if the running CPU has the features.
+
+#ifdef __SSE__
+void matmult_Sse(Mat44 *out, const Mat44 &A, const Mat44 &B);
+void vecmult_Sse(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m);
+void vecmult_SsePar2(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m);
+void vecTmult_SseSingles(Vector4 *out, const Mat44 &m, const Vector4 *in, size_t count);
+#endif
+
+#ifdef __x86_64__
+void matmult_Avx4Mem(Mat44 *out, const Mat44 &A, const Mat44 &B);
+void matmult_Avx8(Mat44 *out, const Mat44 &A, const Mat44 &B);
+void vecTmult_Avx256Singles(Vector4 *out, const Mat44 &mT, const Vector4 *in, size_t count);
+#endif
+
+#ifdef __x86_64__
+void matmult_Fma(Mat44 *out, const Mat44 &A, const Mat44 &B);
+void matmult_FmaExp(Mat44 *out, const Mat44 &A, const Mat44 &B);
+void vecmult_FmaExp(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m);
+void matmult_Fma256Exp(Mat44 *out, const Mat44 &A, const Mat44 &B);
+void matmult_Fma256Pre(Mat44 *out, const Mat44 &A, const Mat44 &B);
+void vecmult_Fma256Exp(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m);
+void vecTmult_TransFma256(Vector4 *out, const Mat44 &m, const Vector4 *in, size_t count);
+#endif
+
+#ifdef __x86_64__
+void matmult_Avx512(Mat44 *out, const Mat44 &A, const Mat44 &B);
+void vecmult_Avx512(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m);
+void vecTmult_Avx512Singles(Vector4 *out, const Mat44 &m, const Vector4 *in, size_t count);
+#endif
+
+#ifdef __aarch64__
+void matmult_Neon(Mat44 *out, const Mat44 &A, const Mat44 &B);
+void matmult_NeonPar2(Mat44 *out, const Mat44 &A, const Mat44 &B);
+void matmult_NeonPar4(Mat44 *out, const Mat44 &A, const Mat44 &B);
+void vecmult_Neon(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m);
+void vecmult_NeonPar2(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m);
+void vecTmult_Neon(Vector4 *out, const Mat44 &m, const Vector4 *in, size_t count);
+void vecTmult_NeonPar2(Vector4 *out, const Mat44 &m, const Vector4 *in, size_t count);
+#endif
+
+#ifdef __ARM_FEATURE_SVE
+void matmult_SveRows(Mat44 *out, const Mat44 &A, const Mat44 &B);
+void matmult_SveSingle(Mat44 *out, const Mat44 &A, const Mat44 &B);
+void vecmult_Sve(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m);
+#endif
+
+
+// Bounds transformation, matrix is expected to be affine (last column 0, 0, 0, 1).  Spheres are stored as Vector4
+// with center in x, y, z and radius in w.  Planes for culling are six Vector4 (a, b, c, d), the inside is where
+// a*x+b*y+c*z+d >= 0.  Culling sets bit (c%64) of visible[c/64] if box c is not completely outside of any plane.
+
+void aabbmult_ref(Aabb *out, const Aabb *in, size_t count, const Mat44 &m);
+void spheremult_ref(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m);
+void aabbcull_ref(uint64_t *visible, const Aabb *in, size_t count, const Mat44 &m, const Vector4 *planes);
+
+#ifdef __SSE__
+void aabbmult_Sse(Aabb *out, const Aabb *in, size_t count, const Mat44 &m);
+void spheremult_Sse(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m);
+void aabbcull_Sse(uint64_t *visible, const Aabb *in, size_t count, const Mat44 &m, const Vector4 *planes);
+#endif
+
+#ifdef __x86_64__
+void aabbmult_Fma256(Aabb *out, const Aabb *in, size_t count, const Mat44 &m);
+void spheremult_Fma256(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m);
+void aabbcull_Fma256(uint64_t *visible, const Aabb *in, size_t count, const Mat44 &m, const Vector4 *planes);
+#endif
+
+#ifdef __x86_64__
+void aabbmult_Avx512(Aabb *out, const Aabb *in, size_t count, const Mat44 &m);
+void spheremult_Avx512(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m);
+void aabbcull_Avx512(uint64_t *visible, const Aabb *in, size_t count, const Mat44 &m, const Vector4 *planes);
+#endif
+
+#ifdef __aarch64__
+void aabbmult_Neon(Aabb *out, const Aabb *in, size_t count, const Mat44 &m);
+void spheremult_Neon(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m);
+void aabbcull_Neon(uint64_t *visible, const Aabb *in, size_t count, const Mat44 &m, const Vector4 *planes);
+#endif
+
+
+// CPU features required by variant on top of the build baseline
+enum Math4DFeature {
+	MATH4D_SSE3 = 1,
+	MATH4D_AVX = 2,
+	MATH4D_AVX2_FMA = 4,
+	MATH4D_AVX512 = 8, // F, DQ and FMA
+};
+
+// Whether the running CPU supports all the features
+bool math4dCpuSupports(unsigned features);
+
+// All variants compiled for the target, the first one is always the reference implementation.  Only the variants
+// the running CPU supports may be called.
+
+struct MatmultVariant {
+	const char *name;
+	void (*matmult)(Mat44 *out, const Mat44 &A, const Mat44 &B);
+	unsigned features;
+};
+
+struct VecmultVariant {
+	const char *name;
+	void (*vecmult)(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m);
+	unsigned features;
+};
+
+struct VecTmultVariant {
+	const char *name;
+	void (*vecTmult)(Vector4 *out, const Mat44 &m, const Vector4 *in, size_t count);
+	unsigned features;
+};
+
+struct AabbmultVariant {
+	const char *name;
+	void (*aabbmult)(Aabb *out, const Aabb *in, size_t count, const Mat44 &m);
+	unsigned features;
+};
+
+struct SpheremultVariant {
+	const char *name;
+	void (*spheremult)(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m);
+	unsigned features;
+};
+
+struct AabbcullVariant {
+	const char *name;
+	void (*aabbcull)(uint64_t *visible, const Aabb *in, size_t count, const Mat44 &m, const Vector4 *planes);
+	unsigned features;
+};
+
+extern const MatmultVariant matmult_variants[];
+extern const size_t matmult_variants_count;
+
+extern const VecmultVariant vecmult_variants[];
+extern const size_t vecmult_variants_count;
+
+extern const VecTmultVariant vecTmult_variants[];
+extern const size_t vecTmult_variants_count;
+
+extern const AabbmultVariant aabbmult_variants[];
+extern const size_t aabbmult_variants_count;
+
+extern const SpheremultVariant spheremult_variants[];
+extern const size_t spheremult_variants_count;
+
+extern const AabbcullVariant aabbcull_variants[];
+extern const size_t aabbcull_variants_count;
+
+
+#endif
@@ -0,0 +1,78 @@
+/*
+ * AVX kernels, compiled with -mavx and dispatched only on CPUs supporting it.
+ *
+ * Based on existing public code, extended by Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Math4DKernels.hxx"
+
+
+#ifdef __AVX__
+// vector by matrix multiplication, AVX based:
+static inline __m128 vectorMultiplyMatrix_Avx4Mem(const float *a, const Mat44 &B)
+{
+	__m128 result;
+	result = _mm_mul_ps(_mm_broadcast_ss(&a[0]), B.row[0]);
+	result = _mm_add_ps(result, _mm_mul_ps(_mm_broadcast_ss(&a[1]), B.row[1]));
+	result = _mm_add_ps(result, _mm_mul_ps(_mm_broadcast_ss(&a[2]), B.row[2]));
+	result = _mm_add_ps(result, _mm_mul_ps(_mm_broadcast_ss(&a[3]), B.row[3]));
+	return result;
+}
+
+// AVX based:
+void matmult_Avx4Mem(Mat44 *out, const Mat44 &A, const Mat44 &B)
+{
+	_mm256_zeroupper();
+	__m128 out0x = vectorMultiplyMatrix_Avx4Mem(A.m[0], B);
+	__m128 out1x = vectorMultiplyMatrix_Avx4Mem(A.m[1], B);
+	__m128 out2x = vectorMultiplyMatrix_Avx4Mem(A.m[2], B);
+	__m128 out3x = vectorMultiplyMatrix_Avx4Mem(A.m[3], B);
+
+	out->row[0] = out0x;
+	out->row[1] = out1x;
+	out->row[2] = out2x;
+	out->row[3] = out3x;
+}
+#endif
+
+#ifdef __AVX__
+// vector by matrix multiplication, AVX based, two at a time:
+static inline __m256 vectorMultiplyMatrixDual_Avx(__m256 A01, const Mat44 &B)
+{
+	__m256 result;
+	result = _mm256_mul_ps(_mm256_shuffle_ps(A01, A01, 0x00), _mm256_broadcast_ps(&B.row[0]));
+	result = _mm256_add_ps(result, _mm256_mul_ps(_mm256_shuffle_ps(A01, A01, 0x55), _mm256_broadcast_ps(&B.row[1])));
+	result = _mm256_add_ps(result, _mm256_mul_ps(_mm256_shuffle_ps(A01, A01, 0xaa), _mm256_broadcast_ps(&B.row[2])));
+	result = _mm256_add_ps(result, _mm256_mul_ps(_mm256_shuffle_ps(A01, A01, 0xff), _mm256_broadcast_ps(&B.row[3])));
+	return result;
+}
+
+// Avxbased, two vectors at once:
+void matmult_Avx8(Mat44 *out, const Mat44 &A, const Mat44 &B)
+{
+	__m256 A01 = _mm256_loadu_ps(&A.m[0][0]);
+	__m256 A23 = _mm256_loadu_ps(&A.m[2][0]);
+
+	__m256 out01x = vectorMultiplyMatrixDual_Avx(A01, B);
+	__m256 out23x = vectorMultiplyMatrixDual_Avx(A23, B);
+
+	_mm256_storeu_ps(&out->m[0][0], out01x);
+	_mm256_storeu_ps(&out->m[2][0], out23x);
+}
+
+void vecTmult_Avx256Singles(Vector4 *out, const Mat44 &mT, const Vector4 *in, size_t count)
+{
+	__m256 m02 = _mm256_insertf128_ps(_mm256_castps128_ps256(mT.row[0]), mT.row[2], 1);
+	__m256 m13 = _mm256_insertf128_ps(_mm256_castps128_ps256(mT.row[1]), mT.row[3], 1);
+
+	for (size_t c = 0; c < count; c += 1) {
+		__m256 v00 = _mm256_broadcast_ps(&in[c].row);
+		__m256 r02 = _mm256_mul_ps(v00, m02);
+		__m256 r13 = _mm256_mul_ps(v00, m13);
+		__m256 s0213 = _mm256_hadd_ps(r02, r13);
+		out[c].row = _mm_hadd_ps(_mm256_castps256_ps128(s0213), _mm256_extractf128_ps(s0213, 1));
+	}
+}
+#endif
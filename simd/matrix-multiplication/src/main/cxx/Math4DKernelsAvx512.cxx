@@ -0,0 +1,95 @@
+/*
+ * AVX-512 kernels, compiled with -mavx512f -mavx512dq -mfma and dispatched only on CPUs supporting it.
+ *
+ * Based on existing public code, extended by Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Math4DKernels.hxx"
+
+
+#if (defined __AVX512F__)
+// Vector by matrix multiplication, FMA based:
+static inline __m128 vectorMultiplyMatrix_FmaExp(const __m128 a, const __m128 b0, const __m128 b1, const __m128 b2, const __m128 b3)
+{
+	__m128 result = _mm_mul_ps(_mm_permute_ps(a, 0x00), b0);
+	result = _mm_fmadd_ps(_mm_permute_ps(a, 0x55), b1, result);
+	result = _mm_fmadd_ps(_mm_permute_ps(a, 0xaa), b2, result);
+	result = _mm_fmadd_ps(_mm_permute_ps(a, 0xff), b3, result);
+	return result;
+}
+
+// Vectors by matrix multiplication, FMA256 based:
+static inline __m256 vectorMultiplyMatrix_Fma256Exp(const __m256 at, const __m256 b00, const __m256 b11, __m256 b22, __m256 b33)
+{
+	__m256 result = _mm256_mul_ps(_mm256_permute_ps(at, 0x00), b00);
+	result = _mm256_fmadd_ps(_mm256_permute_ps(at, 0x55), b11, result);
+	result = _mm256_fmadd_ps(_mm256_permute_ps(at, 0xaa), b22, result);
+	result = _mm256_fmadd_ps(_mm256_permute_ps(at, 0xff), b33, result);
+	return result;
+}
+
+// Vectors by matrix multiplication, AVX-512 based:
+static inline __m512 vectorMultiplyMatrix_Avx512(const __m512 a0123, const __m512 b0000, const __m512 b1111, __m512 b2222, __m512 b3333)
+{
+	__m512 result = _mm512_mul_ps(_mm512_permute_ps(a0123, 0x00), b0000);
+	result = _mm512_fmadd_ps(_mm512_permute_ps(a0123, 0x55), b1111, result);
+	result = _mm512_fmadd_ps(_mm512_permute_ps(a0123, 0xaa), b2222, result);
+	result = _mm512_fmadd_ps(_mm512_permute_ps(a0123, 0xff), b3333, result);
+	return result;
+}
+
+// AVX-512 based:
+void matmult_Avx512(Mat44 *out, const Mat44 &A, const Mat44 &B)
+{
+	__m512 a0123 = _mm512_loadu_ps(&A.m[0][0]);
+	__m512 b0000 = _mm512_broadcast_f32x4(B.row[0]);
+	__m512 b1111 = _mm512_broadcast_f32x4(B.row[1]);
+	__m512 b2222 = _mm512_broadcast_f32x4(B.row[2]);
+	__m512 b3333 = _mm512_broadcast_f32x4(B.row[3]);
+
+	_mm512_storeu_ps(&out->m[0][0], vectorMultiplyMatrix_Avx512(a0123, b0000, b1111, b2222, b3333));
+}
+
+void vecmult_Avx512(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m)
+{
+	__m512 b0000 = _mm512_broadcast_f32x4(m.row[0]);
+	__m512 b1111 = _mm512_broadcast_f32x4(m.row[1]);
+	__m512 b2222 = _mm512_broadcast_f32x4(m.row[2]);
+	__m512 b3333 = _mm512_broadcast_f32x4(m.row[3]);
+
+	size_t count0 = count&~3;
+	for (size_t c = 0; c < count0; c += 4) {
+		_mm512_storeu_ps(out[c].m, vectorMultiplyMatrix_Avx512(_mm512_loadu_ps(in[c].m), b0000, b1111, b2222, b3333));
+	}
+	switch (count&3) {
+	case 3:
+		_mm256_storeu_ps(out[count0].m, vectorMultiplyMatrix_Fma256Exp(_mm256_loadu_ps(in[count0].m), _mm512_castps512_ps256(b0000), _mm512_castps512_ps256(b1111), _mm512_castps512_ps256(b2222), _mm512_castps512_ps256(b3333)));
+		// fall through
+	case 1:
+		out[count-1].row = vectorMultiplyMatrix_FmaExp(in[count-1].row, _mm512_castps512_ps128(b0000), _mm512_castps512_ps128(b1111), _mm512_castps512_ps128(b2222), _mm512_castps512_ps128(b3333));
+		break;
+	case 2:
+		_mm256_storeu_ps(out[count0].m, vectorMultiplyMatrix_Fma256Exp(_mm256_loadu_ps(in[count0].m), _mm512_castps512_ps256(b0000), _mm512_castps512_ps256(b1111), _mm512_castps512_ps256(b2222), _mm512_castps512_ps256(b3333)));
+		break;
+	case 0:
+		break;
+	}
+}
+
+void vecTmult_Avx512Singles(Vector4 *out, const Mat44 &m, const Vector4 *in, size_t count)
+{
+	__m512 a0123 = _mm512_loadu_ps((float *)(uintptr_t)&m.m[0][0]);
+	__m512 a0213 = _mm512_insertf32x4(_mm512_insertf32x4(a0123, _mm512_extractf32x4_ps(a0123, 2), 1), _mm512_extractf32x4_ps(a0123, 1), 2);
+
+	for (size_t c = 0; c < count; c += 1) {
+		__m512 v0000 = _mm512_broadcast_f32x4(in[c].row);
+		__m512 r0213 = _mm512_mul_ps(v0000, a0213);
+		__m256 r02 = _mm512_castps512_ps256(r0213);
+		__m256 r13 = _mm512_extractf32x8_ps(r0213, 1);
+		__m256 s0213 = _mm256_hadd_ps(r02, r13);
+		out[c].row = _mm_hadd_ps(_mm256_castps256_ps128(s0213), _mm256_extractf128_ps(s0213, 1));
+	}
+}
+#endif
@@ -0,0 +1,154 @@
+/*
+ * FMA kernels, compiled with -mavx2 -mfma and dispatched only on CPUs supporting both.
+ *
+ * Based on existing public code, extended by Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Math4DKernels.hxx"
+
+
+#ifdef __FMA__
+// Vector by matrix multiplication, FMA based:
+static inline __m128 vectorMultiplyMatrix_Fma(const __m128 &a, const Mat44 &B)
+{
+	__m128 result = _mm_mul_ps(_mm_permute_ps(a, 0x00), B.row[0]);
+	result = _mm_fmadd_ps(_mm_permute_ps(a, 0x55), B.row[1], result);
+	result = _mm_fmadd_ps(_mm_permute_ps(a, 0xaa), B.row[2], result);
+	result = _mm_fmadd_ps(_mm_permute_ps(a, 0xff), B.row[3], result);
+	return result;
+}
+
+// FMA based:
+void matmult_Fma(Mat44 *out, const Mat44 &A, const Mat44 &B)
+{
+	__m128 out0x = vectorMultiplyMatrix_Fma(A.row[0], B);
+	__m128 out1x = vectorMultiplyMatrix_Fma(A.row[1], B);
+	__m128 out2x = vectorMultiplyMatrix_Fma(A.row[2], B);
+	__m128 out3x = vectorMultiplyMatrix_Fma(A.row[3], B);
+
+	out->row[0] = out0x;
+	out->row[1] = out1x;
+	out->row[2] = out2x;
+	out->row[3] = out3x;
+}
+#endif
+
+#ifdef __FMA__
+// Vector by matrix multiplication, FMA based:
+static inline __m128 vectorMultiplyMatrix_FmaExp(const __m128 a, const __m128 b0, const __m128 b1, const __m128 b2, const __m128 b3)
+{
+	__m128 result = _mm_mul_ps(_mm_permute_ps(a, 0x00), b0);
+	result = _mm_fmadd_ps(_mm_permute_ps(a, 0x55), b1, result);
+	result = _mm_fmadd_ps(_mm_permute_ps(a, 0xaa), b2, result);
+	result = _mm_fmadd_ps(_mm_permute_ps(a, 0xff), b3, result);
+	return result;
+}
+
+// FMA based:
+void matmult_FmaExp(Mat44 *out, const Mat44 &A, const Mat44 &B)
+{
+	__m128 b0 = B.row[0];
+	__m128 b1 = B.row[1];
+	__m128 b2 = B.row[2];
+	__m128 b3 = B.row[3];
+
+	out->row[0] = vectorMultiplyMatrix_FmaExp(A.row[0], b0, b1, b2, b3);
+	out->row[1] = vectorMultiplyMatrix_FmaExp(A.row[1], b0, b1, b2, b3);
+	out->row[2] = vectorMultiplyMatrix_FmaExp(A.row[2], b0, b1, b2, b3);
+	out->row[3] = vectorMultiplyMatrix_FmaExp(A.row[3], b0, b1, b2, b3);
+}
+
+void vecmult_FmaExp(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m)
+{
+	__m128 b0 = m.row[0];
+	__m128 b1 = m.row[1];
+	__m128 b2 = m.row[2];
+	__m128 b3 = m.row[3];
+
+	for (size_t c = 0; c < count; ++c) {
+		out[c].row = vectorMultiplyMatrix_FmaExp(in[c].row, b0, b1, b2, b3);
+	}
+}
+#endif
+
+#ifdef __FMA__
+// Vectors by matrix multiplication, FMA256 based:
+static inline __m256 vectorMultiplyMatrix_Fma256Exp(const __m256 at, const __m256 b00, const __m256 b11, __m256 b22, __m256 b33)
+{
+	__m256 result = _mm256_mul_ps(_mm256_permute_ps(at, 0x00), b00);
+	result = _mm256_fmadd_ps(_mm256_permute_ps(at, 0x55), b11, result);
+	result = _mm256_fmadd_ps(_mm256_permute_ps(at, 0xaa), b22, result);
+	result = _mm256_fmadd_ps(_mm256_permute_ps(at, 0xff), b33, result);
+	return result;
+}
+
+// FMA256 based:
+void matmult_Fma256Exp(Mat44 *out, const Mat44 &A, const Mat44 &B)
+{
+	__m256 b00 = _mm256_broadcast_ps(&B.row[0]);
+	__m256 b11 = _mm256_broadcast_ps(&B.row[1]);
+	__m256 b22 = _mm256_broadcast_ps(&B.row[2]);
+	__m256 b33 = _mm256_broadcast_ps(&B.row[3]);
+
+	_mm256_storeu_ps(&out->m[0][0], vectorMultiplyMatrix_Fma256Exp(_mm256_loadu_ps(&A.m[0][0]), b00, b11, b22, b33));
+	_mm256_storeu_ps(&out->m[2][0], vectorMultiplyMatrix_Fma256Exp(_mm256_loadu_ps(&A.m[2][0]), b00, b11, b22, b33));
+}
+
+// FMA256 based:
+void matmult_Fma256Pre(Mat44 *out, const Mat44 &A, const Mat44 &B)
+{
+	// On some CPUs it is better to read at the beginning, to avoid pipeline conflicts
+	__m256 a01 = _mm256_loadu_ps(&A.m[0][0]);
+	__m256 a23 = _mm256_loadu_ps(&A.m[2][0]);
+
+	__m256 b00 = _mm256_broadcast_ps(&B.row[0]);
+	__m256 b11 = _mm256_broadcast_ps(&B.row[1]);
+	__m256 b22 = _mm256_broadcast_ps(&B.row[2]);
+	__m256 b33 = _mm256_broadcast_ps(&B.row[3]);
+
+	_mm256_storeu_ps(&out->m[0][0], vectorMultiplyMatrix_Fma256Exp(a01, b00, b11, b22, b33));
+	_mm256_storeu_ps(&out->m[2][0], vectorMultiplyMatrix_Fma256Exp(a23, b00, b11, b22, b33));
+}
+
+void vecmult_Fma256Exp(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m)
+{
+	__m256 b00 = _mm256_broadcast_ps(&m.row[0]);
+	__m256 b11 = _mm256_broadcast_ps(&m.row[1]);
+	__m256 b22 = _mm256_broadcast_ps(&m.row[2]);
+	__m256 b33 = _mm256_broadcast_ps(&m.row[3]);
+
+	size_t count0 = count&~1;
+	for (size_t c = 0; c < count0; c += 2) {
+		_mm256_storeu_ps(out[c].m, vectorMultiplyMatrix_Fma256Exp(_mm256_loadu_ps(in[c].m), b00, b11, b22, b33));
+	}
+	if ((count&1) != 0) {
+		out[count-1].row = vectorMultiplyMatrix_FmaExp(in[count-1].row, _mm256_castps256_ps128(b00), _mm256_castps256_ps128(b11), _mm256_castps256_ps128(b22), _mm256_castps256_ps128(b33));
+	}
+}
+
+void vecTmult_TransFma256(Vector4 *out, const Mat44 &m, const Vector4 *in, size_t count)
+{
+	__m256 b00, b11, b22, b33;
+	{
+		__m128 b0 = m.row[0];
+		__m128 b1 = m.row[1];
+		__m128 b2 = m.row[2];
+		__m128 b3 = m.row[3];
+		_MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+		b00 = _mm256_insertf128_ps(_mm256_castps128_ps256(b0), b0, 1);
+		b11 = _mm256_insertf128_ps(_mm256_castps128_ps256(b1), b1, 1);
+		b22 = _mm256_insertf128_ps(_mm256_castps128_ps256(b2), b2, 1);
+		b33 = _mm256_insertf128_ps(_mm256_castps128_ps256(b3), b3, 1);
+	}
+
+	size_t count0 = count&~1;
+	for (size_t c = 0; c < count0; c += 2) {
+		_mm256_storeu_ps(out[c].m, vectorMultiplyMatrix_Fma256Exp(_mm256_loadu_ps(in[c].m), b00, b11, b22, b33));
+	}
+	if ((count&1) != 0) {
+		out[count-1].row = vectorMultiplyMatrix_FmaExp(in[count-1].row, _mm256_castps256_ps128(b00), _mm256_castps256_ps128(b11), _mm256_castps256_ps128(b22), _mm256_castps256_ps128(b33));
+	}
+}
+#endif
@@ -11,737 +11,57 @@
 #include <functional>
 #include <chrono>
 #include <ctime>
-
-#ifdef __ARM_FEATURE_SVE
-# include <arm_sve.h>
-#endif
-
-#include "Math4D.hxx"
-
-
-void mat_transpose(Mat44 *out, const Mat44 &in)
-{
-	float f00 = in.m[0][0], f01 = in.m[0][1], f02 = in.m[0][2], f03 = in.m[0][3];
-	float f10 = in.m[1][0], f11 = in.m[1][1], f12 = in.m[1][2], f13 = in.m[1][3];
-	float f20 = in.m[2][0], f21 = in.m[2][1], f22 = in.m[2][2], f23 = in.m[2][3];
-	float f30 = in.m[3][0], f31 = in.m[3][1], f32 = in.m[3][2], f33 = in.m[3][3];
-
-	out->m[0][0] = f00; out->m[0][1] = f10; out->m[0][2] = f20; out->m[0][3] = f30;
-	out->m[1][0] = f01; out->m[1][1] = f11; out->m[1][2] = f21; out->m[1][3] = f31;
-	out->m[2][0] = f02; out->m[2][1] = f12; out->m[2][2] = f22; out->m[2][3] = f32;
-	out->m[3][0] = f03; out->m[3][1] = f13; out->m[3][2] = f23; out->m[3][3] = f33;
-}
-
-// C loop implementation (may be vectorized by compiler in newer versions)
-void matmult_ref(Mat44 *out, const Mat44 &A, const Mat44 &B)
-{
-	Mat44 t;
-	for (int i = 0; i < 4; i++) {
-		for (int j = 0; j < 4; j++) {
-			t.m[i][j] = A.m[i][0]*B.m[0][j] + A.m[i][1]*B.m[1][j] + A.m[i][2]*B.m[2][j] + A.m[i][3]*B.m[3][j];
-		}
-	}
-
-	*out = t;
-}
-
-// C loop implementation (may be vectorized by compiler in newer versions)
-void vecmult_ref(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m)
+#include <cmath>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+
+#include "Math4DKernels.hxx"
+#include "MatrixMultiplicationBenchmark.hxx"
+#include "Math4DApi.h"
+#include "Math4DExpr.hxx"
+
+
+std::vector<MatmultVariant> matmultVariants;
+std::vector<VecmultVariant> vecmultVariants;
+std::vector<VecTmultVariant> vecTmultVariants;
+std::vector<AabbmultVariant> aabbmultVariants;
+std::vector<SpheremultVariant> spheremultVariants;
+std::vector<AabbcullVariant> aabbcullVariants;
+
+template <typename V>
+static void supportedVariants(std::vector<V> *out, const V *variants, size_t count, std::initializer_list<V> benchmarkOnly)
 {
-	for (size_t c = 0; c < count; ++c) {
-		Vector4 t;
-		for (int j = 0; j < 4; j++) {
-			t.m[j] = in[c].m[0]*m.m[0][j] + in[c].m[1]*m.m[1][j] + in[c].m[2]*m.m[2][j] + in[c].m[3]*m.m[3][j];
-		}
-
-		out[c] = t;
+	out->push_back(variants[0]);
+	out->insert(out->end(), benchmarkOnly);
+	for (size_t i = 1; i < count; ++i) {
+		if (math4dCpuSupports(variants[i].features))
+			out->push_back(variants[i]);
 	}
 }
 
-// C loop implementation (may be vectorized by compiler in newer versions)
-void vecTmult_ref(Vector4 *out, const Mat44 &m, const Vector4 *in, size_t count)
+void initBenchmarkVariants()
 {
-	for (size_t c = 0; c < count; ++c) {
-		Vector4 t;
-		for (int j = 0; j < 4; j++) {
-			t.m[j] = in[c].m[0]*m.m[j][0] + in[c].m[1]*m.m[j][1] + in[c].m[2]*m.m[j][2] + in[c].m[3]*m.m[j][3];
-		}
-
-		out[c] = t;
-	}
-}
-
-void matmult_novec(Mat44 *out, const Mat44 &A, const Mat44 &B);
-void vecmult_novec(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m);
-
+	supportedVariants(&matmultVariants, matmult_variants, matmult_variants_count, {
+		{ "matmult_novec",     matmult_novec,     0 },
 #ifdef __x86_64__
-void matmult_Fpu87(Mat44 *out, const Mat44 &A, const Mat44 &B);
-void vecmult_Fpu87(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m);
-#endif
-
-#ifdef __SSE__
-// Vector by matrix multiplication, SSE based:
-static inline __m128 vectorMultiplyMatrix_Sse(const __m128 a, const Mat44 &B)
-{
-	__m128 result;
-	result = _mm_mul_ps(_mm_shuffle_ps(a, a, 0x00), B.row[0]);
-	result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(a, a, 0x55), B.row[1]));
-	result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(a, a, 0xaa), B.row[2]));
-	result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(a, a, 0xff), B.row[3]));
-	return result;
-}
-
-static inline __m128 vectorMultiplyMatrix_Sse(const __m128 a, const __m128 b0, const __m128 b1, const __m128 b2, const __m128 b3)
-{
-	__m128 result;
-	result = _mm_mul_ps(_mm_shuffle_ps(a, a, 0x00), b0);
-	result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(a, a, 0x55), b1));
-	result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(a, a, 0xaa), b2));
-	result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(a, a, 0xff), b3));
-	return result;
-}
-
-// SSE based:
-void matmult_Sse(Mat44 *out, const Mat44 &A, const Mat44 &B)
-{
-	__m128 out0x = vectorMultiplyMatrix_Sse(A.row[0], B);
-	__m128 out1x = vectorMultiplyMatrix_Sse(A.row[1], B);
-	__m128 out2x = vectorMultiplyMatrix_Sse(A.row[2], B);
-	__m128 out3x = vectorMultiplyMatrix_Sse(A.row[3], B);
-
-	out->row[0] = out0x;
-	out->row[1] = out1x;
-	out->row[2] = out2x;
-	out->row[3] = out3x;
-}
-
-void vecmult_Sse(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m)
-{
-	for (size_t c = 0; c < count; ++c) {
-		out[c].row = vectorMultiplyMatrix_Sse(in[c].row, m);
-	}
-}
-
-void vecmult_SsePar2(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m)
-{
-	__m128 b0 = m.row[0];
-	__m128 b1 = m.row[1];
-	__m128 b2 = m.row[2];
-	__m128 b3 = m.row[3];
-
-	size_t count0 = count&~1;
-	for (size_t c = 0; c < count0; c += 2) {
-		__m128 v0 = in[c].row;
-		__m128 v1 = in[c+1].row;
-		out[c].row = vectorMultiplyMatrix_Sse(v0, b0, b1, b2, b3);
-		out[c+1].row = vectorMultiplyMatrix_Sse(v1, b0, b1, b2, b3);
-	}
-	if ((count&1) != 0) {
-		out[count-1].row = vectorMultiplyMatrix_Sse(in[count-1].row, b0, b1, b2, b3);
-	}
-}
-
-void vecTmult_SseSingles(Vector4 *out, const Mat44 &m, const Vector4 *in, size_t count)
-{
-	for (size_t c = 0; c < count; c += 1) {
-		__m128 v = in[c].row;
-		__m128 x0 = _mm_mul_ps(v, m.row[0]);
-		__m128 x1 = _mm_mul_ps(v, m.row[1]);
-		__m128 x2 = _mm_mul_ps(v, m.row[2]);
-		__m128 x3 = _mm_mul_ps(v, m.row[3]);
-		__m128 s01 = _mm_hadd_ps(x0, x1);
-		__m128 s23 = _mm_hadd_ps(x2, x3);
-		__m128 s0123 = _mm_hadd_ps(s01, s23);
-		out[c].row = s0123;
-	}
-}
-#endif
-
-#ifdef __AVX__
-// vector by matrix multiplication, AVX based:
-static inline __m128 vectorMultiplyMatrix_Avx4Mem(const float *a, const Mat44 &B)
-{
-	__m128 result;
-	result = _mm_mul_ps(_mm_broadcast_ss(&a[0]), B.row[0]);
-	result = _mm_add_ps(result, _mm_mul_ps(_mm_broadcast_ss(&a[1]), B.row[1]));
-	result = _mm_add_ps(result, _mm_mul_ps(_mm_broadcast_ss(&a[2]), B.row[2]));
-	result = _mm_add_ps(result, _mm_mul_ps(_mm_broadcast_ss(&a[3]), B.row[3]));
-	return result;
-}
-
-// AVX based:
-void matmult_Avx4Mem(Mat44 *out, const Mat44 &A, const Mat44 &B)
-{
-	_mm256_zeroupper();
-	__m128 out0x = vectorMultiplyMatrix_Avx4Mem(A.m[0], B);
-	__m128 out1x = vectorMultiplyMatrix_Avx4Mem(A.m[1], B);
-	__m128 out2x = vectorMultiplyMatrix_Avx4Mem(A.m[2], B);
-	__m128 out3x = vectorMultiplyMatrix_Avx4Mem(A.m[3], B);
-
-	out->row[0] = out0x;
-	out->row[1] = out1x;
-	out->row[2] = out2x;
-	out->row[3] = out3x;
-}
-#endif
-
-#ifdef __AVX__
-// vector by matrix multiplication, AVX based, two at a time:
-static inline __m256 vectorMultiplyMatrixDual_Avx(__m256 A01, const Mat44 &B)
-{
-	__m256 result;
-	result = _mm256_mul_ps(_mm256_shuffle_ps(A01, A01, 0x00), _mm256_broadcast_ps(&B.row[0]));
-	result = _mm256_add_ps(result, _mm256_mul_ps(_mm256_shuffle_ps(A01, A01, 0x55), _mm256_broadcast_ps(&B.row[1])));
-	result = _mm256_add_ps(result, _mm256_mul_ps(_mm256_shuffle_ps(A01, A01, 0xaa), _mm256_broadcast_ps(&B.row[2])));
-	result = _mm256_add_ps(result, _mm256_mul_ps(_mm256_shuffle_ps(A01, A01, 0xff), _mm256_broadcast_ps(&B.row[3])));
-	return result;
-}
-
-// Avxbased, two vectors at once:
-void matmult_Avx8(Mat44 *out, const Mat44 &A, const Mat44 &B)
-{
-	__m256 A01 = _mm256_loadu_ps(&A.m[0][0]);
-	__m256 A23 = _mm256_loadu_ps(&A.m[2][0]);
-
-	__m256 out01x = vectorMultiplyMatrixDual_Avx(A01, B);
-	__m256 out23x = vectorMultiplyMatrixDual_Avx(A23, B);
-
-	_mm256_storeu_ps(&out->m[0][0], out01x);
-	_mm256_storeu_ps(&out->m[2][0], out23x);
-}
-
-void vecTmult_Avx256Singles(Vector4 *out, const Mat44 &mT, const Vector4 *in, size_t count)
-{
-	__m256 m02 = _mm256_insertf128_ps(_mm256_castps128_ps256(mT.row[0]), mT.row[2], 1);
-	__m256 m13 = _mm256_insertf128_ps(_mm256_castps128_ps256(mT.row[1]), mT.row[3], 1);
-
-	for (size_t c = 0; c < count; c += 1) {
-		__m256 v00 = _mm256_broadcast_ps(&in[c].row);
-		__m256 r02 = _mm256_mul_ps(v00, m02);
-		__m256 r13 = _mm256_mul_ps(v00, m13);
-		__m256 s0213 = _mm256_hadd_ps(r02, r13);
-		out[c].row = _mm_hadd_ps(_mm256_castps256_ps128(s0213), _mm256_extractf128_ps(s0213, 1));
-	}
-}
-#endif
-
-#ifdef __FMA__
-// Vector by matrix multiplication, FMA based:
-static inline __m128 vectorMultiplyMatrix_Fma(const __m128 &a, const Mat44 &B)
-{
-	__m128 result = _mm_mul_ps(_mm_permute_ps(a, 0x00), B.row[0]);
-	result = _mm_fmadd_ps(_mm_permute_ps(a, 0x55), B.row[1], result);
-	result = _mm_fmadd_ps(_mm_permute_ps(a, 0xaa), B.row[2], result);
-	result = _mm_fmadd_ps(_mm_permute_ps(a, 0xff), B.row[3], result);
-	return result;
-}
-
-// FMA based:
-void matmult_Fma(Mat44 *out, const Mat44 &A, const Mat44 &B)
-{
-	__m128 out0x = vectorMultiplyMatrix_Fma(A.row[0], B);
-	__m128 out1x = vectorMultiplyMatrix_Fma(A.row[1], B);
-	__m128 out2x = vectorMultiplyMatrix_Fma(A.row[2], B);
-	__m128 out3x = vectorMultiplyMatrix_Fma(A.row[3], B);
-
-	out->row[0] = out0x;
-	out->row[1] = out1x;
-	out->row[2] = out2x;
-	out->row[3] = out3x;
-}
-#endif
-
-#ifdef __FMA__
-// Vector by matrix multiplication, FMA based:
-static inline __m128 vectorMultiplyMatrix_FmaExp(const __m128 a, const __m128 b0, const __m128 b1, const __m128 b2, const __m128 b3)
-{
-	__m128 result = _mm_mul_ps(_mm_permute_ps(a, 0x00), b0);
-	result = _mm_fmadd_ps(_mm_permute_ps(a, 0x55), b1, result);
-	result = _mm_fmadd_ps(_mm_permute_ps(a, 0xaa), b2, result);
-	result = _mm_fmadd_ps(_mm_permute_ps(a, 0xff), b3, result);
-	return result;
-}
-
-// FMA based:
-void matmult_FmaExp(Mat44 *out, const Mat44 &A, const Mat44 &B)
-{
-	__m128 b0 = B.row[0];
-	__m128 b1 = B.row[1];
-	__m128 b2 = B.row[2];
-	__m128 b3 = B.row[3];
-
-	out->row[0] = vectorMultiplyMatrix_FmaExp(A.row[0], b0, b1, b2, b3);
-	out->row[1] = vectorMultiplyMatrix_FmaExp(A.row[1], b0, b1, b2, b3);
-	out->row[2] = vectorMultiplyMatrix_FmaExp(A.row[2], b0, b1, b2, b3);
-	out->row[3] = vectorMultiplyMatrix_FmaExp(A.row[3], b0, b1, b2, b3);
-}
-
-void vecmult_FmaExp(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m)
-{
-	__m128 b0 = m.row[0];
-	__m128 b1 = m.row[1];
-	__m128 b2 = m.row[2];
-	__m128 b3 = m.row[3];
-
-	for (size_t c = 0; c < count; ++c) {
-		out[c].row = vectorMultiplyMatrix_FmaExp(in[c].row, b0, b1, b2, b3);
-	}
-}
-#endif
-
-#ifdef __FMA__
-// Vectors by matrix multiplication, FMA256 based:
-static inline __m256 vectorMultiplyMatrix_Fma256Exp(const __m256 at, const __m256 b00, const __m256 b11, __m256 b22, __m256 b33)
-{
-	__m256 result = _mm256_mul_ps(_mm256_permute_ps(at, 0x00), b00);
-	result = _mm256_fmadd_ps(_mm256_permute_ps(at, 0x55), b11, result);
-	result = _mm256_fmadd_ps(_mm256_permute_ps(at, 0xaa), b22, result);
-	result = _mm256_fmadd_ps(_mm256_permute_ps(at, 0xff), b33, result);
-	return result;
-}
-
-// FMA256 based:
-void matmult_Fma256Exp(Mat44 *out, const Mat44 &A, const Mat44 &B)
-{
-	__m256 b00 = _mm256_broadcast_ps(&B.row[0]);
-	__m256 b11 = _mm256_broadcast_ps(&B.row[1]);
-	__m256 b22 = _mm256_broadcast_ps(&B.row[2]);
-	__m256 b33 = _mm256_broadcast_ps(&B.row[3]);
-
-	_mm256_storeu_ps(&out->m[0][0], vectorMultiplyMatrix_Fma256Exp(_mm256_loadu_ps(&A.m[0][0]), b00, b11, b22, b33));
-	_mm256_storeu_ps(&out->m[2][0], vectorMultiplyMatrix_Fma256Exp(_mm256_loadu_ps(&A.m[2][0]), b00, b11, b22, b33));
-}
-
-// FMA256 based:
-void matmult_Fma256Pre(Mat44 *out, const Mat44 &A, const Mat44 &B)
-{
-	// On some CPUs it is better to read at the beginning, to avoid pipeline conflicts
-	__m256 a01 = _mm256_loadu_ps(&A.m[0][0]);
-	__m256 a23 = _mm256_loadu_ps(&A.m[2][0]);
-
-	__m256 b00 = _mm256_broadcast_ps(&B.row[0]);
-	__m256 b11 = _mm256_broadcast_ps(&B.row[1]);
-	__m256 b22 = _mm256_broadcast_ps(&B.row[2]);
-	__m256 b33 = _mm256_broadcast_ps(&B.row[3]);
-
-	_mm256_storeu_ps(&out->m[0][0], vectorMultiplyMatrix_Fma256Exp(a01, b00, b11, b22, b33));
-	_mm256_storeu_ps(&out->m[2][0], vectorMultiplyMatrix_Fma256Exp(a23, b00, b11, b22, b33));
-}
-
-void vecmult_Fma256Exp(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m)
-{
-	__m256 b00 = _mm256_broadcast_ps(&m.row[0]);
-	__m256 b11 = _mm256_broadcast_ps(&m.row[1]);
-	__m256 b22 = _mm256_broadcast_ps(&m.row[2]);
-	__m256 b33 = _mm256_broadcast_ps(&m.row[3]);
-
-	size_t count0 = count&~1;
-	for (size_t c = 0; c < count0; c += 2) {
-		_mm256_storeu_ps(out[c].m, vectorMultiplyMatrix_Fma256Exp(_mm256_loadu_ps(in[c].m), b00, b11, b22, b33));
-	}
-	if ((count&1) != 0) {
-		out[count-1].row = vectorMultiplyMatrix_FmaExp(in[count-1].row, _mm256_castps256_ps128(b00), _mm256_castps256_ps128(b11), _mm256_castps256_ps128(b22), _mm256_castps256_ps128(b33));
-	}
-}
-
-void vecTmult_TransFma256(Vector4 *out, const Mat44 &m, const Vector4 *in, size_t count)
-{
-	__m256 b00, b11, b22, b33;
-	{
-		__m128 b0 = m.row[0];
-		__m128 b1 = m.row[1];
-		__m128 b2 = m.row[2];
-		__m128 b3 = m.row[3];
-		_MM_TRANSPOSE4_PS(b0, b1, b2, b3);
-		b00 = _mm256_insertf128_ps(_mm256_castps128_ps256(b0), b0, 1);
-		b11 = _mm256_insertf128_ps(_mm256_castps128_ps256(b1), b1, 1);
-		b22 = _mm256_insertf128_ps(_mm256_castps128_ps256(b2), b2, 1);
-		b33 = _mm256_insertf128_ps(_mm256_castps128_ps256(b3), b3, 1);
-	}
-
-	size_t count0 = count&~1;
-	for (size_t c = 0; c < count0; c += 2) {
-		_mm256_storeu_ps(out[c].m, vectorMultiplyMatrix_Fma256Exp(_mm256_loadu_ps(in[c].m), b00, b11, b22, b33));
-	}
-	if ((count&1) != 0) {
-		out[count-1].row = vectorMultiplyMatrix_FmaExp(in[count-1].row, _mm256_castps256_ps128(b00), _mm256_castps256_ps128(b11), _mm256_castps256_ps128(b22), _mm256_castps256_ps128(b33));
-	}
-}
+		{ "matmult_Fpu87",     matmult_Fpu87,     0 },
 #endif
-
-#if (defined __AVX512F__)
-// Vectors by matrix multiplication, AVX-512 based:
-static inline __m512 vectorMultiplyMatrix_Avx512(const __m512 a0123, const __m512 b0000, const __m512 b1111, __m512 b2222, __m512 b3333)
-{
-	__m512 result = _mm512_mul_ps(_mm512_permute_ps(a0123, 0x00), b0000);
-	result = _mm512_fmadd_ps(_mm512_permute_ps(a0123, 0x55), b1111, result);
-	result = _mm512_fmadd_ps(_mm512_permute_ps(a0123, 0xaa), b2222, result);
-	result = _mm512_fmadd_ps(_mm512_permute_ps(a0123, 0xff), b3333, result);
-	return result;
-}
-
-// AVX-512 based:
-void matmult_Avx512(Mat44 *out, const Mat44 &A, const Mat44 &B)
-{
-	__m512 a0123 = _mm512_loadu_ps(&A.m[0][0]);
-	__m512 b0000 = _mm512_broadcast_f32x4(B.row[0]);
-	__m512 b1111 = _mm512_broadcast_f32x4(B.row[1]);
-	__m512 b2222 = _mm512_broadcast_f32x4(B.row[2]);
-	__m512 b3333 = _mm512_broadcast_f32x4(B.row[3]);
-
-	_mm512_storeu_ps(&out->m[0][0], vectorMultiplyMatrix_Avx512(a0123, b0000, b1111, b2222, b3333));
-}
-
-void vecmult_Avx512(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m)
-{
-	__m512 b0000 = _mm512_broadcast_f32x4(m.row[0]);
-	__m512 b1111 = _mm512_broadcast_f32x4(m.row[1]);
-	__m512 b2222 = _mm512_broadcast_f32x4(m.row[2]);
-	__m512 b3333 = _mm512_broadcast_f32x4(m.row[3]);
-
-	size_t count0 = count&~3;
-	for (size_t c = 0; c < count0; c += 4) {
-		_mm512_storeu_ps(out[c].m, vectorMultiplyMatrix_Avx512(_mm512_loadu_ps(in[c].m), b0000, b1111, b2222, b3333));
-	}
-	switch (count&3) {
-	case 3:
-		_mm256_storeu_ps(out[count0].m, vectorMultiplyMatrix_Fma256Exp(_mm256_loadu_ps(in[count0].m), _mm512_castps512_ps256(b0000), _mm512_castps512_ps256(b1111), _mm512_castps512_ps256(b2222), _mm512_castps512_ps256(b3333)));
-		// fall through
-	case 1:
-		out[count-1].row = vectorMultiplyMatrix_FmaExp(in[count-1].row, _mm512_castps512_ps128(b0000), _mm512_castps512_ps128(b1111), _mm512_castps512_ps128(b2222), _mm512_castps512_ps128(b3333));
-		break;
-	case 2:
-		_mm256_storeu_ps(out[count0].m, vectorMultiplyMatrix_Fma256Exp(_mm256_loadu_ps(in[count0].m), _mm512_castps512_ps256(b0000), _mm512_castps512_ps256(b1111), _mm512_castps512_ps256(b2222), _mm512_castps512_ps256(b3333)));
-		break;
-	case 0:
-		break;
-	}
-}
-
-void vecTmult_Avx512Singles(Vector4 *out, const Mat44 &m, const Vector4 *in, size_t count)
-{
-	__m512 a0123 = _mm512_loadu_ps((float *)(uintptr_t)&m.m[0][0]);
-	__m512 a0213 = _mm512_insertf32x4(_mm512_insertf32x4(a0123, _mm512_extractf32x4_ps(a0123, 2), 1), _mm512_extractf32x4_ps(a0123, 1), 2);
-
-	for (size_t c = 0; c < count; c += 1) {
-		__m512 v0000 = _mm512_broadcast_f32x4(in[c].row);
-		__m512 r0213 = _mm512_mul_ps(v0000, a0213);
-		__m256 r02 = _mm512_castps512_ps256(r0213);
-		__m256 r13 = _mm512_extractf32x8_ps(r0213, 1);
-		__m256 s0213 = _mm256_hadd_ps(r02, r13);
-		out[c].row = _mm_hadd_ps(_mm256_castps256_ps128(s0213), _mm256_extractf128_ps(s0213, 1));
-	}
-}
-#endif
-
-#ifdef __aarch64__
-// Vector by matrix multiplication, Neon based:
-static inline float32x4_t vectorMultiplyMatrix_Neon(const float32x4_t a, const float32x4_t b0, const float32x4_t b1, const float32x4_t b2, const float32x4_t b3)
-{
-	float32x4_t result = vmulq_laneq_f32(b0, a, 0);
-	result = vfmaq_laneq_f32(result, b1, a, 1);
-	result = vfmaq_laneq_f32(result, b2, a, 2);
-	result = vfmaq_laneq_f32(result, b3, a, 3);
-	return result;
-}
-
-// Neon based:
-void matmult_Neon(Mat44 *out, const Mat44 &A, const Mat44 &B)
-{
-	float32x4_t b0 = B.row[0];
-	float32x4_t b1 = B.row[1];
-	float32x4_t b2 = B.row[2];
-	float32x4_t b3 = B.row[3];
-
-	out->row[0] = vectorMultiplyMatrix_Neon(A.row[0], b0, b1, b2, b3);
-	out->row[1] = vectorMultiplyMatrix_Neon(A.row[1], b0, b1, b2, b3);
-	out->row[2] = vectorMultiplyMatrix_Neon(A.row[2], b0, b1, b2, b3);
-	out->row[3] = vectorMultiplyMatrix_Neon(A.row[3], b0, b1, b2, b3);
-}
-
-void matmult_NeonPar2(Mat44 *out, const Mat44 &A, const Mat44 &B)
-{
-	float32x4_t b0 = B.row[0];
-	float32x4_t b1 = B.row[1];
-	float32x4_t b2 = B.row[2];
-	float32x4_t b3 = B.row[3];
-
-	float32x4_t a0 = A.row[0];
-	float32x4_t a1 = A.row[1];
-	float32x4_t a2 = A.row[2];
-	float32x4_t a3 = A.row[3];
-	out->row[0] = vectorMultiplyMatrix_Neon(a0, b0, b1, b2, b3);
-	out->row[1] = vectorMultiplyMatrix_Neon(a1, b0, b1, b2, b3);
-	out->row[2] = vectorMultiplyMatrix_Neon(a2, b0, b1, b2, b3);
-	out->row[3] = vectorMultiplyMatrix_Neon(a3, b0, b1, b2, b3);
-}
-
-void matmult_NeonPar4(Mat44 *out, const Mat44 &A, const Mat44 &B)
-{
-	float32x4_t b0 = B.row[0];
-	float32x4_t b1 = B.row[1];
-	float32x4_t b2 = B.row[2];
-	float32x4_t b3 = B.row[3];
-
-	float32x4_t a0 = A.row[0];
-	float32x4_t a1 = A.row[1];
-	float32x4_t a2 = A.row[2];
-	float32x4_t a3 = A.row[3];
-
-	float32x4_t c0 = vmulq_laneq_f32(b0, a0, 0);
-	float32x4_t c1 = vmulq_laneq_f32(b0, a1, 0);
-	float32x4_t c2 = vmulq_laneq_f32(b0, a2, 0);
-	float32x4_t c3 = vmulq_laneq_f32(b0, a3, 0);
-
-	c0 = vfmaq_laneq_f32(c0, b1, a0, 1);
-	c1 = vfmaq_laneq_f32(c1, b1, a1, 1);
-	c2 = vfmaq_laneq_f32(c2, b1, a2, 1);
-	c3 = vfmaq_laneq_f32(c3, b1, a3, 1);
-
-	c0 = vfmaq_laneq_f32(c0, b2, a0, 2);
-	c1 = vfmaq_laneq_f32(c1, b2, a1, 2);
-	c2 = vfmaq_laneq_f32(c2, b2, a2, 2);
-	c3 = vfmaq_laneq_f32(c3, b2, a3, 2);
-
-	c0 = vfmaq_laneq_f32(c0, b3, a0, 3);
-	c1 = vfmaq_laneq_f32(c1, b3, a1, 3);
-	c2 = vfmaq_laneq_f32(c2, b3, a2, 3);
-	c3 = vfmaq_laneq_f32(c3, b3, a3, 3);
-
-	out->row[0] = c0;
-	out->row[1] = c1;
-	out->row[2] = c2;
-	out->row[3] = c3;
-}
-
-void vecmult_Neon(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m)
-{
-	float32x4_t b0 = m.row[0];
-	float32x4_t b1 = m.row[1];
-	float32x4_t b2 = m.row[2];
-	float32x4_t b3 = m.row[3];
-
-	for (size_t c = 0; c < count; ++c) {
-		out[c].row = vectorMultiplyMatrix_Neon(in[c].row, b0, b1, b2, b3);
-	}
-}
-
-void vecmult_NeonPar2(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m)
-{
-	float32x4_t b0 = m.row[0];
-	float32x4_t b1 = m.row[1];
-	float32x4_t b2 = m.row[2];
-	float32x4_t b3 = m.row[3];
-
-	size_t count0 = count&~1;
-	for (size_t c = 0; c < count0; c += 2) {
-		float32x4_t a0 = in[c].row;
-		float32x4_t a1 = in[c+1].row;
-		float32x4_t r0 = vmulq_laneq_f32(b0, a0, 0);
-		float32x4_t r1 = vmulq_laneq_f32(b0, a1, 0);
-		r0 = vfmaq_laneq_f32(r0, b1, a0, 1);
-		r1 = vfmaq_laneq_f32(r1, b1, a1, 1);
-		r0 = vfmaq_laneq_f32(r0, b2, a0, 2);
-		r1 = vfmaq_laneq_f32(r1, b2, a1, 2);
-		r0 = vfmaq_laneq_f32(r0, b3, a0, 3);
-		r1 = vfmaq_laneq_f32(r1, b3, a1, 3);
-		out[c].row = r0;
-		out[c+1].row = r1;
-	}
-	if (count&1) {
-		out[count-1].row = vectorMultiplyMatrix_Neon(in[count-1].row, b0, b1, b2, b3);
-	}
-}
-
-void vecTmult_Neon(Vector4 *out, const Mat44 &m, const Vector4 *in, size_t count)
-{
-	float32x4_t b0 = m.row[0];
-	float32x4_t b1 = m.row[1];
-	float32x4_t b2 = m.row[2];
-	float32x4_t b3 = m.row[3];
-
-	for (size_t c = 0; c < count; ++c) {
-		float32x4_t v = in[c].row;
-		float32x4_t r0 = vmulq_f32(v, b0);
-		float32x4_t r1 = vmulq_f32(v, b1);
-		float32x4_t r2 = vmulq_f32(v, b2);
-		float32x4_t r3 = vmulq_f32(v, b3);
-		float32x4_t s01 = vpaddq_f32(r0, r1);
-		float32x4_t s23 = vpaddq_f32(r2, r3);
-		float32x4_t s0123 = vpaddq_f32(s01, s23);
-		out[c].row = s0123;
-	}
-}
-
-void vecTmult_NeonPar2(Vector4 *out, const Mat44 &m, const Vector4 *in, size_t count)
-{
-	float32x4_t b0 = m.row[0];
-	float32x4_t b1 = m.row[1];
-	float32x4_t b2 = m.row[2];
-	float32x4_t b3 = m.row[3];
-
-	size_t count0 = count&~1;
-	for (size_t c = 0; c < count0; c += 2) {
-		float32x4_t v0 = in[c].row;
-		float32x4_t v1 = in[c+1].row;
-		float32x4_t v0r0 = vmulq_f32(v0, b0);
-		float32x4_t v1r0 = vmulq_f32(v1, b0);
-		float32x4_t v0r1 = vmulq_f32(v0, b1);
-		float32x4_t v1r1 = vmulq_f32(v1, b1);
-		float32x4_t v0r2 = vmulq_f32(v0, b2);
-		float32x4_t v1r2 = vmulq_f32(v1, b2);
-		float32x4_t v0r3 = vmulq_f32(v0, b3);
-		float32x4_t v1r3 = vmulq_f32(v1, b3);
-		float32x4_t v0s01 = vpaddq_f32(v0r0, v0r1);
-		float32x4_t v1s01 = vpaddq_f32(v1r0, v1r1);
-		float32x4_t v0s23 = vpaddq_f32(v0r2, v0r3);
-		float32x4_t v1s23 = vpaddq_f32(v1r2, v1r3);
-		float32x4_t v0s0123 = vpaddq_f32(v0s01, v0s23);
-		float32x4_t v1s0123 = vpaddq_f32(v1s01, v1s23);
-		out[c].row = v0s0123;
-		out[c+1].row = v1s0123;
-	}
-}
+	});
+	supportedVariants(&vecmultVariants, vecmult_variants, vecmult_variants_count, {
+		{ "vecmult_novec",     vecmult_novec,     0 },
+#ifdef __x86_64__
+		{ "vecmult_Fpu87",     vecmult_Fpu87,     0 },
 #endif
-
-#ifdef __ARM_FEATURE_SVE
-// SVE based:
-
-void matmult_SveRows(Mat44 *out, const Mat44 &A, const Mat44 &B)
-{
-	const size_t n = 4;
-	// these are the rows A
-	svfloat32_t A0;
-	svfloat32_t A1;
-	svfloat32_t A2;
-	svfloat32_t A3;
-
-	// these are the rows B
-	svfloat32_t B0;
-	svfloat32_t B1;
-	svfloat32_t B2;
-	svfloat32_t B3;
-
-	// these are the rows C
-	svfloat32_t C0;
-	svfloat32_t C1;
-	svfloat32_t C2;
-	svfloat32_t C3;
-
-	svbool_t pred = svwhilelt_b32_u32(0, n);
-
-	B0 = svld1_f32(pred, &B.row[0][0]);
-	B1 = svld1_f32(pred, &B.row[1][0]);
-	B2 = svld1_f32(pred, &B.row[2][0]);
-	B3 = svld1_f32(pred, &B.row[3][0]);
-
-	// Zero accumulators for C values
-	C0 = svdup_n_f32(0);
-	C1 = svdup_n_f32(0);
-	C2 = svdup_n_f32(0);
-	C3 = svdup_n_f32(0);
-
-	// Multiply accumulate in 4x1 blocks, that is each row in C
-	A0 = svld1rq_f32(svptrue_b32(), &A.row[0][0]);
-	C0 = svmla_lane_f32(C0, B0, A0, 0);
-	C0 = svmla_lane_f32(C0, B1, A0, 1);
-	C0 = svmla_lane_f32(C0, B2, A0, 2);
-	C0 = svmla_lane_f32(C0, B3, A0, 3);
-	svst1_f32(pred, &out->row[0][0], C0);
-
-	A1 = svld1rq_f32(svptrue_b32(), &A.row[1][0]);
-	C1 = svmla_lane_f32(C1, B0, A1, 0);
-	C1 = svmla_lane_f32(C1, B1, A1, 1);
-	C1 = svmla_lane_f32(C1, B2, A1, 2);
-	C1 = svmla_lane_f32(C1, B3, A1, 3);
-	svst1_f32(pred, &out->row[1][0], C1);
-
-	A2 = svld1rq_f32(svptrue_b32(), &A.row[2][0]);
-	C2 = svmla_lane_f32(C2, B0, A2, 0);
-	C2 = svmla_lane_f32(C2, B1, A2, 1);
-	C2 = svmla_lane_f32(C2, B2, A2, 2);
-	C2 = svmla_lane_f32(C2, B3, A2, 3);
-	svst1_f32(pred, &out->row[2][0], C2);
-
-	A3 = svld1rq_f32(svptrue_b32(), &A.row[3][0]);
-	C3 = svmla_lane_f32(C3, B0, A3, 0);
-	C3 = svmla_lane_f32(C3, B1, A3, 1);
-	C3 = svmla_lane_f32(C3, B2, A3, 2);
-	C3 = svmla_lane_f32(C3, B3, A3, 3);
-	svst1_f32(pred, &out->row[3][0], C3);
-}
-
-void matmult_SveSingle(Mat44 *out, const Mat44 &A, const Mat44 &B)
-{
-	// we have 4 rows, 4*4 floats
-	const size_t n = 4;
-
-	// these are the rows A
-	svfloat32_t A0;
-	svfloat32_t A1;
-	svfloat32_t A2;
-	svfloat32_t A3;
-
-	// these are the rows B
-	svfloat32_t B0;
-	svfloat32_t B1;
-	svfloat32_t B2;
-	svfloat32_t B3;
-
-	// this is full result
-	svfloat32_t Ca;
-
-	svbool_t pred = svwhilelt_b32_u32(0, n);
-
-	B0 = svld1_f32(svptrue_b32(), &B.row[0][0]);
-	B1 = svld1_f32(svptrue_b32(), &B.row[1][0]);
-	B2 = svld1_f32(svptrue_b32(), &B.row[2][0]);
-	B3 = svld1_f32(svptrue_b32(), &B.row[3][0]);
-
-	// Multiply accumulate in 4x1 blocks, that is each row in C
-	A0 = svld1rq_f32(pred, &A.row[0][0]);
-	Ca = svmul_lane_f32(B0, A0, 0);
-	Ca = svmla_lane_f32(Ca, B1, A0, 1);
-	Ca = svmla_lane_f32(Ca, B2, A0, 2);
-	Ca = svmla_lane_f32(Ca, B3, A0, 3);
-	svst1_f32(pred, &out->row[0][0], Ca);
-}
-
-void vecmult_Sve(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m)
-{
-	const size_t n = count;
-
-	// these are the rows M
-	svfloat32_t M0;
-	svfloat32_t M1;
-	svfloat32_t M2;
-	svfloat32_t M3;
-
-	// these are the rows B
-	svfloat32_t A0;
-
-	// these are the rows C
-	svfloat32_t C0;
-
-	svbool_t pred = svwhilelt_b32_u32(0, n);
-
-	M0 = svld1rq_f32(svptrue_b32(), &m.row[0][0]);
-	M1 = svld1rq_f32(svptrue_b32(), &m.row[1][0]);
-	M2 = svld1rq_f32(svptrue_b32(), &m.row[2][0]);
-	M3 = svld1rq_f32(svptrue_b32(), &m.row[3][0]);
-
-	A0 = svld1_f32(pred, &in[0].row[0]);
-
-	// Multiply accumulate in 4x1 blocks, that is each row in C
-	C0 = svmul_lane_f32(M0, A0, 0);
-	C0 = svmla_lane_f32(C0, M1, A0, 1);
-	C0 = svmla_lane_f32(C0, M2, A0, 2);
-	C0 = svmla_lane_f32(C0, M3, A0, 3);
-	svst1_f32(pred, &out[0].row[0], C0);
+	});
+	supportedVariants(&vecTmultVariants, vecTmult_variants, vecTmult_variants_count, {});
+	supportedVariants(&aabbmultVariants, aabbmult_variants, aabbmult_variants_count, {});
+	supportedVariants(&spheremultVariants, spheremult_variants, spheremult_variants_count, {});
+	supportedVariants(&aabbcullVariants, aabbcull_variants, aabbcull_variants_count, {});
 }
 
-#endif
-
 
 // ---- testing stuff
 
@@ -909,185 +229,765 @@ void runBenchmark(const char *name, long repeatCount, long innerSize, std::funct
 	printf("%-25s: %6.2f cycles, avg %6.2f cycles, %8.3f MOPS\n", name, cycles_per_run, avg_time, (double)nruns*repeatCount*innerSize/duration.count()/1000000);
 }
 
-// matmult variants
-static const struct {
-	const char *name;
-	void (*matmult)(Mat44 *out, const Mat44 &A, const Mat44 &B);
-} matmult_variants[] = {
-	{ "matmult_ref",       matmult_ref },
-	{ "matmult_novec",     matmult_novec },
-#ifdef __x86_64__
-	{ "matmult_Fpu87",     matmult_Fpu87 },
-#endif
-#ifdef __SSE__
-	{ "matmult_Sse",       matmult_Sse },
-#endif
-#ifdef __AVX__
-	{ "matmult_Avx4Mem",   matmult_Avx4Mem },
-#endif
-#ifdef __AVX__
-	{ "matmult_Avx8",      matmult_Avx8 },
-#endif
-#ifdef __FMA__
-	{ "matmult_Fma",       matmult_Fma },
-#endif
-#ifdef __FMA__
-	{ "matmult_FmaExp",    matmult_FmaExp },
-#endif
-#ifdef __FMA__
-	{ "matmult_Fma256Exp", matmult_Fma256Exp },
-#endif
-#ifdef __FMA__
-	{ "matmult_Fma256Pre", matmult_Fma256Pre },
-#endif
-#if (defined __AVX512F__)
-	{ "matmult_Avx512",    matmult_Avx512 },
-#endif
-#if (defined __aarch64__)
-	{ "matmult_Neon",      matmult_Neon },
-	{ "matmult_NeonPar2",  matmult_NeonPar2 },
-	{ "matmult_NeonPar4",  matmult_NeonPar4 },
-#endif
-#ifdef __ARM_FEATURE_SVE
-	{ "matmult_SveRows",   matmult_SveRows },
-	{ "matmult_SveSingle", matmult_SveSingle },
-#endif
+// ---- verification
+
+enum VerifyMode {
+	VERIFY_NONE,
+	VERIFY_QUICK,
+	VERIFY_FULL,
 };
 
-// vecmult variants
-static const struct {
-	const char *name;
-	void (*vecmult)(Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m);
-} vecmult_variants[] = {
-	{ "vecmult_ref",       vecmult_ref },
-	{ "vecmult_novec",     vecmult_novec },
-#ifdef __x86_64__
-	{ "vecmult_Fpu87",     vecmult_Fpu87 },
-#endif
-#ifdef __SSE__
-	{ "vecmult_Sse",       vecmult_Sse },
-	{ "vecmult_SsePar2",   vecmult_SsePar2 },
-#endif
-#ifdef __FMA__
-	{ "vecmult_FmaExp",    vecmult_FmaExp },
-#endif
-#ifdef __FMA__
-	{ "vecmult_Fma256Exp", vecmult_Fma256Exp },
-#endif
-#if (defined __AVX512F__)
-	{ "vecmult_Avx512",    vecmult_Avx512 },
-#endif
-#if (defined __aarch64__)
-	{ "vecmult_Neon",      vecmult_Neon },
-	{ "vecmult_NeonPar2",  vecmult_NeonPar2 },
-#endif
-#if (defined __ARM_FEATURE_SVE)
-	{ "vecmult_Sve",       vecmult_Sve },
-#endif
+// Deterministic per-test-case random generator (splitmix64), allows running the test cases in any order and on any
+// number of threads while still getting the same data for the same test case.
+struct VerifyRandom {
+	uint64_t state;
+
+	explicit VerifyRandom(uint64_t seed): state(seed*0x9e3779b97f4a7c15ull+1234) {}
+
+	uint64_t next()
+	{
+		uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+		z = (z^(z >> 30))*0xbf58476d1ce4e5b9ull;
+		z = (z^(z >> 27))*0x94d049bb133111ebull;
+		return z^(z >> 31);
+	}
+
+	float nextFloat(int minExp, int maxExp)
+	{
+		uint64_t r = next();
+		float mantissa = 1.0f+(float)(r&0x7fffff)/0x800000;
+		int exponent = minExp+(int)((r >> 23)%(maxExp-minExp+1));
+		return ((r >> 40)&1) ? -ldexpf(mantissa, exponent) : ldexpf(mantissa, exponent);
+	}
 };
 
-// vecTmult variants
-static const struct {
-	const char *name;
-	void (*vecTmult)(Vector4 *out, const Mat44 &m, const Vector4 *in, size_t count);
-} vecTmult_variants[] = {
-	{ "vecTmult_ref",           vecTmult_ref },
-#ifdef __SSE__
-	{ "vecTmult_SseSingles",    vecTmult_SseSingles },
-#endif
-#ifdef __AVX__
-	{ "vecTmult_Avx256Singles", vecTmult_Avx256Singles },
-#endif
-#ifdef __AVX__
-	{ "vecTmult_TransFma256",   vecTmult_TransFma256 },
-#endif
-#if (defined __AVX512F__)
-	{ "vecTmult_Avx512Singles", vecTmult_Avx512Singles },
-#endif
-#if (defined __aarch64__)
-	{ "vecTmult_Neon",          vecTmult_Neon },
-	{ "vecTmult_NeonPar2",      vecTmult_NeonPar2 },
-#endif
+// Strata of input values, randf() generates only STRATUM_NORMAL:
+enum VerifyStratum {
+	STRATUM_NORMAL,
+	STRATUM_UNIT,
+	STRATUM_TINY,
+	STRATUM_HUGE,
+	STRATUM_DENORMAL,
+	STRATUM_SPECIAL,
+	STRATUM_MIXED,
+	STRATUM_COUNT
 };
 
-int runVerification()
+static float verifyValue(VerifyRandom *random, int stratum)
 {
-	srand(1234); // deterministic random tests
+	static const float specials[] = {
+		0.0f, -0.0f, 1.0f, -1.0f,
+		std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(),
+		std::numeric_limits<float>::quiet_NaN(),
+		std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(),
+		std::numeric_limits<float>::min(), std::numeric_limits<float>::denorm_min(),
+	};
+
+	if (stratum == STRATUM_MIXED)
+		stratum = (int)(random->next()%STRATUM_MIXED);
+	switch (stratum) {
+	case STRATUM_NORMAL:
+		return ((int64_t)(random->next() >> 33)-16384.0f)/1024.0f;
+	case STRATUM_UNIT:
+		return random->nextFloat(-24, -1);
+	case STRATUM_TINY:
+		// products get into denormal range
+		return random->nextFloat(-75, -50);
+	case STRATUM_HUGE:
+		// products and their sums get close to or over float range
+		return random->nextFloat(40, 64);
+	case STRATUM_DENORMAL:
+		{
+			uint64_t r = random->next();
+			float f = (float)(r&0x7fffff)*std::numeric_limits<float>::denorm_min();
+			return ((r >> 40)&1) ? -f : f;
+		}
+	case STRATUM_SPECIAL:
+		{
+			// keep specials sparse, so they do not turn the whole result into NaN
+			uint64_t r = random->next();
+			if (r%4 != 0)
+				return ((int64_t)(r >> 33)-16384.0f)/1024.0f;
+			return specials[(r >> 8)%(sizeof(specials)/sizeof(specials[0]))];
+		}
+	}
+	abort();
+}
 
-	// matmult correctness tests, all should provide the same result as reference
-	// implementation (or close to the same, FMADD may provide better precision)
-	for (int i = 0; i < 1000000; i++) {
-		Mat44 A, B, AT, BT, out, outT, ref_out, ref_outT;
-		randmat(&A);
-		randmat(&B);
-		mat_transpose(&AT, A);
-		mat_transpose(&BT, B);
-		matmult_ref(&ref_out, A, B);
-		mat_transpose(&ref_outT, ref_out);
-		matmult_ref(&outT, BT, AT);
-		if (!equalsMatrix(outT, ref_outT)) {
-			fprintf(stderr, "transpose mult failed\n");
-			return 1;
+static void verifyMatrix(Mat44 *m, VerifyRandom *random, int stratum)
+{
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++)
+			m->m[i][j] = verifyValue(random, stratum);
+}
+
+static void verifyVector(Vector4 *v, VerifyRandom *random, int stratum)
+{
+	for (int j = 0; j < 4; j++)
+		v->m[j] = verifyValue(random, stratum);
+}
+
+// Distance in ULPs between two finite floats
+static uint64_t ulpDistance(float l, float r)
+{
+	int32_t li, ri;
+	memcpy(&li, &l, sizeof(li));
+	memcpy(&ri, &r, sizeof(ri));
+	int64_t lo = li < 0 ? (int64_t)INT32_MIN-li : li;
+	int64_t ro = ri < 0 ? (int64_t)INT32_MIN-ri : ri;
+	return lo > ro ? lo-ro : ro-lo;
+}
+
+// Per-variant accuracy.  The error is measured relative to the accepted bound eps*sum(|a[k]*b[k]|)+denorm_min, which
+// tells the variants apart even where the result cancels to far below the products.  ULP error against double precision result
+// rounded to float is counted only for well conditioned elements, the result at least half of the bound.
+struct VerificationStats {
+	uint64_t count = 0;
+	double maxBound = 0;
+	double sumBound = 0;
+	uint64_t ulpCount = 0;
+	uint64_t maxUlp = 0;
+	double sumUlp = 0;
+	long failedTest = -1;
+	std::string failure;
+
+	void merge(const VerificationStats &other)
+	{
+		count += other.count;
+		sumBound += other.sumBound;
+		if (other.maxBound > maxBound)
+			maxBound = other.maxBound;
+		ulpCount += other.ulpCount;
+		sumUlp += other.sumUlp;
+		if (other.maxUlp > maxUlp)
+			maxUlp = other.maxUlp;
+		if (other.failedTest >= 0 && (failedTest < 0 || other.failedTest < failedTest)) {
+			failedTest = other.failedTest;
+			failure = other.failure;
 		}
+	}
+};
 
-		for (size_t j = 0; j < sizeof(matmult_variants)/sizeof(matmult_variants[0]); j++) {
-			matmult_variants[j].matmult(&out, A, B);
-			if (!equalsMatrix(out, ref_out)) {
-				fprintf(stderr, "%s failed test %d\n", matmult_variants[j].name, i);
-				for (int r = 0; r < 4; ++r) {
-					fprintf(stderr, "%15.6f %15.6f %15.6f %15.6f      %15.6f %15.6f %15.6f %15.6f\n", out.m[r][0], out.m[r][1], out.m[r][2], out.m[r][3], ref_out.m[r][0], ref_out.m[r][1], ref_out.m[r][2], ref_out.m[r][3]);
-				}
-				return 1;
+// Checks single result element, computed as sum of a[k]*b[k]. The accepted error is bound by the magnitude of the
+// products, so the order of operations and FMA contraction do not matter. If the products can overflow float range,
+// any infinity or NaN is accepted too as the outcome depends on the order of operations.
+static bool verifyElement(VerificationStats *stats, float result, const float a[4], const float b[4])
+{
+	double exact = 0, bound = 0;
+	for (int k = 0; k < 4; ++k) {
+		double p = (double)a[k]*b[k];
+		exact += p;
+		if (std::isfinite(p))
+			bound += fabs(p);
+	}
+	bool overflow = bound >= std::numeric_limits<float>::max()*0.5;
+	++stats->count;
+	if (std::isnan(exact))
+		return std::isnan(result);
+	if (!std::isfinite(result) && overflow)
+		return true;
+	if (std::isinf(exact))
+		return result == exact;
+	if (!std::isfinite(result))
+		return false;
+	double error = fabs(result-exact)/(std::numeric_limits<float>::epsilon()*bound+(double)std::numeric_limits<float>::denorm_min());
+	if (error > 8)
+		return false;
+	stats->sumBound += error;
+	if (error > stats->maxBound)
+		stats->maxBound = error;
+	float expected = (float)exact;
+	if (std::isfinite(expected) && fabs(exact) >= 0.5*bound) {
+		++stats->ulpCount;
+		uint64_t ulp = ulpDistance(result, expected);
+		stats->sumUlp += ulp;
+		if (ulp > stats->maxUlp)
+			stats->maxUlp = ulp;
+	}
+	return true;
+}
+
+static bool verifyMatmultResult(VerificationStats *stats, long test, const char *name, const Mat44 &out, const Mat44 &A, const Mat44 &B)
+{
+	for (int i = 0; i < 4; ++i) {
+		for (int j = 0; j < 4; ++j) {
+			const float b[4] = { B.m[0][j], B.m[1][j], B.m[2][j], B.m[3][j] };
+			if (!verifyElement(stats, out.m[i][j], A.m[i], b)) {
+				char buf[256];
+				snprintf(buf, sizeof(buf), "%s failed test %ld at [%d][%d]: %.9g, expected %.9g\n", name, test, i, j, out.m[i][j], A.m[i][0]*b[0]+A.m[i][1]*b[1]+A.m[i][2]*b[2]+A.m[i][3]*b[3]);
+				stats->failedTest = test;
+				stats->failure = buf;
+				return false;
 			}
 		}
 	}
-	fprintf(stderr, "matmult correctness ok.\n");
+	return true;
+}
 
-	srand(1234); // deterministic random tests
+static bool verifyVecmultResult(VerificationStats *stats, long test, const char *name, const Vector4 *out, const Vector4 *in, size_t count, const Mat44 &m)
+{
+	for (size_t c = 0; c < count; ++c) {
+		for (int j = 0; j < 4; ++j) {
+			const float b[4] = { m.m[0][j], m.m[1][j], m.m[2][j], m.m[3][j] };
+			if (!verifyElement(stats, out[c].m[j], in[c].m, b)) {
+				char buf[256];
+				snprintf(buf, sizeof(buf), "%s failed vecmult test %ld at [%zu][%d]: %.9g, expected %.9g\n", name, test, c, j, out[c].m[j], in[c].m[0]*b[0]+in[c].m[1]*b[1]+in[c].m[2]*b[2]+in[c].m[3]*b[3]);
+				stats->failedTest = test;
+				stats->failure = buf;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// Math4DApi.h allows output to be the same as input, so in place result must be bitwise equal to the separate output
+template <typename T>
+static bool verifyInPlaceResult(VerificationStats *stats, long test, const char *name, const char *aliased, const T *inPlace, const T *out, size_t count)
+{
+	if (memcmp(inPlace, out, count*sizeof(T)) == 0)
+		return true;
+	char buf[256];
+	snprintf(buf, sizeof(buf), "%s failed in place test %ld, output same as %s\n", name, test, aliased);
+	if (stats != NULL) {
+		stats->failedTest = test;
+		stats->failure = buf;
+	}
+	else {
+		fputs(buf, stderr);
+	}
+	return false;
+}
+
+// Test case layout: the normal random tests first, then stratified samples for each combination of left and right
+// operand strata.
+struct VerifyPlan {
+	long normalCount;
+	long stratumSamples;
+
+	long total() const
+	{
+		return normalCount+stratumSamples*STRATUM_COUNT*STRATUM_COUNT;
+	}
+
+	void strata(long test, int *left, int *right) const
+	{
+		if (test < normalCount) {
+			*left = *right = STRATUM_NORMAL;
+		}
+		else {
+			long combination = (test-normalCount)/stratumSamples;
+			*left = (int)(combination/STRATUM_COUNT);
+			*right = (int)(combination%STRATUM_COUNT);
+		}
+	}
+};
+
+static void verifyMatmultRange(std::vector<VerificationStats> *stats, const VerifyPlan &plan, long begin, long end)
+{
+	for (long i = begin; i < end; i++) {
+		VerifyRandom random(i);
+		int leftStratum, rightStratum;
+		plan.strata(i, &leftStratum, &rightStratum);
+
+		Mat44 A, B, out;
+		verifyMatrix(&A, &random, leftStratum);
+		verifyMatrix(&B, &random, rightStratum);
+
+		if (leftStratum == STRATUM_NORMAL && rightStratum == STRATUM_NORMAL) {
+			Mat44 AT, BT, outT, ref_out, ref_outT;
+			mat_transpose(&AT, A);
+			mat_transpose(&BT, B);
+			matmult_ref(&ref_out, A, B);
+			mat_transpose(&ref_outT, ref_out);
+			matmult_ref(&outT, BT, AT);
+			if (!equalsMatrix(outT, ref_outT)) {
+				(*stats)[0].failedTest = i;
+				(*stats)[0].failure = "transpose mult failed\n";
+				return;
+			}
+		}
+
+		Mat44 inPlace;
+		for (size_t j = 0; j < matmultVariants.size(); j++) {
+			matmultVariants[j].matmult(&out, A, B);
+			if (!verifyMatmultResult(&(*stats)[j], i, matmultVariants[j].name, out, A, B))
+				return;
+			// the library passes out == A directly to the kernel, out == B is copied
+			inPlace = A;
+			matmultVariants[j].matmult(&inPlace, inPlace, B);
+			if (!verifyInPlaceResult(&(*stats)[j], i, matmultVariants[j].name, "A", &inPlace, &out, 1))
+				return;
+		}
+		math4d_matmult(&out, &A, &B, 1);
+		if (!verifyMatmultResult(&(*stats)[matmultVariants.size()], i, "math4d_matmult", out, A, B))
+			return;
+		inPlace = A;
+		math4d_matmult(&inPlace, &inPlace, &B, 1);
+		if (!verifyInPlaceResult(&(*stats)[matmultVariants.size()], i, "math4d_matmult", "A", &inPlace, &out, 1))
+			return;
+		inPlace = B;
+		math4d_matmult(&inPlace, &A, &inPlace, 1);
+		if (!verifyInPlaceResult(&(*stats)[matmultVariants.size()], i, "math4d_matmult", "B", &inPlace, &out, 1))
+			return;
+	}
+}
+
+static void verifyVecmultRange(std::vector<VerificationStats> *stats, const VerifyPlan &plan, long begin, long end)
+{
+	const size_t vecmultCount = vecmultVariants.size();
+	const size_t dispatchIndex = vecmultVariants.size()+vecTmultVariants.size();
+	for (long i = begin; i < end; i++) {
+		VerifyRandom random(i);
+		int matrixStratum, vectorStratum;
+		plan.strata(i, &matrixStratum, &vectorStratum);
 
-	// vecmult correctness tests, all should provide the same result as reference
-	// implementation (or close to the same, FMADD may provide better precision)
-	for (int i = 0; i < 100000; i++) {
 		Mat44 m, mT;
-		Vector4 out[31], in[31], ref_out[31];
-		randmat(&m);
+		Vector4 out[31], in[31], inPlace[31];
+		const size_t count = sizeof(in)/sizeof(in[0]);
+		verifyMatrix(&m, &random, matrixStratum);
 		mat_transpose(&mT, m);
-		for (size_t c = 0; c < sizeof(in)/sizeof(in[0]); ++c) {
-			randvec(&in[c]);
+		for (size_t c = 0; c < count; ++c) {
+			verifyVector(&in[c], &random, vectorStratum);
+		}
+
+		for (size_t j = 0; j < vecmultCount; j++) {
+			vecmultVariants[j].vecmult(out, in, count, m);
+			if (!verifyVecmultResult(&(*stats)[j], i, vecmultVariants[j].name, out, in, count, m))
+				return;
+			memcpy(inPlace, in, sizeof(in));
+			vecmultVariants[j].vecmult(inPlace, inPlace, count, m);
+			if (!verifyInPlaceResult(&(*stats)[j], i, vecmultVariants[j].name, "in", inPlace, out, count))
+				return;
+		}
+		for (size_t j = 0; j < vecTmultVariants.size(); j++) {
+			vecTmultVariants[j].vecTmult(out, mT, in, count);
+			if (!verifyVecmultResult(&(*stats)[vecmultCount+j], i, vecTmultVariants[j].name, out, in, count, m))
+				return;
+			memcpy(inPlace, in, sizeof(in));
+			vecTmultVariants[j].vecTmult(inPlace, mT, inPlace, count);
+			if (!verifyInPlaceResult(&(*stats)[vecmultCount+j], i, vecTmultVariants[j].name, "in", inPlace, out, count))
+				return;
+		}
+		math4d_vecmult(out, in, count, m);
+		if (!verifyVecmultResult(&(*stats)[dispatchIndex], i, "math4d_vecmult", out, in, count, m))
+			return;
+		memcpy(inPlace, in, sizeof(in));
+		math4d_vecmult(inPlace, inPlace, count, m);
+		if (!verifyInPlaceResult(&(*stats)[dispatchIndex], i, "math4d_vecmult", "in", inPlace, out, count))
+			return;
+		math4d_vecTmult(out, mT, in, count);
+		if (!verifyVecmultResult(&(*stats)[dispatchIndex+1], i, "math4d_vecTmult", out, in, count, m))
+			return;
+		memcpy(inPlace, in, sizeof(in));
+		math4d_vecTmult(inPlace, mT, inPlace, count);
+		if (!verifyInPlaceResult(&(*stats)[dispatchIndex+1], i, "math4d_vecTmult", "in", inPlace, out, count))
+			return;
+	}
+}
+
+// Runs the test cases on all CPUs, in chunks picked up by worker threads until done or first failure
+static std::vector<VerificationStats> runVerificationParallel(size_t variantCount, const VerifyPlan &plan, void (*verifyRange)(std::vector<VerificationStats> *stats, const VerifyPlan &plan, long begin, long end))
+{
+	static const long chunkSize = 1024;
+
+	unsigned threadCount = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<std::vector<VerificationStats>> threadStats(threadCount, std::vector<VerificationStats>(variantCount));
+	std::atomic<long> nextChunk(0);
+	std::atomic<bool> failed(false);
+
+	auto worker = [&](unsigned t) {
+		for (;;) {
+			long begin = nextChunk.fetch_add(chunkSize);
+			if (begin >= plan.total() || failed.load())
+				break;
+			verifyRange(&threadStats[t], plan, begin, std::min(begin+chunkSize, plan.total()));
+			for (const VerificationStats &s: threadStats[t]) {
+				if (s.failedTest >= 0)
+					failed.store(true);
+			}
+		}
+	};
+	std::vector<std::thread> threads;
+	for (unsigned t = 1; t < threadCount; ++t) {
+		threads.emplace_back(worker, t);
+	}
+	worker(0);
+	for (std::thread &thread: threads) {
+		thread.join();
+	}
+
+	std::vector<VerificationStats> stats(variantCount);
+	for (const std::vector<VerificationStats> &ts: threadStats) {
+		for (size_t j = 0; j < variantCount; ++j) {
+			stats[j].merge(ts[j]);
+		}
+	}
+	return stats;
+}
+
+static int reportVerification(const std::vector<VerificationStats> &stats, const std::vector<const char *> &names)
+{
+	int err = 0;
+	for (size_t j = 0; j < stats.size(); ++j) {
+		if (stats[j].failedTest >= 0) {
+			fputs(stats[j].failure.c_str(), stderr);
+			err = 1;
+		}
+		else {
+			fprintf(stderr, "%-25s: max %6.3f mean %6.3f eps*bound, max %3llu mean %6.3f ulp (conditioned), %10llu elements\n", names[j], stats[j].maxBound, stats[j].count != 0 ? stats[j].sumBound/stats[j].count : 0.0, (unsigned long long) stats[j].maxUlp, stats[j].ulpCount != 0 ? stats[j].sumUlp/stats[j].ulpCount : 0.0, (unsigned long long) stats[j].count);
+		}
+	}
+	return err;
+}
+
+// Expressions use the same dispatched kernels, so the results must be identical to hand-written calls
+static int verifyExpressions()
+{
+	VerifyRandom random(0);
+	Mat44 m1, m2, m3, hand1, hand2;
+	Vector4 in[7], hand[7], out[7];
+	verifyMatrix(&m1, &random, STRATUM_UNIT);
+	verifyMatrix(&m2, &random, STRATUM_UNIT);
+	verifyMatrix(&m3, &random, STRATUM_UNIT);
+	for (size_t c = 0; c < sizeof(in)/sizeof(in[0]); ++c) {
+		verifyVector(&in[c], &random, STRATUM_UNIT);
+	}
+	math4d_matmult(&hand1, &m1, &m2, 1);
+	math4d_matmult(&hand2, &hand1, &m3, 1);
+	math4d_vecmult(hand, in, sizeof(in)/sizeof(in[0]), hand2);
+
+	Mat44 product = m1 * m2 * m3;
+	if (memcmp(&product, &hand2, sizeof(product)) != 0) {
+		fprintf(stderr, "Mat44 expression failed\n");
+		return 1;
+	}
+	Mat44 compound = m1;
+	compound *= m2;
+	compound *= m3;
+	if (memcmp(&compound, &hand2, sizeof(compound)) != 0) {
+		fprintf(stderr, "Mat44 compound expression failed\n");
+		return 1;
+	}
+	VectorSpan outSpan(out);
+	outSpan = ConstVectorSpan(in) * (m1 * m2) * m3;
+	if (memcmp(out, hand, sizeof(out)) != 0) {
+		fprintf(stderr, "VectorSpan expression failed\n");
+		return 1;
+	}
+	memcpy(out, in, sizeof(out));
+	outSpan *= m1 * m2 * m3;
+	if (memcmp(out, hand, sizeof(out)) != 0) {
+		fprintf(stderr, "VectorSpan compound expression failed\n");
+		return 1;
+	}
+	Vector4 single = in[3] * product;
+	if (memcmp(&single, &hand[3], sizeof(single)) != 0) {
+		fprintf(stderr, "Vector4 expression failed\n");
+		return 1;
+	}
+	fprintf(stderr, "expressions correctness ok.\n");
+	return 0;
+}
+
+// Random affine matrix, bounding volumes require last column (0, 0, 0, 1)
+static void verifyAffine(Mat44 *m, VerifyRandom *random)
+{
+	verifyMatrix(m, random, STRATUM_NORMAL);
+	for (int i = 0; i < 3; i++)
+		m->m[i][3] = 0;
+	m->m[3][3] = 1;
+}
+
+static void verifyAabb(Aabb *box, VerifyRandom *random)
+{
+	verifyVector(&box->center, random, STRATUM_NORMAL);
+	verifyVector(&box->extent, random, STRATUM_NORMAL);
+	for (int j = 0; j < 4; j++)
+		box->extent.m[j] = fabsf(box->extent.m[j])/4;
+}
+
+// Corner based reference, transforms all eight corners in double and takes the bounds
+static void boundsCorners(double lo[3], double hi[3], const Aabb &box, const Mat44 &m)
+{
+	for (int j = 0; j < 3; j++) {
+		lo[j] = INFINITY;
+		hi[j] = -INFINITY;
+	}
+	for (int corner = 0; corner < 8; corner++) {
+		double p[3];
+		for (int k = 0; k < 3; k++)
+			p[k] = (double)box.center.m[k]+((corner >> k)&1 ? 1 : -1)*(double)box.extent.m[k];
+		for (int j = 0; j < 3; j++) {
+			double v = p[0]*m.m[0][j]+p[1]*m.m[1][j]+p[2]*m.m[2][j]+m.m[3][j];
+			lo[j] = std::min(lo[j], v);
+			hi[j] = std::max(hi[j], v);
+		}
+	}
+}
+
+// Magnitude of the values involved in transformation, for error bound
+static double boundsMagnitude(const Aabb &box, const Mat44 &m)
+{
+	double magnitude = fabs(m.m[3][0])+fabs(m.m[3][1])+fabs(m.m[3][2]);
+	for (int k = 0; k < 3; k++)
+		magnitude += (fabs(box.center.m[k])+box.extent.m[k])*(fabs(m.m[k][0])+fabs(m.m[k][1])+fabs(m.m[k][2]));
+	return magnitude;
+}
+
+static bool verifyAabbResult(long test, const char *name, const Aabb &out, const Aabb &in, const Mat44 &m)
+{
+	double lo[3], hi[3];
+	boundsCorners(lo, hi, in, m);
+	double tolerance = boundsMagnitude(in, m)*8*std::numeric_limits<float>::epsilon();
+	for (int j = 0; j < 3; j++) {
+		if (fabs(out.center.m[j]-(lo[j]+hi[j])/2) > tolerance || fabs(out.extent.m[j]-(hi[j]-lo[j])/2) > tolerance) {
+			fprintf(stderr, "aabbmult failed for %s test %ld: component %d, got center %g extent %g, expected %g %g\n", name, test, j, out.center.m[j], out.extent.m[j], (lo[j]+hi[j])/2, (hi[j]-lo[j])/2);
+			return false;
+		}
+	}
+	return true;
+}
+
+// Surface directions tested for sphere containment: axes, cube diagonals and random ones, deterministic per sphere
+static void sphereDirections(double directions[][3], size_t count, uint64_t seed)
+{
+	VerifyRandom random(seed);
+	for (size_t d = 0; d < count; d++) {
+		double v[3], length2 = 0;
+		if (d < 6) {
+			for (int k = 0; k < 3; k++)
+				v[k] = d/2 == (size_t)k ? (d%2 ? -1 : 1) : 0;
+		}
+		else if (d < 14) {
+			for (int k = 0; k < 3; k++)
+				v[k] = ((d-6) >> k)&1 ? -1 : 1;
+		}
+		else {
+			do {
+				for (int k = 0; k < 3; k++)
+					v[k] = (double)(random.next() >> 11)/(1ull << 52)-1;
+				length2 = v[0]*v[0]+v[1]*v[1]+v[2]*v[2];
+			} while (length2 > 1 || length2 < 1e-6);
+		}
+		length2 = v[0]*v[0]+v[1]*v[1]+v[2]*v[2];
+		for (int k = 0; k < 3; k++)
+			directions[d][k] = v[k]/sqrt(length2);
+	}
+}
+
+// Sphere must contain the transformed surface points of the source sphere and be tight for uniform scale
+static bool verifySphereResult(long test, size_t index, const char *name, const Vector4 &out, const Vector4 &in, const Vector4 &ref, const Mat44 &m)
+{
+	double magnitude = fabs(m.m[3][0])+fabs(m.m[3][1])+fabs(m.m[3][2]);
+	for (int k = 0; k < 3; k++)
+		magnitude += (fabs(in.m[k])+fabs(in.m[3]))*(fabs(m.m[k][0])+fabs(m.m[k][1])+fabs(m.m[k][2]));
+	double tolerance = magnitude*8*std::numeric_limits<float>::epsilon();
+	for (int j = 0; j < 4; j++) {
+		if (fabs(out.m[j]-ref.m[j]) > tolerance) {
+			fprintf(stderr, "spheremult failed for %s test %ld: component %d, got %g, expected %g\n", name, test, j, out.m[j], ref.m[j]);
+			return false;
+		}
+	}
+	double directions[30][3];
+	sphereDirections(directions, sizeof(directions)/sizeof(directions[0]), ((uint64_t)test << 16)+index);
+	for (size_t d = 0; d < sizeof(directions)/sizeof(directions[0]); d++) {
+		double p[3], distance2 = 0;
+		for (int k = 0; k < 3; k++)
+			p[k] = (double)in.m[k]+directions[d][k]*in.m[3];
+		for (int j = 0; j < 3; j++) {
+			double v = p[0]*m.m[0][j]+p[1]*m.m[1][j]+p[2]*m.m[2][j]+m.m[3][j];
+			distance2 += (v-out.m[j])*(v-out.m[j]);
+		}
+		if (sqrt(distance2) > fabs(out.m[3])+tolerance) {
+			fprintf(stderr, "spheremult failed for %s test %ld: sphere %zu direction %zu outside of sphere, distance %g, radius %g\n", name, test, index, d, sqrt(distance2), out.m[3]);
+			return false;
+		}
+	}
+	return true;
+}
+
+// Expected visibility from the eight corners: 1 visible, 0 culled, -1 too close to plane to decide in float
+static int cullExpected(const Aabb &box, const Mat44 &m, const Vector4 *planes)
+{
+	double lo[3], hi[3];
+	boundsCorners(lo, hi, box, m);
+	int result = 1;
+	for (int p = 0; p < 6; p++) {
+		double maxDistance = planes[p].m[3], magnitude = fabs(planes[p].m[3]);
+		for (int j = 0; j < 3; j++) {
+			maxDistance += planes[p].m[j]*(planes[p].m[j] >= 0 ? hi[j] : lo[j]);
+			magnitude += fabs(planes[p].m[j])*std::max(fabs(lo[j]), fabs(hi[j]));
+		}
+		double tolerance = (magnitude+boundsMagnitude(box, m))*16*std::numeric_limits<float>::epsilon();
+		if (maxDistance < -tolerance)
+			return 0;
+		if (maxDistance <= tolerance)
+			result = -1;
+	}
+	return result;
+}
+
+// Bounding volumes correctness tests, compared to the corner based reference computed in double
+static int verifyBounds(VerifyMode mode)
+{
+	static const size_t count = 67;
+	const long tests = mode == VERIFY_FULL ? 20000 : 200;
+
+	// rotation with uniform scale 3 must not inflate the radius
+	{
+		const double a = 0.5, b = 0.7;
+		Mat44 m = { { { 0 } } };
+		m.m[0][0] = 3*cos(a);        m.m[0][1] = 3*sin(a);        m.m[0][2] = 0;
+		m.m[1][0] = -3*sin(a)*cos(b); m.m[1][1] = 3*cos(a)*cos(b); m.m[1][2] = 3*sin(b);
+		m.m[2][0] = 3*sin(a)*sin(b);  m.m[2][1] = -3*cos(a)*sin(b); m.m[2][2] = 3*cos(b);
+		m.m[3][3] = 1;
+		Vector4 sphere = { { 1, 2, 3, 1 } }, out;
+		for (size_t i = 0; i <= spheremultVariants.size(); ++i) {
+			const char *name = i < spheremultVariants.size() ? spheremultVariants[i].name : "math4d_spheremult";
+			if (i < spheremultVariants.size())
+				spheremultVariants[i].spheremult(&out, &sphere, 1, m);
+			else
+				math4d_spheremult(&out, &sphere, 1, m);
+			if (fabs(out.m[3]-3) > 3*8*std::numeric_limits<float>::epsilon()) {
+				fprintf(stderr, "spheremult failed for %s: radius %.9g for rotation with scale 3\n", name, out.m[3]);
+				return 1;
+			}
+		}
+	}
+	for (long test = 0; test < tests; ++test) {
+		VerifyRandom random(test);
+		Mat44 m;
+		Aabb boxes[count], boxesOut[count], boxesInPlace[count];
+		Vector4 spheres[count], spheresRef[count], spheresOut[count], spheresInPlace[count], planes[6];
+		uint64_t visible[(count+63)/64];
+		int expected[count];
+		verifyAffine(&m, &random);
+		for (size_t c = 0; c < count; ++c) {
+			verifyAabb(&boxes[c], &random);
+			spheres[c] = boxes[c].center;
+			spheres[c].m[3] = boxes[c].extent.m[3];
+		}
+		for (int p = 0; p < 6; ++p) {
+			verifyVector(&planes[p], &random, STRATUM_NORMAL);
+			planes[p].m[3] *= 64;
 		}
-		vecmult_ref(ref_out, in, sizeof(in)/sizeof(in[0]), m);
-
-		for (size_t j = 0; j < sizeof(vecmult_variants)/sizeof(vecmult_variants[0]); j++) {
-			vecmult_variants[j].vecmult(out, in, sizeof(in)/sizeof(in[0]), m);
-			for (size_t c = 0; c < sizeof(in)/sizeof(in[0]); ++c) {
-				if (!equalsVector(out[c], ref_out[c])) {
-					fprintf(stderr, "%s failed vecmult test %d\n", vecmult_variants[j].name, i);
-					fprintf(stderr, "%15.6f %15.6f %15.6f %15.6f      %15.6f %15.6f %15.6f %15.6f\n", out[c].m[0], out[c].m[1], out[c].m[2], out[c].m[3], ref_out[c].m[0], ref_out[c].m[1], ref_out[c].m[2], ref_out[c].m[3]);
+		for (size_t c = 0; c < count; ++c) {
+			expected[c] = cullExpected(boxes[c], m, planes);
+		}
+		spheremult_ref(spheresRef, spheres, count, m);
+
+		for (size_t i = 0; i <= aabbmultVariants.size(); ++i) {
+			const char *name = i < aabbmultVariants.size() ? aabbmultVariants[i].name : "math4d_aabbmult";
+			memset(boxesOut, 0, sizeof(boxesOut));
+			if (i < aabbmultVariants.size())
+				aabbmultVariants[i].aabbmult(boxesOut, boxes, count, m);
+			else
+				math4d_aabbmult(boxesOut, boxes, count, m);
+			for (size_t c = 0; c < count; ++c) {
+				if (!verifyAabbResult(test, name, boxesOut[c], boxes[c], m))
 					return 1;
-				}
 			}
+			memcpy(boxesInPlace, boxes, sizeof(boxes));
+			if (i < aabbmultVariants.size())
+				aabbmultVariants[i].aabbmult(boxesInPlace, boxesInPlace, count, m);
+			else
+				math4d_aabbmult(boxesInPlace, boxesInPlace, count, m);
+			if (!verifyInPlaceResult((VerificationStats *)NULL, test, name, "in", boxesInPlace, boxesOut, count))
+				return 1;
+		}
+		for (size_t i = 0; i <= spheremultVariants.size(); ++i) {
+			const char *name = i < spheremultVariants.size() ? spheremultVariants[i].name : "math4d_spheremult";
+			memset(spheresOut, 0, sizeof(spheresOut));
+			if (i < spheremultVariants.size())
+				spheremultVariants[i].spheremult(spheresOut, spheres, count, m);
+			else
+				math4d_spheremult(spheresOut, spheres, count, m);
+			for (size_t c = 0; c < count; ++c) {
+				if (!verifySphereResult(test, c, name, spheresOut[c], spheres[c], spheresRef[c], m))
+					return 1;
+			}
+			memcpy(spheresInPlace, spheres, sizeof(spheres));
+			if (i < spheremultVariants.size())
+				spheremultVariants[i].spheremult(spheresInPlace, spheresInPlace, count, m);
+			else
+				math4d_spheremult(spheresInPlace, spheresInPlace, count, m);
+			if (!verifyInPlaceResult((VerificationStats *)NULL, test, name, "in", spheresInPlace, spheresOut, count))
+				return 1;
 		}
-		for (size_t j = 0; j < sizeof(vecTmult_variants)/sizeof(vecTmult_variants[0]); j++) {
-			vecTmult_variants[j].vecTmult(out, mT, in, sizeof(in)/sizeof(in[0]));
-			for (size_t c = 0; c < sizeof(in)/sizeof(in[0]); ++c) {
-				if (!equalsVector(out[c], ref_out[c])) {
-					fprintf(stderr, "%s failed vecmult test %d\n", vecTmult_variants[j].name, i);
-					fprintf(stderr, "%15.6f %15.6f %15.6f %15.6f      %15.6f %15.6f %15.6f %15.6f\n", out[c].m[0], out[c].m[1], out[c].m[2], out[c].m[3], ref_out[c].m[0], ref_out[c].m[1], ref_out[c].m[2], ref_out[c].m[3]);
+		for (size_t i = 0; i <= aabbcullVariants.size(); ++i) {
+			const char *name = i < aabbcullVariants.size() ? aabbcullVariants[i].name : "math4d_aabbcull";
+			memset(visible, 0xa5, sizeof(visible));
+			if (i < aabbcullVariants.size())
+				aabbcullVariants[i].aabbcull(visible, boxes, count, m, planes);
+			else
+				math4d_aabbcull(visible, boxes, count, m, planes);
+			if ((visible[count/64] >> (count%64)) != 0) {
+				fprintf(stderr, "aabbcull failed for %s test %ld: bits set over count\n", name, test);
+				return 1;
+			}
+			for (size_t c = 0; c < count; ++c) {
+				int got = (visible[c/64] >> (c%64))&1;
+				if (expected[c] >= 0 && got != expected[c]) {
+					fprintf(stderr, "aabbcull failed for %s test %ld: box %zu, got %d, expected %d\n", name, test, c, got, expected[c]);
 					return 1;
 				}
 			}
 		}
 	}
-	fprintf(stderr, "vecmult correctness ok.\n");
-
+	fprintf(stderr, "bounds correctness ok.\n");
 	return 0;
 }
 
+int runVerification(VerifyMode mode)
+{
+	if (mode == VERIFY_NONE)
+		return 0;
+
+	// matmult correctness tests, all should provide the same result as reference
+	// implementation (or close to the same, FMADD may provide better precision)
+	{
+		VerifyPlan plan = { mode == VERIFY_FULL ? 1000000 : 10000, mode == VERIFY_FULL ? 1024 : 64 };
+		std::vector<const char *> names;
+		for (size_t j = 0; j < matmultVariants.size(); j++) {
+			names.push_back(matmultVariants[j].name);
+		}
+		names.push_back("math4d_matmult");
+		if (reportVerification(runVerificationParallel(names.size(), plan, &verifyMatmultRange), names) != 0)
+			return 1;
+		fprintf(stderr, "matmult correctness ok.\n");
+	}
+
+	// vecmult correctness tests, all should provide the same result as reference
+	// implementation (or close to the same, FMADD may provide better precision)
+	{
+		VerifyPlan plan = { mode == VERIFY_FULL ? 100000 : 1000, mode == VERIFY_FULL ? 128 : 8 };
+		std::vector<const char *> names;
+		for (size_t j = 0; j < vecmultVariants.size(); j++) {
+			names.push_back(vecmultVariants[j].name);
+		}
+		for (size_t j = 0; j < vecTmultVariants.size(); j++) {
+			names.push_back(vecTmultVariants[j].name);
+		}
+		names.push_back("math4d_vecmult");
+		names.push_back("math4d_vecTmult");
+		if (reportVerification(runVerificationParallel(names.size(), plan, &verifyVecmultRange), names) != 0)
+			return 1;
+		fprintf(stderr, "vecmult correctness ok.\n");
+	}
+
+	if (verifyBounds(mode) != 0)
+		return 1;
+
+	return verifyExpressions();
+}
+
 int runBenchmarkSet()
 {
 	static const int muls_per_run = 16;
 
 	Mat44 Aperf, ATperf, Bperf, out;
+	Mat44 Abatch[muls_per_run], Bbatch[muls_per_run], outBatch[muls_per_run];
 	Vector4 vectors[muls_per_run];
 	Vector4 vectorsOut[muls_per_run];
 	randmat(&Aperf);
@@ -1096,31 +996,145 @@ int runBenchmarkSet()
 	for (size_t i = 0; i < sizeof(vectors)/sizeof(vectors[0]); ++i) {
 		randvec(&vectors[i]);
 	}
+	for (size_t i = 0; i < muls_per_run; ++i) {
+		Abatch[i] = Aperf;
+		Bbatch[i] = Bperf;
+	}
 
-	for (size_t i = 0; i < sizeof(matmult_variants)/sizeof(matmult_variants[0]); i++) {
-		runBenchmark(matmult_variants[i].name, 256, muls_per_run, [i, &out, Aperf, Bperf](){ run_matmult(matmult_variants[i].matmult, &out, &Aperf, &Bperf, muls_per_run); });
+	for (size_t i = 0; i < matmultVariants.size(); i++) {
+		runBenchmark(matmultVariants[i].name, 256, muls_per_run, [i, &out, Aperf, Bperf](){ run_matmult(matmultVariants[i].matmult, &out, &Aperf, &Bperf, muls_per_run); });
+	}
+	runBenchmark("math4d_matmult", 256, muls_per_run, [&outBatch, &Abatch, &Bbatch](){ math4d_matmult(outBatch, Abatch, Bbatch, muls_per_run); });
+	for (size_t i = 0; i < vecmultVariants.size(); i++) {
+		runBenchmark(vecmultVariants[i].name, 2048, sizeof(vectors)/sizeof(vectors[0]), [i, vectors, &vectorsOut, Aperf](){ vecmultVariants[i].vecmult(vectorsOut, vectors, sizeof(vectors)/sizeof(vectors[0]), Aperf); });
+	}
+	runBenchmark("math4d_vecmult", 2048, sizeof(vectors)/sizeof(vectors[0]), [vectors, &vectorsOut, Aperf](){ math4d_vecmult(vectorsOut, vectors, sizeof(vectors)/sizeof(vectors[0]), Aperf); });
+	runBenchmark("vecmult_expr", 2048, sizeof(vectors)/sizeof(vectors[0]), [vectors, &vectorsOut, Aperf](){ VectorSpan out(vectorsOut); out = ConstVectorSpan(vectors) * Aperf; });
+	runBenchmark("vecmult_chainHand", 2048, sizeof(vectors)/sizeof(vectors[0]), [vectors, &vectorsOut, Aperf, Bperf, ATperf](){
+		Mat44 m1, m2;
+		math4d_matmult(&m1, &Aperf, &Bperf, 1);
+		math4d_matmult(&m2, &m1, &ATperf, 1);
+		math4d_vecmult(vectorsOut, vectors, sizeof(vectors)/sizeof(vectors[0]), m2);
+	});
+	runBenchmark("vecmult_chainExpr", 2048, sizeof(vectors)/sizeof(vectors[0]), [vectors, &vectorsOut, Aperf, Bperf, ATperf](){ VectorSpan out(vectorsOut); out = ConstVectorSpan(vectors) * (Aperf * Bperf) * ATperf; });
+	for (size_t i = 0; i < vecTmultVariants.size(); i++) {
+		runBenchmark(vecTmultVariants[i].name, 2048, sizeof(vectors)/sizeof(vectors[0]), [i, vectors, &vectorsOut, ATperf](){ vecTmultVariants[i].vecTmult(vectorsOut, ATperf, vectors, sizeof(vectors)/sizeof(vectors[0])); });
+	}
+	runBenchmark("math4d_vecTmult", 2048, sizeof(vectors)/sizeof(vectors[0]), [vectors, &vectorsOut, ATperf](){ math4d_vecTmult(vectorsOut, ATperf, vectors, sizeof(vectors)/sizeof(vectors[0])); });
+
+	// bounding volumes, per box or sphere
+	static const size_t bounds_per_run = 64;
+	Mat44 affine = Aperf;
+	Aabb boxes[bounds_per_run], boxesOut[bounds_per_run];
+	Vector4 spheres[bounds_per_run], spheresOut[bounds_per_run], planes[6];
+	uint64_t visible[(bounds_per_run+63)/64];
+	for (int i = 0; i < 3; ++i)
+		affine.m[i][3] = 0;
+	affine.m[3][3] = 1;
+	for (size_t i = 0; i < bounds_per_run; ++i) {
+		randvec(&boxes[i].center);
+		randvec(&boxes[i].extent);
+		for (int j = 0; j < 4; ++j)
+			boxes[i].extent.m[j] = fabsf(boxes[i].extent.m[j]);
+		spheres[i] = boxes[i].center;
+	}
+	for (int p = 0; p < 6; ++p) {
+		randvec(&planes[p]);
 	}
-	for (size_t i = 0; i < sizeof(vecmult_variants)/sizeof(vecmult_variants[0]); i++) {
-		runBenchmark(vecmult_variants[i].name, 2048, sizeof(vectors)/sizeof(vectors[0]), [i, vectors, &vectorsOut, Aperf](){ vecmult_variants[i].vecmult(vectorsOut, vectors, sizeof(vectors)/sizeof(vectors[0]), Aperf); });
+	runBenchmark("aabbmult_corners", 256, bounds_per_run, [&boxes, &boxesOut, affine](){
+		for (size_t i = 0; i < bounds_per_run; ++i) {
+			Vector4 corners[8];
+			for (int corner = 0; corner < 8; ++corner) {
+				for (int k = 0; k < 3; ++k)
+					corners[corner].m[k] = boxes[i].center.m[k]+((corner >> k)&1 ? boxes[i].extent.m[k] : -boxes[i].extent.m[k]);
+				corners[corner].m[3] = 1;
+			}
+			vecmult_ref(corners, corners, 8, affine);
+			Vector4 lo = corners[0], hi = corners[0];
+			for (int corner = 1; corner < 8; ++corner) {
+				for (int j = 0; j < 3; ++j) {
+					lo.m[j] = std::min(lo.m[j], corners[corner].m[j]);
+					hi.m[j] = std::max(hi.m[j], corners[corner].m[j]);
+				}
+			}
+			for (int j = 0; j < 4; ++j) {
+				boxesOut[i].center.m[j] = (lo.m[j]+hi.m[j])/2;
+				boxesOut[i].extent.m[j] = (hi.m[j]-lo.m[j])/2;
+			}
+		}
+	});
+	for (size_t i = 0; i < aabbmultVariants.size(); i++) {
+		runBenchmark(aabbmultVariants[i].name, 256, bounds_per_run, [i, &boxes, &boxesOut, affine](){ aabbmultVariants[i].aabbmult(boxesOut, boxes, bounds_per_run, affine); });
+	}
+	runBenchmark("math4d_aabbmult", 256, bounds_per_run, [&boxes, &boxesOut, affine](){ math4d_aabbmult(boxesOut, boxes, bounds_per_run, affine); });
+	for (size_t i = 0; i < spheremultVariants.size(); i++) {
+		runBenchmark(spheremultVariants[i].name, 256, bounds_per_run, [i, &spheres, &spheresOut, affine](){ spheremultVariants[i].spheremult(spheresOut, spheres, bounds_per_run, affine); });
 	}
-	for (size_t i = 0; i < sizeof(vecTmult_variants)/sizeof(vecTmult_variants[0]); i++) {
-		runBenchmark(vecTmult_variants[i].name, 2048, sizeof(vectors)/sizeof(vectors[0]), [i, vectors, &vectorsOut, ATperf](){ vecTmult_variants[i].vecTmult(vectorsOut, ATperf, vectors, sizeof(vectors)/sizeof(vectors[0])); });
+	runBenchmark("math4d_spheremult", 256, bounds_per_run, [&spheres, &spheresOut, affine](){ math4d_spheremult(spheresOut, spheres, bounds_per_run, affine); });
+	for (size_t i = 0; i < aabbcullVariants.size(); i++) {
+		runBenchmark(aabbcullVariants[i].name, 256, bounds_per_run, [i, &visible, &boxes, affine, &planes](){ aabbcullVariants[i].aabbcull(visible, boxes, bounds_per_run, affine, planes); });
 	}
+	runBenchmark("math4d_aabbcull", 256, bounds_per_run, [&visible, &boxes, affine, &planes](){ math4d_aabbcull(visible, boxes, bounds_per_run, affine, planes); });
 	return 0;
 }
 
+static int usage(const char *argv0)
+{
+	fprintf(stderr, "Usage: %s [--verify=full|quick|none] [count]\n", argv0);
+	fprintf(stderr, "       %s [--verify=full|quick|none] --sustained=variant[,variant...]|isa [--threads=N|M-N] [--duration=seconds] [--cooldown=seconds]\n", argv0);
+	return 2;
+}
+
 int main(int argc, char **argv)
 {
+	VerifyMode verifyMode = VERIFY_QUICK;
+	const char *sustained = NULL;
+	const char *threads = "1";
+	double duration = 120;
+	double cooldown = 10;
 	long count = 1;
-	if (argc > 1) {
-		if ((count = (long) atof(argv[1])) == 0) {
-			fprintf(stderr, "Usage: %s [count]\n", argv[0]);
+	int argi;
+	for (argi = 1; argi < argc && strncmp(argv[argi], "--", 2) == 0; ++argi) {
+		if (strcmp(argv[argi], "--verify=full") == 0) {
+			verifyMode = VERIFY_FULL;
+		}
+		else if (strcmp(argv[argi], "--verify=quick") == 0) {
+			verifyMode = VERIFY_QUICK;
+		}
+		else if (strcmp(argv[argi], "--verify=none") == 0) {
+			verifyMode = VERIFY_NONE;
+		}
+		else if (strncmp(argv[argi], "--sustained=", 12) == 0) {
+			sustained = argv[argi]+12;
+		}
+		else if (strncmp(argv[argi], "--threads=", 10) == 0) {
+			threads = argv[argi]+10;
+		}
+		else if (strncmp(argv[argi], "--duration=", 11) == 0) {
+			if ((duration = atof(argv[argi]+11)) <= 0)
+				return usage(argv[0]);
+		}
+		else if (strncmp(argv[argi], "--cooldown=", 11) == 0) {
+			cooldown = atof(argv[argi]+11);
+		}
+		else {
+			return usage(argv[0]);
 		}
 	}
+	if (argi < argc) {
+		if ((count = (long) atof(argv[argi])) == 0) {
+			usage(argv[0]);
+		}
+	}
+	initBenchmarkVariants();
 	int err;
-	if ((err = runVerification()) != 0) {
+	if ((err = runVerification(verifyMode)) != 0) {
 		return err;
 	}
+	fprintf(stderr, "math4d selected: %s %s %s %s %s %s\n", math4d_variant(MATH4D_MATMULT), math4d_variant(MATH4D_VECMULT), math4d_variant(MATH4D_VECTMULT), math4d_variant(MATH4D_AABBMULT), math4d_variant(MATH4D_SPHEREMULT), math4d_variant(MATH4D_AABBCULL));
+	if (sustained != NULL) {
+		return runSustained(sustained, threads, duration, cooldown);
+	}
 	for (long i = 0; i < count; ++i) {
 		runBenchmarkSet();
 	}
@@ -0,0 +1,27 @@
+/*
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+
+#ifndef MatrixMultiplicationBenchmark_hxx__
+# define MatrixMultiplicationBenchmark_hxx__
+
+#include <vector>
+
+#include "Math4DKernels.hxx"
+
+
+// Variants measured by benchmark: library variants supported by the running CPU, with the benchmark only variants
+// inserted after the reference one
+extern std::vector<MatmultVariant> matmultVariants;
+extern std::vector<VecmultVariant> vecmultVariants;
+extern std::vector<VecTmultVariant> vecTmultVariants;
+extern std::vector<AabbmultVariant> aabbmultVariants;
+extern std::vector<SpheremultVariant> spheremultVariants;
+extern std::vector<AabbcullVariant> aabbcullVariants;
+
+void initBenchmarkVariants();
+
+int runSustained(const char *variants, const char *threads, double duration, double cooldown);
+
+
+#endif
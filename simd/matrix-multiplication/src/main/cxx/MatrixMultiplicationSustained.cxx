@@ -0,0 +1,426 @@
+/*
+ * Sustained multi-core benchmark, measuring throughput and effective frequency over time.
+ *
+ * Zbynek Vyskovsky, kvr000@gmail.com https://github.com/kvr000/zbynek-cxx-exp/
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <memory>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "Math4DKernels.hxx"
+#include "MatrixMultiplicationBenchmark.hxx"
+
+
+static const int SAMPLE_INTERVAL_MS = 100;
+
+// Representative variants of each ISA level, used for --sustained=isa
+static const char *const isaVariants[] = {
+	"vecmult_novec",
+	"vecmult_Sse",
+	"vecmult_Fma256Exp",
+	"vecmult_Avx512",
+	"vecmult_Neon",
+	"vecmult_Sve",
+};
+
+struct SustainedWorkload {
+	std::string name;
+	size_t opsPerCall;
+	std::function<void()> (*create)(size_t index);
+	size_t index;
+};
+
+struct alignas(64) SustainedWorker {
+	std::atomic<uint64_t> ops;
+	int cycleFd;
+	int cpu;
+};
+
+struct SustainedSample {
+	double time;
+	double mops;
+	double mhz;
+};
+
+static std::function<void()> createMatmult(size_t index)
+{
+	struct State {
+		Mat44 A[16], B[16], out[16];
+	};
+	std::shared_ptr<State> state = std::make_shared<State>();
+	for (int k = 0; k < 16; ++k) {
+		for (int i = 0; i < 4; ++i) {
+			for (int j = 0; j < 4; ++j) {
+				state->A[k].m[i][j] = (float)(k+i+j)/16;
+				state->B[k].m[i][j] = (float)(k*i+j)/16;
+			}
+		}
+	}
+	auto matmult = matmultVariants[index].matmult;
+	return [state, matmult]() {
+		for (int k = 0; k < 16; ++k) {
+			matmult(&state->out[k], state->A[k], state->B[k]);
+		}
+	};
+}
+
+static std::function<void()> createVecmult(size_t index)
+{
+	struct State {
+		Mat44 m;
+		Vector4 in[1024], out[1024];
+	};
+	std::shared_ptr<State> state = std::make_shared<State>();
+	for (int i = 0; i < 4; ++i) {
+		for (int j = 0; j < 4; ++j) {
+			state->m.m[i][j] = (float)(i*4+j)/16;
+		}
+	}
+	for (int c = 0; c < 1024; ++c) {
+		for (int j = 0; j < 4; ++j) {
+			state->in[c].m[j] = (float)(c+j)/1024;
+		}
+	}
+	auto vecmult = vecmultVariants[index].vecmult;
+	return [state, vecmult]() {
+		vecmult(state->out, state->in, 1024, state->m);
+	};
+}
+
+static std::function<void()> createVecTmult(size_t index)
+{
+	struct State {
+		Mat44 mT;
+		Vector4 in[1024], out[1024];
+	};
+	std::shared_ptr<State> state = std::make_shared<State>();
+	for (int i = 0; i < 4; ++i) {
+		for (int j = 0; j < 4; ++j) {
+			state->mT.m[i][j] = (float)(i*4+j)/16;
+		}
+	}
+	for (int c = 0; c < 1024; ++c) {
+		for (int j = 0; j < 4; ++j) {
+			state->in[c].m[j] = (float)(c+j)/1024;
+		}
+	}
+	auto vecTmult = vecTmultVariants[index].vecTmult;
+	return [state, vecTmult]() {
+		vecTmult(state->out, state->mT, state->in, 1024);
+	};
+}
+
+static bool findWorkload(SustainedWorkload *workload, const std::string &name)
+{
+	for (size_t i = 0; i < matmultVariants.size(); ++i) {
+		if (name == matmultVariants[i].name) {
+			*workload = SustainedWorkload{ name, 16, &createMatmult, i };
+			return true;
+		}
+	}
+	for (size_t i = 0; i < vecmultVariants.size(); ++i) {
+		if (name == vecmultVariants[i].name) {
+			*workload = SustainedWorkload{ name, 1024, &createVecmult, i };
+			return true;
+		}
+	}
+	for (size_t i = 0; i < vecTmultVariants.size(); ++i) {
+		if (name == vecTmultVariants[i].name) {
+			*workload = SustainedWorkload{ name, 1024, &createVecTmult, i };
+			return true;
+		}
+	}
+	return false;
+}
+
+static std::vector<int> allowedCpus()
+{
+	std::vector<int> cpus;
+#ifdef __linux__
+	cpu_set_t set;
+	if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+		for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+			if (CPU_ISSET(cpu, &set))
+				cpus.push_back(cpu);
+		}
+	}
+#endif
+	if (cpus.empty()) {
+		for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu)
+			cpus.push_back(cpu);
+	}
+	return cpus;
+}
+
+// Pins current thread to cpu and opens user-space cycle counter for it, returns -1 if counters are not available
+static int pinAndOpenCycles(int cpu)
+{
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+		fprintf(stderr, "Failed to pin thread to cpu %d\n", cpu);
+	}
+
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = PERF_COUNT_HW_CPU_CYCLES;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+	(void)cpu;
+	return -1;
+#endif
+}
+
+static uint64_t readCycles(int fd)
+{
+	uint64_t value = 0;
+#ifdef __linux__
+	if (read(fd, &value, sizeof(value)) != sizeof(value))
+		return 0;
+#endif
+	return value;
+}
+
+// Fallback when cycle counters are not available, reports frequency the kernel sees (in MHz, 0 if unknown)
+static double readScalingFrequency(int cpu)
+{
+	std::ifstream fd("/sys/devices/system/cpu/cpu"+std::to_string(cpu)+"/cpufreq/scaling_cur_freq");
+	double khz = 0;
+	if (fd >> khz)
+		return khz/1000;
+	return 0;
+}
+
+static std::vector<SustainedSample> runSustainedSeries(const SustainedWorkload &workload, const std::vector<int> &cpus, unsigned threadCount, double duration)
+{
+	std::vector<SustainedWorker> workers(threadCount);
+	std::atomic<bool> stop(false);
+	std::atomic<unsigned> ready(0);
+	std::vector<std::thread> threads;
+
+	for (unsigned t = 0; t < threadCount; ++t) {
+		workers[t].ops.store(0);
+		workers[t].cpu = cpus[t%cpus.size()];
+		workers[t].cycleFd = -1;
+		threads.emplace_back([&, t]() {
+			workers[t].cycleFd = pinAndOpenCycles(workers[t].cpu);
+			std::function<void()> benchmark = workload.create(workload.index);
+			ready.fetch_add(1);
+			while (!stop.load(std::memory_order_relaxed)) {
+				benchmark();
+				workers[t].ops.fetch_add(workload.opsPerCall, std::memory_order_relaxed);
+			}
+		});
+	}
+	while (ready.load() < threadCount) {
+		std::this_thread::yield();
+	}
+
+	std::vector<SustainedSample> samples;
+	std::vector<uint64_t> lastOps(threadCount), lastCycles(threadCount);
+	auto start = std::chrono::steady_clock::now();
+	auto last = start;
+	for (unsigned t = 0; t < threadCount; ++t) {
+		lastOps[t] = workers[t].ops.load();
+		lastCycles[t] = workers[t].cycleFd >= 0 ? readCycles(workers[t].cycleFd) : 0;
+	}
+	for (int sample = 1; ; ++sample) {
+		std::this_thread::sleep_until(start+std::chrono::milliseconds(sample*SAMPLE_INTERVAL_MS));
+		auto now = std::chrono::steady_clock::now();
+		double interval = std::chrono::duration<double>(now-last).count();
+		last = now;
+
+		uint64_t ops = 0;
+		double mhz = 0;
+		for (unsigned t = 0; t < threadCount; ++t) {
+			uint64_t currentOps = workers[t].ops.load(std::memory_order_relaxed);
+			ops += currentOps-lastOps[t];
+			lastOps[t] = currentOps;
+			if (workers[t].cycleFd >= 0) {
+				uint64_t cycles = readCycles(workers[t].cycleFd);
+				mhz += (cycles-lastCycles[t])/interval/1000000;
+				lastCycles[t] = cycles;
+			}
+			else {
+				mhz += readScalingFrequency(workers[t].cpu);
+			}
+		}
+		SustainedSample s = { std::chrono::duration<double>(now-start).count(), ops/interval/1000000, mhz/threadCount };
+		samples.push_back(s);
+		printf("series,%s,%u,%.3f,%.3f,%.0f\n", workload.name.c_str(), threadCount, s.time, s.mops, s.mhz);
+		if (s.time >= duration)
+			break;
+	}
+
+	stop.store(true);
+	for (std::thread &thread: threads) {
+		thread.join();
+	}
+	for (SustainedWorker &worker: workers) {
+#ifdef __linux__
+		if (worker.cycleFd >= 0)
+			close(worker.cycleFd);
+#endif
+	}
+	return samples;
+}
+
+struct SustainedSummary {
+	std::string name;
+	unsigned threads;
+	double peakMops;
+	double steadyMops;
+	double steadyMhz;
+	double throttleTime;
+};
+
+// Throughput is smoothed by moving average over one second. Peak is taken from the first two seconds, steady state
+// from the last quarter. Throttling is detected when the average falls under 95% of the peak after reaching it.
+static SustainedSummary summarize(const std::string &name, unsigned threads, const std::vector<SustainedSample> &samples)
+{
+	SustainedSummary summary = { name, threads, 0, 0, 0, -1 };
+	// series shorter than the window, runSustained rejects such duration but keep the averages sane anyway
+	const size_t window = std::max((size_t)1, std::min((size_t)(1000/SAMPLE_INTERVAL_MS), samples.size()));
+	std::vector<double> average(samples.size());
+	double sum = 0;
+	for (size_t i = 0; i < samples.size(); ++i) {
+		sum += samples[i].mops;
+		if (i >= window)
+			sum -= samples[i-window].mops;
+		average[i] = sum/std::min(i+1, window);
+	}
+	size_t peakIndex = window-1;
+	for (size_t i = window-1; i < samples.size(); ++i) {
+		if (samples[i].time > 2.0 && summary.peakMops != 0)
+			break;
+		if (average[i] > summary.peakMops) {
+			summary.peakMops = average[i];
+			peakIndex = i;
+		}
+	}
+	for (size_t i = peakIndex; i < samples.size(); ++i) {
+		if (average[i] < summary.peakMops*0.95) {
+			summary.throttleTime = samples[i].time;
+			break;
+		}
+	}
+	size_t steadyStart = samples.size()*3/4;
+	for (size_t i = steadyStart; i < samples.size(); ++i) {
+		summary.steadyMops += samples[i].mops;
+		summary.steadyMhz += samples[i].mhz;
+	}
+	if (samples.size() > steadyStart) {
+		summary.steadyMops /= samples.size()-steadyStart;
+		summary.steadyMhz /= samples.size()-steadyStart;
+	}
+	return summary;
+}
+
+static bool parseThreads(std::vector<unsigned> *counts, const char *spec)
+{
+	unsigned from, to;
+	int end = 0;
+	if (sscanf(spec, "%u-%u%n", &from, &to, &end) == 2 && spec[end] == '\0' && from > 0 && from <= to) {
+		for (unsigned n = from; n <= to; ++n)
+			counts->push_back(n);
+		return true;
+	}
+	if (sscanf(spec, "%u%n", &from, &end) == 1 && spec[end] == '\0' && from > 0) {
+		counts->push_back(from);
+		return true;
+	}
+	return false;
+}
+
+int runSustained(const char *variants, const char *threads, double duration, double cooldown)
+{
+	std::vector<SustainedWorkload> workloads;
+	std::string list(variants);
+	for (size_t pos = 0; pos <= list.size(); ) {
+		size_t end = std::min(list.find(',', pos), list.size());
+		std::string name = list.substr(pos, end-pos);
+		SustainedWorkload workload;
+		if (name == "isa") {
+			for (const char *isaName: isaVariants) {
+				if (findWorkload(&workload, isaName))
+					workloads.push_back(workload);
+			}
+		}
+		else if (findWorkload(&workload, name)) {
+			workloads.push_back(workload);
+		}
+		else {
+			fprintf(stderr, "Unknown or unsupported variant: %s\n", name.c_str());
+			return 2;
+		}
+		pos = end+1;
+	}
+	std::vector<unsigned> threadCounts;
+	if (!parseThreads(&threadCounts, threads)) {
+		fprintf(stderr, "Invalid thread count, expected N or M-N: %s\n", threads);
+		return 2;
+	}
+	if (duration < 1) {
+		fprintf(stderr, "Duration must be at least one second, the throughput is averaged over one second: %g\n", duration);
+		return 2;
+	}
+	std::vector<int> cpus = allowedCpus();
+
+	printf("series,variant,threads,time,mops,mhz\n");
+	std::vector<SustainedSummary> summaries;
+	for (unsigned threadCount: threadCounts) {
+		for (const SustainedWorkload &workload: workloads) {
+			if (!summaries.empty() && cooldown > 0)
+				std::this_thread::sleep_for(std::chrono::duration<double>(cooldown));
+			summaries.push_back(summarize(workload.name, threadCount, runSustainedSeries(workload, cpus, threadCount, duration)));
+		}
+	}
+
+	// frequency drop is relative to the first variant run with the same thread count, i.e. the lowest ISA level for isa
+	printf("%-25s %7s %12s %12s %10s %10s %8s\n", "variant", "threads", "peak-MOPS", "steady-MOPS", "throttle-s", "steady-MHz", "drop-%");
+	for (const SustainedSummary &summary: summaries) {
+		const SustainedSummary *baseline = nullptr;
+		for (const SustainedSummary &b: summaries) {
+			if (b.threads == summary.threads) {
+				baseline = &b;
+				break;
+			}
+		}
+		char throttle[32], drop[32];
+		if (summary.throttleTime >= 0)
+			snprintf(throttle, sizeof(throttle), "%.1f", summary.throttleTime);
+		else
+			snprintf(throttle, sizeof(throttle), "none");
+		if (baseline->steadyMhz > 0)
+			snprintf(drop, sizeof(drop), "%.1f", (1-summary.steadyMhz/baseline->steadyMhz)*100);
+		else
+			snprintf(drop, sizeof(drop), "n/a");
+		printf("%-25s %7u %12.3f %12.3f %10s %10.0f %8s\n", summary.name.c_str(), summary.threads, summary.peakMops, summary.steadyMops, throttle, summary.steadyMhz, drop);
+	}
+	return 0;
+}